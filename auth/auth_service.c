@@ -0,0 +1,414 @@
+#define WLOG_MODULE auth
+#include "auth_service.h"
+#include "tropic_proto.h"
+#include "wallet_log.h"
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+typedef struct auth_request auth_request_t;
+
+struct auth_request {
+    auth_request_t *next;
+    auth_completion_t result;
+    auth_callback_t done;
+    uint64_t queued_us;
+    // Arguments of the call, as passed by the submitter
+    const uint8_t *data;
+    size_t data_size;
+    const uint8_t *signature;       // AUTH_OP_VERIFY input, out_size long
+    uint8_t *out;                   // Signature, key or token output
+    size_t out_size;
+    const char *service_name;
+    device_binding_t *binding;
+    tropic_sign_item_t *items;
+    size_t count;
+};
+
+typedef struct {
+    auth_request_t *head;
+    auth_request_t *tail;
+} request_list_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool running;
+    int efd;
+    uint32_t next_id;
+    auth_request_t pool[AUTH_SERVICE_QUEUE_SIZE];
+    auth_request_t *free_list;
+    request_list_t queue[AUTH_PRIORITY_COUNT];
+    request_list_t completed;
+} svc = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .efd = -1,
+};
+
+static uint64_t service_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void list_append(request_list_t *list, auth_request_t *req) {
+    req->next = NULL;
+    if (list->tail) {
+        list->tail->next = req;
+    } else {
+        list->head = req;
+    }
+    list->tail = req;
+}
+
+static void list_prepend(request_list_t *list, auth_request_t *req) {
+    req->next = list->head;
+    list->head = req;
+    if (!list->tail) {
+        list->tail = req;
+    }
+}
+
+/**
+ * Unlink req, whose predecessor in the list is prev (NULL for the head)
+ */
+static void list_remove(request_list_t *list, auth_request_t *prev, auth_request_t *req) {
+    if (prev) {
+        prev->next = req->next;
+    } else {
+        list->head = req->next;
+    }
+    if (list->tail == req) {
+        list->tail = prev;
+    }
+    req->next = NULL;
+}
+
+static void request_free(auth_request_t *req) {
+    memset(req, 0, sizeof(*req));
+    req->next = svc.free_list;
+    svc.free_list = req;
+}
+
+/**
+ * Take the most urgent request, plus the signatures queued right behind it
+ * at its level when it is one, so they share a single batch on the chip.
+ * Levels above it are empty, and a signature further back waits its turn:
+ * coalescing never lets a request overtake one queued before it, or one
+ * of a more urgent level.
+ * @return number of requests taken (0 if all queues are empty)
+ */
+static size_t service_take(auth_request_t **batch) {
+    size_t n = 0;
+    int p;
+
+    for (p = 0; p < AUTH_PRIORITY_COUNT; p++) {
+        if (svc.queue[p].head) {
+            break;
+        }
+    }
+    if (p == AUTH_PRIORITY_COUNT) {
+        return 0;
+    }
+
+    auth_request_t *req = svc.queue[p].head;
+    do {
+        list_remove(&svc.queue[p], NULL, req);
+        batch[n++] = req;
+        req = svc.queue[p].head;
+    } while (batch[0]->result.op == AUTH_OP_SIGN && req && req->result.op == AUTH_OP_SIGN &&
+             n < TROPIC_SIGN_BATCH_MAX);
+    return n;
+}
+
+static void service_run(auth_request_t **batch, size_t n) {
+    auth_request_t *req = batch[0];
+
+    switch (req->result.op) {
+    case AUTH_OP_SIGN: {
+        tropic_sign_item_t items[TROPIC_SIGN_BATCH_MAX];
+        for (size_t i = 0; i < n; i++) {
+            items[i] = (tropic_sign_item_t){
+                .data = batch[i]->data, .data_size = batch[i]->data_size,
+                .signature = batch[i]->out, .signature_size = batch[i]->out_size,
+            };
+        }
+        int ret = tropic_auth_sign_batch(items, n);
+        for (size_t i = 0; i < n; i++) {
+            batch[i]->result.status = ret < 0 ? ret : items[i].status;
+        }
+        break;
+    }
+    case AUTH_OP_SIGN_BATCH:
+        req->result.status = tropic_auth_sign_batch(req->items, req->count);
+        break;
+    case AUTH_OP_VERIFY:
+        req->result.status = tropic_auth_verify(req->data, req->data_size,
+                                                req->signature, req->out_size);
+        break;
+    case AUTH_OP_DERIVE_KEY:
+        req->result.status = tropic_auth_derive_key(req->service_name, req->out, req->out_size);
+        break;
+    case AUTH_OP_SERVICE_TOKEN:
+        // A token asked for before the identity check ran waits for it
+        // here rather than failing
+        req->result.status = req->binding->identity_verified
+                                 ? 0 : device_binding_verify_identity(req->binding);
+        if (req->result.status >= 0) {
+            req->result.status = device_binding_get_service_token(req->binding, req->service_name,
+                                                                  req->out, req->out_size);
+        }
+        break;
+    case AUTH_OP_VERIFY_IDENTITY:
+        req->result.status = device_binding_verify_identity(req->binding);
+        break;
+    }
+}
+
+static void *service_thread(void *arg) {
+    auth_request_t *batch[TROPIC_SIGN_BATCH_MAX];
+    (void)arg;
+
+    pthread_mutex_lock(&svc.lock);
+    while (svc.running) {
+        size_t n = service_take(batch);
+        if (!n) {
+            pthread_cond_wait(&svc.cond, &svc.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&svc.lock);
+
+        uint64_t start = service_clock_us();
+        service_run(batch, n);
+        uint64_t end = service_clock_us();
+
+        pthread_mutex_lock(&svc.lock);
+        for (size_t i = 0; i < n; i++) {
+            batch[i]->result.wait_us = (uint32_t)(start - batch[i]->queued_us);
+            batch[i]->result.run_us = (uint32_t)(end - start);
+            list_append(&svc.completed, batch[i]);
+        }
+        uint64_t one = 1;
+        if (write(svc.efd, &one, sizeof(one)) < 0) {
+            // Counter saturated: the dispatcher is already due to run
+        }
+    }
+    pthread_mutex_unlock(&svc.lock);
+    return NULL;
+}
+
+int auth_service_start(void) {
+    pthread_mutex_lock(&svc.lock);
+    if (svc.running) {
+        pthread_mutex_unlock(&svc.lock);
+        return -1;
+    }
+
+    svc.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (svc.efd < 0) {
+        pthread_mutex_unlock(&svc.lock);
+        return -1;
+    }
+    memset(svc.queue, 0, sizeof(svc.queue));
+    memset(&svc.completed, 0, sizeof(svc.completed));
+    svc.free_list = NULL;
+    for (int i = AUTH_SERVICE_QUEUE_SIZE - 1; i >= 0; i--) {
+        request_free(&svc.pool[i]);
+    }
+
+    svc.running = true;
+    if (pthread_create(&svc.thread, NULL, service_thread, NULL) != 0) {
+        svc.running = false;
+        close(svc.efd);
+        svc.efd = -1;
+        pthread_mutex_unlock(&svc.lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&svc.lock);
+
+    WLOG_INFO("Auth service started");
+    return 0;
+}
+
+void auth_service_stop(void) {
+    pthread_mutex_lock(&svc.lock);
+    if (!svc.running) {
+        pthread_mutex_unlock(&svc.lock);
+        return;
+    }
+    svc.running = false;
+    pthread_cond_signal(&svc.cond);
+    pthread_mutex_unlock(&svc.lock);
+
+    pthread_join(svc.thread, NULL);
+
+    pthread_mutex_lock(&svc.lock);
+    close(svc.efd);
+    svc.efd = -1;
+    memset(svc.pool, 0, sizeof(svc.pool));
+    memset(svc.queue, 0, sizeof(svc.queue));
+    memset(&svc.completed, 0, sizeof(svc.completed));
+    svc.free_list = NULL;
+    pthread_mutex_unlock(&svc.lock);
+}
+
+int auth_service_fd(void) {
+    return svc.efd;
+}
+
+int auth_service_dispatch(void) {
+    uint64_t count;
+    int ran = 0;
+
+    if (svc.efd < 0 || read(svc.efd, &count, sizeof(count)) < 0) {
+        return 0;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&svc.lock);
+        auth_request_t *req = svc.completed.head;
+        if (!req) {
+            pthread_mutex_unlock(&svc.lock);
+            break;
+        }
+        list_remove(&svc.completed, NULL, req);
+        auth_completion_t result = req->result;
+        auth_callback_t done = req->done;
+        // Free the slot first so the callback can queue a follow-up
+        request_free(req);
+        pthread_mutex_unlock(&svc.lock);
+
+        if (done) {
+            done(&result);
+        }
+        ran++;
+    }
+    return ran;
+}
+
+/**
+ * Copy a prepared request into a free slot and queue it
+ */
+static int service_submit(const auth_request_t *tmpl) {
+    if ((unsigned)tmpl->result.priority >= AUTH_PRIORITY_COUNT) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&svc.lock);
+    auth_request_t *req = svc.free_list;
+    if (!svc.running || !req) {
+        pthread_mutex_unlock(&svc.lock);
+        return -1;
+    }
+    svc.free_list = req->next;
+
+    *req = *tmpl;
+    if (svc.next_id >= INT_MAX) {
+        svc.next_id = 0;
+    }
+    req->result.id = ++svc.next_id;
+    req->queued_us = service_clock_us();
+    // Everything else that uses the binding depends on its identity
+    if (req->result.op == AUTH_OP_VERIFY_IDENTITY) {
+        list_prepend(&svc.queue[req->result.priority], req);
+    } else {
+        list_append(&svc.queue[req->result.priority], req);
+    }
+    pthread_cond_signal(&svc.cond);
+
+    int id = (int)req->result.id;
+    pthread_mutex_unlock(&svc.lock);
+    return id;
+}
+
+int auth_service_sign(auth_priority_t priority, const uint8_t *data, size_t data_size,
+                      uint8_t *signature, size_t signature_size,
+                      auth_callback_t done, void *user_data) {
+    auth_request_t req = {
+        .result = { .op = AUTH_OP_SIGN, .priority = priority, .user_data = user_data },
+        .done = done,
+        .data = data, .data_size = data_size,
+        .out = signature, .out_size = signature_size,
+    };
+    return service_submit(&req);
+}
+
+int auth_service_sign_batch(auth_priority_t priority, tropic_sign_item_t *items, size_t count,
+                            auth_callback_t done, void *user_data) {
+    auth_request_t req = {
+        .result = { .op = AUTH_OP_SIGN_BATCH, .priority = priority, .user_data = user_data },
+        .done = done,
+        .items = items, .count = count,
+    };
+    return service_submit(&req);
+}
+
+int auth_service_verify(auth_priority_t priority, const uint8_t *data, size_t data_size,
+                        const uint8_t *signature, size_t signature_size,
+                        auth_callback_t done, void *user_data) {
+    auth_request_t req = {
+        .result = { .op = AUTH_OP_VERIFY, .priority = priority, .user_data = user_data },
+        .done = done,
+        .data = data, .data_size = data_size,
+        .signature = signature, .out_size = signature_size,
+    };
+    return service_submit(&req);
+}
+
+int auth_service_derive_key(auth_priority_t priority, const char *service_name,
+                            uint8_t *key, size_t key_size,
+                            auth_callback_t done, void *user_data) {
+    auth_request_t req = {
+        .result = { .op = AUTH_OP_DERIVE_KEY, .priority = priority, .user_data = user_data },
+        .done = done,
+        .service_name = service_name,
+        .out = key, .out_size = key_size,
+    };
+    return service_submit(&req);
+}
+
+int auth_service_get_service_token(auth_priority_t priority, device_binding_t *binding,
+                                   const char *service_name, uint8_t *token, size_t token_size,
+                                   auth_callback_t done, void *user_data) {
+    auth_request_t req = {
+        .result = { .op = AUTH_OP_SERVICE_TOKEN, .priority = priority, .user_data = user_data },
+        .done = done,
+        .binding = binding, .service_name = service_name,
+        .out = token, .out_size = token_size,
+    };
+    return service_submit(&req);
+}
+
+int auth_service_verify_identity(auth_priority_t priority, device_binding_t *binding,
+                                 auth_callback_t done, void *user_data) {
+    auth_request_t req = {
+        .result = { .op = AUTH_OP_VERIFY_IDENTITY, .priority = priority, .user_data = user_data },
+        .done = done,
+        .binding = binding,
+    };
+    return service_submit(&req);
+}
+
+int auth_service_cancel(uint32_t id) {
+    int ret = -1;
+
+    pthread_mutex_lock(&svc.lock);
+    for (int p = 0; p < AUTH_PRIORITY_COUNT && ret < 0; p++) {
+        auth_request_t *prev = NULL;
+        for (auth_request_t *req = svc.queue[p].head; req; prev = req, req = req->next) {
+            if (req->result.id == id) {
+                list_remove(&svc.queue[p], prev, req);
+                request_free(req);
+                ret = 0;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&svc.lock);
+    return ret;
+}
@@ -1,11 +1,195 @@
+#define WLOG_MODULE auth
 #include "device_binding.h"
 #include "tropic_auth.h"
+#include "secure_arena.h"
+#include "wallet_log.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+
+// Device identity kept across boots so startup needs no Tropic01 traffic
+#ifndef DEVICE_IDENTITY_CACHE_PATH
+#define DEVICE_IDENTITY_CACHE_PATH "/var/lib/wallet/identity.cache"
+#endif
+#define IDENTITY_CACHE_MAGIC "WIDC"
+#define IDENTITY_CACHE_VERSION 1
+// Service name the cache MAC key is derived under
+#define IDENTITY_CACHE_KEY_SERVICE "wallet-identity-cache"
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint8_t device_id[DEVICE_ID_SIZE];
+    uint8_t cert[DEVICE_CERT_SIZE];
+    uint8_t mac[32];    // HMAC-SHA256 over the fields above
+} identity_cache_file_t;
+
+// Size of a service key derived by the Tropic01
+#define SERVICE_KEY_SIZE 32
+
+/**
+ * One cached service. The derived key stays here, in the arena, and each
+ * token is computed with an HMAC context that is freed, and wiped by
+ * OpenSSL, before it returns: a context kept across calls would hold the
+ * key's pad digests on the ordinary heap.
+ */
+typedef struct {
+    char service[SERVICE_NAME_MAX];
+    size_t service_len;
+    bool in_use;
+    uint8_t key[SERVICE_KEY_SIZE];
+    uint8_t token[SERVICE_TOKEN_SIZE];
+    uint64_t expires_ms;   // 0 = no expiry
+    bool token_valid;
+} token_slot_t;
+
+/**
+ * Token cache, kept in the locked arena with the other key material
+ */
+struct service_token_cache {
+    pthread_mutex_t lock;
+    EVP_MAC *hmac;
+    unsigned int next_victim;
+    token_slot_t slots[SERVICE_TOKEN_CACHE_SLOTS];
+};
+
+static uint64_t token_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static service_token_cache_t *token_cache_alloc(void) {
+    service_token_cache_t *cache = secure_alloc(sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->hmac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if (!cache->hmac) {
+        secure_free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static void token_slot_clear(token_slot_t *slot) {
+    OPENSSL_cleanse(slot, sizeof(*slot));
+}
+
+static void token_cache_free(service_token_cache_t *cache) {
+    for (int i = 0; i < SERVICE_TOKEN_CACHE_SLOTS; i++) {
+        token_slot_clear(&cache->slots[i]);
+    }
+    EVP_MAC_free(cache->hmac);
+    pthread_mutex_destroy(&cache->lock);
+    secure_free(cache);
+}
+
+/**
+ * Token = HMAC(service_key, service_name || device_id), with a context
+ * that lives only for this call
+ */
+static int token_compute(EVP_MAC *hmac, const uint8_t *key, const char *service_name,
+                         size_t service_len, const uint8_t *device_id, uint8_t *token) {
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0),
+        OSSL_PARAM_construct_end()
+    };
+    size_t out_len = 0;
+
+    EVP_MAC_CTX *mac = EVP_MAC_CTX_new(hmac);
+    int ok = mac && EVP_MAC_init(mac, key, SERVICE_KEY_SIZE, params) &&
+             EVP_MAC_update(mac, (const unsigned char *)service_name, service_len) &&
+             EVP_MAC_update(mac, device_id, DEVICE_ID_SIZE) &&
+             EVP_MAC_final(mac, token, &out_len, SERVICE_TOKEN_SIZE);
+    EVP_MAC_CTX_free(mac);
+    return ok && out_len == SERVICE_TOKEN_SIZE ? 0 : -1;
+}
+
+static const char *identity_cache_path(void) {
+    const char *path = getenv("WALLET_IDENTITY_CACHE");
+    return path && *path ? path : DEVICE_IDENTITY_CACHE_PATH;
+}
+
+/**
+ * MAC a cache record under a key only the Tropic01 can derive
+ */
+static int identity_cache_mac(const identity_cache_file_t *rec, uint8_t mac[32]) {
+    uint8_t *key = secure_alloc(32);
+    unsigned int mac_len = 32;
+    
+    if (!key || tropic_auth_derive_key(IDENTITY_CACHE_KEY_SERVICE, key, 32) < 0) {
+        secure_free(key);
+        return -1;
+    }
+    const uint8_t *ok = HMAC(EVP_sha256(), key, 32, (const unsigned char *)rec,
+                             offsetof(identity_cache_file_t, mac), mac, &mac_len);
+    secure_free(key);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Read the cache record; only its layout is checked here, the MAC needs
+ * the chip and is left to device_binding_verify_identity()
+ */
+static int identity_cache_load(identity_cache_file_t *rec) {
+    int fd = open(identity_cache_path(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, rec, sizeof(*rec));
+    close(fd);
+    
+    if (n != (ssize_t)sizeof(*rec) || memcmp(rec->magic, IDENTITY_CACHE_MAGIC, 4) != 0 ||
+        rec->version != IDENTITY_CACHE_VERSION) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write the binding's identity to the cache, replacing it atomically
+ */
+static int identity_cache_store(const device_binding_t *binding) {
+    identity_cache_file_t rec;
+    char tmp[PATH_MAX];
+    const char *path = identity_cache_path();
+    
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.magic, IDENTITY_CACHE_MAGIC, 4);
+    rec.version = IDENTITY_CACHE_VERSION;
+    memcpy(rec.device_id, binding->device_id, DEVICE_ID_SIZE);
+    memcpy(rec.cert, binding->cert, DEVICE_CERT_SIZE);
+    if (identity_cache_mac(&rec, rec.mac) < 0 ||
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return -1;
+    }
+    
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        WLOG_WARN("Device binding: cannot write identity cache %s", path);
+        return -1;
+    }
+    bool ok = write(fd, &rec, sizeof(rec)) == (ssize_t)sizeof(rec) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
 
 int device_binding_init(device_binding_t *binding) {
     if (!binding) {
@@ -13,31 +197,107 @@ int device_binding_init(device_binding_t *binding) {
     }
     
     memset(binding, 0, sizeof(device_binding_t));
+    // Both up front: token requests may come from several threads, and
+    // nothing is left to create under a lock later
+    binding->binding_key = secure_alloc(BINDING_KEY_SIZE);
+    binding->token_cache = token_cache_alloc();
+    if (!binding->binding_key || !binding->token_cache) {
+        device_binding_deinit(binding);
+        return -1;
+    }
+    
+    // Start from the cached identity; it is checked against the chip later
+    identity_cache_file_t rec;
+    if (identity_cache_load(&rec) == 0) {
+        memcpy(binding->device_id, rec.device_id, DEVICE_ID_SIZE);
+        memcpy(binding->cert, rec.cert, DEVICE_CERT_SIZE);
+        binding->identity_verified = false;
+        binding->is_bound = false;
+        return 0;
+    }
     
     // Generate device ID from Tropic01
     if (device_binding_generate_id(binding, binding->device_id, DEVICE_ID_SIZE) < 0) {
+        device_binding_deinit(binding);
         return -1;
     }
+    binding->identity_verified = true;
+    identity_cache_store(binding);
     
     binding->is_bound = false;
     return 0;
 }
 
+int device_binding_verify_identity(device_binding_t *binding) {
+    if (!binding) {
+        return -1;
+    }
+    
+    if (binding->identity_verified) {
+        return 0;
+    }
+    
+    uint8_t device_id[DEVICE_ID_SIZE];
+    uint8_t cached_id[DEVICE_ID_SIZE];
+    uint8_t cached_cert[DEVICE_CERT_SIZE];
+    memcpy(cached_id, binding->device_id, DEVICE_ID_SIZE);
+    memcpy(cached_cert, binding->cert, DEVICE_CERT_SIZE);
+    if (device_binding_generate_id(binding, device_id, sizeof(device_id)) < 0) {
+        memcpy(binding->cert, cached_cert, DEVICE_CERT_SIZE);
+        return -1;
+    }
+    
+    // The record must still be the one we started from, under the chip's MAC
+    identity_cache_file_t rec;
+    uint8_t mac[32];
+    bool valid = identity_cache_load(&rec) == 0 && identity_cache_mac(&rec, mac) == 0 &&
+                 CRYPTO_memcmp(mac, rec.mac, sizeof(mac)) == 0 &&
+                 memcmp(rec.device_id, cached_id, DEVICE_ID_SIZE) == 0 &&
+                 memcmp(rec.cert, cached_cert, DEVICE_CERT_SIZE) == 0 &&
+                 memcmp(device_id, cached_id, DEVICE_ID_SIZE) == 0 &&
+                 memcmp(binding->cert, cached_cert, DEVICE_CERT_SIZE) == 0;
+    binding->identity_verified = true;
+    if (valid) {
+        return 0;
+    }
+    
+    WLOG_WARN("Device binding: cached identity does not match Tropic01, replacing it");
+    memcpy(binding->device_id, device_id, DEVICE_ID_SIZE);
+    OPENSSL_cleanse(binding->binding_key, BINDING_KEY_SIZE);
+    binding->is_bound = false;
+    device_binding_invalidate_tokens(binding, NULL);
+    identity_cache_store(binding);
+    return 1;
+}
+
+void device_binding_deinit(device_binding_t *binding) {
+    if (!binding) {
+        return;
+    }
+    
+    if (binding->token_cache) {
+        token_cache_free(binding->token_cache);
+    }
+    secure_free(binding->binding_key);
+    OPENSSL_cleanse(binding, sizeof(device_binding_t));
+}
+
 int device_binding_generate_id(device_binding_t *binding, uint8_t *device_id, size_t device_id_size) {
     if (!binding || !device_id || device_id_size < DEVICE_ID_SIZE) {
         return -1;
     }
     
-    // Use Tropic01 to generate device certificate
-    uint8_t cert[256];
-    if (tropic_auth_generate_cert(cert, sizeof(cert)) < 0) {
+    // Use Tropic01 to generate device certificate; the chip fills only
+    // the start of the buffer, keep the rest zero so the ID is stable
+    memset(binding->cert, 0, DEVICE_CERT_SIZE);
+    if (tropic_auth_generate_cert(binding->cert, DEVICE_CERT_SIZE) < 0) {
         return -1;
     }
     
     // Hash certificate to get device ID
     SHA256_CTX ctx;
     SHA256_Init(&ctx);
-    SHA256_Update(&ctx, cert, sizeof(cert));
+    SHA256_Update(&ctx, binding->cert, DEVICE_CERT_SIZE);
     SHA256_Final(device_id, &ctx);
     
     return 0;
@@ -47,6 +307,9 @@ int device_binding_create(device_binding_t *binding, const char *base_station_id
     if (!binding || !base_station_id || !binding_key) {
         return -1;
     }
+    if (!binding->identity_verified) {
+        return DEVICE_BINDING_UNVERIFIED;
+    }
     
     // Derive binding key from device ID and base station ID
     // Using HMAC-SHA256
@@ -58,6 +321,9 @@ int device_binding_create(device_binding_t *binding, const char *base_station_id
     memcpy(binding->binding_key, binding_key, BINDING_KEY_SIZE);
     binding->is_bound = true;
     
+    // Tokens issued under a previous binding must not be handed out again
+    device_binding_invalidate_tokens(binding, NULL);
+    
     return 0;
 }
 
@@ -81,38 +347,147 @@ int device_binding_sign(device_binding_t *binding, const uint8_t *challenge, siz
     if (signature_size < SIGNATURE_SIZE) {
         return -1;
     }
+    if (!binding->identity_verified) {
+        return DEVICE_BINDING_UNVERIFIED;
+    }
     
     // Sign challenge using Tropic01
     return tropic_auth_sign(challenge, challenge_size, signature, signature_size);
 }
 
+int device_binding_sign_batch(device_binding_t *binding, tropic_sign_item_t *items, size_t count) {
+    if (!binding || (!items && count)) {
+        return -1;
+    }
+    if (!binding->identity_verified) {
+        return DEVICE_BINDING_UNVERIFIED;
+    }
+    
+    // Sign challenges using Tropic01; items with a signature buffer
+    // shorter than SIGNATURE_SIZE fail on their own
+    return tropic_auth_sign_batch(items, count);
+}
+
 int device_binding_get_service_token(device_binding_t *binding, const char *service_name,
                                     uint8_t *token, size_t token_size) {
-    if (!binding || !service_name || !token) {
+    if (!binding || !service_name || !token || token_size < SERVICE_TOKEN_SIZE) {
         return -1;
     }
+    // Tokens are keyed by the device ID, which may still be a forged cache
+    if (!binding->identity_verified) {
+        return DEVICE_BINDING_UNVERIFIED;
+    }
     
-    // Derive service-specific key from binding key
-    uint8_t service_key[32];
-    if (tropic_auth_derive_key(service_name, service_key, sizeof(service_key)) < 0) {
-        return -1;
+    service_token_cache_t *cache = binding->token_cache;
+    size_t service_len = strlen(service_name);
+    int ret = -1;
+    
+    // Names that do not fit a slot are derived from scratch every time
+    if (service_len >= SERVICE_NAME_MAX) {
+        uint8_t *key = secure_alloc(SERVICE_KEY_SIZE);
+        if (key && tropic_auth_derive_key(service_name, key, SERVICE_KEY_SIZE) == 0) {
+            ret = token_compute(cache->hmac, key, service_name, service_len,
+                                binding->device_id, token);
+        }
+        secure_free(key);
+        return ret;
     }
     
-    // Create token: HMAC(binding_key, service_name || device_id)
-    size_t data_len = strlen(service_name) + DEVICE_ID_SIZE;
-    uint8_t *data = malloc(data_len);
-    if (!data) {
-        return -1;
+    pthread_mutex_lock(&cache->lock);
+    
+    token_slot_t *slot = NULL;
+    for (int i = 0; i < SERVICE_TOKEN_CACHE_SLOTS; i++) {
+        token_slot_t *s = &cache->slots[i];
+        if (s->in_use && s->service_len == service_len &&
+            memcmp(s->service, service_name, service_len) == 0) {
+            slot = s;
+            break;
+        }
     }
     
-    memcpy(data, service_name, strlen(service_name));
-    memcpy(data + strlen(service_name), binding->device_id, DEVICE_ID_SIZE);
+    uint64_t now = binding->token_ttl_ms ? token_clock_ms() : 0;
+    if (slot && slot->token_valid && (slot->expires_ms == 0 || now < slot->expires_ms)) {
+        memcpy(token, slot->token, SERVICE_TOKEN_SIZE);
+        pthread_mutex_unlock(&cache->lock);
+        return 0;
+    }
     
-    unsigned int token_len = token_size;
-    HMAC(EVP_sha256(), service_key, sizeof(service_key),
-         data, data_len, token, &token_len);
+    if (!slot) {
+        // Prefer an empty slot, otherwise evict round-robin
+        for (int i = 0; i < SERVICE_TOKEN_CACHE_SLOTS && !slot; i++) {
+            if (!cache->slots[i].in_use) {
+                slot = &cache->slots[i];
+            }
+        }
+        if (!slot) {
+            slot = &cache->slots[cache->next_victim];
+            cache->next_victim = (cache->next_victim + 1) % SERVICE_TOKEN_CACHE_SLOTS;
+            token_slot_clear(slot);
+        }
+        if (tropic_auth_derive_key(service_name, slot->key, SERVICE_KEY_SIZE) < 0) {
+            token_slot_clear(slot);
+            goto out;
+        }
+        slot->in_use = true;
+        memcpy(slot->service, service_name, service_len);
+        slot->service_len = service_len;
+    }
     
-    free(data);
-    return 0;
+    slot->token_valid = false;
+    if (token_compute(cache->hmac, slot->key, service_name, service_len, binding->device_id,
+                      slot->token) < 0) {
+        goto out;
+    }
+    slot->expires_ms = binding->token_ttl_ms ? now + binding->token_ttl_ms : 0;
+    slot->token_valid = true;
+    memcpy(token, slot->token, SERVICE_TOKEN_SIZE);
+    ret = 0;
+    
+out:
+    pthread_mutex_unlock(&cache->lock);
+    return ret;
 }
 
+void device_binding_set_token_ttl(device_binding_t *binding, uint32_t ttl_ms) {
+    if (!binding) {
+        return;
+    }
+    
+    service_token_cache_t *cache = binding->token_cache;
+    if (!cache) {
+        binding->token_ttl_ms = ttl_ms;
+        return;
+    }
+    
+    // Expire the cached tokens so none outlives the new lifetime, but keep
+    // the derived keys: they do not depend on the TTL
+    pthread_mutex_lock(&cache->lock);
+    binding->token_ttl_ms = ttl_ms;
+    for (int i = 0; i < SERVICE_TOKEN_CACHE_SLOTS; i++) {
+        cache->slots[i].token_valid = false;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void device_binding_invalidate_tokens(device_binding_t *binding, const char *service_name) {
+    if (!binding || !binding->token_cache) {
+        return;
+    }
+    
+    service_token_cache_t *cache = binding->token_cache;
+    size_t service_len = service_name ? strlen(service_name) : 0;
+    
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < SERVICE_TOKEN_CACHE_SLOTS; i++) {
+        token_slot_t *slot = &cache->slots[i];
+        if (!slot->in_use) {
+            continue;
+        }
+        if (!service_name ||
+            (slot->service_len == service_len &&
+             memcmp(slot->service, service_name, service_len) == 0)) {
+            token_slot_clear(slot);
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
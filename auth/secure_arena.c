@@ -0,0 +1,163 @@
+#define WLOG_MODULE auth
+#include "secure_arena.h"
+#include "wallet_metrics.h"
+#include "wallet_log.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <openssl/crypto.h>
+
+#define ARENA_BLOCKS (SECURE_ARENA_SIZE / SECURE_ARENA_BLOCK)
+
+_Static_assert(SECURE_ARENA_SIZE % SECURE_ARENA_BLOCK == 0, "whole blocks only");
+_Static_assert(ARENA_BLOCKS % 64 == 0, "the bitmap is in 64-bit words");
+_Static_assert(ARENA_BLOCKS <= UINT16_MAX, "runs are 16-bit");
+
+METRICS_GAUGE(m_used, "wallet_secure_arena_used_bytes", "Key material arena bytes in use");
+METRICS_GAUGE(m_max_used, "wallet_secure_arena_max_used_bytes", "High-water mark of the key material arena");
+METRICS_COUNTER(m_failures, "wallet_secure_arena_failures_total",
+                "Key material allocations refused for lack of room");
+
+static struct {
+    pthread_mutex_t lock;
+    uint8_t *map;           // Guard page, arena, guard page
+    size_t map_size;
+    uint8_t *base;
+    uint64_t busy[ARENA_BLOCKS / 64];   // One bit per block
+    uint16_t run[ARENA_BLOCKS];         // Blocks allocated from here, 0 if none
+    size_t used;
+    size_t max_used;
+    unsigned int failures;
+    bool locked;
+    bool ready;
+} arena = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static bool block_busy(size_t i) {
+    return arena.busy[i / 64] >> (i % 64) & 1;
+}
+
+static void blocks_mark(size_t first, size_t n, bool busy) {
+    for (size_t i = first; i < first + n; i++) {
+        if (busy) {
+            arena.busy[i / 64] |= 1ULL << (i % 64);
+        } else {
+            arena.busy[i / 64] &= ~(1ULL << (i % 64));
+        }
+    }
+}
+
+// Called with the lock held
+static int arena_setup(void) {
+    if (arena.ready) {
+        return 0;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (SECURE_ARENA_SIZE + page - 1) / page * page;
+    arena.map_size = size + 2 * page;
+    arena.map = mmap(NULL, arena.map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena.map == MAP_FAILED) {
+        arena.map = NULL;
+        return -1;
+    }
+    arena.base = arena.map + page;
+    if (mprotect(arena.base, size, PROT_READ | PROT_WRITE) < 0) {
+        munmap(arena.map, arena.map_size);
+        arena.map = NULL;
+        return -1;
+    }
+    arena.locked = mlock(arena.base, size) == 0;
+    if (!arena.locked) {
+        WLOG_WARN("secure_arena: cannot lock %zu bytes, key material may be swapped", size);
+    }
+#ifdef MADV_DONTDUMP
+    madvise(arena.base, size, MADV_DONTDUMP);
+#endif
+#ifdef MADV_WIPEONFORK
+    madvise(arena.base, size, MADV_WIPEONFORK);
+#endif
+    arena.ready = true;
+    return 0;
+}
+
+void *secure_alloc(size_t size) {
+    if (size == 0 || size > SECURE_ARENA_SIZE) {
+        return NULL;
+    }
+    size_t n = (size + SECURE_ARENA_BLOCK - 1) / SECURE_ARENA_BLOCK;
+    void *ptr = NULL;
+
+    pthread_mutex_lock(&arena.lock);
+    if (arena_setup() == 0) {
+        // First fit: free blocks are always zero, nothing to clear
+        size_t start = 0, len = 0;
+        for (size_t i = 0; i < ARENA_BLOCKS && len < n; i++) {
+            if (block_busy(i)) {
+                len = 0;
+                start = i + 1;
+            } else {
+                len++;
+            }
+        }
+        if (len == n) {
+            blocks_mark(start, n, true);
+            arena.run[start] = (uint16_t)n;
+            arena.used += n * SECURE_ARENA_BLOCK;
+            if (arena.used > arena.max_used) {
+                arena.max_used = arena.used;
+                metrics_set(&m_max_used, (int64_t)arena.max_used);
+            }
+            metrics_set(&m_used, (int64_t)arena.used);
+            ptr = arena.base + start * SECURE_ARENA_BLOCK;
+        }
+    }
+    if (!ptr) {
+        arena.failures++;
+        metrics_inc(&m_failures);
+    }
+    pthread_mutex_unlock(&arena.lock);
+    return ptr;
+}
+
+void secure_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    pthread_mutex_lock(&arena.lock);
+    uintptr_t offset = (uintptr_t)ptr - (uintptr_t)arena.base;
+    size_t start = offset / SECURE_ARENA_BLOCK;
+    if (!arena.ready || (uint8_t *)ptr < arena.base || offset % SECURE_ARENA_BLOCK ||
+        start >= ARENA_BLOCKS || arena.run[start] == 0) {
+        // A stray free here could hand a live secret to someone else
+        WLOG_ERROR("secure_arena: invalid free of %p", ptr);
+        wlog_flush();
+        abort();
+    }
+    size_t n = arena.run[start];
+    OPENSSL_cleanse(ptr, n * SECURE_ARENA_BLOCK);
+    blocks_mark(start, n, false);
+    arena.run[start] = 0;
+    arena.used -= n * SECURE_ARENA_BLOCK;
+    metrics_set(&m_used, (int64_t)arena.used);
+    pthread_mutex_unlock(&arena.lock);
+}
+
+void secure_arena_stats(secure_arena_stats_t *out) {
+    if (!out) {
+        return;
+    }
+    size_t largest = 0, len = 0;
+    pthread_mutex_lock(&arena.lock);
+    for (size_t i = 0; i < ARENA_BLOCKS; i++) {
+        len = block_busy(i) ? 0 : len + 1;
+        largest = len > largest ? len : largest;
+    }
+    *out = (secure_arena_stats_t){
+        .size = SECURE_ARENA_SIZE, .used = arena.used, .max_used = arena.max_used,
+        .largest_free = largest * SECURE_ARENA_BLOCK, .failures = arena.failures,
+        .locked = arena.locked,
+    };
+    pthread_mutex_unlock(&arena.lock);
+}
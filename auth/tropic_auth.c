@@ -1,32 +1,201 @@
+#define WLOG_MODULE auth
 #include "tropic_auth.h"
-#include <stdio.h>
+#include "tropic_session.h"
+#include "tropic_proto.h"
+#include "wallet_metrics.h"
+#include "secure_arena.h"
+#include "wallet_log.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+#ifdef RADXA_ZERO_3W
+#include "dev_hardware_SPI.h"
+#endif
+
+// Tropic01 sits on the display's SPI controller, on the second chip select
+#ifndef TROPIC01_SPI_DEVICE
+#define TROPIC01_SPI_DEVICE "/dev/spidev1.1"
+#endif
+#define TROPIC01_SPI_SPEED 5000000
+
+// Where the secure session runs unless TROPIC01_TRANSPORT says otherwise:
+// "model", "tcp:HOST:PORT", "unix:PATH" or "spi" (see tropic_session.h).
+// The board talks to the chip; the in-process model has to be asked for.
+#ifndef TROPIC01_DEFAULT_TRANSPORT
+#ifdef RADXA_ZERO_3W
+#define TROPIC01_DEFAULT_TRANSPORT "spi"
+#else
+#define TROPIC01_DEFAULT_TRANSPORT "model"
+#endif
+#endif
+#define TROPIC01_PAIRING_SLOT 0
 
 // Placeholder for Tropic01 integration
 // In real implementation, this would use libtropic-linux API
 static bool tropic_initialized = false;
 
+// One secure session for the lifetime of the process, opened by
+// tropic_auth_init(); NULL falls back to the placeholder crypto below
+static tropic_session_t *tropic_session = NULL;
+static bool tropic_session_tried = false;
+static pthread_mutex_t tropic_session_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static tropic_session_t *tropic_session_get(void);
+
+METRICS_COUNTER(m_signs, "wallet_tropic_signs_total", "Signatures made");
+METRICS_COUNTER(m_sign_errors, "wallet_tropic_sign_errors_total", "Signing requests that failed");
+METRICS_HISTOGRAM(m_sign_us, "wallet_tropic_sign_microseconds", "Time to sign one message");
+METRICS_HISTOGRAM(m_sign_batch_us, "wallet_tropic_sign_batch_microseconds", "Time to sign a batch");
+
+#ifdef RADXA_ZERO_3W
+// Opened with urgent priority so a display frame upload yields to it
+static SPI_DEVICE *tropic_spi = NULL;
+#endif
+
 int tropic_auth_init(void) {
     // TODO: Initialize libtropic-linux connection
     // Example:
     // tropic_handle_t *handle = tropic_open();
     // if (!handle) return -1;
-    
+
+#ifdef RADXA_ZERO_3W
+    tropic_spi = DEV_HARDWARE_SPI_Open(TROPIC01_SPI_DEVICE, SPI_MODE0, TROPIC01_SPI_SPEED,
+                                       SPI_BIT_ORDER_MSBFIRST, SPI_PRIORITY_URGENT);
+    if (!tropic_spi) {
+        WLOG_ERROR("Tropic01: %s not available", TROPIC01_SPI_DEVICE);
+    }
+#endif
+
+    // Handshake now, on the boot thread, rather than in the first
+    // signing request
+    tropic_session_get();
     tropic_initialized = true;
-    printf("Tropic01 authentication initialized\n");
+    WLOG_INFO("Tropic01 authentication initialized");
     return 0;
 }
 
 void tropic_auth_deinit(void) {
-    // TODO: Close Tropic01 connection
-    // tropic_close(handle);
+    // The SPI transport still needs the device while the session aborts
+    pthread_mutex_lock(&tropic_session_lock);
+    tropic_session_close(tropic_session);
+    tropic_session = NULL;
+    tropic_session_tried = false;
+    pthread_mutex_unlock(&tropic_session_lock);
+#ifdef RADXA_ZERO_3W
+    DEV_HARDWARE_SPI_Close(tropic_spi);
+    tropic_spi = NULL;
+#endif
     tropic_initialized = false;
 }
 
+int tropic_auth_spi_begin(void) {
+#ifdef RADXA_ZERO_3W
+    if (!tropic_spi) {
+        return -1;
+    }
+    DEV_HARDWARE_SPI_DeviceLock(tropic_spi);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void tropic_auth_spi_end(void) {
+#ifdef RADXA_ZERO_3W
+    if (tropic_spi) {
+        DEV_HARDWARE_SPI_DeviceUnlock(tropic_spi);
+    }
+#endif
+}
+
+int tropic_auth_spi_transfer(const uint8_t *tx, uint8_t *rx, size_t len) {
+    tropic_spi_segment_t seg = { tx, rx, len };
+    return tropic_auth_spi_transfer_v(&seg, 1);
+}
+
+int tropic_auth_spi_transfer_v(const tropic_spi_segment_t *seg, int count) {
+#ifdef RADXA_ZERO_3W
+    SPI_IOVEC iov[TROPIC_SPI_MAX_SEGMENTS];
+    size_t total = 0;
+
+    if (!tropic_spi || count < 1 || count > TROPIC_SPI_MAX_SEGMENTS) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        iov[i] = (SPI_IOVEC){ seg[i].tx, seg[i].rx, (uint32_t)seg[i].len };
+        total += seg[i].len;
+    }
+    // Past bufsiz the driver splits the message, and the chip select
+    // would rise in the middle of the frame
+    if (total > DEV_HARDWARE_SPI_Bufsiz()) {
+        return -1;
+    }
+    return DEV_HARDWARE_SPI_DeviceTransferV(tropic_spi, iov, count) < 0 ? -1 : 0;
+#else
+    (void)seg;
+    (void)count;
+    return -1;
+#endif
+}
+
+/**
+ * Get the secure session, establishing it on the first call;
+ * tropic_auth_init() makes that first call
+ * @return session, or NULL to use the placeholder crypto
+ */
+static tropic_session_t *tropic_session_get(void) {
+    pthread_mutex_lock(&tropic_session_lock);
+    if (!tropic_session_tried) {
+        tropic_session_tried = true;
+
+        const char *spec = getenv("TROPIC01_TRANSPORT");
+        if (!spec || !*spec) {
+            spec = TROPIC01_DEFAULT_TRANSPORT;
+        }
+        uint8_t *pairing_key = secure_alloc(TROPIC_KEY_SIZE);
+        if (pairing_key) {
+            tropic_seed_key(TROPIC_PLACEHOLDER_PAIRING_SEED, pairing_key);
+            tropic_session = tropic_session_open(tropic_transport_create(spec), TROPIC01_PAIRING_SLOT,
+                                                 pairing_key);
+            secure_free(pairing_key);
+        }
+        if (tropic_session) {
+            tropic_session_stats_t stats;
+            tropic_session_get_stats(tropic_session, &stats);
+            WLOG_INFO("Tropic01: secure session over %s (handshake %llu us)", spec,
+                      (unsigned long long)stats.last_handshake_us);
+        } else {
+            WLOG_WARN("Tropic01: no secure session over %s, using placeholder crypto", spec);
+        }
+    }
+    tropic_session_t *session = tropic_session;
+    pthread_mutex_unlock(&tropic_session_lock);
+    return session;
+}
+
+/**
+ * Run one L3 command over the session
+ * @return result payload length, -1 if the chip could not be reached
+ *         or refused the command
+ */
+static int tropic_command(uint8_t cmd, const uint8_t *req, size_t req_len,
+                          uint8_t *res, size_t res_size) {
+    tropic_cmd_t c = {
+        .cmd = cmd, .req = req, .req_len = req_len,
+        .res = res, .res_size = res_size,
+    };
+    if (tropic_session_exec(tropic_session, &c, 1) < 0 || c.result != TROPIC_L3_RESULT_OK) {
+        return -1;
+    }
+    return (int)c.res_len;
+}
+
 int tropic_auth_generate_cert(uint8_t *cert, size_t cert_size) {
     if (!cert || cert_size < 64) {
         return -1;
@@ -36,14 +205,12 @@ int tropic_auth_generate_cert(uint8_t *cert, size_t cert_size) {
         return -1;
     }
     
-    // TODO: Use Tropic01 to generate device certificate
-    // For now, generate a placeholder
-    // In real implementation:
-    // tropic_cert_t *cert_obj = tropic_generate_device_cert();
-    // memcpy(cert, cert_obj->data, cert_size);
+    if (tropic_session_get()) {
+        return tropic_command(TROPIC_L3_GET_CERT, NULL, 0, cert, cert_size) < 0 ? -1 : 0;
+    }
     
     // Placeholder: generate deterministic cert from device
-    const char *seed = "tropic01_device_cert_seed";
+    const char *seed = TROPIC_PLACEHOLDER_CERT_SEED;
     SHA256_CTX ctx;
     SHA256_Init(&ctx);
     SHA256_Update(&ctx, seed, strlen(seed));
@@ -62,17 +229,162 @@ int tropic_auth_sign(const uint8_t *data, size_t data_size,
         return -1;
     }
     
-    // TODO: Use Tropic01 to sign data
-    // In real implementation:
-    // tropic_signature_t *sig = tropic_sign(device_key_handle, data, data_size);
-    // memcpy(signature, sig->data, signature_size);
+    uint64_t start = metrics_now_us();
+    int ret = 0;
+    if (tropic_session_get()) {
+        ret = tropic_command(TROPIC_L3_SIGN, data, data_size, signature, signature_size) < 0 ? -1 : 0;
+    } else {
+        // Placeholder: create deterministic signature
+        const char *key = TROPIC_PLACEHOLDER_DEVICE_KEY;
+        unsigned int sig_len = signature_size;
+        HMAC(EVP_sha256(), key, strlen(key), data, data_size, signature, &sig_len);
+    }
+    
+    metrics_observe(&m_sign_us, metrics_now_us() - start);
+    metrics_inc(ret == 0 ? &m_signs : &m_sign_errors);
+    return ret;
+}
+
+// Signing batch commands in flight at once, with their payloads
+typedef struct {
+    tropic_cmd_t cmds[TROPIC_SESSION_PIPELINE_MAX];
+    size_t first[TROPIC_SESSION_PIPELINE_MAX];     // Index of each command's first item
+    uint8_t req[TROPIC_SESSION_PIPELINE_MAX][TROPIC_L3_MAX - 1];
+    uint8_t res[TROPIC_SESSION_PIPELINE_MAX][TROPIC_SIGN_BATCH_RES_SIZE(TROPIC_SIGN_BATCH_MAX)];
+} sign_window_t;
+
+static bool sign_item_valid(const tropic_sign_item_t *item) {
+    return item->data && item->signature && item->signature_size >= 64 &&
+           item->data_size <= TROPIC_L3_MAX - 1;
+}
+
+/**
+ * Pack the next items into up to TROPIC_SESSION_PIPELINE_MAX commands
+ * @return number of commands, 0 when no items are left
+ */
+static size_t sign_window_pack(sign_window_t *w, tropic_sign_item_t *items, size_t count, size_t *next) {
+    size_t ncmd = 0, i = *next;
+
+    while (ncmd < TROPIC_SESSION_PIPELINE_MAX) {
+        while (i < count && !sign_item_valid(&items[i])) {
+            i++;
+        }
+        if (i == count) {
+            break;
+        }
+
+        tropic_cmd_t *c = &w->cmds[ncmd];
+        size_t len = 0;
+        w->first[ncmd] = i;
+        if (tropic_sign_batch_add(w->req[ncmd], &len, items[i].data, items[i].data_size) < 0) {
+            // Too long to share a command, the plain SIGN still takes it
+            *c = (tropic_cmd_t){
+                .cmd = TROPIC_L3_SIGN, .req = items[i].data, .req_len = items[i].data_size,
+                .res = items[i].signature, .res_size = items[i].signature_size,
+            };
+            i++;
+        } else {
+            for (i++; i < count; i++) {
+                if (sign_item_valid(&items[i]) &&
+                    tropic_sign_batch_add(w->req[ncmd], &len, items[i].data, items[i].data_size) < 0) {
+                    break;
+                }
+            }
+            *c = (tropic_cmd_t){
+                .cmd = TROPIC_L3_SIGN_BATCH, .req = w->req[ncmd], .req_len = len,
+                .res = w->res[ncmd], .res_size = sizeof(w->res[ncmd]),
+            };
+        }
+        ncmd++;
+    }
+
+    *next = i;
+    return ncmd;
+}
+
+/**
+ * Hand the per-item results of executed commands back to the items
+ * @return number of items signed
+ */
+static size_t sign_window_unpack(const sign_window_t *w, size_t ncmd, tropic_sign_item_t *items) {
+    size_t signed_count = 0;
+
+    for (size_t k = 0; k < ncmd; k++) {
+        const tropic_cmd_t *c = &w->cmds[k];
+        size_t i = w->first[k];
+
+        if (c->cmd == TROPIC_L3_SIGN) {
+            if (c->result == TROPIC_L3_RESULT_OK) {
+                items[i].status = 0;
+                signed_count++;
+            }
+            continue;
+        }
+
+        size_t n = w->req[k][0];
+        if (c->result != TROPIC_L3_RESULT_OK || c->res_len != TROPIC_SIGN_BATCH_RES_SIZE(n) ||
+            c->res[0] != n) {
+            continue;
+        }
+        for (size_t j = 0; j < n; i++) {
+            if (!sign_item_valid(&items[i])) {
+                continue;
+            }
+            const uint8_t *r = c->res + 1 + j * (1 + TROPIC_SIGN_BATCH_SIG_SIZE);
+            if (r[0] == TROPIC_L3_RESULT_OK) {
+                memcpy(items[i].signature, r + 1, TROPIC_SIGN_BATCH_SIG_SIZE);
+                items[i].status = 0;
+                signed_count++;
+            }
+            j++;
+        }
+    }
+    return signed_count;
+}
+
+int tropic_auth_sign_batch(tropic_sign_item_t *items, size_t count) {
+    if ((!items && count) || count > INT_MAX) {
+        return -1;
+    }
+    
+    if (!tropic_initialized) {
+        return -1;
+    }
+    
+    size_t signed_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        items[i].status = -1;
+    }
     
-    // Placeholder: create deterministic signature
-    const char *key = "tropic01_device_key";
-    unsigned int sig_len = signature_size;
-    HMAC(EVP_sha256(), key, strlen(key), data, data_size, signature, &sig_len);
+    if (!tropic_session_get()) {
+        // Placeholder: nothing to batch, sign one by one
+        for (size_t i = 0; i < count; i++) {
+            items[i].status = tropic_auth_sign(items[i].data, items[i].data_size,
+                                               items[i].signature, items[i].signature_size);
+            signed_count += items[i].status == 0;
+        }
+        return (int)signed_count;
+    }
     
-    return 0;
+    sign_window_t *w = malloc(sizeof(*w));
+    if (!w) {
+        return -1;
+    }
+    uint64_t start = metrics_now_us();
+    size_t next = 0, ncmd;
+    while ((ncmd = sign_window_pack(w, items, count, &next)) > 0) {
+        if (tropic_session_exec(tropic_session, w->cmds, ncmd) < 0) {
+            break;      // Chip unreachable, the remaining items keep status -1
+        }
+        signed_count += sign_window_unpack(w, ncmd, items);
+    }
+    OPENSSL_cleanse(w, sizeof(*w));
+    free(w);
+    
+    metrics_observe(&m_sign_batch_us, metrics_now_us() - start);
+    metrics_add(&m_signs, (int64_t)signed_count);
+    metrics_add(&m_sign_errors, (int64_t)(count - signed_count));
+    return (int)signed_count;
 }
 
 bool tropic_auth_verify(const uint8_t *data, size_t data_size,
@@ -85,13 +397,21 @@ bool tropic_auth_verify(const uint8_t *data, size_t data_size,
         return false;
     }
     
-    // TODO: Use Tropic01 to verify signature
-    // In real implementation:
-    // return tropic_verify(device_cert, data, data_size, signature, signature_size);
+    if (tropic_session_get()) {
+        // The chip checks the 32-byte MAC part of the signature
+        if (signature_size < 32 || data_size > TROPIC_L3_MAX - 1 - 32) {
+            return false;
+        }
+        uint8_t req[TROPIC_L3_MAX];
+        uint8_t valid = 0;
+        memcpy(req, signature, 32);
+        memcpy(req + 32, data, data_size);
+        return tropic_command(TROPIC_L3_VERIFY, req, 32 + data_size, &valid, 1) == 1 && valid;
+    }
     
     // Placeholder: verify using same key
     uint8_t computed_sig[64];
-    const char *key = "tropic01_device_key";
+    const char *key = TROPIC_PLACEHOLDER_DEVICE_KEY;
     unsigned int sig_len = sizeof(computed_sig);
     HMAC(EVP_sha256(), key, strlen(key), data, data_size, computed_sig, &sig_len);
     
@@ -107,13 +427,13 @@ int tropic_auth_derive_key(const char *service_name, uint8_t *key, size_t key_si
         return -1;
     }
     
-    // TODO: Use Tropic01 key derivation
-    // In real implementation:
-    // tropic_key_t *derived = tropic_derive_key(master_key_handle, service_name);
-    // memcpy(key, derived->data, key_size);
+    if (tropic_session_get()) {
+        return tropic_command(TROPIC_L3_DERIVE_KEY, (const uint8_t *)service_name,
+                              strlen(service_name), key, key_size) < 0 ? -1 : 0;
+    }
     
     // Placeholder: derive key using HKDF-like approach
-    const char *master_key = "tropic01_master_key";
+    const char *master_key = TROPIC_PLACEHOLDER_MASTER_KEY;
     unsigned int key_len = key_size;
     HMAC(EVP_sha256(), master_key, strlen(master_key),
          (const unsigned char *)service_name, strlen(service_name),
@@ -0,0 +1,387 @@
+#include "tropic_model.h"
+#include "tropic_proto.h"
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+// Pairing slots the model accepts; slot 0 holds the placeholder host key
+#define MODEL_PAIRING_SLOTS 1
+
+typedef struct {
+    int fd;
+    tropic_model_config_t config;
+    uint8_t st_priv[TROPIC_KEY_SIZE];
+    uint8_t st_pub[TROPIC_KEY_SIZE];
+    uint8_t sh_pub[MODEL_PAIRING_SLOTS][TROPIC_KEY_SIZE];
+    tropic_channel_t ch;
+    uint32_t commands;
+    // Reassembly of the L3 packet in flight
+    uint8_t l3[2 + TROPIC_L3_MAX + TROPIC_L3_TAG_SIZE];
+    size_t l3_got;
+    uint8_t pt[TROPIC_L3_MAX];
+} model_t;
+
+typedef struct {
+    int fd;
+    tropic_model_config_t config;
+} model_thread_arg_t;
+
+static int model_reply(model_t *m, uint8_t status, const uint8_t *data, uint8_t len) {
+    return tropic_l2_write(m->fd, status, data, len);
+}
+
+static int model_handshake(model_t *m, const tropic_l2_frame_t *req) {
+    uint8_t ec_priv[TROPIC_KEY_SIZE], rsp[TROPIC_KEY_SIZE + TROPIC_L3_TAG_SIZE];
+    uint8_t ikm[3 * TROPIC_KEY_SIZE], hash[32];
+    const uint8_t *eh_pub = req->data;
+    uint8_t slot;
+    int ok;
+
+    if (req->len != TROPIC_KEY_SIZE + 1) {
+        return model_reply(m, TROPIC_L2_GEN_ERR, NULL, 0);
+    }
+    slot = req->data[TROPIC_KEY_SIZE];
+    if (slot >= MODEL_PAIRING_SLOTS) {
+        return model_reply(m, TROPIC_L2_GEN_ERR, NULL, 0);
+    }
+
+    tropic_channel_close(&m->ch);
+    ok = tropic_x25519_keygen(ec_priv, rsp) == 0 &&
+         tropic_x25519(ec_priv, eh_pub, ikm) == 0 &&
+         tropic_x25519(m->st_priv, eh_pub, ikm + TROPIC_KEY_SIZE) == 0 &&
+         tropic_x25519(ec_priv, m->sh_pub[slot], ikm + 2 * TROPIC_KEY_SIZE) == 0;
+    if (ok) {
+        tropic_handshake_hash(m->sh_pub[slot], m->st_pub, eh_pub, rsp, hash);
+        ok = tropic_channel_derive(&m->ch, hash, ikm, rsp + TROPIC_KEY_SIZE) == 0;
+    }
+    OPENSSL_cleanse(ec_priv, sizeof(ec_priv));
+    OPENSSL_cleanse(ikm, sizeof(ikm));
+
+    if (m->config.handshake_us) {
+        usleep(m->config.handshake_us);
+    }
+    if (!ok) {
+        return model_reply(m, TROPIC_L2_GEN_ERR, NULL, 0);
+    }
+    m->l3_got = 0;
+    return model_reply(m, TROPIC_L2_OK, rsp, sizeof(rsp));
+}
+
+static void model_hmac(const char *key, const uint8_t *data, size_t len, uint8_t out[32]) {
+    unsigned int out_len = 32;
+    HMAC(EVP_sha256(), key, (int)strlen(key), data, len, out, &out_len);
+}
+
+/**
+ * Sign every message of a SIGN_BATCH payload, see tropic_proto.h
+ */
+static size_t model_sign_batch(model_t *m, const uint8_t *payload, size_t payload_len) {
+    uint8_t res[TROPIC_SIGN_BATCH_RES_SIZE(TROPIC_SIGN_BATCH_MAX)];
+    size_t off = 1, count;
+
+    if (payload_len < 1 || payload[0] == 0 || payload[0] > TROPIC_SIGN_BATCH_MAX) {
+        m->pt[0] = TROPIC_L3_RESULT_INVALID;
+        return 1;
+    }
+    count = payload[0];
+    res[0] = (uint8_t)count;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *item = res + 1 + i * (1 + TROPIC_SIGN_BATCH_SIG_SIZE);
+        size_t len;
+        if (off + 2 > payload_len ||
+            (len = (size_t)(payload[off] | (payload[off + 1] << 8))) > payload_len - off - 2) {
+            // Truncated payload: this item and every one after it fail
+            item[0] = TROPIC_L3_RESULT_FAIL;
+            memset(item + 1, 0, TROPIC_SIGN_BATCH_SIG_SIZE);
+            continue;
+        }
+        item[0] = TROPIC_L3_RESULT_OK;
+        model_hmac(TROPIC_PLACEHOLDER_DEVICE_KEY, payload + off + 2, len, item + 1);
+        off += 2 + len;
+    }
+
+    m->pt[0] = TROPIC_L3_RESULT_OK;
+    memcpy(m->pt + 1, res, TROPIC_SIGN_BATCH_RES_SIZE(count));
+    OPENSSL_cleanse(res, sizeof(res));
+    return 1 + TROPIC_SIGN_BATCH_RES_SIZE(count);
+}
+
+/**
+ * Execute one decrypted command in place: m->pt holds the command on
+ * entry and the result on return
+ */
+static size_t model_execute(model_t *m, size_t len) {
+    const uint8_t *payload = m->pt + 1;
+    size_t payload_len = len - 1;
+    uint8_t out[32];
+
+    switch (m->pt[0]) {
+    case TROPIC_L3_PING:
+        memmove(m->pt + 1, payload, payload_len);
+        m->pt[0] = TROPIC_L3_RESULT_OK;
+        return len;
+    case TROPIC_L3_GET_CERT:
+        SHA256((const unsigned char *)TROPIC_PLACEHOLDER_CERT_SEED,
+               strlen(TROPIC_PLACEHOLDER_CERT_SEED), out);
+        break;
+    case TROPIC_L3_SIGN:
+        model_hmac(TROPIC_PLACEHOLDER_DEVICE_KEY, payload, payload_len, out);
+        break;
+    case TROPIC_L3_SIGN_BATCH:
+        return model_sign_batch(m, payload, payload_len);
+    case TROPIC_L3_VERIFY:
+        // payload: 32-byte signature | data
+        if (payload_len < 32) {
+            m->pt[0] = TROPIC_L3_RESULT_FAIL;
+            return 1;
+        }
+        model_hmac(TROPIC_PLACEHOLDER_DEVICE_KEY, payload + 32, payload_len - 32, out);
+        m->pt[1] = CRYPTO_memcmp(out, payload, 32) == 0;
+        m->pt[0] = TROPIC_L3_RESULT_OK;
+        return 2;
+    case TROPIC_L3_DERIVE_KEY:
+        model_hmac(TROPIC_PLACEHOLDER_MASTER_KEY, payload, payload_len, out);
+        break;
+    default:
+        m->pt[0] = TROPIC_L3_RESULT_INVALID;
+        return 1;
+    }
+
+    m->pt[0] = TROPIC_L3_RESULT_OK;
+    memcpy(m->pt + 1, out, sizeof(out));
+    OPENSSL_cleanse(out, sizeof(out));
+    return 1 + sizeof(out);
+}
+
+static int model_encrypted_cmd(model_t *m, const tropic_l2_frame_t *req) {
+    if (!m->ch.open) {
+        return model_reply(m, TROPIC_L2_NO_SESSION, NULL, 0);
+    }
+    if (m->l3_got + req->len > sizeof(m->l3)) {
+        m->l3_got = 0;
+        return model_reply(m, TROPIC_L2_GEN_ERR, NULL, 0);
+    }
+    memcpy(m->l3 + m->l3_got, req->data, req->len);
+    m->l3_got += req->len;
+    if (m->l3_got < 2) {
+        return model_reply(m, TROPIC_L2_REQ_CONT, NULL, 0);
+    }
+
+    size_t total = 2 + (size_t)(m->l3[0] | (m->l3[1] << 8)) + TROPIC_L3_TAG_SIZE;
+    if (total > sizeof(m->l3)) {
+        m->l3_got = 0;
+        return model_reply(m, TROPIC_L2_GEN_ERR, NULL, 0);
+    }
+    if (m->l3_got < total) {
+        return model_reply(m, TROPIC_L2_REQ_CONT, NULL, 0);
+    }
+    m->l3_got = 0;
+
+    int n = tropic_channel_open(&m->ch, true, m->l3 + 2, total - 2, m->pt);
+    if (n < 1) {
+        // Like the chip, a bad tag ends the session
+        tropic_channel_close(&m->ch);
+        return model_reply(m, TROPIC_L2_TAG_ERR, NULL, 0);
+    }
+
+    size_t res_len = model_execute(m, (size_t)n);
+    if (m->config.command_us) {
+        usleep(m->config.command_us);
+    }
+
+    int sealed = tropic_channel_seal(&m->ch, false, m->pt, res_len, m->l3 + 2);
+    OPENSSL_cleanse(m->pt, sizeof(m->pt));
+    if (sealed < 0) {
+        return model_reply(m, TROPIC_L2_GEN_ERR, NULL, 0);
+    }
+    m->l3[0] = res_len & 0xFF;
+    m->l3[1] = (res_len >> 8) & 0xFF;
+
+    size_t out_total = (size_t)sealed + 2, off = 0;
+    while (off < out_total) {
+        size_t chunk = out_total - off > TROPIC_L2_MAX_DATA ? TROPIC_L2_MAX_DATA : out_total - off;
+        uint8_t status = off + chunk < out_total ? TROPIC_L2_RES_CONT : TROPIC_L2_OK;
+        if (model_reply(m, status, m->l3 + off, (uint8_t)chunk) < 0) {
+            return -1;
+        }
+        off += chunk;
+    }
+
+    m->commands++;
+    if (m->config.drop_session_every && m->commands % m->config.drop_session_every == 0) {
+        tropic_channel_close(&m->ch);
+    }
+    return 0;
+}
+
+int tropic_model_serve(int fd, const tropic_model_config_t *config) {
+    model_t *m = calloc(1, sizeof(*m));
+    uint8_t sh_priv[TROPIC_KEY_SIZE];
+    tropic_l2_frame_t req;
+    int ret = 0;
+
+    if (!m) {
+        close(fd);
+        return -1;
+    }
+    m->fd = fd;
+    if (config) {
+        m->config = *config;
+    }
+
+    tropic_seed_key(TROPIC_PLACEHOLDER_CHIP_SEED, m->st_priv);
+    tropic_seed_key(TROPIC_PLACEHOLDER_PAIRING_SEED, sh_priv);
+    if (tropic_x25519_public(m->st_priv, m->st_pub) < 0 ||
+        tropic_x25519_public(sh_priv, m->sh_pub[0]) < 0) {
+        ret = -1;
+    }
+    OPENSSL_cleanse(sh_priv, sizeof(sh_priv));
+
+    while (ret == 0) {
+        if (tropic_l2_read(fd, &req, -1) < 0) {
+            break;  // EOF, or a corrupted stream we cannot resynchronise
+        }
+        switch (req.id) {
+        case TROPIC_L2_GET_INFO:
+            ret = model_reply(m, TROPIC_L2_OK, m->st_pub, TROPIC_KEY_SIZE);
+            break;
+        case TROPIC_L2_HANDSHAKE:
+            ret = model_handshake(m, &req);
+            break;
+        case TROPIC_L2_ENCRYPTED_CMD:
+            ret = model_encrypted_cmd(m, &req);
+            break;
+        case TROPIC_L2_SESSION_ABORT:
+            tropic_channel_close(&m->ch);
+            m->l3_got = 0;
+            ret = model_reply(m, TROPIC_L2_OK, NULL, 0);
+            break;
+        default:
+            ret = model_reply(m, TROPIC_L2_UNKNOWN_REQ, NULL, 0);
+            break;
+        }
+    }
+
+    close(fd);
+    OPENSSL_cleanse(m, sizeof(*m));
+    free(m);
+    return ret;
+}
+
+static void *model_thread(void *arg) {
+    model_thread_arg_t a = *(model_thread_arg_t *)arg;
+    free(arg);
+    tropic_model_serve(a.fd, &a.config);
+    return NULL;
+}
+
+int tropic_model_spawn(const tropic_model_config_t *config, pthread_t *thread) {
+    model_thread_arg_t *arg;
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        return -1;
+    }
+    arg = calloc(1, sizeof(*arg));
+    if (!arg) {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    arg->fd = sv[1];
+    if (config) {
+        arg->config = *config;
+    }
+    if (pthread_create(thread, NULL, model_thread, arg) != 0) {
+        free(arg);
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    return sv[0];
+}
+
+static int model_listen_socket(const char *spec) {
+    int fd = -1, one = 1;
+
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, spec + 5, sizeof(addr.sun_path) - 1);
+        unlink(addr.sun_path);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else if (strncmp(spec, "tcp:", 4) == 0) {
+        char host[128];
+        struct addrinfo hints, *res;
+        char *port;
+
+        strncpy(host, spec + 4, sizeof(host) - 1);
+        host[sizeof(host) - 1] = '\0';
+        port = strrchr(host, ':');
+        if (!port) {
+            return -1;
+        }
+        *port++ = '\0';
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0) {
+            return -1;
+        }
+        fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+    }
+
+    if (fd >= 0 && listen(fd, 4) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+int tropic_model_listen(const char *spec, const tropic_model_config_t *config) {
+    int one = 1;
+    int lfd = model_listen_socket(spec);
+    if (lfd < 0) {
+        fprintf(stderr, "tropic_model: cannot listen on %s: %s\n", spec, strerror(errno));
+        return -1;
+    }
+    printf("tropic_model: listening on %s\n", spec);
+
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(lfd);
+            return -1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        tropic_model_serve(fd, config);
+    }
+}
@@ -0,0 +1,309 @@
+#include "tropic_proto.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#define TROPIC_PROTOCOL_NAME "Noise_KK1_25519_AESGCM_SHA256"
+
+static uint16_t crc16_table[256];
+static pthread_once_t crc16_once = PTHREAD_ONCE_INIT;
+
+// CRC-16, polynomial 0x8005, initial value 0
+static void crc16_init(void) {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+        }
+        crc16_table[i] = crc;
+    }
+}
+
+uint16_t tropic_crc16(const uint8_t *data, size_t len) {
+    pthread_once(&crc16_once, crc16_init);
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 8) ^ crc16_table[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+size_t tropic_l2_encode(uint8_t id, const uint8_t *data, uint8_t len, uint8_t *out) {
+    out[0] = id;
+    out[1] = len;
+    if (len) {
+        memcpy(out + 2, data, len);
+    }
+    uint16_t crc = tropic_crc16(out, (size_t)len + 2);
+    out[len + 2] = crc & 0xFF;
+    out[len + 3] = crc >> 8;
+    return (size_t)len + 4;
+}
+
+int tropic_l2_decode(const uint8_t *buf, size_t len, tropic_l2_frame_t *frame) {
+    if (len < 4 || buf[1] > TROPIC_L2_MAX_DATA || len < (size_t)buf[1] + 4) {
+        return -1;
+    }
+    size_t n = buf[1];
+    uint16_t crc = tropic_crc16(buf, n + 2);
+    if (buf[n + 2] != (crc & 0xFF) || buf[n + 3] != (crc >> 8)) {
+        return -1;
+    }
+    frame->id = buf[0];
+    frame->len = buf[1];
+    memcpy(frame->data, buf + 2, n);
+    return 0;
+}
+
+int tropic_write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        // A vanished peer must not raise SIGPIPE in the wallet
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int tropic_read_exact(int fd, uint8_t *buf, size_t len, int timeout_ms) {
+    while (len) {
+        if (timeout_ms >= 0) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            int r = poll(&pfd, 1, timeout_ms);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                return -1;
+            }
+        }
+        ssize_t n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int tropic_l2_write(int fd, uint8_t id, const uint8_t *data, uint8_t len) {
+    uint8_t buf[TROPIC_L2_FRAME_MAX];
+    size_t n = tropic_l2_encode(id, data, len, buf);
+    return tropic_write_all(fd, buf, n);
+}
+
+int tropic_l2_read(int fd, tropic_l2_frame_t *frame, int timeout_ms) {
+    uint8_t buf[TROPIC_L2_FRAME_MAX];
+    if (tropic_read_exact(fd, buf, 2, timeout_ms) < 0) {
+        return -1;
+    }
+    if (buf[1] > TROPIC_L2_MAX_DATA ||
+        tropic_read_exact(fd, buf + 2, (size_t)buf[1] + 2, timeout_ms) < 0) {
+        return -1;
+    }
+    return tropic_l2_decode(buf, (size_t)buf[1] + 4, frame);
+}
+
+int tropic_x25519_public(const uint8_t priv[TROPIC_KEY_SIZE], uint8_t pub[TROPIC_KEY_SIZE]) {
+    EVP_PKEY *key = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, NULL, priv, TROPIC_KEY_SIZE);
+    size_t len = TROPIC_KEY_SIZE;
+    int ret = key && EVP_PKEY_get_raw_public_key(key, pub, &len) == 1 ? 0 : -1;
+    EVP_PKEY_free(key);
+    return ret;
+}
+
+int tropic_x25519_keygen(uint8_t priv[TROPIC_KEY_SIZE], uint8_t pub[TROPIC_KEY_SIZE]) {
+    if (RAND_bytes(priv, TROPIC_KEY_SIZE) != 1) {
+        return -1;
+    }
+    return tropic_x25519_public(priv, pub);
+}
+
+int tropic_x25519(const uint8_t priv[TROPIC_KEY_SIZE], const uint8_t peer[TROPIC_KEY_SIZE],
+                  uint8_t shared[TROPIC_KEY_SIZE]) {
+    EVP_PKEY *key = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, NULL, priv, TROPIC_KEY_SIZE);
+    EVP_PKEY *peer_key = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, peer, TROPIC_KEY_SIZE);
+    EVP_PKEY_CTX *ctx = key ? EVP_PKEY_CTX_new(key, NULL) : NULL;
+    size_t len = TROPIC_KEY_SIZE;
+    int ret = -1;
+
+    if (ctx && peer_key &&
+        EVP_PKEY_derive_init(ctx) == 1 &&
+        EVP_PKEY_derive_set_peer(ctx, peer_key) == 1 &&
+        EVP_PKEY_derive(ctx, shared, &len) == 1 && len == TROPIC_KEY_SIZE) {
+        ret = 0;
+    }
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(peer_key);
+    EVP_PKEY_free(key);
+    return ret;
+}
+
+void tropic_seed_key(const char *seed, uint8_t priv[TROPIC_KEY_SIZE]) {
+    SHA256((const unsigned char *)seed, strlen(seed), priv);
+}
+
+void tropic_handshake_hash(const uint8_t sh_pub[TROPIC_KEY_SIZE], const uint8_t st_pub[TROPIC_KEY_SIZE],
+                           const uint8_t eh_pub[TROPIC_KEY_SIZE], const uint8_t ec_pub[TROPIC_KEY_SIZE],
+                           uint8_t hash[32]) {
+    EVP_MD_CTX *md = EVP_MD_CTX_new();
+    unsigned int len = 32;
+
+    EVP_DigestInit_ex(md, EVP_sha256(), NULL);
+    EVP_DigestUpdate(md, TROPIC_PROTOCOL_NAME, strlen(TROPIC_PROTOCOL_NAME));
+    EVP_DigestUpdate(md, sh_pub, TROPIC_KEY_SIZE);
+    EVP_DigestUpdate(md, st_pub, TROPIC_KEY_SIZE);
+    EVP_DigestUpdate(md, eh_pub, TROPIC_KEY_SIZE);
+    EVP_DigestUpdate(md, ec_pub, TROPIC_KEY_SIZE);
+    EVP_DigestFinal_ex(md, hash, &len);
+    EVP_MD_CTX_free(md);
+}
+
+// 12-byte GCM IV: 32-bit little-endian counter, zero padded
+static void channel_iv(uint32_t counter, uint8_t iv[12]) {
+    memset(iv, 0, 12);
+    iv[0] = counter & 0xFF;
+    iv[1] = (counter >> 8) & 0xFF;
+    iv[2] = (counter >> 16) & 0xFF;
+    iv[3] = (counter >> 24) & 0xFF;
+}
+
+static int gcm_seal(const uint8_t key[TROPIC_KEY_SIZE], uint32_t counter, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *pt, size_t len, uint8_t *out) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    uint8_t iv[12];
+    int n = 0, ret = -1;
+
+    channel_iv(counter, iv);
+    if (ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1 &&
+        (!aad_len || EVP_EncryptUpdate(ctx, NULL, &n, aad, (int)aad_len) == 1) &&
+        (!len || EVP_EncryptUpdate(ctx, out, &n, pt, (int)len) == 1) &&
+        EVP_EncryptFinal_ex(ctx, out + len, &n) == 1 &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TROPIC_L3_TAG_SIZE, out + len) == 1) {
+        ret = (int)len + TROPIC_L3_TAG_SIZE;
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+static int gcm_open(const uint8_t key[TROPIC_KEY_SIZE], uint32_t counter,
+                    const uint8_t *in, size_t len, uint8_t *pt) {
+    EVP_CIPHER_CTX *ctx;
+    uint8_t iv[12], tag[TROPIC_L3_TAG_SIZE];
+    size_t ct_len;
+    int n = 0, ret = -1;
+
+    if (len < TROPIC_L3_TAG_SIZE) {
+        return -1;
+    }
+    ct_len = len - TROPIC_L3_TAG_SIZE;
+    memcpy(tag, in + ct_len, TROPIC_L3_TAG_SIZE);
+    channel_iv(counter, iv);
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1 &&
+        (!ct_len || EVP_DecryptUpdate(ctx, pt, &n, in, (int)ct_len) == 1) &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TROPIC_L3_TAG_SIZE, tag) == 1 &&
+        EVP_DecryptFinal_ex(ctx, pt + ct_len, &n) == 1) {
+        ret = (int)ct_len;
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+int tropic_channel_derive(tropic_channel_t *ch, const uint8_t hash[32], const uint8_t ikm[96],
+                          uint8_t tag[TROPIC_L3_TAG_SIZE]) {
+    uint8_t okm[3 * TROPIC_KEY_SIZE];
+    EVP_KDF *kdf = EVP_KDF_fetch(NULL, "HKDF", NULL);
+    EVP_KDF_CTX *kctx = kdf ? EVP_KDF_CTX_new(kdf) : NULL;
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, "SHA256", 0),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, (void *)ikm, 96),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, (void *)hash, 32),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, TROPIC_PROTOCOL_NAME,
+                                          strlen(TROPIC_PROTOCOL_NAME)),
+        OSSL_PARAM_construct_end()
+    };
+    int ret = -1;
+
+    if (kctx && EVP_KDF_derive(kctx, okm, sizeof(okm), params) == 1) {
+        // okm = k_auth | k_cmd | k_res; the tag proves the chip holds st_priv
+        if (gcm_seal(okm, 0, hash, 32, NULL, 0, tag) == TROPIC_L3_TAG_SIZE) {
+            memcpy(ch->k_cmd, okm + TROPIC_KEY_SIZE, TROPIC_KEY_SIZE);
+            memcpy(ch->k_res, okm + 2 * TROPIC_KEY_SIZE, TROPIC_KEY_SIZE);
+            ch->n_cmd = 0;
+            ch->n_res = 0;
+            ch->open = true;
+            ret = 0;
+        }
+    }
+    OPENSSL_cleanse(okm, sizeof(okm));
+    EVP_KDF_CTX_free(kctx);
+    EVP_KDF_free(kdf);
+    return ret;
+}
+
+int tropic_channel_seal(tropic_channel_t *ch, bool to_chip, const uint8_t *pt, size_t len, uint8_t *out) {
+    if (!ch->open) {
+        return -1;
+    }
+    uint32_t *counter = to_chip ? &ch->n_cmd : &ch->n_res;
+    int ret = gcm_seal(to_chip ? ch->k_cmd : ch->k_res, *counter, NULL, 0, pt, len, out);
+    if (ret >= 0) {
+        (*counter)++;
+    }
+    return ret;
+}
+
+int tropic_channel_open(tropic_channel_t *ch, bool to_chip, const uint8_t *in, size_t len, uint8_t *pt) {
+    if (!ch->open) {
+        return -1;
+    }
+    uint32_t *counter = to_chip ? &ch->n_cmd : &ch->n_res;
+    int ret = gcm_open(to_chip ? ch->k_cmd : ch->k_res, *counter, in, len, pt);
+    if (ret >= 0) {
+        (*counter)++;
+    }
+    return ret;
+}
+
+void tropic_channel_close(tropic_channel_t *ch) {
+    OPENSSL_cleanse(ch, sizeof(*ch));
+}
+
+int tropic_sign_batch_add(uint8_t *buf, size_t *len, const uint8_t *msg, size_t msg_len) {
+    if (*len == 0) {
+        buf[0] = 0;
+        *len = 1;
+    }
+    if (buf[0] >= TROPIC_SIGN_BATCH_MAX || msg_len > TROPIC_L3_MAX || *len + 2 + msg_len > TROPIC_L3_MAX - 1) {
+        return -1;
+    }
+    buf[*len] = msg_len & 0xFF;
+    buf[*len + 1] = (msg_len >> 8) & 0xFF;
+    if (msg_len) {
+        memcpy(buf + *len + 2, msg, msg_len);
+    }
+    *len += 2 + msg_len;
+    buf[0]++;
+    return 0;
+}
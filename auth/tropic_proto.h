@@ -0,0 +1,167 @@
+#ifndef TROPIC_PROTO_H
+#define TROPIC_PROTO_H
+
+/*
+ * Tropic01 wire protocol shared by the host session (tropic_session.c)
+ * and the chip model (tropic_model.c). Not part of the public API.
+ *
+ * L2 frame, host -> chip:  REQ_ID | REQ_LEN | data[REQ_LEN] | CRC16
+ * L2 frame, chip -> host:  STATUS | RSP_LEN | data[RSP_LEN] | CRC16
+ *
+ * L3 packets are AES-256-GCM encrypted under the session keys and carried
+ * in ENCRYPTED_CMD frames, chunked to 252 bytes. The first chunk starts
+ * with the little-endian ciphertext length (without tag). Each request
+ * chunk is answered, intermediate ones with REQ_CONT, and the encrypted
+ * result comes back as RES_CONT ... OK chunks in the same layout.
+ *
+ * The secure channel follows Noise KK1 (X25519, AES-GCM, SHA-256): both
+ * sides know each other's static key (the chip's from its certificate,
+ * the host's from a pairing slot) and exchange ephemerals once.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TROPIC_L2_MAX_DATA      252
+#define TROPIC_L2_FRAME_MAX     (TROPIC_L2_MAX_DATA + 4)
+#define TROPIC_L3_MAX           4096    // Largest L3 plaintext (command id + payload)
+#define TROPIC_L3_TAG_SIZE      16
+#define TROPIC_KEY_SIZE         32
+
+// L2 request ids
+#define TROPIC_L2_GET_INFO          0x01    // -> chip static public key
+#define TROPIC_L2_HANDSHAKE         0x02    // eh_pub | pairing slot -> ec_pub | tag
+#define TROPIC_L2_ENCRYPTED_CMD     0x04
+#define TROPIC_L2_SESSION_ABORT     0x08
+
+// L2 response status
+#define TROPIC_L2_OK                0x01
+#define TROPIC_L2_REQ_CONT          0x02
+#define TROPIC_L2_RES_CONT          0x03
+#define TROPIC_L2_NO_SESSION        0x79
+#define TROPIC_L2_TAG_ERR           0x7A
+#define TROPIC_L2_CRC_ERR           0x7B
+#define TROPIC_L2_UNKNOWN_REQ       0x7C
+#define TROPIC_L2_GEN_ERR           0x7D
+
+// L3 commands (first plaintext byte) and results
+#define TROPIC_L3_PING              0x01
+#define TROPIC_L3_GET_CERT          0x10
+#define TROPIC_L3_SIGN              0x20
+#define TROPIC_L3_VERIFY            0x21
+#define TROPIC_L3_SIGN_BATCH        0x22    // See tropic_sign_batch_add()
+#define TROPIC_L3_DERIVE_KEY        0x30
+
+#define TROPIC_L3_RESULT_OK         0xC3
+#define TROPIC_L3_RESULT_FAIL       0x3C
+#define TROPIC_L3_RESULT_INVALID    0x02
+
+// SIGN_BATCH payload: count | count x (len LE16 | message)
+// SIGN_BATCH result:  count | count x (status | signature)
+// A bad item fails on its own with status RESULT_FAIL
+#define TROPIC_SIGN_BATCH_MAX           64
+#define TROPIC_SIGN_BATCH_SIG_SIZE      32
+#define TROPIC_SIGN_BATCH_RES_SIZE(n)   (1 + (size_t)(n) * (1 + TROPIC_SIGN_BATCH_SIG_SIZE))
+
+// Placeholder secrets until libtropic provides the real ones; the model
+// and the no-chip fallback in tropic_auth.c must agree on them
+#define TROPIC_PLACEHOLDER_DEVICE_KEY   "tropic01_device_key"
+#define TROPIC_PLACEHOLDER_MASTER_KEY   "tropic01_master_key"
+#define TROPIC_PLACEHOLDER_CERT_SEED    "tropic01_device_cert_seed"
+#define TROPIC_PLACEHOLDER_PAIRING_SEED "tropic01_pairing_key_sh0"
+#define TROPIC_PLACEHOLDER_CHIP_SEED    "tropic01_chip_static_key"
+
+/**
+ * Decoded L2 frame
+ */
+typedef struct {
+    uint8_t id;         // REQ_ID or STATUS
+    uint8_t len;
+    uint8_t data[TROPIC_L2_MAX_DATA];
+} tropic_l2_frame_t;
+
+/**
+ * One direction-pair of session keys with their nonce counters
+ */
+typedef struct {
+    uint8_t k_cmd[TROPIC_KEY_SIZE];     // host -> chip
+    uint8_t k_res[TROPIC_KEY_SIZE];     // chip -> host
+    uint32_t n_cmd;
+    uint32_t n_res;
+    bool open;
+} tropic_channel_t;
+
+uint16_t tropic_crc16(const uint8_t *data, size_t len);
+
+/**
+ * Encode a frame, returns its length (len + 4)
+ */
+size_t tropic_l2_encode(uint8_t id, const uint8_t *data, uint8_t len, uint8_t *out);
+
+/**
+ * Decode and CRC-check a frame, returns 0 or -1
+ */
+int tropic_l2_decode(const uint8_t *buf, size_t len, tropic_l2_frame_t *frame);
+
+/**
+ * Stream helpers for socket transports
+ * @param timeout_ms Receive timeout, negative waits forever
+ * @return 0 on success, -1 on error or EOF
+ */
+int tropic_l2_write(int fd, uint8_t id, const uint8_t *data, uint8_t len);
+int tropic_l2_read(int fd, tropic_l2_frame_t *frame, int timeout_ms);
+int tropic_read_exact(int fd, uint8_t *buf, size_t len, int timeout_ms);
+int tropic_write_all(int fd, const uint8_t *buf, size_t len);
+
+/**
+ * X25519 helpers
+ */
+int tropic_x25519_keygen(uint8_t priv[TROPIC_KEY_SIZE], uint8_t pub[TROPIC_KEY_SIZE]);
+int tropic_x25519_public(const uint8_t priv[TROPIC_KEY_SIZE], uint8_t pub[TROPIC_KEY_SIZE]);
+int tropic_x25519(const uint8_t priv[TROPIC_KEY_SIZE], const uint8_t peer[TROPIC_KEY_SIZE],
+                  uint8_t shared[TROPIC_KEY_SIZE]);
+
+/**
+ * Deterministic X25519 key from a placeholder seed string
+ */
+void tropic_seed_key(const char *seed, uint8_t priv[TROPIC_KEY_SIZE]);
+
+/**
+ * Handshake transcript hash over both static and ephemeral public keys
+ */
+void tropic_handshake_hash(const uint8_t sh_pub[TROPIC_KEY_SIZE], const uint8_t st_pub[TROPIC_KEY_SIZE],
+                           const uint8_t eh_pub[TROPIC_KEY_SIZE], const uint8_t ec_pub[TROPIC_KEY_SIZE],
+                           uint8_t hash[32]);
+
+/**
+ * Derive the session keys from the three DH results and compute the
+ * chip's authentication tag over the transcript
+ * @param ikm DH(e,e) | DH(eh,st) | DH(sh,ec), 96 bytes
+ */
+int tropic_channel_derive(tropic_channel_t *ch, const uint8_t hash[32], const uint8_t ikm[96],
+                          uint8_t tag[TROPIC_L3_TAG_SIZE]);
+
+/**
+ * Encrypt/decrypt one L3 packet; the nonce counter of that direction
+ * advances on success
+ * @param to_chip true for commands, false for results
+ * @return output length (ciphertext + tag, or plaintext), -1 on error
+ */
+int tropic_channel_seal(tropic_channel_t *ch, bool to_chip, const uint8_t *pt, size_t len, uint8_t *out);
+int tropic_channel_open(tropic_channel_t *ch, bool to_chip, const uint8_t *in, size_t len, uint8_t *pt);
+
+/**
+ * Wipe the session keys
+ */
+void tropic_channel_close(tropic_channel_t *ch);
+
+/**
+ * Append one message to a SIGN_BATCH payload
+ * @param buf Payload buffer of TROPIC_L3_MAX - 1 bytes
+ * @param len In/out payload length, 0 starts a new batch
+ * @return 0, or -1 if the message does not fit (send the batch first)
+ */
+int tropic_sign_batch_add(uint8_t *buf, size_t *len, const uint8_t *msg, size_t msg_len);
+
+#endif // TROPIC_PROTO_H
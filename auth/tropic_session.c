@@ -0,0 +1,609 @@
+#define WLOG_MODULE auth
+#include "tropic_session.h"
+#include "tropic_proto.h"
+#include "tropic_model.h"
+#include "tropic_auth.h"
+#include "secure_arena.h"
+#include "wallet_log.h"
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <openssl/crypto.h>
+
+#define TROPIC_SESSION_TIMEOUT_MS   2000
+
+// SPI L1: GET_RESPONSE is polled until CHIP_STATUS reports READY
+#define TROPIC_SPI_GET_RESPONSE     0xAA
+#define TROPIC_SPI_CHIP_READY       0x01
+#define TROPIC_SPI_POLL_US          100
+
+struct tropic_session {
+    pthread_mutex_t lock;
+    tropic_transport_t *transport;
+    bool connected;
+    tropic_channel_t ch;
+    uint8_t slot;
+    uint8_t sh_priv[TROPIC_KEY_SIZE];
+    uint8_t sh_pub[TROPIC_KEY_SIZE];
+    uint8_t st_pub[TROPIC_KEY_SIZE];
+    bool have_st;
+    tropic_session_stats_t stats;
+    // 2-byte length prefix + ciphertext + tag of the largest L3 packet
+    uint8_t l3[2 + TROPIC_L3_MAX + TROPIC_L3_TAG_SIZE];
+    uint8_t pt[TROPIC_L3_MAX];
+};
+
+static uint64_t session_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* ------------------------------------------------------------------------
+ * Stream transports: in-process model, TCP, Unix socket
+ * ------------------------------------------------------------------------ */
+
+typedef enum {
+    STREAM_MODEL,
+    STREAM_TCP,
+    STREAM_UNIX,
+} stream_kind_t;
+
+typedef struct {
+    stream_kind_t kind;
+    int fd;
+    char address[108];              // host:port or socket path
+    tropic_model_config_t model;
+    pthread_t model_thread;
+    bool model_running;
+} stream_priv_t;
+
+static int stream_connect_tcp(stream_priv_t *p) {
+    char host[sizeof(p->address)];
+    struct addrinfo hints, *res, *ai;
+    char *port;
+    int fd = -1, one = 1;
+
+    strncpy(host, p->address, sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    port = strrchr(host, ':');
+    if (!port) {
+        return -1;
+    }
+    *port++ = '\0';
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        // Frames are small; don't let Nagle hold a request back
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static int stream_connect_unix(stream_priv_t *p) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", p->address);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int stream_connect(tropic_transport_t *t) {
+    stream_priv_t *p = t->priv;
+
+    switch (p->kind) {
+    case STREAM_MODEL:
+        p->fd = tropic_model_spawn(&p->model, &p->model_thread);
+        p->model_running = p->fd >= 0;
+        break;
+    case STREAM_TCP:
+        p->fd = stream_connect_tcp(p);
+        break;
+    case STREAM_UNIX:
+        p->fd = stream_connect_unix(p);
+        break;
+    }
+    return p->fd >= 0 ? 0 : -1;
+}
+
+static int stream_send(tropic_transport_t *t, const uint8_t *frame, size_t len) {
+    stream_priv_t *p = t->priv;
+    return tropic_write_all(p->fd, frame, len);
+}
+
+static int stream_recv(tropic_transport_t *t, uint8_t *frame, size_t size, int timeout_ms) {
+    stream_priv_t *p = t->priv;
+
+    if (size < 4 || tropic_read_exact(p->fd, frame, 2, timeout_ms) < 0) {
+        return -1;
+    }
+    size_t len = (size_t)frame[1] + 4;
+    if (len > size || tropic_read_exact(p->fd, frame + 2, len - 2, timeout_ms) < 0) {
+        return -1;
+    }
+    return (int)len;
+}
+
+static void stream_disconnect(tropic_transport_t *t) {
+    stream_priv_t *p = t->priv;
+
+    if (p->fd >= 0) {
+        close(p->fd);
+        p->fd = -1;
+    }
+    // The model thread sees EOF and returns
+    if (p->model_running) {
+        pthread_join(p->model_thread, NULL);
+        p->model_running = false;
+    }
+}
+
+static void stream_destroy(tropic_transport_t *t) {
+    stream_disconnect(t);
+    free(t->priv);
+    free(t);
+}
+
+/* ------------------------------------------------------------------------
+ * SPI transport through tropic_auth_spi_*: one request in flight, the
+ * response is polled with GET_RESPONSE while the bus is held. Every L1
+ * frame is a single tropic_auth_spi_transfer_v() call, so the chip select
+ * does not rise between its bytes.
+ * ------------------------------------------------------------------------ */
+
+static int spi_connect(tropic_transport_t *t) {
+    (void)t;
+    // Probe: fails when there is no SPI device behind tropic_auth
+    if (tropic_auth_spi_begin() < 0) {
+        return -1;
+    }
+    tropic_auth_spi_end();
+    return 0;
+}
+
+static int spi_send(tropic_transport_t *t, const uint8_t *frame, size_t len) {
+    (void)t;
+    if (tropic_auth_spi_begin() < 0) {
+        return -1;
+    }
+    int ret = tropic_auth_spi_transfer(frame, NULL, len);
+    tropic_auth_spi_end();
+    return ret;
+}
+
+static int spi_recv(tropic_transport_t *t, uint8_t *frame, size_t size, int timeout_ms) {
+    uint64_t deadline = session_clock_us() + (uint64_t)timeout_ms * 1000;
+    (void)t;
+
+    if (size < 4) {
+        return -1;
+    }
+    if (size > TROPIC_L2_FRAME_MAX) {
+        size = TROPIC_L2_FRAME_MAX;
+    }
+    for (;;) {
+        const uint8_t cmd = TROPIC_SPI_GET_RESPONSE;
+        uint8_t chip_status = 0;
+        // The length is only known once the header is in, so a whole
+        // frame is clocked every time; the chip pads past its end
+        tropic_spi_segment_t seg[] = {
+            { &cmd, &chip_status, 1 },
+            { NULL, frame, 2 },
+            { NULL, frame + 2, size - 2 },
+        };
+
+        if (tropic_auth_spi_begin() < 0) {
+            return -1;
+        }
+        int ret = tropic_auth_spi_transfer_v(seg, 3);
+        tropic_auth_spi_end();
+        if (ret < 0) {
+            return -1;
+        }
+        if (chip_status & TROPIC_SPI_CHIP_READY) {
+            return (size_t)frame[1] + 4 <= size ? frame[1] + 4 : -1;
+        }
+        if (timeout_ms >= 0 && session_clock_us() > deadline) {
+            return -1;
+        }
+        usleep(TROPIC_SPI_POLL_US);
+    }
+}
+
+static void spi_disconnect(tropic_transport_t *t) {
+    (void)t;
+}
+
+static void spi_destroy(tropic_transport_t *t) {
+    free(t);
+}
+
+tropic_transport_t *tropic_transport_create(const char *spec) {
+    tropic_transport_t *t;
+    stream_priv_t *p;
+
+    if (!spec) {
+        return NULL;
+    }
+
+    t = calloc(1, sizeof(*t));
+    if (!t) {
+        return NULL;
+    }
+
+    if (strcmp(spec, "spi") == 0) {
+        t->name = "spi";
+        t->can_pipeline = false;
+        t->connect = spi_connect;
+        t->send = spi_send;
+        t->recv = spi_recv;
+        t->disconnect = spi_disconnect;
+        t->destroy = spi_destroy;
+        return t;
+    }
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        free(t);
+        return NULL;
+    }
+    p->fd = -1;
+
+    if (strncmp(spec, "model", 5) == 0 && (spec[5] == '\0' || spec[5] == ':')) {
+        // "model:HANDSHAKE_US,COMMAND_US" adds chip-like latency
+        p->kind = STREAM_MODEL;
+        if (spec[5] == ':') {
+            unsigned int hs = 0, cmd = 0;
+            sscanf(spec + 6, "%u,%u", &hs, &cmd);
+            p->model.handshake_us = hs;
+            p->model.command_us = cmd;
+        }
+        t->name = "model";
+    } else if (strncmp(spec, "tcp:", 4) == 0) {
+        p->kind = STREAM_TCP;
+        strncpy(p->address, spec + 4, sizeof(p->address) - 1);
+        t->name = "tcp";
+    } else if (strncmp(spec, "unix:", 5) == 0) {
+        p->kind = STREAM_UNIX;
+        strncpy(p->address, spec + 5, sizeof(p->address) - 1);
+        t->name = "unix";
+    } else {
+        free(p);
+        free(t);
+        return NULL;
+    }
+
+    t->can_pipeline = true;
+    t->connect = stream_connect;
+    t->send = stream_send;
+    t->recv = stream_recv;
+    t->disconnect = stream_disconnect;
+    t->destroy = stream_destroy;
+    t->priv = p;
+    return t;
+}
+
+/* ------------------------------------------------------------------------
+ * Session
+ * ------------------------------------------------------------------------ */
+
+static int session_send_frame(tropic_session_t *s, uint8_t id, const uint8_t *data, uint8_t len) {
+    uint8_t buf[TROPIC_L2_FRAME_MAX];
+    size_t n = tropic_l2_encode(id, data, len, buf);
+    return s->transport->send(s->transport, buf, n);
+}
+
+static int session_recv_frame(tropic_session_t *s, tropic_l2_frame_t *frame) {
+    uint8_t buf[TROPIC_L2_FRAME_MAX];
+    int n = s->transport->recv(s->transport, buf, sizeof(buf), TROPIC_SESSION_TIMEOUT_MS);
+    if (n < 0) {
+        return -1;
+    }
+    return tropic_l2_decode(buf, (size_t)n, frame);
+}
+
+static int session_l2_request(tropic_session_t *s, uint8_t id, const uint8_t *data, uint8_t len,
+                              tropic_l2_frame_t *rsp) {
+    if (session_send_frame(s, id, data, len) < 0 || session_recv_frame(s, rsp) < 0) {
+        return -1;
+    }
+    return rsp->id == TROPIC_L2_OK ? 0 : -1;
+}
+
+static void session_drop(tropic_session_t *s) {
+    tropic_channel_close(&s->ch);
+    if (s->connected) {
+        s->transport->disconnect(s->transport);
+        s->connected = false;
+    }
+}
+
+static int session_handshake(tropic_session_t *s) {
+    uint8_t eh_priv[TROPIC_KEY_SIZE], eh_pub[TROPIC_KEY_SIZE], req[TROPIC_KEY_SIZE + 1];
+    uint8_t ikm[3 * TROPIC_KEY_SIZE], hash[32], tag[TROPIC_L3_TAG_SIZE];
+    tropic_l2_frame_t rsp;
+    uint64_t start = session_clock_us();
+    int ret = -1;
+
+    if (!s->connected) {
+        if (s->transport->connect(s->transport) < 0) {
+            return -1;
+        }
+        s->connected = true;
+    }
+
+    // The chip's static key; libtropic checks it against the device
+    // certificate chain before trusting it
+    if (!s->have_st) {
+        if (session_l2_request(s, TROPIC_L2_GET_INFO, NULL, 0, &rsp) < 0 || rsp.len != TROPIC_KEY_SIZE) {
+            return -1;
+        }
+        memcpy(s->st_pub, rsp.data, TROPIC_KEY_SIZE);
+        s->have_st = true;
+    }
+
+    if (tropic_x25519_keygen(eh_priv, eh_pub) < 0) {
+        return -1;
+    }
+    memcpy(req, eh_pub, TROPIC_KEY_SIZE);
+    req[TROPIC_KEY_SIZE] = s->slot;
+    if (session_l2_request(s, TROPIC_L2_HANDSHAKE, req, sizeof(req), &rsp) < 0 ||
+        rsp.len != TROPIC_KEY_SIZE + TROPIC_L3_TAG_SIZE) {
+        goto out;
+    }
+
+    const uint8_t *ec_pub = rsp.data;
+    if (tropic_x25519(eh_priv, ec_pub, ikm) < 0 ||
+        tropic_x25519(eh_priv, s->st_pub, ikm + TROPIC_KEY_SIZE) < 0 ||
+        tropic_x25519(s->sh_priv, ec_pub, ikm + 2 * TROPIC_KEY_SIZE) < 0) {
+        goto out;
+    }
+    tropic_handshake_hash(s->sh_pub, s->st_pub, eh_pub, ec_pub, hash);
+    if (tropic_channel_derive(&s->ch, hash, ikm, tag) < 0) {
+        goto out;
+    }
+    if (CRYPTO_memcmp(tag, rsp.data + TROPIC_KEY_SIZE, TROPIC_L3_TAG_SIZE) != 0) {
+        WLOG_ERROR("Tropic01: handshake authentication failed");
+        tropic_channel_close(&s->ch);
+        goto out;
+    }
+
+    s->stats.last_handshake_us = session_clock_us() - start;
+    s->stats.handshake_us_total += s->stats.last_handshake_us;
+    if (s->stats.handshakes++) {
+        s->stats.renegotiations++;
+    }
+    ret = 0;
+
+out:
+    OPENSSL_cleanse(eh_priv, sizeof(eh_priv));
+    OPENSSL_cleanse(ikm, sizeof(ikm));
+    return ret;
+}
+
+/**
+ * Encrypt one command and send its L2 chunks. Without pipelining each
+ * intermediate chunk's REQ_CONT is read before the next one goes out.
+ */
+static int session_send_cmd(tropic_session_t *s, const tropic_cmd_t *cmd) {
+    if (cmd->req_len + 1 > TROPIC_L3_MAX) {
+        return -1;
+    }
+
+    s->pt[0] = cmd->cmd;
+    if (cmd->req_len) {
+        memcpy(s->pt + 1, cmd->req, cmd->req_len);
+    }
+    size_t pt_len = cmd->req_len + 1;
+    int sealed = tropic_channel_seal(&s->ch, true, s->pt, pt_len, s->l3 + 2);
+    OPENSSL_cleanse(s->pt, pt_len);
+    if (sealed < 0) {
+        return -1;
+    }
+    s->l3[0] = pt_len & 0xFF;
+    s->l3[1] = (pt_len >> 8) & 0xFF;
+
+    size_t total = (size_t)sealed + 2, off = 0;
+    while (off < total) {
+        size_t chunk = total - off > TROPIC_L2_MAX_DATA ? TROPIC_L2_MAX_DATA : total - off;
+        if (session_send_frame(s, TROPIC_L2_ENCRYPTED_CMD, s->l3 + off, (uint8_t)chunk) < 0) {
+            return -1;
+        }
+        off += chunk;
+        if (off < total && !s->transport->can_pipeline) {
+            tropic_l2_frame_t rsp;
+            if (session_recv_frame(s, &rsp) < 0 || rsp.id != TROPIC_L2_REQ_CONT) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Collect and decrypt the result of the oldest command in flight
+ */
+static int session_recv_result(tropic_session_t *s, tropic_cmd_t *cmd) {
+    tropic_l2_frame_t rsp;
+    size_t got = 0, total = 0;
+
+    for (;;) {
+        if (session_recv_frame(s, &rsp) < 0) {
+            return -1;
+        }
+        if (rsp.id == TROPIC_L2_REQ_CONT) {
+            continue;   // Acks of a pipelined command's earlier chunks
+        }
+        if (rsp.id != TROPIC_L2_RES_CONT && rsp.id != TROPIC_L2_OK) {
+            return -1;
+        }
+        if (got + rsp.len > sizeof(s->l3)) {
+            return -1;
+        }
+        memcpy(s->l3 + got, rsp.data, rsp.len);
+        got += rsp.len;
+        if (got >= 2 && !total) {
+            total = 2 + (size_t)(s->l3[0] | (s->l3[1] << 8)) + TROPIC_L3_TAG_SIZE;
+        }
+        if (rsp.id == TROPIC_L2_OK) {
+            break;
+        }
+    }
+    if (!total || got != total) {
+        return -1;
+    }
+
+    int n = tropic_channel_open(&s->ch, false, s->l3 + 2, got - 2, s->pt);
+    if (n < 1 || (size_t)(n - 1) > cmd->res_size) {
+        OPENSSL_cleanse(s->pt, sizeof(s->pt));
+        return -1;
+    }
+    cmd->result = s->pt[0];
+    cmd->res_len = (size_t)n - 1;
+    if (cmd->res_len) {
+        memcpy(cmd->res, s->pt + 1, cmd->res_len);
+    }
+    OPENSSL_cleanse(s->pt, (size_t)n);
+    return 0;
+}
+
+tropic_session_t *tropic_session_open(tropic_transport_t *transport, uint8_t pairing_slot,
+                                      const uint8_t pairing_key[32]) {
+    if (!transport || !pairing_key) {
+        return NULL;
+    }
+
+    // Holds the pairing key and the channel keys
+    tropic_session_t *s = secure_alloc(sizeof(*s));
+    if (!s) {
+        transport->destroy(transport);
+        return NULL;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    s->transport = transport;
+    s->slot = pairing_slot;
+    memcpy(s->sh_priv, pairing_key, TROPIC_KEY_SIZE);
+
+    if (tropic_x25519_public(s->sh_priv, s->sh_pub) < 0 || session_handshake(s) < 0) {
+        tropic_session_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+void tropic_session_close(tropic_session_t *s) {
+    if (!s) {
+        return;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    if (s->ch.open) {
+        tropic_l2_frame_t rsp;
+        session_l2_request(s, TROPIC_L2_SESSION_ABORT, NULL, 0, &rsp);
+    }
+    session_drop(s);
+    s->transport->destroy(s->transport);
+    pthread_mutex_unlock(&s->lock);
+    pthread_mutex_destroy(&s->lock);
+    secure_free(s);
+}
+
+int tropic_session_exec(tropic_session_t *s, tropic_cmd_t *cmds, size_t count) {
+    if (!s || (!cmds && count)) {
+        return -1;
+    }
+    // Refuse oversized commands up front rather than dropping the session
+    for (size_t i = 0; i < count; i++) {
+        if (cmds[i].req_len + 1 > TROPIC_L3_MAX || (cmds[i].req_len && !cmds[i].req)) {
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&s->lock);
+    uint64_t start = session_clock_us();
+    size_t done = 0;
+    bool retried = false;
+    int ret = 0;
+
+    while (done < count) {
+        size_t window = 1, i = 0;
+        if (s->transport->can_pipeline) {
+            window = count - done < TROPIC_SESSION_PIPELINE_MAX ? count - done : TROPIC_SESSION_PIPELINE_MAX;
+        }
+
+        if (s->ch.open || session_handshake(s) == 0) {
+            size_t sent;
+            for (sent = 0; sent < window && session_send_cmd(s, &cmds[done + sent]) == 0; sent++) {
+            }
+            for (i = 0; i < sent && session_recv_result(s, &cmds[done + i]) == 0; i++) {
+            }
+        }
+        // Keep whatever was answered before a failure
+        done += i;
+        s->stats.commands += i;
+        if (i == window) {
+            continue;
+        }
+
+        // Lost the transport or the chip dropped the session: start over
+        // on a fresh connection, resending everything not yet answered.
+        // Give up after two failures in a row without progress.
+        session_drop(s);
+        if (i > 0) {
+            retried = false;
+        }
+        if (retried) {
+            s->stats.errors++;
+            ret = -1;
+            break;
+        }
+        retried = true;
+    }
+
+    s->stats.command_us_total += session_clock_us() - start;
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+void tropic_session_get_stats(tropic_session_t *s, tropic_session_stats_t *stats) {
+    if (!s || !stats) {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    *stats = s->stats;
+    pthread_mutex_unlock(&s->lock);
+}
@@ -38,11 +38,30 @@ int EPD_CS_PIN;
 int EPD_BUSY_PIN;
 int EPD_PWR_PIN;
 
+// Level last written to EPD_CS_PIN, restored after a bus yield
+static UBYTE EPD_CS_Level = 1;
+
+#if (defined(RPI) && defined(USE_DEV_LIB)) || (defined(RADXA_ZERO_3W) && !defined(RADXA_USE_HW_SPI_CS))
+#define EPD_GPIO_CS_YIELD 1
+/**
+ * The panel's chip select is a GPIO that spidev does not drive: raise it
+ * while another device has the bus in the middle of a frame, then put it
+ * back. The controller takes CS going high between bytes as a pause.
+**/
+static void DEV_SPI_YieldCS(int release)
+{
+	if (EPD_CS_Level == 0)
+		SYSFS_GPIO_Write(EPD_CS_PIN, release ? 1 : 0);
+}
+#endif
+
 /**
  * GPIO read and write
 **/
 void DEV_Digital_Write(UWORD Pin, UBYTE Value)
 {
+	if (Pin == EPD_CS_PIN)
+		EPD_CS_Level = Value;
 #ifdef RPI
 #ifdef USE_BCM2835_LIB
 	bcm2835_gpio_write(Pin, Value);
@@ -143,14 +162,13 @@ void DEV_SPI_Write_nByte(uint8_t *pData, uint32_t Len)
 #elif USE_WIRINGPI_LIB
 	wiringPiSPIDataRW(0, pData, Len);
 #elif USE_DEV_LIB
-	DEV_HARDWARE_SPI_Transfer(pData, Len);
+	DEV_HARDWARE_SPI_Write(pData, Len);
 #endif
 #endif
 
 #ifdef JETSON
 #ifdef USE_DEV_LIB
-	//JETSON nano waits for hardware SPI
-	Debug("not support");
+	SYSFS_software_spi_transfer_buf(pData, NULL, Len);
 #elif USE_HARDWARE_LIB
 	Debug("not support");
 #endif
@@ -158,9 +176,9 @@ void DEV_SPI_Write_nByte(uint8_t *pData, uint32_t Len)
 
 #ifdef RADXA_ZERO_3W
 #ifdef USE_DEV_LIB
-	DEV_HARDWARE_SPI_Transfer(pData, Len);
+	DEV_HARDWARE_SPI_Write(pData, Len);
 #elif USE_HARDWARE_LIB
-	DEV_HARDWARE_SPI_Transfer(pData, Len);
+	DEV_HARDWARE_SPI_Write(pData, Len);
 #endif
 #endif
 }
@@ -393,6 +411,7 @@ UBYTE DEV_Module_Init(void)
 	DEV_GPIO_Init();
 	DEV_HARDWARE_SPI_begin("/dev/spidev0.0");
     DEV_HARDWARE_SPI_setSpeed(10000000);
+	DEV_HARDWARE_SPI_SetYieldCS(DEV_SPI_YieldCS);
 #endif
 
 #elif JETSON
@@ -418,6 +437,9 @@ UBYTE DEV_Module_Init(void)
 	DEV_HARDWARE_SPI_SetBitOrder(SPI_BIT_ORDER_MSBFIRST);  // Waveshare uses MSB first
 	DEV_HARDWARE_SPI_ChipSelect(SPI_CS_Mode_LOW);  // Use hardware-controlled CS
 	DEV_HARDWARE_SPI_setSpeed(1000000);  // 1MHz SPI speed (matches working ESP32 code)
+#ifdef EPD_GPIO_CS_YIELD
+	DEV_HARDWARE_SPI_SetYieldCS(DEV_SPI_YieldCS);
+#endif
 #elif USE_HARDWARE_LIB
 	printf("Write and read /dev/spidev1.0 \r\n");
 	DEV_GPIO_Init();
@@ -426,6 +448,9 @@ UBYTE DEV_Module_Init(void)
 	DEV_HARDWARE_SPI_SetBitOrder(SPI_BIT_ORDER_MSBFIRST);  // Waveshare uses MSB first
 	DEV_HARDWARE_SPI_ChipSelect(SPI_CS_Mode_LOW);  // Use hardware-controlled CS
 	DEV_HARDWARE_SPI_setSpeed(1000000);  // 1MHz SPI speed (matches working ESP32 code)
+#ifdef EPD_GPIO_CS_YIELD
+	DEV_HARDWARE_SPI_SetYieldCS(DEV_SPI_YieldCS);
+#endif
 #endif
 
 #endif
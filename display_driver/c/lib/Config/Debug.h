@@ -37,7 +37,12 @@
 
 #include <stdio.h>
 
-#if DEBUG
+#if defined(WALLET_LOG)
+	// Built into the wallet: debug output goes through its logger, and is
+	// compiled out unless WLOG_LEVEL_waveshare is WLOG_LEVEL_DEBUG or above
+	#include "wallet_log.h"
+	#define Debug(__info,...) WLOG_MODULE_AT(waveshare, WLOG_LEVEL_DEBUG, __info, ##__VA_ARGS__)
+#elif DEBUG
 	#define Debug(__info,...) printf("Debug: " __info,##__VA_ARGS__)
 #else
 	#define Debug(__info,...)  
@@ -44,6 +44,9 @@
 #include <sys/ioctl.h> 
 #include <linux/types.h> 
 #include <linux/spi/spidev.h> 
+#include <time.h>
+#include <pthread.h>
+#include <string.h>
 
 HARDWARE_SPI hardware_SPI;
 
@@ -58,6 +61,173 @@ static uint8_t bits = 8;
 
 struct spi_ioc_transfer tr;
 
+static uint32_t spi_bufsiz = 0;
+
+/**
+ * Arbiter shared by every device on one SPI controller
+**/
+typedef struct {
+    int id;                     // B in /dev/spidevB.C, -1 when unused
+    int users;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int busy;                   // A device owns the bus
+    int urgent_waiting;         // URGENT devices blocked in SPI_Bus_Acquire
+} SPI_BUS;
+
+struct SPIDevice {
+    int fd;
+    uint16_t mode;
+    uint32_t speed;
+    uint16_t delay;
+    SPIPriority priority;
+    SPI_BUS *bus;
+    int held;                   // Locked with DEV_HARDWARE_SPI_DeviceLock
+    SPI_YIELD_CS yield_cs;      // GPIO chip select to drop while yielding
+    SPI_STATS stats;
+};
+
+static SPI_BUS spi_buses[SPI_MAX_BUSES];
+static pthread_mutex_t spi_bus_table = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t spi_buses_once = PTHREAD_ONCE_INIT;
+
+// The device behind the legacy hardware_SPI / DEV_HARDWARE_SPI_* API
+static SPI_DEVICE legacy_dev = { .fd = -1 };
+
+
+/******************************************************************************
+function:   Set up every arbiter's lock once
+Info:   They are never destroyed: a device that is being closed can still be
+        inside SPI_Bus_Release or waiting on the condition when the last
+        user of a bus puts it, and a slot is reused by the next bus opened
+******************************************************************************/
+static void SPI_Buses_Init(void)
+{
+    for (int i = 0; i < SPI_MAX_BUSES; i++) {
+        pthread_mutex_init(&spi_buses[i].lock, NULL);
+        pthread_cond_init(&spi_buses[i].cond, NULL);
+    }
+}
+
+/******************************************************************************
+function:   Find or create the arbiter for a spidev node's bus
+parameter:
+    SPI_device : /dev/spidevB.C
+Info:   Return NULL when the bus number can't be parsed (no arbitration)
+******************************************************************************/
+static SPI_BUS *SPI_Bus_Get(const char *SPI_device)
+{
+    int id, cs;
+    SPI_BUS *bus = NULL;
+
+    if (sscanf(SPI_device, "/dev/spidev%d.%d", &id, &cs) != 2)
+        return NULL;
+
+    pthread_once(&spi_buses_once, SPI_Buses_Init);
+    pthread_mutex_lock(&spi_bus_table);
+    for (int i = 0; i < SPI_MAX_BUSES; i++) {
+        if (spi_buses[i].users > 0 && spi_buses[i].id == id) {
+            bus = &spi_buses[i];
+            break;
+        }
+    }
+    if (bus == NULL) {
+        for (int i = 0; i < SPI_MAX_BUSES; i++) {
+            if (spi_buses[i].users == 0) {
+                bus = &spi_buses[i];
+                pthread_mutex_lock(&bus->lock);
+                bus->id = id;
+                bus->busy = 0;
+                bus->urgent_waiting = 0;
+                pthread_mutex_unlock(&bus->lock);
+                break;
+            }
+        }
+    }
+    if (bus != NULL)
+        bus->users++;
+    pthread_mutex_unlock(&spi_bus_table);
+    return bus;
+}
+
+static void SPI_Bus_Put(SPI_BUS *bus)
+{
+    if (bus == NULL)
+        return;
+
+    pthread_mutex_lock(&spi_bus_table);
+    bus->users--;
+    pthread_mutex_unlock(&spi_bus_table);
+}
+
+/******************************************************************************
+function:   Take the bus for a device
+Info:   URGENT devices are queued ahead of BULK ones; a BULK device waits
+        until no URGENT device is pending
+******************************************************************************/
+static void SPI_Bus_Acquire(SPI_DEVICE *dev)
+{
+    SPI_BUS *bus = dev->bus;
+    if (bus == NULL)
+        return;
+
+    pthread_mutex_lock(&bus->lock);
+    if (dev->priority == SPI_PRIORITY_URGENT) {
+        bus->urgent_waiting++;
+        while (bus->busy)
+            pthread_cond_wait(&bus->cond, &bus->lock);
+        bus->urgent_waiting--;
+    } else {
+        while (bus->busy || bus->urgent_waiting > 0)
+            pthread_cond_wait(&bus->cond, &bus->lock);
+    }
+    bus->busy = 1;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+static void SPI_Bus_Release(SPI_DEVICE *dev)
+{
+    SPI_BUS *bus = dev->bus;
+    if (bus == NULL)
+        return;
+
+    pthread_mutex_lock(&bus->lock);
+    bus->busy = 0;
+    pthread_cond_broadcast(&bus->cond);
+    pthread_mutex_unlock(&bus->lock);
+}
+
+/******************************************************************************
+function:   Preemption point for BULK transfers
+Info:   Called between messages of a long transfer. If an URGENT device is
+        waiting the bus is handed over and taken back once it is done.
+        Each message is a complete chip-select cycle, so the display sees
+        an ordinary pause in its data stream. A chip select driven from a
+        GPIO stays low across messages, so it is raised through yield_cs
+        for as long as the other device has the bus; otherwise the urgent
+        device's traffic would be clocked into the display as well.
+******************************************************************************/
+static void SPI_Bus_Yield(SPI_DEVICE *dev)
+{
+    SPI_BUS *bus = dev->bus;
+    if (bus == NULL || dev->priority != SPI_PRIORITY_BULK)
+        return;
+
+    pthread_mutex_lock(&bus->lock);
+    if (bus->urgent_waiting > 0) {
+        if (dev->yield_cs)
+            dev->yield_cs(1);
+        bus->busy = 0;
+        pthread_cond_broadcast(&bus->cond);
+        while (bus->busy || bus->urgent_waiting > 0)
+            pthread_cond_wait(&bus->cond, &bus->lock);
+        bus->busy = 1;
+        if (dev->yield_cs)
+            dev->yield_cs(0);
+        dev->stats.yields++;
+    }
+    pthread_mutex_unlock(&bus->lock);
+}
 
 /******************************************************************************
 function:   SPI port initialization
@@ -90,6 +260,8 @@ void DEV_HARDWARE_SPI_begin(char *SPI_device)
         DEV_HARDWARE_SPI_Debug("can't get bits per word\r\n"); 
     }
     tr.bits_per_word = bits;
+    legacy_dev.bus = SPI_Bus_Get(SPI_device);
+    legacy_dev.priority = SPI_PRIORITY_BULK;
     
     DEV_HARDWARE_SPI_Mode(SPI_MODE_0);
     DEV_HARDWARE_SPI_ChipSelect(SPI_CS_Mode_LOW);
@@ -117,6 +289,8 @@ void DEV_HARDWARE_SPI_beginSet(char *SPI_device, SPIMode mode, uint32_t speed)
     ret = ioctl(hardware_SPI.fd, SPI_IOC_RD_BITS_PER_WORD, &bits);
     if (ret == -1) 
         DEV_HARDWARE_SPI_Debug("can't get bits per word\r\n"); 
+    legacy_dev.bus = SPI_Bus_Get(SPI_device);
+    legacy_dev.priority = SPI_PRIORITY_BULK;
 
     DEV_HARDWARE_SPI_Mode(mode);
     DEV_HARDWARE_SPI_ChipSelect(SPI_CS_Mode_LOW);
@@ -133,6 +307,8 @@ Info:
 void DEV_HARDWARE_SPI_end(void)
 {
     hardware_SPI.mode = 0;
+    SPI_Bus_Put(legacy_dev.bus);
+    legacy_dev.bus = NULL;
     if (close(hardware_SPI.fd) != 0){
         DEV_HARDWARE_SPI_Debug("Failed to close SPI device\r\n");
         perror("Failed to close SPI device.\n");  
@@ -309,6 +485,19 @@ int DEV_HARDWARE_SPI_SetBusMode(BusMode mode)
     return 1;
 }
 
+/******************************************************************************
+function:   Chip select driven from a GPIO instead of by spidev
+parameter:
+    yield_cs : Called with 1 before the bus is handed to an urgent device in
+               the middle of a transfer and with 0 once it is taken back;
+               NULL when spidev drives the chip select
+Info:   Applies to the device opened by DEV_HARDWARE_SPI_begin
+******************************************************************************/
+void DEV_HARDWARE_SPI_SetYieldCS(SPI_YIELD_CS yield_cs)
+{
+    legacy_dev.yield_cs = yield_cs;
+}
+
 /******************************************************************************
 function: 
     Time interval after transmission of one byte during continuous transmission
@@ -341,7 +530,12 @@ uint8_t DEV_HARDWARE_SPI_TransferByte(uint8_t buf)
     tr_local.cs_change = 0;  // Don't change CS after transfer (we control it manually)
     
     //ioctl Operation, transmission of data
+    legacy_dev.fd = hardware_SPI.fd;
+    if (!legacy_dev.held)
+        SPI_Bus_Acquire(&legacy_dev);
     int ret = ioctl(hardware_SPI.fd, SPI_IOC_MESSAGE(1), &tr_local);
+    if (!legacy_dev.held)
+        SPI_Bus_Release(&legacy_dev);
     if (ret < 1) {
         DEV_HARDWARE_SPI_Debug("SPI transfer failed: ret=%d, errno=%d\r\n", ret, errno);
         perror("SPI transfer");
@@ -352,22 +546,297 @@ uint8_t DEV_HARDWARE_SPI_TransferByte(uint8_t buf)
 }
 
 /******************************************************************************
-function: The SPI port reads a byte
+function: Full-duplex transfer, the received data overwrites buf
 parameter:
-Info: Return read data
+    buf :   Data to send / receive buffer
+    len :   Number of bytes
+Info:   Longer than bufsiz is split automatically
+        Return 1 success
+        Return -1 failed
 ******************************************************************************/
 int DEV_HARDWARE_SPI_Transfer(uint8_t *buf, uint32_t len)
 {
-    tr.len = len;
-    tr.tx_buf =  (unsigned long)buf;
-    tr.rx_buf =  (unsigned long)buf;
-    
-    //ioctl Operation, transmission of data
-    if (ioctl(hardware_SPI.fd, SPI_IOC_MESSAGE(1), &tr)  < 1 ){  
+    SPI_IOVEC iov = { buf, buf, len };
+
+    if (DEV_HARDWARE_SPI_TransferV(&iov, 1) < 0) {
         DEV_HARDWARE_SPI_Debug("can't send spi message\r\n"); 
         return -1;
     }
-    
     return 1;
 }
 
+/******************************************************************************
+function: Largest single spidev message
+Info:   spidev copies each message through a bounce buffer of
+        /sys/module/spidev/parameters/bufsiz bytes (4096 by default,
+        raise with spidev.bufsiz=<n> on the kernel command line), and
+        rejects messages whose total length is larger
+******************************************************************************/
+uint32_t DEV_HARDWARE_SPI_Bufsiz(void)
+{
+    if (spi_bufsiz == 0) {
+        FILE *fp = fopen("/sys/module/spidev/parameters/bufsiz", "r");
+        unsigned long v = 0;
+        if (fp != NULL) {
+            if (fscanf(fp, "%lu", &v) != 1)
+                v = 0;
+            fclose(fp);
+        }
+        spi_bufsiz = v > 0 ? (uint32_t)v : SPI_DEFAULT_BUFSIZ;
+        DEV_HARDWARE_SPI_Debug("spidev bufsiz = %u\r\n", spi_bufsiz);
+    }
+    return spi_bufsiz;
+}
+
+static uint64_t DEV_HARDWARE_SPI_Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int DEV_HARDWARE_SPI_Submit(SPI_DEVICE *dev, struct spi_ioc_transfer *xfer, int n, uint32_t bytes)
+{
+    uint64_t start = DEV_HARDWARE_SPI_Now();
+    int ret = ioctl(dev->fd, SPI_IOC_MESSAGE(n), xfer);
+    dev->stats.ns += DEV_HARDWARE_SPI_Now() - start;
+
+    if (ret < 0 || (uint32_t)ret != bytes) {
+        DEV_HARDWARE_SPI_Debug("SPI message failed: ret=%d, errno=%d\r\n", ret, errno);
+        return -1;
+    }
+    dev->stats.bytes += bytes;
+    dev->stats.ioctls++;
+    return 0;
+}
+
+/******************************************************************************
+function: Scatter-gather transfer on a device
+parameter:
+    dev    :   Device handle
+    iov    :   Segments, sent back to back with CS held between them
+    iovcnt :   Number of segments
+Info:   Segments are cut at bufsiz and packed into as few SPI_IOC_MESSAGE
+        calls as the kernel allows: each message carries up to
+        SPI_MAX_SEGMENTS transfers and at most bufsiz bytes in total.
+        Unless the caller holds the bus with DEV_HARDWARE_SPI_DeviceLock,
+        a BULK device offers the bus to waiting URGENT devices between
+        messages.
+        Return bytes transferred
+        Return -1 failed
+******************************************************************************/
+int DEV_HARDWARE_SPI_DeviceTransferV(SPI_DEVICE *dev, const SPI_IOVEC *iov, int iovcnt)
+{
+    struct spi_ioc_transfer xfer[SPI_MAX_SEGMENTS];
+    uint32_t bufsiz = DEV_HARDWARE_SPI_Bufsiz();
+    uint32_t batch = 0;     // Bytes queued in xfer
+    int n = 0;              // Transfers queued in xfer
+    int total = 0;
+    int locked_here = !dev->held;
+
+    if (locked_here)
+        SPI_Bus_Acquire(dev);
+
+    for (int i = 0; i < iovcnt; i++) {
+        uint32_t off = 0;
+        while (off < iov[i].len) {
+            uint32_t len = iov[i].len - off;
+            if (len > bufsiz - batch)
+                len = bufsiz - batch;
+
+            struct spi_ioc_transfer *t = &xfer[n++];
+            memset(t, 0, sizeof(*t));
+            t->tx_buf = iov[i].tx ? (unsigned long)(iov[i].tx + off) : 0;
+            t->rx_buf = iov[i].rx ? (unsigned long)(iov[i].rx + off) : 0;
+            t->len = len;
+            t->speed_hz = dev->speed;
+            t->bits_per_word = bits;
+            t->delay_usecs = dev->delay;
+
+            off += len;
+            batch += len;
+            if (batch == bufsiz || n == SPI_MAX_SEGMENTS) {
+                if (DEV_HARDWARE_SPI_Submit(dev, xfer, n, batch) < 0) {
+                    total = -1;
+                    goto out;
+                }
+                total += batch;
+                batch = 0;
+                n = 0;
+                if (locked_here)
+                    SPI_Bus_Yield(dev);
+            }
+        }
+    }
+
+    if (n > 0) {
+        if (DEV_HARDWARE_SPI_Submit(dev, xfer, n, batch) < 0)
+            total = -1;
+        else
+            total += batch;
+    }
+
+out:
+    if (locked_here)
+        SPI_Bus_Release(dev);
+    return total;
+}
+
+int DEV_HARDWARE_SPI_DeviceTransfer(SPI_DEVICE *dev, const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    SPI_IOVEC iov = { tx, rx, len };
+    return DEV_HARDWARE_SPI_DeviceTransferV(dev, &iov, 1) < 0 ? -1 : 1;
+}
+
+/******************************************************************************
+function: Scatter-gather transfer on the device opened by DEV_HARDWARE_SPI_begin
+******************************************************************************/
+int DEV_HARDWARE_SPI_TransferV(const SPI_IOVEC *iov, int iovcnt)
+{
+    legacy_dev.fd = hardware_SPI.fd;
+    legacy_dev.speed = hardware_SPI.speed;
+    legacy_dev.delay = hardware_SPI.delay;
+    return DEV_HARDWARE_SPI_DeviceTransferV(&legacy_dev, iov, iovcnt);
+}
+
+/******************************************************************************
+function: Hold the bus across several transfers
+Info:   For command/response exchanges that must not be interleaved with
+        another device. Return 1 success
+******************************************************************************/
+int DEV_HARDWARE_SPI_DeviceLock(SPI_DEVICE *dev)
+{
+    if (dev->held++ == 0)
+        SPI_Bus_Acquire(dev);
+    return 1;
+}
+
+void DEV_HARDWARE_SPI_DeviceUnlock(SPI_DEVICE *dev)
+{
+    if (dev->held > 0 && --dev->held == 0)
+        SPI_Bus_Release(dev);
+}
+
+/******************************************************************************
+function: Open a spidev node as an independent device
+parameter:
+    SPI_device : /dev/spidevB.C
+    mode       : SPI_MODE0..3
+    speed      : Clock in Hz, applied per transfer
+    order      : Bit order
+    priority   : Arbitration class on the shared bus
+Info:   Unlike DEV_HARDWARE_SPI_begin this does not exit on failure
+        Return NULL failed
+******************************************************************************/
+SPI_DEVICE *DEV_HARDWARE_SPI_Open(const char *SPI_device, SPIMode mode, uint32_t speed,
+                                  SPIBitOrder order, SPIPriority priority)
+{
+    SPI_DEVICE *dev = calloc(1, sizeof(SPI_DEVICE));
+    if (dev == NULL)
+        return NULL;
+
+    dev->fd = open(SPI_device, O_RDWR | O_CLOEXEC);
+    if (dev->fd < 0) {
+        DEV_HARDWARE_SPI_Debug("Failed to open %s\r\n", SPI_device);
+        free(dev);
+        return NULL;
+    }
+
+    dev->mode = mode & 0x03;
+    if (order == SPI_BIT_ORDER_LSBFIRST)
+        dev->mode |= SPI_LSB_FIRST;
+    dev->speed = speed;
+    dev->priority = priority;
+
+    uint8_t mode8 = (uint8_t)dev->mode;
+    if (ioctl(dev->fd, SPI_IOC_WR_MODE, &mode8) == -1 ||
+        ioctl(dev->fd, SPI_IOC_WR_BITS_PER_WORD, &bits) == -1 ||
+        ioctl(dev->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1) {
+        DEV_HARDWARE_SPI_Debug("can't configure %s\r\n", SPI_device);
+        close(dev->fd);
+        free(dev);
+        return NULL;
+    }
+
+    dev->bus = SPI_Bus_Get(SPI_device);
+    DEV_HARDWARE_SPI_Debug("open : %s (priority %d)\r\n", SPI_device, priority);
+    return dev;
+}
+
+void DEV_HARDWARE_SPI_Close(SPI_DEVICE *dev)
+{
+    if (dev == NULL)
+        return;
+
+    while (dev->held > 0)
+        DEV_HARDWARE_SPI_DeviceUnlock(dev);
+    SPI_Bus_Put(dev->bus);
+    close(dev->fd);
+    free(dev);
+}
+
+/******************************************************************************
+function: The device behind the legacy DEV_HARDWARE_SPI_* functions
+Info:   Lets code written against the handle API share the display's bus
+        arbiter. Return NULL before DEV_HARDWARE_SPI_begin
+******************************************************************************/
+SPI_DEVICE *DEV_HARDWARE_SPI_Default(void)
+{
+    if (hardware_SPI.fd <= 0)
+        return NULL;
+    legacy_dev.fd = hardware_SPI.fd;
+    legacy_dev.speed = hardware_SPI.speed;
+    legacy_dev.delay = hardware_SPI.delay;
+    return &legacy_dev;
+}
+
+int DEV_HARDWARE_SPI_DeviceSetSpeed(SPI_DEVICE *dev, uint32_t speed)
+{
+    if (ioctl(dev->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1) {
+        DEV_HARDWARE_SPI_Debug("can't set max speed hz\r\n"); 
+        return -1;
+    }
+    dev->speed = speed;
+    return 1;
+}
+
+/******************************************************************************
+function: Write-only transfer, buf is left untouched
+parameter:
+    buf :   Data to send
+    len :   Number of bytes
+Info:   Return 1 success
+        Return -1 failed
+******************************************************************************/
+int DEV_HARDWARE_SPI_Write(const uint8_t *buf, uint32_t len)
+{
+    SPI_IOVEC iov = { buf, NULL, len };
+    return DEV_HARDWARE_SPI_TransferV(&iov, 1) < 0 ? -1 : 1;
+}
+
+/******************************************************************************
+function: Transfer statistics
+Info:   Throughput is bytes per second spent inside the kernel, so it
+        reflects the controller rather than the caller's pacing
+******************************************************************************/
+void DEV_HARDWARE_SPI_GetStats(SPI_STATS *stats)
+{
+    *stats = legacy_dev.stats;
+}
+
+void DEV_HARDWARE_SPI_DeviceStats(SPI_DEVICE *dev, SPI_STATS *stats)
+{
+    *stats = dev->stats;
+}
+
+void DEV_HARDWARE_SPI_ResetStats(void)
+{
+    memset(&legacy_dev.stats, 0, sizeof(legacy_dev.stats));
+}
+
+double DEV_HARDWARE_SPI_Throughput(void)
+{
+    if (legacy_dev.stats.ns == 0)
+        return 0.0;
+    return (double)legacy_dev.stats.bytes * 1e9 / (double)legacy_dev.stats.ns;
+}
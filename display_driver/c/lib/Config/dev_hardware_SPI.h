@@ -97,6 +97,54 @@ typedef struct SPIStruct {
     int fd; //
 } HARDWARE_SPI;
 
+/**
+ * One segment of a scatter-gather transfer
+ * tx : data to send, NULL clocks out zeros
+ * rx : receive buffer, NULL discards what is read
+**/
+typedef struct {
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint32_t len;
+} SPI_IOVEC;
+
+/**
+ * Transfer statistics since the last reset
+**/
+typedef struct {
+    uint64_t bytes;
+    uint64_t ioctls;
+    uint64_t ns;        // Time spent inside SPI_IOC_MESSAGE
+    uint64_t yields;    // Times the bus was handed to an urgent device
+} SPI_STATS;
+
+#define SPI_MAX_SEGMENTS    64      // spi_ioc_transfer entries per ioctl
+#define SPI_DEFAULT_BUFSIZ  4096    // spidev default when sysfs is unreadable
+#define SPI_MAX_BUSES       4
+
+/**
+ * Bus arbitration priority
+ * BULK devices (the display) give the bus up between bufsiz chunks when an
+ * URGENT device (the secure element) is waiting for it
+**/
+typedef enum
+{
+    SPI_PRIORITY_BULK   = 0,
+    SPI_PRIORITY_URGENT = 1
+}SPIPriority;
+
+/**
+ * Handle for one spidev node (one chip select), with its own fd, mode and
+ * speed. Devices on the same bus (/dev/spidevB.*) share an arbiter.
+**/
+typedef struct SPIDevice SPI_DEVICE;
+
+/**
+ * Drives a GPIO chip select around a bus yield: 1 releases it, 0 asserts
+ * it again
+**/
+typedef void (*SPI_YIELD_CS)(int release);
+
 
 
 
@@ -108,8 +156,28 @@ int DEV_HARDWARE_SPI_setSpeed(uint32_t speed);
 
 uint8_t DEV_HARDWARE_SPI_TransferByte(uint8_t buf);
 int DEV_HARDWARE_SPI_Transfer(uint8_t *buf, uint32_t len);
+int DEV_HARDWARE_SPI_TransferV(const SPI_IOVEC *iov, int iovcnt);
+int DEV_HARDWARE_SPI_Write(const uint8_t *buf, uint32_t len);
+uint32_t DEV_HARDWARE_SPI_Bufsiz(void);
+
+void DEV_HARDWARE_SPI_GetStats(SPI_STATS *stats);
+void DEV_HARDWARE_SPI_ResetStats(void);
+double DEV_HARDWARE_SPI_Throughput(void);
+
+SPI_DEVICE *DEV_HARDWARE_SPI_Open(const char *SPI_device, SPIMode mode, uint32_t speed,
+                                  SPIBitOrder order, SPIPriority priority);
+void DEV_HARDWARE_SPI_Close(SPI_DEVICE *dev);
+SPI_DEVICE *DEV_HARDWARE_SPI_Default(void);
+
+int DEV_HARDWARE_SPI_DeviceSetSpeed(SPI_DEVICE *dev, uint32_t speed);
+int DEV_HARDWARE_SPI_DeviceTransferV(SPI_DEVICE *dev, const SPI_IOVEC *iov, int iovcnt);
+int DEV_HARDWARE_SPI_DeviceTransfer(SPI_DEVICE *dev, const uint8_t *tx, uint8_t *rx, uint32_t len);
+int DEV_HARDWARE_SPI_DeviceLock(SPI_DEVICE *dev);
+void DEV_HARDWARE_SPI_DeviceUnlock(SPI_DEVICE *dev);
+void DEV_HARDWARE_SPI_DeviceStats(SPI_DEVICE *dev, SPI_STATS *stats);
 
 void DEV_HARDWARE_SPI_SetDataInterval(uint16_t us);
+void DEV_HARDWARE_SPI_SetYieldCS(SPI_YIELD_CS yield_cs);
 int DEV_HARDWARE_SPI_SetBusMode(BusMode mode);
 int DEV_HARDWARE_SPI_SetBitOrder(SPIBitOrder Order);
 int DEV_HARDWARE_SPI_ChipSelect(SPIChipSelect CS_Mode);
@@ -29,9 +29,224 @@
 #
 ******************************************************************************/
 #include "sysfs_software_spi.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
 
 SOFTWARE_SPI software_spi;
 
+/**
+ * GPIO character device state. SCLK and MOSI are requested together in
+ * one output handle (index 0 and 1) so a clock edge and its data bit go
+ * out in a single GPIOHANDLE_SET_LINE_VALUES_IOCTL; MISO is its own input
+ * handle and is only sampled when the caller wants the received bytes.
+**/
+#define CDEV_SCLK   0
+#define CDEV_MOSI   1
+#define CDEV_CONSUMER "software-spi"
+
+static SOFTWARE_SPI_Backend spi_backend = SOFTWARE_SPI_SYSFS;
+static int cdev_out_fd = -1;
+static int cdev_in_fd = -1;
+
+/******************************************************************************
+function:   Map a global sysfs GPIO number to a /dev/gpiochipN and line offset
+parameter:
+    Pin     : global GPIO number, as written to /sys/class/gpio/export
+    Offset  : line offset within the returned chip
+    Index   : N of the returned /dev/gpiochipN
+Info:
+    /sys/class/gpio/gpiochipX carries the base, ngpio and label of every
+    controller; the character device with the same label and line count
+    is the one that owns the pin. Returns an open chip fd or -1.
+******************************************************************************/
+static int SYSFS_software_spi_cdev_chip(int Pin, uint32_t *Offset, int *Index)
+{
+    char path[DIR_MAXSIZ + 16], label[32], buf[32];
+    int base = -1, ngpio = 0;
+    struct dirent *ent;
+    DIR *dir;
+    FILE *fp;
+
+    dir = opendir("/sys/class/gpio");
+    if (dir == NULL)
+        return -1;
+    while ((ent = readdir(dir)) != NULL) {
+        int b, n;
+        if (strncmp(ent->d_name, "gpiochip", 8) != 0)
+            continue;
+        snprintf(path, sizeof(path), "/sys/class/gpio/%.32s/base", ent->d_name);
+        if ((fp = fopen(path, "r")) == NULL)
+            continue;
+        b = fgets(buf, sizeof(buf), fp) ? atoi(buf) : -1;
+        fclose(fp);
+        snprintf(path, sizeof(path), "/sys/class/gpio/%.32s/ngpio", ent->d_name);
+        if ((fp = fopen(path, "r")) == NULL)
+            continue;
+        n = fgets(buf, sizeof(buf), fp) ? atoi(buf) : 0;
+        fclose(fp);
+        if (b < 0 || Pin < b || Pin >= b + n)
+            continue;
+        snprintf(path, sizeof(path), "/sys/class/gpio/%.32s/label", ent->d_name);
+        if ((fp = fopen(path, "r")) == NULL)
+            continue;
+        if (fgets(label, sizeof(label), fp) == NULL)
+            label[0] = '\0';
+        fclose(fp);
+        label[strcspn(label, "\n")] = '\0';
+        base = b;
+        ngpio = n;
+        break;
+    }
+    closedir(dir);
+    if (base < 0)
+        return -1;
+
+    for (int i = 0; i < 32; i++) {
+        struct gpiochip_info info;
+        int fd;
+
+        snprintf(path, sizeof(path), "/dev/gpiochip%d", i);
+        fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT)
+                break;
+            continue;
+        }
+        memset(&info, 0, sizeof(info));
+        if (ioctl(fd, GPIO_GET_CHIPINFO_IOCTL, &info) == 0 &&
+            (int)info.lines == ngpio &&
+            strncmp(info.label, label, sizeof(info.label)) == 0) {
+            *Offset = Pin - base;
+            *Index = i;
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+/******************************************************************************
+function:   Request the SPI lines through the GPIO character device
+parameter:
+Info:
+    Returns 0 when SCLK/MOSI (and MISO, if it resolves) are held by this
+    process. Lines stay requested until SYSFS_software_spi_end().
+******************************************************************************/
+static int SYSFS_software_spi_cdev_begin(void)
+{
+    struct gpiohandle_request req;
+    uint32_t sclk, mosi, miso;
+    int chip, mosi_chip, miso_chip, index, mosi_index;
+
+    chip = SYSFS_software_spi_cdev_chip(software_spi.SCLK_PIN, &sclk, &index);
+    if (chip < 0)
+        return -1;
+    mosi_chip = SYSFS_software_spi_cdev_chip(software_spi.MOSI_PIN, &mosi, &mosi_index);
+    if (mosi_chip >= 0)
+        close(mosi_chip);
+    // Both outputs have to live on the same controller to share a handle
+    if (mosi_chip < 0 || mosi_index != index) {
+        SYSFS_SOFTWARE_SPI_Debug("gpio cdev: SCLK and MOSI not on one gpiochip\r\n");
+        close(chip);
+        return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.lineoffsets[CDEV_SCLK] = sclk;
+    req.lineoffsets[CDEV_MOSI] = mosi;
+    req.default_values[CDEV_SCLK] = software_spi.CPOL;
+    req.default_values[CDEV_MOSI] = 0;
+    req.lines = 2;
+    req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+    strncpy(req.consumer_label, CDEV_CONSUMER, sizeof(req.consumer_label) - 1);
+    if (ioctl(chip, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+        SYSFS_SOFTWARE_SPI_Debug("gpio cdev: SCLK/MOSI request failed (%d)\r\n", errno);
+        close(chip);
+        return -1;
+    }
+    close(chip);
+    cdev_out_fd = req.fd;
+
+    miso_chip = SYSFS_software_spi_cdev_chip(software_spi.MISO_PIN, &miso, &index);
+    if (miso_chip >= 0) {
+        memset(&req, 0, sizeof(req));
+        req.lineoffsets[0] = miso;
+        req.lines = 1;
+        req.flags = GPIOHANDLE_REQUEST_INPUT;
+        strncpy(req.consumer_label, CDEV_CONSUMER, sizeof(req.consumer_label) - 1);
+        if (ioctl(miso_chip, GPIO_GET_LINEHANDLE_IOCTL, &req) == 0)
+            cdev_in_fd = req.fd;
+        close(miso_chip);
+    }
+    if (cdev_in_fd < 0)
+        SYSFS_SOFTWARE_SPI_Debug("gpio cdev: MISO unavailable, reads return 0\r\n");
+    return 0;
+}
+
+static inline void SYSFS_software_spi_cdev_set(uint8_t sclk, uint8_t mosi)
+{
+    struct gpiohandle_data data;
+
+    memset(&data, 0, sizeof(data));
+    data.values[CDEV_SCLK] = sclk;
+    data.values[CDEV_MOSI] = mosi;
+    ioctl(cdev_out_fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+}
+
+static inline uint8_t SYSFS_software_spi_cdev_get(void)
+{
+    struct gpiohandle_data data;
+
+    if (cdev_in_fd < 0)
+        return 0;
+    memset(&data, 0, sizeof(data));
+    if (ioctl(cdev_in_fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+        return 0;
+    return data.values[0] & 1;
+}
+
+static inline uint8_t SYSFS_software_spi_reverse(uint8_t value)
+{
+    value = (value & 0xF0) >> 4 | (value & 0x0F) << 4;
+    value = (value & 0xCC) >> 2 | (value & 0x33) << 2;
+    value = (value & 0xAA) >> 1 | (value & 0x55) << 1;
+    return value;
+}
+
+/******************************************************************************
+function:   Shift one byte through the character device lines
+parameter:
+    value   : byte to send, already in MSB-first order
+    Read    : 1 to sample MISO, 0 to skip the extra ioctl per bit
+Info:
+    Two ioctls per bit for any mode:
+      CPHA = 0 : data out with the clock idle, then the leading edge
+      CPHA = 1 : leading edge with the data, then the trailing edge
+    and MISO is sampled after the second one.
+******************************************************************************/
+static uint8_t SYSFS_software_spi_cdev_byte(uint8_t value, uint8_t Read)
+{
+    uint8_t idle = software_spi.CPOL, active = !software_spi.CPOL;
+    uint8_t first = software_spi.CPHA ? active : idle;
+    uint8_t second = software_spi.CPHA ? idle : active;
+    uint8_t Read_data = 0;
+
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        uint8_t mosi = (value >> (7 - bit)) & 1;
+        SYSFS_software_spi_cdev_set(first, mosi);
+        SYSFS_software_spi_cdev_set(second, mosi);
+        if (Read)
+            Read_data = (Read_data << 1) | SYSFS_software_spi_cdev_get();
+    }
+    return Read_data;
+}
+
 /******************************************************************************
 function:
 parameter:
@@ -50,6 +265,17 @@ void SYSFS_software_spi_begin(void)
     software_spi.Delay = SOFTWARE_SPI_CLOCK_DIV2;
     software_spi.Order = SOFTWARE_SPI_MSBFIRST; // MSBFIRST
 
+    software_spi.CPOL = 0;
+    software_spi.CPHA = 0;
+
+    if (SYSFS_software_spi_cdev_begin() == 0) {
+        spi_backend = SOFTWARE_SPI_CDEV;
+        SYSFS_SOFTWARE_SPI_Debug("Software spi: gpio character device\r\n");
+        return;
+    }
+    spi_backend = SOFTWARE_SPI_SYSFS;
+    SYSFS_SOFTWARE_SPI_Debug("Software spi: sysfs gpio\r\n");
+
     SYSFS_GPIO_Export(software_spi.SCLK_PIN);
     SYSFS_GPIO_Export(software_spi.MOSI_PIN);
     SYSFS_GPIO_Export(software_spi.MISO_PIN);
@@ -61,6 +287,16 @@ void SYSFS_software_spi_begin(void)
 
 void SYSFS_software_spi_end(void)
 {
+    if (spi_backend == SOFTWARE_SPI_CDEV) {
+        SYSFS_software_spi_cdev_set(LOW, LOW);
+        close(cdev_out_fd);
+        if (cdev_in_fd >= 0)
+            close(cdev_in_fd);
+        cdev_out_fd = cdev_in_fd = -1;
+        spi_backend = SOFTWARE_SPI_SYSFS;
+        return;
+    }
+
     SYSFS_GPIO_Write(software_spi.SCLK_PIN, LOW);
     SYSFS_GPIO_Write(software_spi.MOSI_PIN, LOW);
 
@@ -143,18 +379,16 @@ Info:
 uint8_t SYSFS_software_spi_transfer(uint8_t value)
 {
     // printf("value = %d\r\n", value);
-    uint8_t Read_data;
-    if (software_spi.Order == SOFTWARE_SPI_LSBFIRST) {
-        uint8_t temp =
-            ((value & 0x01) << 7) |
-            ((value & 0x02) << 5) |
-            ((value & 0x04) << 3) |
-            ((value & 0x08) << 1) |
-            ((value & 0x10) >> 1) |
-            ((value & 0x20) >> 3) |
-            ((value & 0x40) >> 5) |
-            ((value & 0x80) >> 7);
-        value = temp;
+    uint8_t Read_data = 0;
+    if (software_spi.Order == SOFTWARE_SPI_LSBFIRST)
+        value = SYSFS_software_spi_reverse(value);
+
+    if (spi_backend == SOFTWARE_SPI_CDEV) {
+        Read_data = SYSFS_software_spi_cdev_byte(value, 1);
+        SYSFS_software_spi_cdev_set(software_spi.CPOL, LOW);
+        if (software_spi.Order == SOFTWARE_SPI_LSBFIRST)
+            Read_data = SYSFS_software_spi_reverse(Read_data);
+        return Read_data;
     }
 
     uint8_t delay = software_spi.Delay >> 1;
@@ -202,3 +436,41 @@ uint8_t SYSFS_software_spi_transfer(uint8_t value)
     }
     return Read_data;
 }
+
+/******************************************************************************
+function:   Transfer a whole buffer
+parameter:
+    tx      : bytes to send
+    rx      : received bytes, or NULL for write-only (no MISO sampling)
+    len     : number of bytes
+Info:
+    On the character device the clock is only returned to idle once, at
+    the end of the buffer; on sysfs this is a loop over the byte transfer.
+******************************************************************************/
+void SYSFS_software_spi_transfer_buf(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    if (spi_backend != SOFTWARE_SPI_CDEV) {
+        for (uint32_t i = 0; i < len; i++) {
+            uint8_t r = SYSFS_software_spi_transfer(tx[i]);
+            if (rx)
+                rx[i] = r;
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t value = tx[i];
+        if (software_spi.Order == SOFTWARE_SPI_LSBFIRST)
+            value = SYSFS_software_spi_reverse(value);
+        value = SYSFS_software_spi_cdev_byte(value, rx != NULL);
+        if (rx)
+            rx[i] = software_spi.Order == SOFTWARE_SPI_LSBFIRST ?
+                    SYSFS_software_spi_reverse(value) : value;
+    }
+    SYSFS_software_spi_cdev_set(software_spi.CPOL, LOW);
+}
+
+SOFTWARE_SPI_Backend SYSFS_software_spi_backend(void)
+{
+    return spi_backend;
+}
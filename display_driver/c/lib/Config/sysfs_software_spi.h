@@ -4,6 +4,13 @@
 * | Function    :   Read and write /sys/class/gpio, software spi
 * | Info        :
 *----------------
+* |	This version:   V1.1
+* | Date        :   2026-10-19
+* | Info        :
+*    1.Bit-bang through the GPIO character device when available:
+*      SCLK and MOSI share one line handle and change in a single ioctl
+*    2.Add SYSFS_software_spi_transfer_buf() for whole-buffer transfers
+*
 * |	This version:   V1.0
 * | Date        :   2019-06-05
 * | Info        :   Basic version
@@ -101,11 +108,21 @@ typedef struct SPIStruct {
     SOFTWARE_SPI_Order Order;
 } SOFTWARE_SPI;
 
+/**
+ * Pin access backend, chosen by SYSFS_software_spi_begin()
+**/
+typedef enum {
+    SOFTWARE_SPI_SYSFS,     /* open/write/close of /sys/class/gpio per edge */
+    SOFTWARE_SPI_CDEV,      /* line handles on /dev/gpiochipN held open */
+} SOFTWARE_SPI_Backend;
+
 void SYSFS_software_spi_begin(void);
 void SYSFS_software_spi_end(void);
 void SYSFS_software_spi_setBitOrder(uint8_t order);
 void SYSFS_software_spi_setDataMode(uint8_t mode);
 void SYSFS_software_spi_setClockDivider(uint8_t div);
 uint8_t SYSFS_software_spi_transfer(uint8_t value);
+void SYSFS_software_spi_transfer_buf(const uint8_t *tx, uint8_t *rx, uint32_t len);
+SOFTWARE_SPI_Backend SYSFS_software_spi_backend(void);
 
 #endif
\ No newline at end of file
@@ -6,10 +6,14 @@
 *                Used to shield the underlying layers of each master
 *                and enhance portability
 *----------------
-* |	This version:   V2.3
-* | Date        :   2022-07-27
+* |	This version:   V2.4
+* | Date        :   2026-10-19
 * | Info        :   
 * -----------------------------------------------------------------------------
+* V2.4(2026-10-19):
+* 1.Add GUI_ReadBmp_RGB_Dither()
+* 2.GUI_ReadBmp_RGB_7Color() / GUI_ReadBmp_RGB_4Color() read the pixel
+*   array in one fread and quantize through GUI_Dither
 * V2.3(2022-07-27):
 * 1.Add GUI_ReadBmp_RGB_4Color()
 * V2.2(2020-07-08):
@@ -45,6 +49,7 @@
 
 #include "GUI_BMPfile.h"
 #include "GUI_Paint.h"
+#include "GUI_Dither.h"
 #include "Debug.h"
 
 #include <fcntl.h>
@@ -286,12 +291,26 @@ UBYTE GUI_ReadBmp_16Gray(const char *path, UWORD Xstart, UWORD Ystart)
     return 0;
 }
 
-UBYTE GUI_ReadBmp_RGB_7Color(const char *path, UWORD Xstart, UWORD Ystart)
+/******************************************************************************
+function :	Read a 24-bit BMP and reduce it to a color palette
+parameter:
+    path     : BMP file path
+    Xstart   : X position in the Paint image
+    Ystart   : Y position in the Paint image
+    Palette  : Target palette, must match Paint.Scale (7 or 4)
+    Mode     : Error diffusion kernel, DITHER_NONE for pre-quantized art
+info:
+    The pixel array is read in one go and quantized through GUI_Dither.
+    When the picture covers the whole unrotated Paint image it is packed
+    straight into Paint.Image, otherwise it goes through Paint_SetPixel.
+******************************************************************************/
+UBYTE GUI_ReadBmp_RGB_Dither(const char *path, UWORD Xstart, UWORD Ystart,
+                             DITHER_PALETTE Palette, DITHER_MODE Mode)
 {
     FILE *fp;                     //Define a file pointer
     BMPFILEHEADER bmpFileHeader;  //Define a bmp file header structure
     BMPINFOHEADER bmpInfoHeader;  //Define a bmp info header structure
-    
+
     // Binary file open
     if((fp = fopen(path, "rb")) == NULL) {
         Debug("Cann't open the file!\n");
@@ -303,148 +322,85 @@ UBYTE GUI_ReadBmp_RGB_7Color(const char *path, UWORD Xstart, UWORD Ystart)
     fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 14
     fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 50
     printf("pixel = %d * %d\r\n", bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-	
-    UDOUBLE Image_Byte = bmpInfoHeader.biWidth * bmpInfoHeader.biHeight * 3;
-    UBYTE Image[Image_Byte];
-    memset(Image, 0xFF, Image_Byte);
 
-    // Determine if it is a monochrome bitmap
-    int readbyte = bmpInfoHeader.biBitCount;
-    if(readbyte != 24){
+    if(bmpInfoHeader.biBitCount != 24){
         Debug("Bmp image is not 24 bitmap!\n");
         exit(0);
     }
-    // Read image data into the cache
-    UWORD x, y;
-    UBYTE Rdata[3];
-    fseek(fp, bmpFileHeader.bOffset, SEEK_SET);
-    
-    for(y = 0; y < bmpInfoHeader.biHeight; y++) {//Total display column
-        for(x = 0; x < bmpInfoHeader.biWidth ; x++) {//Show a line in the line
-            if(fread((char *)Rdata, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(fread((char *)Rdata+1, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(fread((char *)Rdata+2, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
 
-			if(Rdata[0] == 0 && Rdata[1] == 0 && Rdata[2] == 0){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  0;//Black
-			}else if(Rdata[0] == 255 && Rdata[1] == 255 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  1;//White
-			}else if(Rdata[0] == 0 && Rdata[1] == 255 && Rdata[2] == 0){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  2;//Green
-			}else if(Rdata[0] == 255 && Rdata[1] == 0 && Rdata[2] == 0){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  3;//Blue
-			}else if(Rdata[0] == 0 && Rdata[1] == 0 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  4;//Red
-			}else if(Rdata[0] == 0 && Rdata[1] == 255 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  5;//Yellow
-			}else if(Rdata[0] == 0 && Rdata[1] == 128 && Rdata[2] == 255){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  6;//Orange
-			}
-        }
-    }
-    fclose(fp);
-   
-    // Refresh the image to the display buffer based on the displayed orientation
-    for(y = 0; y < bmpInfoHeader.biHeight; y++) {
-        for(x = 0; x < bmpInfoHeader.biWidth; x++) {
-            if(x > Paint.Width || y > Paint.Height) {
-                break;
-            }
-            Paint_SetPixel(Xstart + x, Ystart + y, Image[bmpInfoHeader.biHeight *  bmpInfoHeader.biWidth - 1 -(bmpInfoHeader.biWidth-x-1+(y* bmpInfoHeader.biWidth))]);
-		}
+    UWORD Width = bmpInfoHeader.biWidth;
+    UWORD Height = bmpInfoHeader.biHeight;
+    UDOUBLE Stride = (Width * 3 + 3) & ~3UL;     // Rows are padded to 4 bytes
+    UBYTE *Rgb = malloc(Stride * Height);
+    if(Rgb == NULL) {
+        Debug("Failed to apply for bmp memory...\r\n");
+        fclose(fp);
+        return 1;
     }
-    return 0;
-}
 
-UBYTE GUI_ReadBmp_RGB_4Color(const char *path, UWORD Xstart, UWORD Ystart)
-{
-    FILE *fp;                     //Define a file pointer
-    BMPFILEHEADER bmpFileHeader;  //Define a bmp file header structure
-    BMPINFOHEADER bmpInfoHeader;  //Define a bmp info header structure
-    
-    // Binary file open
-    if((fp = fopen(path, "rb")) == NULL) {
-        Debug("Cann't open the file!\n");
-        exit(0);
+    fseek(fp, bmpFileHeader.bOffset, SEEK_SET);
+    if(fread(Rgb, 1, Stride * Height, fp) != Stride * Height) {
+        perror("get bmpdata:\r\n");
+        free(Rgb);
+        fclose(fp);
+        return 1;
     }
+    fclose(fp);
 
-    // Set the file pointer from the beginning
-    fseek(fp, 0, SEEK_SET);
-    fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 14
-    fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 50
-    printf("pixel = %d * %d\r\n", bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-	
-    UDOUBLE Image_Byte = bmpInfoHeader.biWidth * bmpInfoHeader.biHeight * 3;
-    UBYTE Image[Image_Byte];
-    memset(Image, 0xFF, Image_Byte);
+    UDOUBLE WidthByte = Dither_WidthByte(Palette, Width);
+    if(Paint.Rotate == ROTATE_0 && Paint.Mirror == MIRROR_NONE &&
+       Xstart == 0 && Ystart == 0 && Width == Paint.WidthMemory &&
+       Height <= Paint.HeightMemory && WidthByte == Paint.WidthByte) {
+        UBYTE ret = Dither_Image(Rgb, Width, Height, Stride, 1, Palette, Mode, Paint.Image);
+        free(Rgb);
+        return ret;
+    }
 
-    // Determine if it is a monochrome bitmap
-    int readbyte = bmpInfoHeader.biBitCount;
-    if(readbyte != 24){
-        Debug("Bmp image is not 24 bitmap!\n");
-        exit(0);
+    UBYTE *Image = malloc(WidthByte * Height);
+    if(Image == NULL) {
+        Debug("Failed to apply for bmp memory...\r\n");
+        free(Rgb);
+        return 1;
     }
-    // Read image data into the cache
+    if(Dither_Image(Rgb, Width, Height, Stride, 1, Palette, Mode, Image) != 0) {
+        Debug("Failed to dither the bmp...\r\n");
+        free(Image);
+        free(Rgb);
+        return 1;
+    }
+    free(Rgb);
+
+    // Refresh the image to the display buffer based on the displayed orientation
     UWORD x, y;
-    UBYTE Rdata[3];
-    fseek(fp, bmpFileHeader.bOffset, SEEK_SET);
-    
-    for(y = 0; y < bmpInfoHeader.biHeight; y++) {//Total display column
-        for(x = 0; x < bmpInfoHeader.biWidth ; x++) {//Show a line in the line
-            if(fread((char *)Rdata, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(fread((char *)Rdata+1, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(fread((char *)Rdata+2, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-			if(Rdata[0] < 128 && Rdata[1] < 128 && Rdata[2] < 128){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  0;//Black
-			}else if(Rdata[0] > 127 && Rdata[1] > 127 && Rdata[2] > 127){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  1;//White
-			}else if(Rdata[0] < 128 && Rdata[1] > 127 && Rdata[2] > 127){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  2;//Yellow
-			}else if(Rdata[0] < 128 && Rdata[1] < 128 && Rdata[2] > 127){
-				Image[x+(y* bmpInfoHeader.biWidth )] =  3;//Red
-			}
+    UBYTE color;
+    for(y = 0; y < Height; y++) {
+        if(Ystart + y >= Paint.Height) {
+            break;
         }
-        if(bmpInfoHeader.biWidth % 4 != 0)
-        {
-            for (UWORD i = 0; i < (bmpInfoHeader.biWidth % 4); i++)
-            {
-                if(fread((char *)Rdata, 1, 1, fp) != 1) {
-                perror("get bmpdata:\r\n");
+        const UBYTE *row = Image + y * WidthByte;
+        for(x = 0; x < Width; x++) {
+            if(Xstart + x >= Paint.Width) {
                 break;
-                }
             }
+            if(Palette == DITHER_PALETTE_7COLOR)
+                color = (row[x / 2] >> ((x % 2) ? 0 : 4)) & 0x0F;
+            else
+                color = (row[x / 4] >> (6 - (x % 4) * 2)) & 0x03;
+            Paint_SetPixel(Xstart + x, Ystart + y, color);
         }
     }
-    fclose(fp);
-   
-    // Refresh the image to the display buffer based on the displayed orientation
-    for(y = 0; y < bmpInfoHeader.biHeight; y++) {
-        for(x = 0; x < bmpInfoHeader.biWidth; x++) {
-            if(x > Paint.Width || y > Paint.Height) {
-                break;
-            }
-            Paint_SetPixel(Xstart + x, Ystart + y, Image[bmpInfoHeader.biHeight *  bmpInfoHeader.biWidth - 1 -(bmpInfoHeader.biWidth-x-1+(y* bmpInfoHeader.biWidth))]);
-		}
-    }
+    free(Image);
     return 0;
 }
 
+UBYTE GUI_ReadBmp_RGB_7Color(const char *path, UWORD Xstart, UWORD Ystart)
+{
+    return GUI_ReadBmp_RGB_Dither(path, Xstart, Ystart, DITHER_PALETTE_7COLOR, DITHER_NONE);
+}
+
+UBYTE GUI_ReadBmp_RGB_4Color(const char *path, UWORD Xstart, UWORD Ystart)
+{
+    return GUI_ReadBmp_RGB_Dither(path, Xstart, Ystart, DITHER_PALETTE_4COLOR, DITHER_NONE);
+}
+
 
@@ -51,6 +51,7 @@
 #include <stdint.h>
 
 #include "DEV_Config.h"
+#include "GUI_Dither.h"
 
 /*Bitmap file header   14bit*/
 typedef struct BMP_FILE_HEADER {
@@ -90,4 +91,6 @@ UBYTE GUI_ReadBmp_4Gray(const char *path, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_16Gray(const char *path, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_RGB_4Color(const char *path, UWORD Xstart, UWORD Ystart);
 UBYTE GUI_ReadBmp_RGB_7Color(const char *path, UWORD Xstart, UWORD Ystart);
+UBYTE GUI_ReadBmp_RGB_Dither(const char *path, UWORD Xstart, UWORD Ystart,
+                             DITHER_PALETTE Palette, DITHER_MODE Mode);
 #endif
@@ -0,0 +1,400 @@
+/*****************************************************************************
+* | File      	:   GUI_Dither.c
+* | Function    :   Color reduction for 7-color, 4-color and 4-gray e-Paper
+* | Info        :
+*   Every palette has a 32768-entry cube (5 bits per channel) that maps an
+*   RGB value to its nearest palette index, so quantizing a pixel is a
+*   shift, an or and a table load instead of a branch chain.
+*
+*   Error diffusion runs one row at a time. The error pushed down from the
+*   rows above does not depend on the current row, so it is added to the
+*   source in a separate pass that is vectorized with NEON where available;
+*   the serial pass then only carries the error to the right.
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-19
+* | Info        :
+******************************************************************************/
+#include "GUI_Dither.h"
+#include "Debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DITHER_NEON 1
+#endif
+
+#define CUBE_BITS   5
+#define CUBE_SIZE   (1 << (3 * CUBE_BITS))
+#define CUBE_KEY(r, g, b)  ((((r) >> 3) << 10) | (((g) >> 3) << 5) | ((b) >> 3))
+
+#define ERR_PAD     2   // Guard pixels on each side of an error row
+
+typedef struct {
+    UBYTE R, G, B;
+} DITHER_RGB;
+
+static const DITHER_RGB Palette_7Color[] = {
+    {  0,   0,   0},    // Black
+    {255, 255, 255},    // White
+    {  0, 255,   0},    // Green
+    {  0,   0, 255},    // Blue
+    {255,   0,   0},    // Red
+    {255, 255,   0},    // Yellow
+    {255, 128,   0},    // Orange
+};
+
+static const DITHER_RGB Palette_4Color[] = {
+    {  0,   0,   0},    // Black
+    {255, 255, 255},    // White
+    {255, 255,   0},    // Yellow
+    {255,   0,   0},    // Red
+};
+
+static const DITHER_RGB Palette_4Gray[] = {
+    {  0,   0,   0},    // Black
+    { 85,  85,  85},    // Gray2
+    {170, 170, 170},    // Gray1
+    {255, 255, 255},    // White
+};
+
+typedef struct {
+    const DITHER_RGB *Colors;
+    UBYTE Count;
+    UBYTE Bits;         // Bits per packed pixel
+    UBYTE White;        // Index used to pad partial bytes
+    UBYTE Gray;         // Match on luma rather than RGB distance
+    UBYTE Ready;
+    UBYTE Cube[CUBE_SIZE];
+} DITHER_TABLE;
+
+static DITHER_TABLE Tables[] = {
+    [DITHER_PALETTE_7COLOR] = { Palette_7Color, 7, 4, 1, 0, 0, {0} },
+    [DITHER_PALETTE_4COLOR] = { Palette_4Color, 4, 2, 1, 0, 0, {0} },
+    [DITHER_PALETTE_4GRAY]  = { Palette_4Gray,  4, 2, 3, 1, 0, {0} },
+};
+
+#define TABLE_COUNT (sizeof(Tables) / sizeof(Tables[0]))
+
+static inline int Luma(int R, int G, int B)
+{
+    return (R * 77 + G * 150 + B * 29) >> 8;
+}
+
+UBYTE Dither_Init(DITHER_PALETTE Palette)
+{
+    if((unsigned)Palette >= TABLE_COUNT) {
+        Debug("Dither: unknown palette %d\r\n", Palette);
+        return 1;
+    }
+
+    DITHER_TABLE *t = &Tables[Palette];
+    if(t->Ready)
+        return 0;
+
+    for(UDOUBLE key = 0; key < CUBE_SIZE; key++) {
+        // Expand each 5-bit channel back to the middle of its 8-bit range
+        int R = ((key >> 10) & 0x1F) << 3 | 4;
+        int G = ((key >> 5) & 0x1F) << 3 | 4;
+        int B = (key & 0x1F) << 3 | 4;
+
+        UDOUBLE best = 0xFFFFFFFF;
+        UBYTE best_i = 0;
+        for(UBYTE i = 0; i < t->Count; i++) {
+            const DITHER_RGB *c = &t->Colors[i];
+            UDOUBLE d;
+            if(t->Gray) {
+                int dl = Luma(R, G, B) - c->R;
+                d = dl * dl;
+            } else {
+                // Weighted toward green, roughly matching perceived brightness
+                int dr = R - c->R, dg = G - c->G, db = B - c->B;
+                d = 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+            }
+            if(d < best) {
+                best = d;
+                best_i = i;
+            }
+        }
+        t->Cube[key] = best_i;
+    }
+    t->Ready = 1;
+    return 0;
+}
+
+UDOUBLE Dither_WidthByte(DITHER_PALETTE Palette, UWORD Width)
+{
+    if(Palette == DITHER_PALETTE_7COLOR)
+        return (Width + 1) / 2;
+    return (Width + 3) / 4;
+}
+
+/******************************************************************************
+function :	Nearest palette index for a row, no error diffusion
+******************************************************************************/
+static void Dither_Row_Nearest(const DITHER_TABLE *t, const UBYTE *Src, UWORD Width, UBYTE *Index)
+{
+    UWORD x = 0;
+#ifdef DITHER_NEON
+    UWORD Key[16];
+    for(; x + 16 <= Width; x += 16) {
+        uint8x16x3_t bgr = vld3q_u8(Src + x * 3);
+        uint8x16_t b = vshrq_n_u8(bgr.val[0], 3);
+        uint8x16_t g = vshrq_n_u8(bgr.val[1], 3);
+        uint8x16_t r = vshrq_n_u8(bgr.val[2], 3);
+
+        uint16x8_t lo = vorrq_u16(vshlq_n_u16(vmovl_u8(vget_low_u8(r)), 10),
+                        vorrq_u16(vshlq_n_u16(vmovl_u8(vget_low_u8(g)), 5),
+                                  vmovl_u8(vget_low_u8(b))));
+        uint16x8_t hi = vorrq_u16(vshlq_n_u16(vmovl_u8(vget_high_u8(r)), 10),
+                        vorrq_u16(vshlq_n_u16(vmovl_u8(vget_high_u8(g)), 5),
+                                  vmovl_u8(vget_high_u8(b))));
+        vst1q_u16(Key, lo);
+        vst1q_u16(Key + 8, hi);
+        for(int i = 0; i < 16; i++)
+            Index[x + i] = t->Cube[Key[i]];
+    }
+#endif
+    for(; x < Width; x++) {
+        const UBYTE *p = Src + x * 3;
+        Index[x] = t->Cube[CUBE_KEY(p[2], p[1], p[0])];
+    }
+}
+
+/******************************************************************************
+function :	Add the error diffused from the rows above to a source row
+            Work and Err are interleaved R, G, B
+******************************************************************************/
+static void Dither_Row_Base(const UBYTE *Src, UWORD Width, const int16_t *Err, int16_t *Work)
+{
+    UWORD x = 0;
+#ifdef DITHER_NEON
+    for(; x + 8 <= Width; x += 8) {
+        uint8x8x3_t bgr = vld3_u8(Src + x * 3);
+        int16x8x3_t e = vld3q_s16(Err + x * 3);
+        int16x8x3_t w;
+        w.val[0] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(bgr.val[2])), e.val[0]);
+        w.val[1] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(bgr.val[1])), e.val[1]);
+        w.val[2] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(bgr.val[0])), e.val[2]);
+        vst3q_s16(Work + x * 3, w);
+    }
+#endif
+    for(; x < Width; x++) {
+        const UBYTE *p = Src + x * 3;
+        Work[x * 3 + 0] = p[2] + Err[x * 3 + 0];
+        Work[x * 3 + 1] = p[1] + Err[x * 3 + 1];
+        Work[x * 3 + 2] = p[0] + Err[x * 3 + 2];
+    }
+}
+
+static inline int Clamp(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/******************************************************************************
+function :	Serial error diffusion pass over one row
+            Next and Next2 point at pixel 0 of the two rows below (padded)
+******************************************************************************/
+static void Dither_Row_Diffuse(const DITHER_TABLE *t, const int16_t *Work, UWORD Width,
+                               DITHER_MODE Mode, int16_t *Next, int16_t *Next2, UBYTE *Index)
+{
+    int carry[3] = {0, 0, 0};    // Error for x + 1
+    int carry2[3] = {0, 0, 0};   // Error for x + 2 (Atkinson)
+
+    for(UWORD x = 0; x < Width; x++) {
+        int c[3];
+        for(int k = 0; k < 3; k++)
+            c[k] = Clamp(Work[x * 3 + k] + carry[k]);
+
+        UBYTE i = t->Cube[CUBE_KEY(c[0], c[1], c[2])];
+        Index[x] = i;
+
+        const DITHER_RGB *p = &t->Colors[i];
+        int e[3] = { c[0] - p->R, c[1] - p->G, c[2] - p->B };
+        int16_t *n = Next + x * 3;
+
+        if(Mode == DITHER_FLOYD_STEINBERG) {
+            for(int k = 0; k < 3; k++) {
+                carry[k] = e[k] * 7 / 16;
+                n[k - 3] += e[k] * 3 / 16;
+                n[k]     += e[k] * 5 / 16;
+                n[k + 3] += e[k] / 16;
+            }
+        } else {
+            int16_t *n2 = Next2 + x * 3;
+            for(int k = 0; k < 3; k++) {
+                int e8 = e[k] / 8;
+                carry[k] = carry2[k] + e8;
+                carry2[k] = e8;
+                n[k - 3] += e8;
+                n[k]     += e8;
+                n[k + 3] += e8;
+                n2[k]    += e8;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+function :	Packers from a row of palette indices to the panel layout
+******************************************************************************/
+static void Dither_Pack_4bpp(const UBYTE *Index, UWORD Width, UBYTE White, UBYTE *Out)
+{
+    UWORD x;
+    for(x = 0; x + 1 < Width; x += 2)
+        *Out++ = (Index[x] << 4) | Index[x + 1];
+    if(x < Width)
+        *Out = (Index[x] << 4) | White;
+}
+
+static void Dither_Pack_2bpp(const UBYTE *Index, UWORD Width, UBYTE White, UBYTE *Out)
+{
+    UWORD x;
+    for(x = 0; x + 3 < Width; x += 4)
+        *Out++ = (Index[x] << 6) | (Index[x + 1] << 4) | (Index[x + 2] << 2) | Index[x + 3];
+    if(x < Width) {
+        UBYTE v = 0;
+        for(int i = 0; i < 4; i++)
+            v = (v << 2) | (x + i < Width ? Index[x + i] : White);
+        *Out = v;
+    }
+}
+
+static void Dither_Pack_Planes(const UBYTE *Index, UWORD Width, UBYTE *Old, UBYTE *New)
+{
+    for(UWORD x = 0; x < Width; x += 8) {
+        UBYTE o = 0, n = 0;
+        for(int i = 0; i < 8; i++) {
+            UBYTE v = x + i < Width ? Index[x + i] : 3;
+            o = (o << 1) | (v >> 1);
+            n = (n << 1) | (v & 1);
+        }
+        *Old++ = o;
+        *New++ = n;
+    }
+}
+
+/******************************************************************************
+function :	Shared driver: quantize every row and hand it to a packer
+******************************************************************************/
+static UBYTE Dither_Run(const UBYTE *Image, UWORD Width, UWORD Height, UDOUBLE Stride,
+                        UBYTE BottomUp, DITHER_PALETTE Palette, DITHER_MODE Mode,
+                        UBYTE *Out, UBYTE *Old, UBYTE *New)
+{
+    if(Image == NULL || Width == 0 || Mode > DITHER_ATKINSON || Dither_Init(Palette) != 0)
+        return 1;
+
+    const DITHER_TABLE *t = &Tables[Palette];
+    UDOUBLE err_len = (UDOUBLE)(Width + 2 * ERR_PAD) * 3;
+    UBYTE *Index = malloc(Width);
+    int16_t *Err = NULL, *Work = NULL;
+
+    if(Mode != DITHER_NONE) {
+        Err = calloc(err_len * 3, sizeof(int16_t));
+        Work = malloc((UDOUBLE)Width * 3 * sizeof(int16_t));
+    }
+    if(Index == NULL || (Mode != DITHER_NONE && (Err == NULL || Work == NULL))) {
+        Debug("Dither: out of memory\r\n");
+        free(Index);
+        free(Err);
+        free(Work);
+        return 1;
+    }
+
+    // Three error rows (this row, +1, +2) used as a ring
+    int16_t *Rows[3];
+    for(int i = 0; i < 3; i++)
+        Rows[i] = Err ? Err + i * err_len : NULL;
+
+    UDOUBLE out_wb = Dither_WidthByte(Palette, Width);
+    UDOUBLE plane_wb = (Width + 7) / 8;
+
+    for(UWORD y = 0; y < Height; y++) {
+        const UBYTE *Src = Image + (UDOUBLE)(BottomUp ? Height - 1 - y : y) * Stride;
+
+        if(Mode == DITHER_NONE) {
+            Dither_Row_Nearest(t, Src, Width, Index);
+        } else {
+            Dither_Row_Base(Src, Width, Rows[0] + ERR_PAD * 3, Work);
+            Dither_Row_Diffuse(t, Work, Width, Mode,
+                               Rows[1] + ERR_PAD * 3, Rows[2] + ERR_PAD * 3, Index);
+            int16_t *done = Rows[0];
+            Rows[0] = Rows[1];
+            Rows[1] = Rows[2];
+            Rows[2] = done;
+            memset(done, 0, err_len * sizeof(int16_t));
+        }
+
+        if(Old != NULL) {
+            Dither_Pack_Planes(Index, Width, Old + y * plane_wb, New + y * plane_wb);
+        } else if(t->Bits == 4) {
+            Dither_Pack_4bpp(Index, Width, t->White, Out + y * out_wb);
+        } else {
+            Dither_Pack_2bpp(Index, Width, t->White, Out + y * out_wb);
+        }
+    }
+
+    free(Index);
+    free(Err);
+    free(Work);
+    return 0;
+}
+
+UBYTE Dither_Image(const UBYTE *Image, UWORD Width, UWORD Height, UDOUBLE Stride,
+                   UBYTE BottomUp, DITHER_PALETTE Palette, DITHER_MODE Mode, UBYTE *Out)
+{
+    if(Out == NULL)
+        return 1;
+    return Dither_Run(Image, Width, Height, Stride, BottomUp, Palette, Mode, Out, NULL, NULL);
+}
+
+UBYTE Dither_Image_4GrayPlanes(const UBYTE *Image, UWORD Width, UWORD Height, UDOUBLE Stride,
+                               UBYTE BottomUp, DITHER_MODE Mode, UBYTE *Old, UBYTE *New)
+{
+    if(Old == NULL || New == NULL)
+        return 1;
+    return Dither_Run(Image, Width, Height, Stride, BottomUp, DITHER_PALETTE_4GRAY, Mode,
+                      NULL, Old, New);
+}
+
+/******************************************************************************
+function :	Split a 2bpp 4-gray buffer into the EPD_4IN2 planes
+            One input byte (4 pixels) gives a nibble of each plane
+******************************************************************************/
+void Dither_Split_4Gray(const UBYTE *Image, UWORD Width, UWORD Height, UBYTE *Old, UBYTE *New)
+{
+    static UBYTE SplitOld[256], SplitNew[256];
+    static UBYTE SplitReady = 0;
+
+    if(!SplitReady) {
+        for(int b = 0; b < 256; b++) {
+            UBYTE o = 0, n = 0;
+            for(int i = 0; i < 4; i++) {
+                UBYTE v = (b >> (6 - 2 * i)) & 0x03;
+                o = (o << 1) | (v >> 1);
+                n = (n << 1) | (v & 1);
+            }
+            SplitOld[b] = o;
+            SplitNew[b] = n;
+        }
+        SplitReady = 1;
+    }
+
+    UDOUBLE in_wb = (Width + 3) / 4;
+    UDOUBLE out_wb = (Width + 7) / 8;
+
+    for(UWORD y = 0; y < Height; y++) {
+        const UBYTE *in = Image + y * in_wb;
+        UBYTE *o = Old + y * out_wb;
+        UBYTE *n = New + y * out_wb;
+        for(UDOUBLE i = 0; i < out_wb; i++) {
+            UBYTE b0 = in[2 * i];
+            UBYTE b1 = (2 * i + 1 < in_wb) ? in[2 * i + 1] : 0xFF;
+            o[i] = (SplitOld[b0] << 4) | SplitOld[b1];
+            n[i] = (SplitNew[b0] << 4) | SplitNew[b1];
+        }
+    }
+}
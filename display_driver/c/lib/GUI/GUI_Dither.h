@@ -0,0 +1,77 @@
+/*****************************************************************************
+* | File      	:   GUI_Dither.h
+* | Function    :   Color reduction for 7-color, 4-color and 4-gray e-Paper
+* | Info        :
+*   RGB images are reduced to the panel palette through a precomputed
+*   15-bit RGB cube lookup, optionally with row-at-a-time error diffusion,
+*   and written directly in the layout the panel driver expects:
+*     7-color : 4 bits per pixel, high nibble first (Paint scale 7)
+*     4-color : 2 bits per pixel, MSB first (Paint scale 4)
+*     4-gray  : 2 bits per pixel, MSB first, 3 = white ... 0 = black,
+*               or the two 1bpp planes sent to EPD_4IN2 (0x10 / 0x13)
+*----------------
+* |	This version:   V1.0
+* | Date        :   2026-10-19
+* | Info        :
+******************************************************************************/
+#ifndef __GUI_DITHER_H
+#define __GUI_DITHER_H
+
+#include "DEV_Config.h"
+
+/**
+ * Target palettes
+**/
+typedef enum {
+    DITHER_PALETTE_7COLOR = 0,  // EPD_7IN3F / EPD_5IN65F color index order
+    DITHER_PALETTE_4COLOR,      // black, white, yellow, red
+    DITHER_PALETTE_4GRAY,       // black, gray2, gray1, white
+} DITHER_PALETTE;
+
+/**
+ * Error diffusion kernels
+**/
+typedef enum {
+    DITHER_NONE = 0,            // Nearest palette color only
+    DITHER_FLOYD_STEINBERG,
+    DITHER_ATKINSON,            // Diffuses 6/8 of the error, keeps more contrast
+} DITHER_MODE;
+
+/**
+ * Build the RGB cube lookup for a palette. Called implicitly by the
+ * functions below; call it up front to keep the first image off the clock.
+ */
+UBYTE Dither_Init(DITHER_PALETTE Palette);
+
+/**
+ * Bytes per packed output row for a palette
+ */
+UDOUBLE Dither_WidthByte(DITHER_PALETTE Palette, UWORD Width);
+
+/**
+ * Reduce a 24-bit BGR image (BMP byte order) to a palette
+ * Image     : source pixels
+ * Width     : image width
+ * Height    : image height
+ * Stride    : bytes per source row (BMP rows are padded to 4 bytes)
+ * BottomUp  : 1 if the first source row is the bottom of the picture
+ * Out       : packed output, Dither_WidthByte() * Height bytes
+ * return    : 0 on success
+ */
+UBYTE Dither_Image(const UBYTE *Image, UWORD Width, UWORD Height, UDOUBLE Stride,
+                   UBYTE BottomUp, DITHER_PALETTE Palette, DITHER_MODE Mode, UBYTE *Out);
+
+/**
+ * Reduce a 24-bit BGR image to 4 grays straight into the EPD_4IN2 planes
+ * Old       : 1bpp plane for command 0x10, (Width + 7) / 8 * Height bytes
+ * New       : 1bpp plane for command 0x13, same size
+ */
+UBYTE Dither_Image_4GrayPlanes(const UBYTE *Image, UWORD Width, UWORD Height, UDOUBLE Stride,
+                               UBYTE BottomUp, DITHER_MODE Mode, UBYTE *Old, UBYTE *New);
+
+/**
+ * Split a packed 2bpp 4-gray image (Paint scale 4) into the two 1bpp planes
+ */
+void Dither_Split_4Gray(const UBYTE *Image, UWORD Width, UWORD Height, UBYTE *Old, UBYTE *New);
+
+#endif
@@ -85,6 +85,36 @@ static void EPD_2in13_V4_SendData(UBYTE Data)
     // Debug("SPI DATA: 0x%02X\r\n", Data);  // Too verbose, comment out
 }
 
+/******************************************************************************
+function :	send a run of data bytes in one SPI transfer
+parameter:
+    Data : data to send
+    Len  : number of bytes
+******************************************************************************/
+static void EPD_2in13_V4_SendDataBlock(UBYTE *Data, UDOUBLE Len)
+{
+    DEV_Digital_Write(EPD_DC_PIN, 1);
+
+#if defined(RADXA_ZERO_3W) && defined(RADXA_USE_HW_SPI_CS)
+    DEV_SPI_Write_nByte(Data, Len);
+#else
+    DEV_Digital_Write(EPD_CS_PIN, 0);
+    DEV_SPI_Write_nByte(Data, Len);
+    DEV_Digital_Write(EPD_CS_PIN, 1);
+#endif
+}
+
+static EPD_BUSY_HOOK EPD_2in13_V4_BusyHook = NULL;
+
+/******************************************************************************
+function :	Report BUSY wait times to hook (NULL to stop)
+parameter:
+******************************************************************************/
+void EPD_2in13_V4_SetBusyHook(EPD_BUSY_HOOK hook)
+{
+	EPD_2in13_V4_BusyHook = hook;
+}
+
 /******************************************************************************
 function :	Wait until the busy_pin goes LOW (ready)
 parameter:
@@ -102,6 +132,8 @@ void EPD_2in13_V4_ReadBusy(void)
 		if(busy_value == 0) {
 			Debug("e-Paper busy release (waited %d ms, BUSY pin = %d)\r\n", count * 10, busy_value);
 			DEV_Delay_ms(10);
+			if(EPD_2in13_V4_BusyHook)
+				EPD_2in13_V4_BusyHook(count * 10, 0);
 			return;
 		}
 		DEV_Delay_ms(10);
@@ -112,6 +144,8 @@ void EPD_2in13_V4_ReadBusy(void)
 	Debug("WARNING: e-Paper busy timeout! (waited 10s, BUSY pin = %d)\r\n", busy_value);
 	Debug("BUSY=1 means busy, BUSY=0 means ready\r\n");
 	DEV_Delay_ms(10);
+	if(EPD_2in13_V4_BusyHook)
+		EPD_2in13_V4_BusyHook(count * 10, 1);
 }
 
 /******************************************************************************
@@ -255,12 +289,11 @@ void EPD_2in13_V4_Clear(void)
     Width = (EPD_2in13_V4_WIDTH % 8 == 0)? (EPD_2in13_V4_WIDTH / 8 ): (EPD_2in13_V4_WIDTH / 8 + 1);
     Height = EPD_2in13_V4_HEIGHT;
 	
+    UBYTE Blank[Width * Height];
+    memset(Blank, 0XFF, sizeof(Blank));
+
     EPD_2in13_V4_SendCommand(0x24);
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-            EPD_2in13_V4_SendData(0XFF);
-        }
-    }	
+    EPD_2in13_V4_SendDataBlock(Blank, sizeof(Blank));
 
 	EPD_2in13_V4_TurnOnDisplay();
 }
@@ -271,12 +304,11 @@ void EPD_2in13_V4_Clear_Black(void)
     Width = (EPD_2in13_V4_WIDTH % 8 == 0)? (EPD_2in13_V4_WIDTH / 8 ): (EPD_2in13_V4_WIDTH / 8 + 1);
     Height = EPD_2in13_V4_HEIGHT;
 	
+    UBYTE Blank[Width * Height];
+    memset(Blank, 0X00, sizeof(Blank));
+
     EPD_2in13_V4_SendCommand(0x24);
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-            EPD_2in13_V4_SendData(0X00);
-        }
-    }	
+    EPD_2in13_V4_SendDataBlock(Blank, sizeof(Blank));
 
 	EPD_2in13_V4_TurnOnDisplay();
 }
@@ -293,11 +325,7 @@ void EPD_2in13_V4_Display(UBYTE *Image)
     Height = EPD_2in13_V4_HEIGHT;
 	
     EPD_2in13_V4_SendCommand(0x24);
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-            EPD_2in13_V4_SendData(Image[i + j * Width]);
-        }
-    }	
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
 	
 	EPD_2in13_V4_TurnOnDisplay();	
 }
@@ -309,11 +337,7 @@ void EPD_2in13_V4_Display_Fast(UBYTE *Image)
     Height = EPD_2in13_V4_HEIGHT;
 	
     EPD_2in13_V4_SendCommand(0x24);
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-            EPD_2in13_V4_SendData(Image[i + j * Width]);
-        }
-    }	
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
 	
 	EPD_2in13_V4_TurnOnDisplay_Fast();	
 }
@@ -331,20 +355,31 @@ void EPD_2in13_V4_Display_Base(UBYTE *Image)
     Height = EPD_2in13_V4_HEIGHT;
 	
 	EPD_2in13_V4_SendCommand(0x24);   //Write Black and White image to RAM
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {        
-			EPD_2in13_V4_SendData(Image[i + j * Width]);
-		}
-	}
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
 	EPD_2in13_V4_SendCommand(0x26);   //Write Black and White image to RAM
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-			EPD_2in13_V4_SendData(Image[i + j * Width]);
-		}
-	}
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
 	EPD_2in13_V4_TurnOnDisplay();	
 }
 
+/******************************************************************************
+function :	Load a base image into both RAMs without refreshing, for an
+			image the panel still shows (e.g. after a restart); the next
+			EPD_2in13_V4_Display_Partial() then only drives changed pixels
+parameter:
+	Image : Image data
+******************************************************************************/
+void EPD_2in13_V4_Load_Base(UBYTE *Image)
+{
+	UWORD Width, Height;
+    Width = (EPD_2in13_V4_WIDTH % 8 == 0)? (EPD_2in13_V4_WIDTH / 8 ): (EPD_2in13_V4_WIDTH / 8 + 1);
+    Height = EPD_2in13_V4_HEIGHT;
+	
+	EPD_2in13_V4_SendCommand(0x24);   //Write Black and White image to RAM
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
+	EPD_2in13_V4_SendCommand(0x26);   //Write the same image as the old-image RAM
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
+}
+
 /******************************************************************************
 function :	Sends the image buffer in RAM to e-Paper and partial refresh
 parameter:
@@ -376,11 +411,7 @@ void EPD_2in13_V4_Display_Partial(UBYTE *Image)
 	EPD_2in13_V4_SetCursor(0, 0);
 
 	EPD_2in13_V4_SendCommand(0x24);   //Write Black and White image to RAM
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-			EPD_2in13_V4_SendData(Image[i + j * Width]);
-		}
-	}
+    EPD_2in13_V4_SendDataBlock(Image, (UDOUBLE)Width * Height);
 	EPD_2in13_V4_TurnOnDisplay_Partial();
 }
 
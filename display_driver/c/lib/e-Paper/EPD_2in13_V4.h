@@ -38,6 +38,9 @@
 #define EPD_2in13_V4_WIDTH       122
 #define EPD_2in13_V4_HEIGHT      250
 
+// Called after each BUSY wait with its length, e.g. to collect metrics
+typedef void (*EPD_BUSY_HOOK)(UDOUBLE waited_ms, UBYTE timed_out);
+
 void EPD_2in13_V4_Init(void);
 void EPD_2in13_V4_Init_Fast(void);
 void EPD_2in13_V4_Init_GUI(void);
@@ -46,9 +49,11 @@ void EPD_2in13_V4_Clear_Black(void);
 void EPD_2in13_V4_Display(UBYTE *Image);
 void EPD_2in13_V4_Display_Fast(UBYTE *Image);
 void EPD_2in13_V4_Display_Base(UBYTE *Image);
+void EPD_2in13_V4_Load_Base(UBYTE *Image);
 void EPD_2in13_V4_Display_Partial(UBYTE *Image);
 void EPD_2in13_V4_ReadBusy(void);
 void EPD_2in13_V4_Sleep(void);
+void EPD_2in13_V4_SetBusyHook(EPD_BUSY_HOOK hook);
 
 
 #endif
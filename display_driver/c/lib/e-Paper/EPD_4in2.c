@@ -655,98 +655,69 @@ void EPD_4IN2_PartialDisplay(UWORD X_start,UWORD Y_start,UWORD X_end,UWORD Y_end
 
 void EPD_4IN2_4GrayDisplay(const UBYTE *Image)
 {
-    UDOUBLE i,j,k,m;
-    UBYTE temp1,temp2,temp3;
-/****Color display description****
-      white  gray1  gray2  black
-0x10|  01     01     00     00
-0x13|  01     00     01     00
-*********************************/
-	EPD_4IN2_SendCommand(0x10);	       
-	// EPD_4IN2_HEIGHT
-	// EPD_4IN2_WIDTH
-	for(m = 0; m<EPD_4IN2_HEIGHT;m++)
-		for(i=0;i<EPD_4IN2_WIDTH/8;i++)
-		{
-			temp3=0;
-			for(j=0;j<2;j++)	
-			{
-				
-				temp1 = Image[(m*(EPD_4IN2_WIDTH/8)+i)*2+j];
-				for(k=0;k<2;k++)	
-				{
-					temp2 = temp1&0xC0 ;
-					if(temp2 == 0xC0)
-						temp3 |= 0x01;//white
-					else if(temp2 == 0x00)
-						temp3 |= 0x00;  //black
-					else if(temp2 == 0x80) 
-						temp3 |= 0x01;  //gray1
-					else //0x40
-						temp3 |= 0x00; //gray2
-					temp3 <<= 1;	
-					
-					temp1 <<= 2;
-					temp2 = temp1&0xC0 ;
-					if(temp2 == 0xC0)  //white
-						temp3 |= 0x01;
-					else if(temp2 == 0x00) //black
-						temp3 |= 0x00;
-					else if(temp2 == 0x80)
-						temp3 |= 0x01; //gray1
-					else    //0x40
-							temp3 |= 0x00;	//gray2	
-					if(j!=1 || k!=1)				
-						temp3 <<= 1;
-					
-					temp1 <<= 2;
-				}
-				
-			 }
-			EPD_4IN2_SendData(temp3);			
-		}
+    /****Color display description****
+          white  gray1  gray2  black
+    0x10|  01     01     00     00
+    0x13|  01     00     01     00
+    *********************************
+    One 2bpp input byte holds four pixels and yields one nibble of each
+    plane, so both planes are built from a pair of 256-entry tables.
+    */
+    static UBYTE PlaneOld[256], PlaneNew[256];
+    static UBYTE PlaneReady = 0;
+    UDOUBLE i, m;
+
+    if(!PlaneReady) {
+        for(i = 0; i < 256; i++) {
+            UBYTE o = 0, n = 0, k;
+            for(k = 0; k < 4; k++) {
+                UBYTE v = (i >> (6 - 2 * k)) & 0x03;
+                o = (o << 1) | (v >> 1);
+                n = (n << 1) | (v & 0x01);
+            }
+            PlaneOld[i] = o;
+            PlaneNew[i] = n;
+        }
+        PlaneReady = 1;
+    }
+
+	EPD_4IN2_SendCommand(0x10);
+	for(m = 0; m < EPD_4IN2_HEIGHT; m++) {
+		const UBYTE *row = Image + m * (EPD_4IN2_WIDTH / 4);
+		for(i = 0; i < EPD_4IN2_WIDTH / 8; i++)
+			EPD_4IN2_SendData((PlaneOld[row[2 * i]] << 4) | PlaneOld[row[2 * i + 1]]);
+	}
+
     // new  data
-    EPD_4IN2_SendCommand(0x13);	 
-	for(m = 0; m<EPD_4IN2_HEIGHT;m++)
-		for(i=0;i<EPD_4IN2_WIDTH/8;i++)
-		{
-			temp3=0;
-			for(j=0;j<2;j++)	
-			{
-				temp1 = Image[(m*(EPD_4IN2_WIDTH/8)+i)*2+j];
-				for(k=0;k<2;k++)	
-				{
-					temp2 = temp1&0xC0 ;
-					if(temp2 == 0xC0)
-						temp3 |= 0x01;//white
-					else if(temp2 == 0x00)
-						temp3 |= 0x00;  //black
-					else if(temp2 == 0x80) 
-						temp3 |= 0x00;  //gray1
-					else //0x40
-						temp3 |= 0x01; //gray2
-					temp3 <<= 1;	
-					
-					temp1 <<= 2;
-					temp2 = temp1&0xC0 ;
-					if(temp2 == 0xC0)  //white
-						temp3 |= 0x01;
-					else if(temp2 == 0x00) //black
-						temp3 |= 0x00;
-					else if(temp2 == 0x80)
-						temp3 |= 0x00; //gray1
-					else    //0x40
-							temp3 |= 0x01;	//gray2
-					if(j!=1 || k!=1)					
-						temp3 <<= 1;
-					
-					temp1 <<= 2;
-				}
-				
-			 }
-			EPD_4IN2_SendData(temp3);	
-		}
-    
+    EPD_4IN2_SendCommand(0x13);
+	for(m = 0; m < EPD_4IN2_HEIGHT; m++) {
+		const UBYTE *row = Image + m * (EPD_4IN2_WIDTH / 4);
+		for(i = 0; i < EPD_4IN2_WIDTH / 8; i++)
+			EPD_4IN2_SendData((PlaneNew[row[2 * i]] << 4) | PlaneNew[row[2 * i + 1]]);
+	}
+
+    EPD_4IN2_4Gray_lut();
+    EPD_4IN2_TurnOnDisplay();
+}
+
+/******************************************************************************
+function :	Sends 4-gray data that is already split into the two planes
+parameter:
+    Old : 1bpp plane for 0x10 (e.g. from Dither_Image_4GrayPlanes)
+    New : 1bpp plane for 0x13
+******************************************************************************/
+void EPD_4IN2_4GrayDisplay_Planes(const UBYTE *Old, const UBYTE *New)
+{
+    UDOUBLE i, size = (UDOUBLE)EPD_4IN2_WIDTH / 8 * EPD_4IN2_HEIGHT;
+
+	EPD_4IN2_SendCommand(0x10);
+	for(i = 0; i < size; i++)
+		EPD_4IN2_SendData(Old[i]);
+
+	EPD_4IN2_SendCommand(0x13);
+	for(i = 0; i < size; i++)
+		EPD_4IN2_SendData(New[i]);
+
     EPD_4IN2_4Gray_lut();
     EPD_4IN2_TurnOnDisplay();
 }
@@ -117,6 +117,9 @@ class JetsonNano:
                 break
         if self.SPI is None:
             raise RuntimeError('Cannot find sysfs_software_spi.so')
+        # Whole-buffer transfer, only in libraries built with the gpio cdev backend
+        self.spi_transfer_buf = getattr(self.SPI, 'SYSFS_software_spi_transfer_buf', None)
+        self.ctypes = ctypes
 
         import Jetson.GPIO
         self.GPIO = Jetson.GPIO
@@ -134,6 +137,10 @@ class JetsonNano:
         self.SPI.SYSFS_software_spi_transfer(data[0])
 
     def spi_writebyte2(self, data):
+        if self.spi_transfer_buf is not None:
+            buf = bytes(data)
+            self.spi_transfer_buf(self.ctypes.c_char_p(buf), None, len(buf))
+            return
         for i in range(len(data)):
             self.SPI.SYSFS_software_spi_transfer(data[i])
 
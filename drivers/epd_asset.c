@@ -0,0 +1,339 @@
+#include "epd_asset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Runtime side of the precompiled asset pipeline. The container produced by
+// tools/epd_assetc is mapped read-only and assets are handed out as views
+// into the mapping, so loading a splash or icon costs no decoding for raw
+// assets and a single PackBits pass for compressed ones.
+
+#ifndef EPD_ASSET_DEFAULT_PATH
+#define EPD_ASSET_DEFAULT_PATH "/usr/local/share/wallet/wallet_assets.epda"
+#endif
+
+#define STREAM_CHUNK 256
+
+struct epd_asset_pack {
+    int fd;
+    const uint8_t *map;
+    size_t map_size;
+    const epd_asset_entry_t *entries;
+    uint16_t count;
+};
+
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;
+
+uint32_t epd_asset_crc32(const uint8_t *data, size_t len) {
+    if (!crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+            }
+            crc_table[i] = c;
+        }
+        crc_table_ready = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+/**
+ * Check an entry against the container before anything reads through it;
+ * the decoders and the blit trust stride, raw_size and size from here on
+ * @return NULL if the entry is sound, otherwise what is wrong with it
+ */
+static const char *entry_check(const epd_asset_entry_t *e, size_t map_size, const uint8_t *map) {
+    if ((size_t)e->offset + e->size > map_size) {
+        return "out of bounds";
+    }
+    // The format is its bits per pixel
+    if (e->format != EPD_ASSET_FMT_1BPP && e->format != EPD_ASSET_FMT_2BPP_GRAY &&
+        e->format != EPD_ASSET_FMT_4BPP_7COLOR) {
+        return "unknown format";
+    }
+    if (e->stride == 0 || e->stride < ((size_t)e->width * e->format + 7) / 8) {
+        return "stride too small for its width";
+    }
+    if (e->raw_size != (uint32_t)e->stride * e->height) {
+        return "size does not match stride and height";
+    }
+    if (!(e->flags & EPD_ASSET_FLAG_RLE) && e->size < e->raw_size) {
+        return "pixel data truncated";
+    }
+    if (epd_asset_crc32(map + e->offset, e->size) != e->crc32) {
+        return "checksum mismatch";
+    }
+    return NULL;
+}
+
+epd_asset_pack_t *epd_asset_open(const char *path) {
+    if (!path) {
+        path = getenv("WALLET_ASSETS");
+    }
+    if (!path) {
+        path = EPD_ASSET_DEFAULT_PATH;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(epd_asset_file_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    const epd_asset_file_header_t *hdr = (const epd_asset_file_header_t *)map;
+    size_t table_end = (size_t)hdr->table_offset + (size_t)hdr->count * sizeof(epd_asset_entry_t);
+    if (memcmp(hdr->magic, EPD_ASSET_MAGIC, 4) != 0 ||
+        hdr->version != EPD_ASSET_VERSION ||
+        table_end > size) {
+        fprintf(stderr, "epd_asset: %s is not a valid asset container\n", path);
+        munmap((void *)map, size);
+        close(fd);
+        return NULL;
+    }
+
+    const epd_asset_entry_t *entries = (const epd_asset_entry_t *)(map + hdr->table_offset);
+    for (uint16_t i = 0; i < hdr->count; i++) {
+        const char *problem = entry_check(&entries[i], size, map);
+        if (problem) {
+            fprintf(stderr, "epd_asset: entry %u in %s: %s\n", i, path, problem);
+            munmap((void *)map, size);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    epd_asset_pack_t *pack = calloc(1, sizeof(*pack));
+    if (!pack) {
+        munmap((void *)map, size);
+        close(fd);
+        return NULL;
+    }
+
+    // Assets are read front to back when streamed to the panel
+    madvise((void *)map, size, MADV_WILLNEED);
+
+    pack->fd = fd;
+    pack->map = map;
+    pack->map_size = size;
+    pack->entries = entries;
+    pack->count = hdr->count;
+    return pack;
+}
+
+void epd_asset_close(epd_asset_pack_t *pack) {
+    if (!pack) return;
+
+    munmap((void *)pack->map, pack->map_size);
+    close(pack->fd);
+    free(pack);
+}
+
+int epd_asset_find(const epd_asset_pack_t *pack, const char *name, epd_asset_t *asset) {
+    if (!pack || !name || !asset) {
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < pack->count; i++) {
+        const epd_asset_entry_t *e = &pack->entries[i];
+        if (strncmp(e->name, name, EPD_ASSET_NAME_SIZE) != 0) {
+            continue;
+        }
+        asset->name = e->name;
+        asset->width = e->width;
+        asset->height = e->height;
+        asset->format = e->format;
+        asset->stride = e->stride;
+        asset->compressed = (e->flags & EPD_ASSET_FLAG_RLE) != 0;
+        asset->data = pack->map + e->offset;
+        asset->size = e->size;
+        asset->raw_size = e->raw_size;
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * PackBits decoder state, resumable so the stream path can decode in chunks
+ */
+typedef struct {
+    const uint8_t *src;
+    const uint8_t *src_end;
+    int run;          // Bytes left in the current run
+    bool literal;     // Current run is literal (copy) rather than repeat
+    uint8_t value;    // Repeat value
+} rle_state_t;
+
+static size_t rle_decode(rle_state_t *st, uint8_t *dst, size_t dst_len) {
+    size_t out = 0;
+
+    while (out < dst_len) {
+        if (st->run == 0) {
+            if (st->src >= st->src_end) {
+                break;
+            }
+            int8_t n = (int8_t)*st->src++;
+            if (n >= 0) {
+                st->run = n + 1;
+                st->literal = true;
+            } else if (n != -128) {
+                if (st->src >= st->src_end) {
+                    break;
+                }
+                st->run = 1 - n;
+                st->literal = false;
+                st->value = *st->src++;
+            }
+            continue;
+        }
+
+        size_t take = (size_t)st->run;
+        if (take > dst_len - out) {
+            take = dst_len - out;
+        }
+        if (st->literal) {
+            if (take > (size_t)(st->src_end - st->src)) {
+                take = (size_t)(st->src_end - st->src);
+                if (take == 0) {
+                    break;
+                }
+            }
+            memcpy(dst + out, st->src, take);
+            st->src += take;
+        } else {
+            memset(dst + out, st->value, take);
+        }
+        st->run -= (int)take;
+        out += take;
+    }
+    return out;
+}
+
+int epd_asset_decode(const epd_asset_t *asset, uint8_t *dst, size_t dst_size) {
+    if (!asset || !dst || dst_size < asset->raw_size) {
+        return -1;
+    }
+
+    if (!asset->compressed) {
+        memcpy(dst, asset->data, asset->raw_size);
+        return 0;
+    }
+
+    rle_state_t st = { asset->data, asset->data + asset->size, 0, false, 0 };
+    return rle_decode(&st, dst, asset->raw_size) == asset->raw_size ? 0 : -1;
+}
+
+int epd_asset_blit_1bpp(const epd_asset_t *asset, uint8_t *dst, size_t dst_stride,
+                        uint32_t dst_height, uint32_t x, uint32_t y) {
+    if (!asset || !dst || asset->format != EPD_ASSET_FMT_1BPP) {
+        return -1;
+    }
+    if (y >= dst_height || x / 8 >= dst_stride) {
+        return -1;
+    }
+
+    uint32_t rows = asset->height;
+    if (rows > dst_height - y) {
+        rows = dst_height - y;
+    }
+
+    rle_state_t st = { asset->data, asset->data + asset->size, 0, false, 0 };
+    uint8_t row_buf[asset->stride];
+    size_t dst_byte = x / 8;
+    unsigned shift = x % 8;
+
+    for (uint32_t r = 0; r < rows; r++) {
+        const uint8_t *row;
+        if (asset->compressed) {
+            if (rle_decode(&st, row_buf, asset->stride) != asset->stride) {
+                return -1;
+            }
+            row = row_buf;
+        } else {
+            row = asset->data + (size_t)r * asset->stride;
+        }
+
+        uint8_t *out = dst + (size_t)(y + r) * dst_stride + dst_byte;
+        size_t avail = dst_stride - dst_byte;
+
+        if (shift == 0) {
+            // Byte-aligned: straight row copy; the last byte is merged so
+            // pixels past the asset width keep their current value
+            size_t full = asset->width / 8;
+            unsigned tail = asset->width % 8;
+            if (full > avail) {
+                full = avail;
+                tail = 0;
+            }
+            memcpy(out, row, full);
+            if (tail && full < avail) {
+                uint8_t mask = (uint8_t)(0xFF << (8 - tail));
+                out[full] = (out[full] & ~mask) | (row[full] & mask);
+            }
+            continue;
+        }
+
+        for (uint32_t px = 0; px < asset->width; px++) {
+            uint32_t dx = px + shift;
+            if (dx / 8 >= avail) {
+                break;
+            }
+            uint8_t bit = 0x80 >> (dx % 8);
+            if (row[px / 8] & (0x80 >> (px % 8))) {
+                out[dx / 8] |= bit;
+            } else {
+                out[dx / 8] &= ~bit;
+            }
+        }
+    }
+    return 0;
+}
+
+int epd_asset_stream(const epd_asset_t *asset, epd_asset_sink_t sink, void *ctx) {
+    if (!asset || !sink) {
+        return -1;
+    }
+
+    if (!asset->compressed) {
+        return sink(asset->data, asset->raw_size, ctx) < 0 ? -1 : 0;
+    }
+
+    rle_state_t st = { asset->data, asset->data + asset->size, 0, false, 0 };
+    uint8_t chunk[STREAM_CHUNK];
+    size_t remaining = asset->raw_size;
+
+    while (remaining > 0) {
+        size_t want = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+        size_t got = rle_decode(&st, chunk, want);
+        if (got == 0) {
+            return -1;
+        }
+        if (sink(chunk, got, ctx) < 0) {
+            return -1;
+        }
+        remaining -= got;
+    }
+    return 0;
+}
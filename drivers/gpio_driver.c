@@ -1,3 +1,5 @@
+#include "gpio_driver.h"
+#include "wallet_metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -12,8 +14,20 @@
 #define GPIO_UNEXPORT "/sys/class/gpio/unexport"
 #define GPIO_DIR_FMT "/sys/class/gpio/gpio%d/direction"
 #define GPIO_VALUE_FMT "/sys/class/gpio/gpio%d/value"
+#define GPIO_EDGE_FMT "/sys/class/gpio/gpio%d/edge"
+#define GPIO_DIR_PATH_FMT "/sys/class/gpio/gpio%d"
+
+METRICS_COUNTER(m_reads, "wallet_gpio_reads_total", "Button GPIO value reads");
+METRICS_COUNTER(m_read_errors, "wallet_gpio_read_errors_total", "Button GPIO value reads that failed");
 
 static int gpio_export(int gpio) {
+    // Already exported (e.g. by a previous run): skip the settle delay
+    char path[64];
+    snprintf(path, sizeof(path), GPIO_DIR_PATH_FMT, gpio);
+    if (access(path, F_OK) == 0) {
+        return 0;
+    }
+    
     int fd = open(GPIO_EXPORT, O_WRONLY);
     if (fd < 0) {
         return -1;
@@ -60,8 +74,10 @@ int gpio_read(int gpio) {
     char path[64];
     snprintf(path, sizeof(path), GPIO_VALUE_FMT, gpio);
     
+    metrics_inc(&m_reads);
     int fd = open(path, O_RDONLY);
     if (fd < 0) {
+        metrics_inc(&m_read_errors);
         return -1;
     }
     
@@ -72,6 +88,51 @@ int gpio_read(int gpio) {
     return (value[0] == '1') ? 1 : 0;
 }
 
+static int gpio_set_edge(int gpio, const char *edge) {
+    char path[64];
+    snprintf(path, sizeof(path), GPIO_EDGE_FMT, gpio);
+    
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    ssize_t n = write(fd, edge, strlen(edge));
+    close(fd);
+    return n == (ssize_t)strlen(edge) ? 0 : -1;
+}
+
+int gpio_open_value(int gpio, const char *edge) {
+    if (edge && gpio_set_edge(gpio, edge) < 0) {
+        return -1;
+    }
+    
+    char path[64];
+    snprintf(path, sizeof(path), GPIO_VALUE_FMT, gpio);
+    
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // Consume the initial state so the first poll() waits for an edge
+    if (gpio_read_fd(fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int gpio_read_fd(int fd) {
+    char value[3];
+    metrics_inc(&m_reads);
+    if (pread(fd, value, sizeof(value), 0) < 1) {
+        metrics_inc(&m_read_errors);
+        return -1;
+    }
+    return (value[0] == '1') ? 1 : 0;
+}
+
 int gpio_init_button(int gpio) {
     if (gpio_export(gpio) < 0) {
         return -1;
@@ -0,0 +1,137 @@
+#ifndef AUTH_SERVICE_H
+#define AUTH_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tropic_auth.h"
+#include "device_binding.h"
+
+/**
+ * Asynchronous front end to tropic_auth / device_binding
+ *
+ * One service thread owns all Tropic01 traffic and works through a
+ * priority queue, so neither the LVGL loop nor network handlers block on
+ * the secure element. Completions are collected on the service side and
+ * handed back on the caller's thread by auth_service_dispatch(); the
+ * eventfd from auth_service_fd() becomes readable when there are any.
+ *
+ * Buffers passed to a request belong to the service until its callback
+ * has run (or auth_service_cancel() succeeded).
+ */
+
+// Requests that can be queued at once
+#define AUTH_SERVICE_QUEUE_SIZE 32
+
+/**
+ * Request priority, lower values are served first; FIFO within a level
+ */
+typedef enum {
+    AUTH_PRIORITY_CONFIRM = 0,  // The user is waiting on a confirmation screen
+    AUTH_PRIORITY_NETWORK,      // Base station and RPC requests
+    AUTH_PRIORITY_BACKGROUND,   // Token refreshes and other housekeeping
+    AUTH_PRIORITY_COUNT
+} auth_priority_t;
+
+typedef enum {
+    AUTH_OP_SIGN,
+    AUTH_OP_SIGN_BATCH,
+    AUTH_OP_VERIFY,
+    AUTH_OP_DERIVE_KEY,
+    AUTH_OP_SERVICE_TOKEN,
+    AUTH_OP_VERIFY_IDENTITY,
+} auth_op_t;
+
+/**
+ * Result of a finished request
+ */
+typedef struct {
+    uint32_t id;            // As returned when the request was queued
+    auth_op_t op;
+    auth_priority_t priority;
+    int status;             // Return value of the underlying call; for
+                            // AUTH_OP_VERIFY 1 if valid, 0 if not
+    uint32_t wait_us;       // Time spent queued
+    uint32_t run_us;        // Time spent on the secure element
+    void *user_data;
+} auth_completion_t;
+
+/**
+ * Completion callback, runs inside auth_service_dispatch()
+ */
+typedef void (*auth_callback_t)(const auth_completion_t *done);
+
+/**
+ * Start the service thread
+ * Call after tropic_auth_init() and device_binding_init().
+ * @return 0 on success, negative on error
+ */
+int auth_service_start(void);
+
+/**
+ * Stop the service thread
+ * The request in progress finishes; queued and undispatched requests are
+ * dropped without their callbacks.
+ */
+void auth_service_stop(void);
+
+/**
+ * Get the completion eventfd for poll()/select()
+ * @return file descriptor, negative if the service is not running
+ */
+int auth_service_fd(void);
+
+/**
+ * Run the callbacks of finished requests on the calling thread
+ * Never blocks; call it from the LVGL loop.
+ * @return number of callbacks run
+ */
+int auth_service_dispatch(void);
+
+/**
+ * Queue requests, mirroring the synchronous calls they run
+ * Signatures queued back to back at one priority are coalesced into one
+ * tropic_auth_sign_batch().
+ * @param priority Request priority
+ * @param done Completion callback (may be NULL)
+ * @param user_data Passed back in the completion
+ * @return request id (> 0), negative if the queue is full or the
+ *         service is not running
+ */
+int auth_service_sign(auth_priority_t priority, const uint8_t *data, size_t data_size,
+                      uint8_t *signature, size_t signature_size,
+                      auth_callback_t done, void *user_data);
+
+int auth_service_sign_batch(auth_priority_t priority, tropic_sign_item_t *items, size_t count,
+                            auth_callback_t done, void *user_data);
+
+int auth_service_verify(auth_priority_t priority, const uint8_t *data, size_t data_size,
+                        const uint8_t *signature, size_t signature_size,
+                        auth_callback_t done, void *user_data);
+
+int auth_service_derive_key(auth_priority_t priority, const char *service_name,
+                            uint8_t *key, size_t key_size,
+                            auth_callback_t done, void *user_data);
+
+int auth_service_get_service_token(auth_priority_t priority, device_binding_t *binding,
+                                   const char *service_name, uint8_t *token, size_t token_size,
+                                   auth_callback_t done, void *user_data);
+
+/**
+ * Check the cached device identity against the chip, see
+ * device_binding_verify_identity(); queue it once the UI is up
+ * It goes ahead of the requests already queued at its priority. A
+ * service token requested before it has run checks the identity first.
+ */
+int auth_service_verify_identity(auth_priority_t priority, device_binding_t *binding,
+                                 auth_callback_t done, void *user_data);
+
+/**
+ * Withdraw a request that has not started yet
+ * @param id Request id
+ * @return 0 if it was withdrawn (its callback will not run), negative if
+ *         it is already running or finished
+ */
+int auth_service_cancel(uint32_t id);
+
+#endif // AUTH_SERVICE_H
@@ -0,0 +1,82 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define BOOT_MAX_STAGES 32
+
+// Dependency mask bit for the stage at index i
+#define BOOT_AFTER(i) (1u << (i))
+
+/**
+ * One step of the boot sequence
+ *
+ * A stage starts as soon as every stage in its `after` mask has finished.
+ * Stages may only depend on stages with a lower index, so the table is
+ * also a valid teardown order read backwards.
+ */
+typedef struct {
+    const char *name;
+    int (*run)(void *ctx);          // Returns 0 on success, negative on error
+    void (*undo)(void *ctx);        // Teardown for boot_shutdown(), may be NULL
+    uint32_t after;                 // BOOT_AFTER() mask of prerequisites
+    bool main_thread;               // Must run on the calling thread (LVGL calls)
+} boot_stage_t;
+
+typedef enum {
+    BOOT_STAGE_PENDING,
+    BOOT_STAGE_RUNNING,
+    BOOT_STAGE_DONE,
+    BOOT_STAGE_FAILED,
+    BOOT_STAGE_SKIPPED,             // A prerequisite failed
+} boot_stage_status_t;
+
+/**
+ * Per-stage timing, relative to the start of boot_run()
+ */
+typedef struct {
+    boot_stage_status_t status;
+    uint64_t start_us;
+    uint64_t end_us;
+} boot_stage_result_t;
+
+typedef struct {
+    size_t count;
+    uint64_t total_us;
+    boot_stage_result_t stages[BOOT_MAX_STAGES];
+} boot_report_t;
+
+/**
+ * Run a boot sequence
+ * Background stages each get a thread; main-thread stages run inline in
+ * table order whenever they become ready. Returns once every stage has
+ * finished, failed or been skipped.
+ * @param stages Stage table
+ * @param count Number of stages (at most BOOT_MAX_STAGES)
+ * @param ctx Passed to every run/undo callback
+ * @param report Output timings and status
+ * @return 0 if every stage succeeded, negative otherwise
+ */
+int boot_run(const boot_stage_t *stages, size_t count, void *ctx, boot_report_t *report);
+
+/**
+ * Undo every stage that completed, in reverse table order
+ */
+void boot_shutdown(const boot_stage_t *stages, const boot_report_t *report, void *ctx);
+
+/**
+ * Print the per-stage timing table and the critical path to the last
+ * stage that finished
+ */
+void boot_report_print(const boot_stage_t *stages, const boot_report_t *report, FILE *out);
+
+/**
+ * Print the report to stdout and write it to WALLET_BOOT_REPORT
+ * (default /run/wallet-boot.txt)
+ */
+void boot_report_write(const boot_stage_t *stages, const boot_report_t *report);
+
+#endif // BOOT_H
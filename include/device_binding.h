@@ -4,31 +4,78 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "tropic_auth.h"
 
 #define DEVICE_ID_SIZE 32
 #define BINDING_KEY_SIZE 32
 #define CHALLENGE_SIZE 32
 #define SIGNATURE_SIZE 64
+#define SERVICE_TOKEN_SIZE 32
+#define DEVICE_CERT_SIZE 256
+
+// Service tokens cached per binding; names longer than the limit are
+// still served, just recomputed on every call
+#define SERVICE_TOKEN_CACHE_SLOTS 16
+#define SERVICE_NAME_MAX 32
+
+// Returned by calls that vouch for the device identity while it is still
+// the unchecked cached one; see device_binding_verify_identity()
+#define DEVICE_BINDING_UNVERIFIED (-2)
+
+typedef struct service_token_cache service_token_cache_t;
 
 /**
  * Device binding context
  */
 typedef struct {
     uint8_t device_id[DEVICE_ID_SIZE];
-    uint8_t binding_key[BINDING_KEY_SIZE];
+    uint8_t cert[DEVICE_CERT_SIZE];      // Tropic01 device certificate
+    bool identity_verified;              // false while taken from an unchecked cache
+    uint8_t *binding_key;                // BINDING_KEY_SIZE bytes in the key material arena
     bool is_bound;
+    service_token_cache_t *token_cache;  // Created by device_binding_init()
+    uint32_t token_ttl_ms;               // 0 = cached tokens never expire
 } device_binding_t;
 
 /**
  * Initialize device binding using Tropic01
+ *
+ * The device ID and certificate come from the identity cache when there
+ * is one, so this does not touch the chip; check them with
+ * device_binding_verify_identity() once the UI is up. Until then,
+ * binding, signing and service tokens return DEVICE_BINDING_UNVERIFIED.
+ * Without a cache they are read from the Tropic01 and the cache is
+ * written. The binding key and the service token cache are held in the
+ * key material arena (secure_arena.h) until device_binding_deinit().
+ *
  * @param binding Binding context to initialize
  * @return 0 on success, negative on error
  */
 int device_binding_init(device_binding_t *binding);
 
 /**
- * Generate device identity from Tropic01
+ * Check a cached identity against the Tropic01
+ *
+ * Verifies the cache file's MAC, keyed by the chip, and compares the
+ * certificate with the one the chip reports. On a mismatch the binding
+ * takes the chip's identity, drops its tokens and its base-station
+ * binding, and the cache is rewritten.
+ *
+ * @param binding Binding context
+ * @return 0 if the identity was confirmed, 1 if it was replaced,
+ *         negative if the chip could not be read
+ */
+int device_binding_verify_identity(device_binding_t *binding);
+
+/**
+ * Release the token cache and wipe key material held by the binding
  * @param binding Binding context
+ */
+void device_binding_deinit(device_binding_t *binding);
+
+/**
+ * Generate device identity from Tropic01
+ * @param binding Binding context, receives the certificate
  * @param device_id Output buffer for device ID
  * @param device_id_size Size of device_id buffer
  * @return 0 on success, negative on error
@@ -40,7 +87,8 @@ int device_binding_generate_id(device_binding_t *binding, uint8_t *device_id, si
  * @param binding Binding context
  * @param base_station_id Base station identifier
  * @param binding_key Output binding key
- * @return 0 on success, negative on error
+ * @return 0 on success, DEVICE_BINDING_UNVERIFIED before the identity
+ *         is verified, other negative values on error
  */
 int device_binding_create(device_binding_t *binding, const char *base_station_id, uint8_t *binding_key);
 
@@ -65,21 +113,54 @@ bool device_binding_verify(device_binding_t *binding, const char *base_station_i
  * @param challenge_size Size of challenge
  * @param signature Output signature buffer
  * @param signature_size Size of signature buffer
- * @return 0 on success, negative on error
+ * @return 0 on success, DEVICE_BINDING_UNVERIFIED before the identity
+ *         is verified, other negative values on error
  */
 int device_binding_sign(device_binding_t *binding, const uint8_t *challenge, size_t challenge_size,
                        uint8_t *signature, size_t signature_size);
 
+/**
+ * Sign several challenges at once, e.g. when a base station issues more
+ * than one, in about one Tropic01 round trip
+ * @param binding Binding context
+ * @param items Challenges; each signature buffer must hold SIGNATURE_SIZE
+ * @param count Number of challenges
+ * @return number of challenges signed, DEVICE_BINDING_UNVERIFIED before
+ *         the identity is verified, other negative values on error
+ */
+int device_binding_sign_batch(device_binding_t *binding, tropic_sign_item_t *items, size_t count);
+
 /**
  * Get unified authentication token for all services
+ *
+ * The first request for a service derives its key and keeps it in the
+ * key material arena; later requests are served from the cache, and
+ * recomputed from the kept key once they expire.
+ *
  * @param binding Binding context
  * @param service_name Service name (e.g., "monerod", "tor", "rpc")
  * @param token Output token buffer
- * @param token_size Size of token buffer
- * @return 0 on success, negative on error
+ * @param token_size Size of token buffer, at least SERVICE_TOKEN_SIZE
+ * @return 0 on success, DEVICE_BINDING_UNVERIFIED before the identity
+ *         is verified, other negative values on error
  */
 int device_binding_get_service_token(device_binding_t *binding, const char *service_name,
                                     uint8_t *token, size_t token_size);
 
+/**
+ * Set how long cached service tokens stay valid
+ * @param binding Binding context
+ * @param ttl_ms Lifetime in milliseconds, 0 to keep tokens until invalidated
+ */
+void device_binding_set_token_ttl(device_binding_t *binding, uint32_t ttl_ms);
+
+/**
+ * Drop cached service tokens and their derived keys
+ * Called implicitly by device_binding_create() when rebinding.
+ * @param binding Binding context
+ * @param service_name Service to drop, or NULL for all services
+ */
+void device_binding_invalidate_tokens(device_binding_t *binding, const char *service_name);
+
 #endif // DEVICE_BINDING_H
 
@@ -1,14 +1,41 @@
 #ifndef DISPLAY_FBDEV_H
 #define DISPLAY_FBDEV_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <lvgl.h>
 
 /**
  * Initialize LVGL with FBDEV backend
+ * Panel, splash, LVGL driver and a first refresh, one after another
  * @return 0 on success, negative on error
  */
 int display_fbdev_init(void);
 
+/**
+ * Bring up the e-paper panel (GPIO, SPI, controller init)
+ * Makes no LVGL calls, so it can run on a boot thread alongside
+ * lv_init() and UI construction.
+ * @param splash Show the splash asset (or clear the panel) while booting;
+ *               skip it when the first UI frame follows right away
+ * @return 0 on success, negative on error
+ */
+int display_fbdev_panel_init(bool splash);
+
+/**
+ * Register the LVGL display driver; touches no hardware
+ * Needs lv_init(). Nothing is flushed until display_fbdev_refresh() or
+ * the LVGL timer runs, which must wait for display_fbdev_panel_init().
+ * @return 0 on success, negative on error
+ */
+int display_fbdev_lvgl_init(void);
+
+/**
+ * Render and flush the current screen immediately
+ */
+void display_fbdev_refresh(void);
+
 /**
  * Deinitialize display
  */
@@ -22,6 +49,31 @@ void display_fbdev_deinit(void);
  */
 void display_fbdev_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
 
+/**
+ * Mark the frames drawn from now on as sensitive (addresses, transaction
+ * details): they are never written to the retained-frame cache, so a
+ * restart after one starts from a cleared panel
+ * @param sensitive true for a sensitive screen
+ */
+void display_fbdev_set_sensitive(bool sensitive);
+
+/**
+ * Keep a packed 1bpp image on top of LVGL's output
+ * It is copied into the panel frame on every flush as it is, never
+ * converted from RGB565. LVGL does not know about it: keep an object over
+ * the same rectangle and invalidate it when the image changes, so a flush
+ * follows.
+ * @param bits Rows of pixels, MSB first, 1 = white; NULL removes the image
+ *             (it must stay valid until then)
+ * @param stride Bytes per row of bits
+ * @param x Left edge, a multiple of 8
+ * @param y Top edge
+ * @param width Width in pixels, a multiple of 8
+ * @param height Height in pixels
+ */
+void display_fbdev_set_overlay(const uint8_t *bits, size_t stride, int x, int y,
+                               int width, int height);
+
 /**
  * Get display width
  * @return Display width in pixels
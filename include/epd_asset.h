@@ -0,0 +1,140 @@
+#ifndef EPD_ASSET_H
+#define EPD_ASSET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Precompiled e-paper asset container ("EPDA")
+ *
+ * Assets are converted at build time by tools/epd_assetc into the panel's
+ * native pixel format, optionally PackBits run-length compressed, and stored
+ * in a single file that is mmap'd at runtime. All integers are little-endian.
+ *
+ * Layout: file header, entry table, then 4-byte aligned pixel data.
+ */
+
+#define EPD_ASSET_MAGIC       "EPDA"
+#define EPD_ASSET_VERSION     1
+#define EPD_ASSET_NAME_SIZE   24
+
+/**
+ * Native pixel formats (match the Waveshare Paint/EPD buffer layouts)
+ */
+typedef enum {
+    EPD_ASSET_FMT_1BPP       = 1,  // MSB first, 1 = white, 0 = black
+    EPD_ASSET_FMT_2BPP_GRAY  = 2,  // MSB first, 3 = white ... 0 = black
+    EPD_ASSET_FMT_4BPP_7COLOR = 4, // high nibble first, EPD_7IN3F/EPD_5IN65F color index
+} epd_asset_format_t;
+
+#define EPD_ASSET_FLAG_RLE    0x01
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t table_offset;
+    uint32_t reserved;
+} __attribute__((packed)) epd_asset_file_header_t;
+
+typedef struct {
+    char name[EPD_ASSET_NAME_SIZE];
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t flags;
+    uint16_t stride;     // Bytes per unpacked row
+    uint32_t offset;     // From start of file
+    uint32_t size;       // Stored (possibly compressed) size
+    uint32_t raw_size;   // stride * height
+    uint32_t crc32;      // CRC-32 of the stored bytes, checked on open
+} __attribute__((packed)) epd_asset_entry_t;
+
+/**
+ * Asset view into a mapped container (no copies are made)
+ */
+typedef struct {
+    const char *name;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint16_t stride;
+    bool compressed;
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t raw_size;
+} epd_asset_t;
+
+typedef struct epd_asset_pack epd_asset_pack_t;
+
+/**
+ * Sink for streamed asset data
+ * @param data Decoded pixel bytes in panel order
+ * @param len Number of bytes
+ * @param ctx User context
+ * @return 0 to continue, negative to abort the stream
+ */
+typedef int (*epd_asset_sink_t)(const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * Open and mmap an asset container
+ * Every entry is checked against the file: its data in bounds, a stride
+ * that holds its width, raw_size equal to stride * height, and its CRC.
+ * @param path Container path (NULL uses $WALLET_ASSETS or the install default)
+ * @return Pack handle, or NULL on error or if any entry is damaged
+ */
+epd_asset_pack_t *epd_asset_open(const char *path);
+
+/**
+ * Unmap and release an asset container
+ * @param pack Pack handle
+ */
+void epd_asset_close(epd_asset_pack_t *pack);
+
+/**
+ * Look up an asset by name
+ * @param pack Pack handle
+ * @param name Asset name
+ * @param asset Output asset view
+ * @return 0 on success, negative if not found
+ */
+int epd_asset_find(const epd_asset_pack_t *pack, const char *name, epd_asset_t *asset);
+
+/**
+ * Decode an asset into a caller-provided buffer of raw_size bytes
+ * @param asset Asset view
+ * @param dst Destination buffer
+ * @param dst_size Size of dst
+ * @return 0 on success, negative on error
+ */
+int epd_asset_decode(const epd_asset_t *asset, uint8_t *dst, size_t dst_size);
+
+/**
+ * Blit a 1bpp asset into a packed 1bpp panel buffer
+ * @param asset Asset view (must be EPD_ASSET_FMT_1BPP)
+ * @param dst Panel buffer
+ * @param dst_stride Bytes per panel row
+ * @param dst_height Panel rows
+ * @param x Destination column (multiples of 8 take the memcpy fast path)
+ * @param y Destination row
+ * @return 0 on success, negative on error
+ */
+int epd_asset_blit_1bpp(const epd_asset_t *asset, uint8_t *dst, size_t dst_stride,
+                        uint32_t dst_height, uint32_t x, uint32_t y);
+
+/**
+ * Stream an asset's decoded bytes to a sink without a full-frame buffer
+ * @param asset Asset view
+ * @param sink Sink callback (e.g. an SPI data writer)
+ * @param ctx Sink context
+ * @return 0 on success, negative on error
+ */
+int epd_asset_stream(const epd_asset_t *asset, epd_asset_sink_t sink, void *ctx);
+
+/**
+ * CRC-32 (IEEE 802.3) used for asset integrity checks
+ */
+uint32_t epd_asset_crc32(const uint8_t *data, size_t len);
+
+#endif // EPD_ASSET_H
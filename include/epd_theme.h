@@ -0,0 +1,35 @@
+#ifndef EPD_THEME_H
+#define EPD_THEME_H
+
+#include <lvgl.h>
+
+/**
+ * LVGL theme for the 1bpp e-paper panel
+ *
+ * Every pixel the panel shows is thresholded to black or white, so the
+ * default theme's rounded corners, shadows, translucent fills, grow
+ * animations and focus outlines cost render time and come out as noise.
+ * This theme draws with black and white at full opacity only: square
+ * corners, 1 px borders, horizontal paddings in whole bytes of the panel
+ * frame, and the focused or pressed widget drawn inverted.
+ *
+ * Styles are set for screens, buttons and plain objects, the only
+ * widgets the wallet creates; anything else is left unstyled. Pair it
+ * with LV_DRAW_COMPLEX 0 (lv_conf.h): nothing here needs the complex
+ * draw paths.
+ */
+
+// Horizontal padding, a whole byte of the panel frame
+#define EPD_THEME_PAD_HOR 8
+#define EPD_THEME_PAD_VER 4
+
+/**
+ * Initialize the theme; apply it with lv_disp_set_theme() before
+ * creating widgets. Calling it again re-initializes the same theme.
+ * @param disp Display the theme is for
+ * @param font Font of text that does not set its own
+ * @return the theme
+ */
+lv_theme_t *epd_theme_init(lv_disp_t *disp, const lv_font_t *font);
+
+#endif // EPD_THEME_H
@@ -17,6 +17,20 @@
 #define RADXA_EPD_BUSY_PIN    24   // GPIO 24 (HAT standard, physical pin 18)
 #define RADXA_EPD_PWR_PIN     18   // GPIO 18 (optional, physical pin 12)
 
+// Wallet buttons, wired to GND with pull-ups (pressed = low)
+#ifndef WALLET_BTN_UP_PIN
+#define WALLET_BTN_UP_PIN     5    // GPIO 5 (physical pin 29)
+#endif
+#ifndef WALLET_BTN_DOWN_PIN
+#define WALLET_BTN_DOWN_PIN   6    // GPIO 6 (physical pin 31)
+#endif
+#ifndef WALLET_BTN_OK_PIN
+#define WALLET_BTN_OK_PIN     13   // GPIO 13 (physical pin 33)
+#endif
+#ifndef WALLET_BTN_ACTIVE_LOW
+#define WALLET_BTN_ACTIVE_LOW 1
+#endif
+
 #endif // GPIO_CONFIG_H
 
 
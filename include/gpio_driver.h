@@ -0,0 +1,44 @@
+#ifndef GPIO_DRIVER_H
+#define GPIO_DRIVER_H
+
+/**
+ * Sysfs GPIO access for the wallet buttons
+ */
+
+/**
+ * Export a GPIO and make it an input
+ * @param gpio GPIO number
+ * @return 0 on success, negative on error
+ */
+int gpio_init_button(int gpio);
+
+/**
+ * Unexport a GPIO
+ * @param gpio GPIO number
+ */
+void gpio_deinit_button(int gpio);
+
+/**
+ * Read a GPIO once, opening and closing its value file
+ * @param gpio GPIO number
+ * @return 0 or 1, negative on error
+ */
+int gpio_read(int gpio);
+
+/**
+ * Open a GPIO's value file and keep it open
+ * With an edge the fd reports POLLPRI on every matching transition; the
+ * pending state is cleared by gpio_read_fd().
+ * @param gpio GPIO number (already set up with gpio_init_button())
+ * @param edge "rising", "falling", "both", or NULL to leave it unchanged
+ * @return file descriptor, negative on error
+ */
+int gpio_open_value(int gpio, const char *edge);
+
+/**
+ * Read the level through an fd from gpio_open_value()
+ * @return 0 or 1, negative on error
+ */
+int gpio_read_fd(int fd);
+
+#endif // GPIO_DRIVER_H
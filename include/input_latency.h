@@ -0,0 +1,60 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <stdint.h>
+
+/**
+ * Input-to-photon latency
+ *
+ * Follows one button press from its GPIO edge to the end of the panel
+ * refresh it caused, stamping each stage on the way:
+ *
+ *   EDGE        the keypad thread saw the (debounced) edge
+ *   EVENT       LVGL read the key from the keypad queue
+ *   INVALIDATE  handling the key left something to redraw
+ *   FLUSH       LVGL finished rendering and handed the frame over
+ *   UPLOAD      the frame was sent to the panel (start of the BUSY wait)
+ *   PHOTON      the panel released BUSY: the change is visible
+ *
+ * Every completed interaction goes into per-stage and total histograms
+ * (see wallet_metrics.h), and is logged at debug level for the `latency`
+ * module. Presses that arrive while one is still being followed are
+ * folded into it: the user has been waiting since the first.
+ *
+ * All calls except the EDGE timestamp itself, which travels with the key
+ * event, are made on the LVGL thread, so none of this is locked.
+ */
+
+typedef enum {
+    LATENCY_EDGE,
+    LATENCY_EVENT,
+    LATENCY_INVALIDATE,
+    LATENCY_FLUSH,
+    LATENCY_UPLOAD,
+    LATENCY_PHOTON,
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+/**
+ * Start following a key press, unless one is already being followed
+ * @param key LVGL key code, for the log
+ * @param edge_us CLOCK_MONOTONIC time of the edge, in microseconds
+ */
+void latency_input(uint32_t key, uint64_t edge_us);
+
+/**
+ * Stamp a stage of the interaction being followed, if any
+ * EVENT, INVALIDATE and FLUSH keep their first stamp; UPLOAD and PHOTON
+ * their last, so an interaction lasts until the last refresh it caused.
+ * @param stage Stage reached
+ * @param t_us CLOCK_MONOTONIC time in microseconds
+ */
+void latency_mark(latency_stage_t stage, uint64_t t_us);
+
+/**
+ * Record the interaction being followed, or drop it if it never reached
+ * the glass (the key changed nothing on screen)
+ */
+void latency_end(void);
+
+#endif // INPUT_LATENCY_H
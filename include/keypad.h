@@ -0,0 +1,85 @@
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <stdbool.h>
+#include <lvgl.h>
+
+/**
+ * LVGL keypad driver for the three wallet buttons
+ *
+ * An event thread sleeps on the buttons' GPIO edges, debounces them by
+ * timestamp and turns them into LVGL keys:
+ *   UP   -> LV_KEY_PREV, repeating while held
+ *   DOWN -> LV_KEY_NEXT, repeating while held
+ *   OK   -> LV_KEY_ENTER on release, LV_KEY_ESC once held for a long press
+ * Each key event makes keypad_fd() readable; the main loop then calls
+ * keypad_dispatch() so LVGL handles it at once instead of on its next
+ * read period.
+ */
+
+// A press is accepted on its first edge; edges within this window after
+// it are bounce and ignored
+#ifndef KEYPAD_DEBOUNCE_MS
+#define KEYPAD_DEBOUNCE_MS 20
+#endif
+
+// Hold time before a long press (OK) or the first repeat (UP/DOWN)
+#ifndef KEYPAD_LONG_PRESS_MS
+#define KEYPAD_LONG_PRESS_MS 600
+#endif
+
+// Interval between repeats while UP/DOWN stay held
+#ifndef KEYPAD_REPEAT_MS
+#define KEYPAD_REPEAT_MS 150
+#endif
+
+/**
+ * Set up the button GPIOs and start the event thread
+ * Makes no LVGL calls, so it can run on a boot thread.
+ * @return 0 on success, negative on error
+ */
+int keypad_start(void);
+
+/**
+ * Stop the event thread and release the GPIOs
+ */
+void keypad_stop(void);
+
+/**
+ * Register the LVGL input device and make its group the default one
+ * Needs lv_init(); call before building screens so their widgets join
+ * the group.
+ * @return 0 on success, negative on error
+ */
+int keypad_lvgl_init(void);
+
+/**
+ * Unregister the input device and delete its group
+ */
+void keypad_lvgl_deinit(void);
+
+/**
+ * Get the key-event eventfd for poll()/select()
+ * @return file descriptor, negative if the keypad is not running
+ */
+int keypad_fd(void);
+
+/**
+ * Feed queued key events to LVGL and redraw what they changed
+ * Call when keypad_fd() is readable.
+ */
+void keypad_dispatch(void);
+
+/**
+ * Get the group focus moves through
+ * @return group, NULL before keypad_lvgl_init()
+ */
+lv_group_t *keypad_get_group(void);
+
+/**
+ * Send key events to another group, e.g. the one of the active screen
+ * @param group Group to use, NULL for the keypad's own group
+ */
+void keypad_set_group(lv_group_t *group);
+
+#endif // KEYPAD_H
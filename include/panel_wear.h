@@ -0,0 +1,91 @@
+#ifndef PANEL_WEAR_H
+#define PANEL_WEAR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Panel wear and refresh-energy accounting
+ *
+ * Lifetime counters for this device's panel: refreshes and BUSY time per
+ * refresh type, and how often each horizontal band of the panel took part
+ * in a non-full refresh. They are kept on persistent storage, written
+ * back at most every PANEL_WEAR_SAVE_S seconds and on shutdown, and
+ * published on the metrics endpoint (see wallet_metrics.h).
+ *
+ * Energy is estimated from BUSY time: the controller draws about
+ * PANEL_REFRESH_POWER_UW while it drives a waveform, and BUSY is high for
+ * exactly that long, whatever the refresh type.
+ *
+ * Called from the display flush path only; not thread-safe.
+ */
+
+// Survives reboots, unlike the frame cache in /run; WALLET_PANEL_WEAR
+// overrides it
+#ifndef PANEL_WEAR_PATH
+#define PANEL_WEAR_PATH "/var/lib/wallet/panel-wear.bin"
+#endif
+
+// Minimum time between writes, to spare the flash
+#ifndef PANEL_WEAR_SAVE_S
+#define PANEL_WEAR_SAVE_S 600
+#endif
+
+// Controller power while refreshing (Waveshare 2.13" V4: 26.4 mW typical)
+#ifndef PANEL_REFRESH_POWER_UW
+#define PANEL_REFRESH_POWER_UW 26400
+#endif
+
+// Horizontal bands counted for non-full refreshes
+#define PANEL_WEAR_REGIONS 10
+
+typedef enum {
+    PANEL_REFRESH_FULL,
+    PANEL_REFRESH_FAST,
+    PANEL_REFRESH_PARTIAL,
+    PANEL_REFRESH_TYPES
+} panel_refresh_t;
+
+typedef struct {
+    uint64_t refreshes[PANEL_REFRESH_TYPES];
+    uint64_t busy_ms[PANEL_REFRESH_TYPES];
+    uint64_t region_updates[PANEL_WEAR_REGIONS];
+} panel_wear_t;
+
+/**
+ * Load the counters of this device's panel
+ * Starts from zero if there are none yet or they are unreadable.
+ * @param height Panel height in pixels, to map rows to bands
+ */
+void panel_wear_load(int height);
+
+/**
+ * Account for one refresh
+ * @param type Refresh type
+ * @param busy_ms How long BUSY stayed high for it
+ * @param y1 First row that changed
+ * @param y2 Last row that changed
+ */
+void panel_wear_record(panel_refresh_t type, uint32_t busy_ms, int y1, int y2);
+
+/**
+ * Write the counters back if they changed since the last write
+ * @param force Write even if PANEL_WEAR_SAVE_S has not passed yet
+ */
+void panel_wear_save(bool force);
+
+/**
+ * Get the current counters
+ * @param out Output counters
+ */
+void panel_wear_get(panel_wear_t *out);
+
+/**
+ * Estimated energy spent on refreshes of a given type
+ * @param wear Counters
+ * @param type Refresh type
+ * @return energy in millijoules
+ */
+double panel_wear_energy_mj(const panel_wear_t *wear, panel_refresh_t type);
+
+#endif // PANEL_WEAR_H
@@ -0,0 +1,59 @@
+#ifndef SECURE_ARENA_H
+#define SECURE_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Locked arena for key material
+ *
+ * One anonymous mapping of SECURE_ARENA_SIZE bytes between two
+ * inaccessible guard pages. It is locked in RAM so nothing in it reaches
+ * swap, left out of core dumps and wiped in forked children. Allocations
+ * come out zeroed and are wiped as soon as they are freed, so free blocks
+ * never hold old secrets.
+ *
+ * Blocks of SECURE_ARENA_BLOCK bytes are handed out first fit from a
+ * bitmap: no headers sit between allocations, and an arena this small
+ * is scanned in well under a microsecond. Secrets are few and long-lived
+ * (session keys, the token cache), so it is sized for them and not as a
+ * general heap.
+ *
+ * Thread-safe.
+ */
+
+#ifndef SECURE_ARENA_SIZE
+#define SECURE_ARENA_SIZE (32 * 1024)
+#endif
+
+#define SECURE_ARENA_BLOCK 64
+
+typedef struct {
+    size_t size;            // Usable bytes
+    size_t used;            // Bytes in allocated blocks
+    size_t max_used;        // High-water mark of used
+    size_t largest_free;    // Largest allocation that would succeed now
+    unsigned int failures;  // Allocations refused for lack of room
+    bool locked;            // false if mlock() was refused (RLIMIT_MEMLOCK)
+} secure_arena_stats_t;
+
+/**
+ * Allocate zeroed memory for secrets; the arena is set up on first use
+ * @param size Bytes needed
+ * @return memory aligned to SECURE_ARENA_BLOCK, NULL if the arena is full
+ */
+void *secure_alloc(size_t size);
+
+/**
+ * Wipe and release memory from secure_alloc()
+ * @param ptr Memory to release (may be NULL)
+ */
+void secure_free(void *ptr);
+
+/**
+ * Get the arena's usage
+ * @param out Output statistics
+ */
+void secure_arena_stats(secure_arena_stats_t *out);
+
+#endif // SECURE_ARENA_H
@@ -35,6 +35,31 @@ int tropic_auth_generate_cert(uint8_t *cert, size_t cert_size);
 int tropic_auth_sign(const uint8_t *data, size_t data_size,
                     uint8_t *signature, size_t signature_size);
 
+/**
+ * One message of a signing batch
+ */
+typedef struct {
+    const uint8_t *data;        // Data to sign
+    size_t data_size;
+    uint8_t *signature;         // Output signature buffer, at least 64 bytes
+    size_t signature_size;
+    int status;                 // Filled in: 0 if signed, negative on error
+} tropic_sign_item_t;
+
+/**
+ * Sign several messages with the Tropic01 device key
+ *
+ * Messages are packed into as few chip commands as fit and the commands
+ * are pipelined over the secure session, so a batch costs about one round
+ * trip instead of one per message. Each item gets the same signature
+ * tropic_auth_sign() would give it.
+ *
+ * @param items Messages, status and signature are written back per item
+ * @param count Number of items
+ * @return number of items signed, negative if nothing could be attempted
+ */
+int tropic_auth_sign_batch(tropic_sign_item_t *items, size_t count);
+
 /**
  * Verify signature using Tropic01
  * @param data Data that was signed
@@ -55,5 +80,49 @@ bool tropic_auth_verify(const uint8_t *data, size_t data_size,
  */
 int tropic_auth_derive_key(const char *service_name, uint8_t *key, size_t key_size);
 
+/**
+ * Hold the SPI bus for a multi-frame Tropic01 exchange
+ * (the libtropic port's chip-select low). A display upload on the same
+ * bus pauses at its next chunk boundary instead of delaying the command.
+ * @return 0 on success, negative if no SPI transport is available
+ */
+int tropic_auth_spi_begin(void);
+
+/**
+ * Release the SPI bus after tropic_auth_spi_begin()
+ */
+void tropic_auth_spi_end(void);
+
+/**
+ * Full-duplex transfer with the Tropic01
+ * @param tx Bytes to send (NULL sends zeros)
+ * @param rx Receive buffer (NULL discards)
+ * @param len Number of bytes
+ * @return 0 on success, negative on error or if no SPI transport is available
+ */
+int tropic_auth_spi_transfer(const uint8_t *tx, uint8_t *rx, size_t len);
+
+// Most segments in one tropic_auth_spi_transfer_v() call
+#define TROPIC_SPI_MAX_SEGMENTS 4
+
+/**
+ * One segment of a Tropic01 frame transfer
+ */
+typedef struct {
+    const uint8_t *tx;  // Bytes to send (NULL sends zeros)
+    uint8_t *rx;        // Receive buffer (NULL discards)
+    size_t len;
+} tropic_spi_segment_t;
+
+/**
+ * Transfer segments back to back in one SPI message, so the chip select
+ * stays low from the first byte to the last: one L1 frame per call
+ * @param seg Segments, in bus order
+ * @param count Number of segments, at most TROPIC_SPI_MAX_SEGMENTS
+ * @return 0 on success, negative on error, if the frame is larger than
+ *         one SPI message or if no SPI transport is available
+ */
+int tropic_auth_spi_transfer_v(const tropic_spi_segment_t *seg, int count);
+
 #endif // TROPIC_AUTH_H
 
@@ -0,0 +1,44 @@
+#ifndef TROPIC_MODEL_H
+#define TROPIC_MODEL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * Software model of the Tropic01 secure element
+ *
+ * Speaks the same L2/L3 protocol as the session layer so sessions can be
+ * exercised and timed without hardware, either in-process or behind a
+ * TCP/Unix socket served by the tropic_model tool. Its keys and results
+ * are the placeholders tropic_auth.c falls back to without a chip.
+ */
+typedef struct {
+    uint32_t handshake_us;          // Extra latency per handshake
+    uint32_t command_us;            // Extra latency per L3 command
+    uint32_t drop_session_every;    // Forget the session after every N commands, 0 = never
+} tropic_model_config_t;
+
+/**
+ * Serve one connection until the peer closes it
+ * @param fd Connected stream socket, closed on return
+ * @param config Model behaviour (NULL for defaults)
+ * @return 0 when the peer disconnected, negative on error
+ */
+int tropic_model_serve(int fd, const tropic_model_config_t *config);
+
+/**
+ * Run the model on a thread behind a socket pair
+ * @param config Model behaviour (NULL for defaults)
+ * @param thread Output thread handle; join it after closing the fd
+ * @return host-side socket, negative on error
+ */
+int tropic_model_spawn(const tropic_model_config_t *config, pthread_t *thread);
+
+/**
+ * Accept connections on "tcp:HOST:PORT" or "unix:PATH" and serve them
+ * one after another. Does not return unless the socket fails.
+ * @return negative on error
+ */
+int tropic_model_listen(const char *spec, const tropic_model_config_t *config);
+
+#endif // TROPIC_MODEL_H
@@ -0,0 +1,105 @@
+#ifndef TROPIC_SESSION_H
+#define TROPIC_SESSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Most commands sent back to back before their results are read
+ */
+#define TROPIC_SESSION_PIPELINE_MAX 8
+
+/**
+ * Transport carrying L2 frames to the chip (or a model of it)
+ *
+ * Stream transports (model, TCP, Unix socket) accept several requests in
+ * flight; the SPI transport answers one request at a time.
+ */
+typedef struct tropic_transport tropic_transport_t;
+
+struct tropic_transport {
+    const char *name;
+    bool can_pipeline;
+    int (*connect)(tropic_transport_t *t);
+    int (*send)(tropic_transport_t *t, const uint8_t *frame, size_t len);
+    // Receive one complete response frame, returns its length or -1
+    int (*recv)(tropic_transport_t *t, uint8_t *frame, size_t size, int timeout_ms);
+    void (*disconnect)(tropic_transport_t *t);
+    void (*destroy)(tropic_transport_t *t);
+    void *priv;
+};
+
+/**
+ * Create a transport from a specification string
+ *   "model"               in-process chip model on a socket pair
+ *   "tcp:HOST:PORT"       chip model served by tropic_model
+ *   "unix:PATH"           same, over a Unix domain socket
+ *   "spi"                 Tropic01 on the SPI bus (tropic_auth_spi_*)
+ * @return transport, or NULL if the spec is not understood
+ */
+tropic_transport_t *tropic_transport_create(const char *spec);
+
+/**
+ * One L3 command in a pipelined batch
+ */
+typedef struct {
+    uint8_t cmd;            // TROPIC_L3_* command id
+    const uint8_t *req;     // Command payload
+    size_t req_len;
+    uint8_t *res;           // Result payload buffer
+    size_t res_size;
+    size_t res_len;         // Filled in: result payload length
+    uint8_t result;         // Filled in: TROPIC_L3_RESULT_* code
+} tropic_cmd_t;
+
+/**
+ * Session counters
+ */
+typedef struct {
+    uint32_t handshakes;
+    uint32_t commands;
+    uint32_t renegotiations;    // Handshakes after the first one
+    uint32_t errors;            // Batches that failed even after renegotiating
+    uint64_t last_handshake_us;
+    uint64_t handshake_us_total;
+    uint64_t command_us_total;
+} tropic_session_stats_t;
+
+typedef struct tropic_session tropic_session_t;
+
+/**
+ * Open a secure session
+ * @param transport Transport, owned by the session from here on
+ * @param pairing_slot Pairing key slot the host authenticates with
+ * @param pairing_key X25519 private key of that slot
+ * @return session, or NULL if the transport or handshake failed
+ */
+tropic_session_t *tropic_session_open(tropic_transport_t *transport, uint8_t pairing_slot,
+                                      const uint8_t pairing_key[32]);
+
+/**
+ * Abort the secure session, close the transport and wipe the keys
+ */
+void tropic_session_close(tropic_session_t *session);
+
+/**
+ * Run commands over the session, pipelined when the transport allows
+ *
+ * If the transport drops or the chip no longer knows the session, the
+ * channel is re-established and the whole batch is sent once more.
+ * Commands must therefore be safe to repeat.
+ *
+ * @param cmds Commands, results are written back into each entry
+ * @param count Number of commands
+ * @return 0 if every command got a result (check cmds[i].result),
+ *         negative if the chip could not be reached
+ */
+int tropic_session_exec(tropic_session_t *session, tropic_cmd_t *cmds, size_t count);
+
+/**
+ * Get session counters
+ */
+void tropic_session_get_stats(tropic_session_t *session, tropic_session_stats_t *stats);
+
+#endif // TROPIC_SESSION_H
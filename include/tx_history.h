@@ -0,0 +1,116 @@
+#ifndef TX_HISTORY_H
+#define TX_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * On-device transaction history
+ *
+ * Two files in one directory:
+ *  - TX_HISTORY_LOG_NAME, an append-only log of checksummed records, one
+ *    per transaction, oldest first;
+ *  - TX_HISTORY_INDEX_NAME, one fixed-size entry per record with the
+ *    record's offset in the log and the balance after it.
+ *
+ * Both are mapped read-only, so finding transaction i is one index entry
+ * and one record away whatever the history's length, and the balance is
+ * the last index entry. Opening parses nothing: it checks the last
+ * indexed record and looks past it for records that were logged but not
+ * indexed before a power cut.
+ *
+ * Appends are durable once committed: the log is synced before the index
+ * entries that point into it are written, so the index never points at a
+ * record that did not reach storage, and a torn record at the end of the
+ * log is cut off when the history is next opened.
+ *
+ * Not thread-safe; once opened, call from the LVGL thread only.
+ */
+
+// Survives reboots; WALLET_TX_HISTORY overrides it
+#ifndef TX_HISTORY_DIR
+#define TX_HISTORY_DIR "/var/lib/wallet"
+#endif
+
+#define TX_HISTORY_LOG_NAME "history.log"
+#define TX_HISTORY_INDEX_NAME "history.idx"
+
+// Appends held before tx_history_append() commits on its own
+#ifndef TX_HISTORY_BATCH_MAX
+#define TX_HISTORY_BATCH_MAX 64
+#endif
+
+// Longest counterparty address kept, including the terminator
+#define TX_HISTORY_ADDRESS_SIZE 128
+
+typedef enum {
+    TX_HISTORY_IN,
+    TX_HISTORY_OUT,
+} tx_history_direction_t;
+
+typedef struct {
+    uint8_t txid[32];
+    uint64_t amount;                        // Atomic units
+    uint64_t fee;                           // Atomic units, paid by us if outgoing
+    int64_t timestamp;                      // Unix seconds
+    uint64_t height;                        // Block height, 0 while in the pool
+    tx_history_direction_t direction;
+    char address[TX_HISTORY_ADDRESS_SIZE];  // Counterparty, may be empty
+} tx_history_entry_t;
+
+/**
+ * Open the history, creating it if there is none
+ * @param dir Directory of the history files, NULL for the default
+ * @return 0 on success, negative on error
+ */
+int tx_history_open(const char *dir);
+
+/**
+ * Commit pending appends and close the history
+ */
+void tx_history_close(void);
+
+/**
+ * Add a transaction at the end of the history
+ * It becomes visible and durable at the next tx_history_commit(), which
+ * happens here every TX_HISTORY_BATCH_MAX appends.
+ * @param entry Transaction
+ * @return 0 on success, negative on error
+ */
+int tx_history_append(const tx_history_entry_t *entry);
+
+/**
+ * Make pending appends durable and visible
+ * @return 0 on success, negative on error
+ */
+int tx_history_commit(void);
+
+/**
+ * @return number of committed transactions
+ */
+uint32_t tx_history_count(void);
+
+/**
+ * Read a transaction
+ * @param index 0 for the oldest
+ * @param out Output transaction
+ * @return 0 on success, negative if there is no such transaction or its
+ *         record is damaged
+ */
+int tx_history_get(uint32_t index, tx_history_entry_t *out);
+
+/**
+ * @return balance after the last committed transaction, in atomic units
+ */
+int64_t tx_history_balance(void);
+
+/**
+ * Rewrite the history with only its newest transactions
+ * The balance is carried over, and the files are replaced atomically
+ * enough that a power cut leaves either history, never a mix.
+ * @param keep Transactions to keep
+ * @return 0 on success, negative on error (the history is unchanged)
+ */
+int tx_history_compact(uint32_t keep);
+
+#endif // TX_HISTORY_H
@@ -0,0 +1,109 @@
+#ifndef UI_LIST_H
+#define UI_LIST_H
+
+#include <stdint.h>
+#include <lvgl.h>
+
+/**
+ * Recycled-row list for long data sets (transaction history, address book)
+ *
+ * Only the rows that fit on screen exist as LVGL objects. They are bound
+ * to one page of items at a time, fetched from a data source, so memory
+ * and the cost of moving through the list do not depend on its length.
+ *
+ * UP and DOWN move the selection within the page, which restyles only
+ * the two rows involved. Moving past either end of the page turns to the
+ * next or previous page: one refetch and one refresh per page rather
+ * than per row, which suits the panel. Rebinding only rewrites rows whose
+ * text changed, so only those are invalidated.
+ *
+ * The list takes over focus on its group and turns off focus wrap; make
+ * it the only focusable widget of its screen. OK selects the focused
+ * item; a long press of OK goes to the cancel callback.
+ */
+
+// Row objects kept per list, whatever the data set size
+#define UI_LIST_MAX_ROWS 12
+
+#define UI_LIST_TEXT_SIZE 32
+#define UI_LIST_VALUE_SIZE 24
+
+// Shown in the first row when the source has no items
+#ifndef UI_LIST_EMPTY_TEXT
+#define UI_LIST_EMPTY_TEXT "Nothing here yet"
+#endif
+
+typedef struct {
+    char text[UI_LIST_TEXT_SIZE];       // Left, clipped to fit
+    char value[UI_LIST_VALUE_SIZE];     // Right-aligned, e.g. an amount
+} ui_list_item_t;
+
+/**
+ * Where the items come from; accessing a page should not depend on how
+ * many items there are
+ */
+typedef struct {
+    // Number of items
+    uint32_t (*count)(void *ctx);
+    // Fill items[0..n-1] with items first..first+n-1; returns how many
+    // were filled
+    int (*fetch)(void *ctx, uint32_t first, ui_list_item_t *items, int n);
+    // OK pressed on an item (optional)
+    void (*select)(void *ctx, uint32_t index);
+    void *ctx;
+} ui_list_source_t;
+
+typedef struct {
+    lv_obj_t *row;
+    lv_obj_t *text;
+    lv_obj_t *value;
+} ui_list_row_t;
+
+typedef struct {
+    lv_obj_t *box;
+    lv_obj_t *before;       // Focusing either edge turns the page
+    lv_obj_t *after;
+    lv_group_t *group;
+    ui_list_row_t rows[UI_LIST_MAX_ROWS];
+    int visible;            // Rows that fit
+    int shown;              // Rows bound to an item on this page
+    uint32_t top;           // Item in the first row
+    uint32_t count;
+    ui_list_source_t source;
+} ui_list_t;
+
+/**
+ * Create the row objects of a list
+ * @param list List to set up, owned by the caller
+ * @param parent Screen or container
+ * @param group Focus group of the screen
+ * @param y Top edge within parent
+ * @param height Room down in pixels; the rows that fit are created
+ * @param font Row font
+ * @param cancel_cb Called with LV_EVENT_CANCEL on a long press of OK
+ * @return 0 on success, negative on error
+ */
+int ui_list_init(ui_list_t *list, lv_obj_t *parent, lv_group_t *group, lv_coord_t y,
+                 lv_coord_t height, const lv_font_t *font, lv_event_cb_t cancel_cb);
+
+/**
+ * Show a data source from its first item
+ * @param list List
+ * @param source Source, copied
+ */
+void ui_list_set_source(ui_list_t *list, const ui_list_source_t *source);
+
+/**
+ * Refetch the page on screen after the data changed, keeping the
+ * position; rows that did not change are not redrawn
+ * @param list List
+ */
+void ui_list_refresh(ui_list_t *list);
+
+/**
+ * @param list List
+ * @return index of the focused item, UINT32_MAX if there is none
+ */
+uint32_t ui_list_selected(const ui_list_t *list);
+
+#endif // UI_LIST_H
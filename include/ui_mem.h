@@ -0,0 +1,53 @@
+#ifndef UI_MEM_H
+#define UI_MEM_H
+
+#include <stdint.h>
+
+/**
+ * UI memory accounting
+ *
+ * Every LVGL object, style and label text comes from LVGL's built-in TLSF
+ * heap: one static pool of LV_MEM_SIZE bytes (lv_conf.h) with
+ * constant-time allocation and freeing, never the C heap. The display's
+ * draw buffer and panel frame are static as well, and the screens are
+ * built once (see wallet_ui.c), so after startup the UI's memory is fixed
+ * and the flush path makes no allocator calls.
+ *
+ * This samples the pool every UI_MEM_SAMPLE_MS and publishes its use,
+ * high-water mark and fragmentation on the metrics endpoint, so
+ * LV_MEM_SIZE can be sized from what the device actually needed.
+ *
+ * Call from the LVGL thread.
+ */
+
+#ifndef UI_MEM_SAMPLE_MS
+#define UI_MEM_SAMPLE_MS 1000
+#endif
+
+// Use of the pool, in percent, that is logged as a warning
+#ifndef UI_MEM_WARN_PCT
+#define UI_MEM_WARN_PCT 90
+#endif
+
+typedef struct {
+    uint32_t size;          // Pool bytes
+    uint32_t used;          // Bytes allocated
+    uint32_t max_used;      // High-water mark of used
+    uint32_t largest_free;  // Largest allocation that would succeed now
+    uint32_t blocks;        // Allocations live
+    uint8_t frag_pct;       // Free space not in the largest free block
+} ui_mem_stats_t;
+
+/**
+ * Start publishing the pool's use; call after lv_init()
+ * @return 0 on success, negative on error
+ */
+int ui_mem_start(void);
+
+/**
+ * Get the pool's use now
+ * @param out Output statistics
+ */
+void ui_mem_stats(ui_mem_stats_t *out);
+
+#endif // UI_MEM_H
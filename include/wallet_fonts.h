@@ -0,0 +1,43 @@
+#ifndef WALLET_FONTS_H
+#define WALLET_FONTS_H
+
+#include <lvgl.h>
+
+/**
+ * Fonts of the wallet UI
+ *
+ * Builds with WALLET_FONT_1BPP use fonts made by tools/epd_fontc: 1 bit
+ * per pixel and hinted for the panel, so LVGL draws them without
+ * anti-aliasing and display_fbdev.c has no grey to threshold. Other
+ * builds fall back to LVGL's built-in Montserrat.
+ *
+ * With the 1bpp fonts, printable ASCII, which covers amounts, "XMR" and
+ * addresses, is looked up in a per-font table filled once by
+ * wallet_fonts_init() instead of by a cmap search for every letter
+ * drawn. The table holds glyph descriptors and pointers to the font's
+ * own bitmaps; it renders nothing. LVGL's built-in fonts are kerned and
+ * are used without a table.
+ */
+
+typedef enum {
+    WALLET_FONT_12,
+    WALLET_FONT_14,
+    WALLET_FONT_16,
+    WALLET_FONT_18,
+    WALLET_FONT_COUNT
+} wallet_font_id_t;
+
+/**
+ * Set up the fonts' glyph tables
+ * Needs lv_init(); call before building screens.
+ */
+void wallet_fonts_init(void);
+
+/**
+ * Get a UI font
+ * @param id Font size
+ * @return font, never NULL
+ */
+const lv_font_t *wallet_font(wallet_font_id_t id);
+
+#endif // WALLET_FONTS_H
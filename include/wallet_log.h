@@ -0,0 +1,181 @@
+#ifndef WALLET_LOG_H
+#define WALLET_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Levelled, ring-buffered logger
+ *
+ * Levels are fixed per module at compile time. A message below its
+ * module's level compiles to nothing, arguments included. An enabled
+ * message only captures its format string and arguments into a lock-free
+ * ring; a drain thread formats it later and writes it to the sink chosen
+ * by WALLET_LOG ("stderr", the default, "syslog", or "file:PATH").
+ *
+ * Usage, in a .c file:
+ *
+ *     #define WLOG_MODULE display
+ *     #include "wallet_log.h"
+ *     ...
+ *     WLOG_DEBUG("flush %d,%d %dx%d", x, y, w, h);
+ *
+ * The format must be a string literal. Arguments may be integers,
+ * floating point values, strings (copied, up to WLOG_STR_MAX bytes in
+ * total per message) or void pointers, at most WLOG_MAX_ARGS of them.
+ * Pointers are printed as they were when logged; cast other pointer
+ * types to (void *) for %p. A trailing newline in the format is dropped.
+ */
+
+#define WLOG_LEVEL_NONE  0
+#define WLOG_LEVEL_ERROR 1
+#define WLOG_LEVEL_WARN  2
+#define WLOG_LEVEL_INFO  3
+#define WLOG_LEVEL_DEBUG 4
+#define WLOG_LEVEL_TRACE 5
+
+// Level for modules without their own setting
+#ifndef WLOG_LEVEL
+#define WLOG_LEVEL WLOG_LEVEL_INFO
+#endif
+
+// Per-module levels, e.g. -DWLOG_LEVEL_display=WLOG_LEVEL_DEBUG
+#ifndef WLOG_LEVEL_waveshare
+#define WLOG_LEVEL_waveshare WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_display
+#define WLOG_LEVEL_display WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_ui
+#define WLOG_LEVEL_ui WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_keypad
+#define WLOG_LEVEL_keypad WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_auth
+#define WLOG_LEVEL_auth WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_boot
+#define WLOG_LEVEL_boot WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_latency
+#define WLOG_LEVEL_latency WLOG_LEVEL
+#endif
+#ifndef WLOG_LEVEL_history
+#define WLOG_LEVEL_history WLOG_LEVEL
+#endif
+
+// Messages the ring holds before new ones are dropped (power of two)
+#ifndef WLOG_RING_SIZE
+#define WLOG_RING_SIZE 256
+#endif
+
+#define WLOG_MAX_ARGS 8
+#define WLOG_STR_MAX  48
+
+typedef enum {
+    WLOG_ARG_INT,
+    WLOG_ARG_DOUBLE,
+    WLOG_ARG_STR,
+    WLOG_ARG_PTR,
+} wlog_arg_type_t;
+
+/**
+ * One captured argument
+ */
+typedef struct {
+    wlog_arg_type_t type;
+    union {
+        int64_t i;
+        double f;
+        const char *s;
+        const void *p;
+    };
+} wlog_arg_t;
+
+/**
+ * Capture a message; use the WLOG_* macros instead
+ * Never blocks and never formats; drops the message if the ring is full.
+ */
+void wlog_write(int level, const char *module, const char *fmt, int nargs, const wlog_arg_t *args);
+
+/**
+ * Write out everything captured so far, on the calling thread
+ */
+void wlog_flush(void);
+
+/**
+ * Flush and stop the drain thread (it starts with the first message)
+ */
+void wlog_shutdown(void);
+
+/**
+ * @return number of messages lost to a full ring since start
+ */
+uint32_t wlog_dropped(void);
+
+static inline wlog_arg_t wlog_arg_int(int64_t v) { return (wlog_arg_t){ .type = WLOG_ARG_INT, .i = v }; }
+static inline wlog_arg_t wlog_arg_uint(uint64_t v) { return (wlog_arg_t){ .type = WLOG_ARG_INT, .i = (int64_t)v }; }
+static inline wlog_arg_t wlog_arg_double(double v) { return (wlog_arg_t){ .type = WLOG_ARG_DOUBLE, .f = v }; }
+static inline wlog_arg_t wlog_arg_str(const char *v) { return (wlog_arg_t){ .type = WLOG_ARG_STR, .s = v }; }
+static inline wlog_arg_t wlog_arg_ptr(const void *v) { return (wlog_arg_t){ .type = WLOG_ARG_PTR, .p = v }; }
+
+#define WLOG_ARG(x) _Generic((x),                                   \
+    char *: wlog_arg_str, const char *: wlog_arg_str,               \
+    void *: wlog_arg_ptr, const void *: wlog_arg_ptr,               \
+    float: wlog_arg_double, double: wlog_arg_double,                \
+    unsigned long: wlog_arg_uint, unsigned long long: wlog_arg_uint, \
+    default: wlog_arg_int)(x)
+
+#define WLOG_CAT_(a, b) a##b
+#define WLOG_CAT(a, b) WLOG_CAT_(a, b)
+#define WLOG_STR_(x) #x
+#define WLOG_STR(x) WLOG_STR_(x)
+
+// The named first parameter makes ## drop the comma in ISO C mode too
+#define WLOG_NARGS(first, ...) WLOG_NARGS_(first, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define WLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define WLOG_MAP_0() { .type = WLOG_ARG_INT }
+#define WLOG_MAP_1(a) WLOG_ARG(a)
+#define WLOG_MAP_2(a, ...) WLOG_ARG(a), WLOG_MAP_1(__VA_ARGS__)
+#define WLOG_MAP_3(a, ...) WLOG_ARG(a), WLOG_MAP_2(__VA_ARGS__)
+#define WLOG_MAP_4(a, ...) WLOG_ARG(a), WLOG_MAP_3(__VA_ARGS__)
+#define WLOG_MAP_5(a, ...) WLOG_ARG(a), WLOG_MAP_4(__VA_ARGS__)
+#define WLOG_MAP_6(a, ...) WLOG_ARG(a), WLOG_MAP_5(__VA_ARGS__)
+#define WLOG_MAP_7(a, ...) WLOG_ARG(a), WLOG_MAP_6(__VA_ARGS__)
+#define WLOG_MAP_8(a, ...) WLOG_ARG(a), WLOG_MAP_7(__VA_ARGS__)
+
+// Only there so the compiler checks formats against their arguments
+static inline __attribute__((format(printf, 1, 2))) void wlog_check_format(const char *fmt, ...) { (void)fmt; }
+
+#ifndef WLOG_MODULE
+#define WLOG_MODULE app
+#endif
+#ifndef WLOG_LEVEL_app
+#define WLOG_LEVEL_app WLOG_LEVEL
+#endif
+
+/**
+ * Log for a given module at an explicit level; the level must be a
+ * constant so that the whole statement folds away when it is disabled
+ */
+#define WLOG_MODULE_AT(module, level, fmt, ...) do {                            \
+    if ((level) <= WLOG_CAT(WLOG_LEVEL_, module)) {                             \
+        if (0) {                                                                \
+            wlog_check_format(fmt, ##__VA_ARGS__);                              \
+        }                                                                       \
+        wlog_write((level), WLOG_STR(module), fmt, WLOG_NARGS(0, ##__VA_ARGS__), \
+                   (const wlog_arg_t[]){ WLOG_CAT(WLOG_MAP_, WLOG_NARGS(0, ##__VA_ARGS__))(__VA_ARGS__) }); \
+    }                                                                           \
+} while (0)
+
+#define WLOG_AT(level, fmt, ...) WLOG_MODULE_AT(WLOG_MODULE, level, fmt, ##__VA_ARGS__)
+
+#define WLOG_ERROR(fmt, ...) WLOG_AT(WLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define WLOG_WARN(fmt, ...)  WLOG_AT(WLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define WLOG_INFO(fmt, ...)  WLOG_AT(WLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define WLOG_DEBUG(fmt, ...) WLOG_AT(WLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define WLOG_TRACE(fmt, ...) WLOG_AT(WLOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+
+#endif // WALLET_LOG_H
@@ -0,0 +1,152 @@
+#ifndef WALLET_METRICS_H
+#define WALLET_METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * Runtime metrics: counters, gauges and latency histograms
+ *
+ * Metrics are static objects defined where they are updated:
+ *
+ *     METRICS_COUNTER(refresh_full, "wallet_epd_refresh_full_total", "Full refreshes");
+ *     METRICS_HISTOGRAM(busy_us, "wallet_epd_busy_microseconds", "BUSY wait time");
+ *     ...
+ *     metrics_inc(&refresh_full);
+ *     metrics_observe(&busy_us, waited_us);
+ *
+ * Each one links itself into the registry before main() runs; metrics
+ * made at run time can be added with metrics_register(). The name of a
+ * counter or gauge may carry Prometheus labels, e.g.
+ * "wallet_x_total{kind=\"a\"}"; register the metrics of one family one
+ * after the other. Updates are single relaxed atomic operations, so any
+ * thread may make them, and they never block. metrics_start() serves a
+ * text snapshot of every metric, in Prometheus exposition format, to
+ * each client that connects to a Unix socket:
+ *
+ *     socat - UNIX-CONNECT:/run/wallet-metrics.sock
+ */
+
+// Socket the snapshot is served on; WALLET_METRICS overrides it, and an
+// empty WALLET_METRICS turns the endpoint off
+#ifndef METRICS_SOCKET_PATH
+#define METRICS_SOCKET_PATH "/run/wallet-metrics.sock"
+#endif
+
+// Histogram buckets: four per power of two, so a bucket is at most 25%
+// wide, up to 2^33 (about 2.4 hours in microseconds)
+#define METRICS_HIST_SUB_BITS 2
+#define METRICS_HIST_BUCKETS 128
+
+typedef enum {
+    METRICS_TYPE_COUNTER,
+    METRICS_TYPE_GAUGE,
+    METRICS_TYPE_HISTOGRAM,
+} metrics_type_t;
+
+typedef struct metrics_hist {
+    _Atomic uint64_t buckets[METRICS_HIST_BUCKETS];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+} metrics_hist_t;
+
+typedef struct metric {
+    const char *name;
+    const char *help;
+    metrics_type_t type;
+    struct metric *_Atomic next;    // Registry link
+    _Atomic int64_t value;          // Counter or gauge
+    metrics_hist_t *hist;           // Histogram only
+} metric_t;
+
+/**
+ * Add a metric to the registry; the METRICS_* macros do this
+ * Safe from any thread, also while a snapshot is being served. A metric
+ * stays registered for the life of the process.
+ */
+void metrics_register(metric_t *m);
+
+#define METRICS_DEFINE_(var, metric_name, metric_help, metric_type, metric_hist)  \
+    static metric_t var = {                                                     \
+        .name = metric_name, .help = metric_help,                               \
+        .type = metric_type, .hist = metric_hist,                               \
+    };                                                                          \
+    __attribute__((constructor)) static void var##_register(void) {            \
+        metrics_register(&var);                                                 \
+    }
+
+#define METRICS_COUNTER(var, name, help) \
+    METRICS_DEFINE_(var, name, help, METRICS_TYPE_COUNTER, NULL)
+#define METRICS_GAUGE(var, name, help) \
+    METRICS_DEFINE_(var, name, help, METRICS_TYPE_GAUGE, NULL)
+#define METRICS_HISTOGRAM(var, name, help)                                      \
+    static metrics_hist_t var##_hist;                                           \
+    METRICS_DEFINE_(var, name, help, METRICS_TYPE_HISTOGRAM, &var##_hist)
+
+static inline void metrics_add(metric_t *m, int64_t n) {
+    atomic_fetch_add_explicit(&m->value, n, memory_order_relaxed);
+}
+
+static inline void metrics_inc(metric_t *m) {
+    metrics_add(m, 1);
+}
+
+/**
+ * Set a gauge, or a counter kept elsewhere (e.g. by a driver)
+ */
+static inline void metrics_set(metric_t *m, int64_t v) {
+    atomic_store_explicit(&m->value, v, memory_order_relaxed);
+}
+
+/**
+ * Bucket index for a histogram value: exact below 4, then four
+ * log-linear buckets per power of two
+ */
+static inline unsigned metrics_hist_bucket(uint64_t v) {
+    if (v < (1u << METRICS_HIST_SUB_BITS)) {
+        return (unsigned)v;
+    }
+    unsigned msb = 63 - (unsigned)__builtin_clzll(v);
+    unsigned sub = (unsigned)(v >> (msb - METRICS_HIST_SUB_BITS)) & ((1u << METRICS_HIST_SUB_BITS) - 1);
+    unsigned i = ((msb - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS) + sub;
+    return i < METRICS_HIST_BUCKETS ? i : METRICS_HIST_BUCKETS - 1;
+}
+
+/**
+ * Record one histogram sample, e.g. a latency in microseconds
+ */
+static inline void metrics_observe(metric_t *m, uint64_t v) {
+    metrics_hist_t *h = m->hist;
+    atomic_fetch_add_explicit(&h->buckets[metrics_hist_bucket(v)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (v > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, v,
+                                                             memory_order_relaxed,
+                                                             memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @return CLOCK_MONOTONIC in microseconds, for timing observations
+ */
+uint64_t metrics_now_us(void);
+
+/**
+ * Write a snapshot of every registered metric
+ * @param fd Destination file descriptor
+ * @return 0 on success, negative on write error
+ */
+int metrics_dump(int fd);
+
+/**
+ * Start serving snapshots on the metrics socket
+ * @return 0 on success (or if the endpoint is turned off), negative on error
+ */
+int metrics_start(void);
+
+/**
+ * Stop serving and remove the socket
+ */
+void metrics_stop(void);
+
+#endif // WALLET_METRICS_H
@@ -0,0 +1,104 @@
+#ifndef WALLET_QR_H
+#define WALLET_QR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * QR codes for receive requests, drawn straight in the panel's format
+ *
+ * Encodes byte-mode QR codes of versions 1 to QR_MAX_VERSION and renders
+ * the modules at an integer scale into packed 1bpp rows (MSB first,
+ * 1 = white, as in epd_asset.h); each row of modules is drawn once and
+ * copied down. Nothing goes through an LVGL canvas: there is no RGB565
+ * image to scale and then threshold, and the result is copied into the
+ * panel frame as it is (see display_fbdev_set_overlay()).
+ *
+ * Rendered codes for receive requests are cached per (address, amount),
+ * so showing the same request again is a lookup and a copy.
+ *
+ * Not thread-safe; called from the LVGL thread.
+ */
+
+// Version 10 (57x57) holds 271 bytes at level L, enough for an
+// integrated address with an amount; anything larger would not be
+// readable at one pixel per module on this panel anyway
+#define QR_MAX_VERSION 10
+#define QR_MAX_SIZE (QR_MAX_VERSION * 4 + 17)
+
+// Light modules around the code, as the standard asks
+#define QR_QUIET_ZONE 4
+
+// Rendered codes kept for receive requests
+#ifndef WALLET_QR_CACHE_SIZE
+#define WALLET_QR_CACHE_SIZE 4
+#endif
+
+// Largest rendered code: one panel-wide byte-aligned square
+#define QR_BITMAP_MAX_WIDTH 128
+#define QR_BITMAP_MAX_STRIDE (QR_BITMAP_MAX_WIDTH / 8)
+
+typedef enum {
+    QR_ECC_L,   // ~7% of codewords recoverable
+    QR_ECC_M,   // ~15%
+    QR_ECC_Q,   // ~25%
+    QR_ECC_H,   // ~30%
+} qr_ecc_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t size;           // Modules per side
+    uint8_t mask;
+    qr_ecc_t ecc;
+    uint8_t modules[QR_MAX_SIZE][QR_MAX_SIZE];     // 1 = dark
+} qr_code_t;
+
+typedef struct {
+    uint32_t serial;        // New for every code rendered into it
+    uint16_t width;         // Pixels, a multiple of 8
+    uint16_t height;        // Pixels
+    uint16_t stride;        // Bytes per row
+    uint8_t bits[QR_BITMAP_MAX_STRIDE * QR_BITMAP_MAX_WIDTH];
+} qr_bitmap_t;
+
+/**
+ * Encode data as a QR code in byte mode
+ * Picks the smallest version that fits at the requested level, then the
+ * highest level that still fits in that version.
+ * @param data Data to encode
+ * @param len Length of data
+ * @param ecc Minimum error correction level
+ * @param qr Output code
+ * @return 0 on success, negative if the data does not fit
+ */
+int qr_encode(const uint8_t *data, size_t len, qr_ecc_t ecc, qr_code_t *qr);
+
+/**
+ * Render a code into packed 1bpp rows
+ * The code, with its quiet zone, is centred in width pixels; everything
+ * else in those rows is left white.
+ * @param qr Code to render
+ * @param scale Pixels per module
+ * @param width Width to fill in pixels, a multiple of 8
+ * @param dst First byte of the first row
+ * @param stride Bytes per row of dst
+ * @return rows written, negative if the code is wider than width
+ */
+int qr_render_1bpp(const qr_code_t *qr, int scale, int width, uint8_t *dst, size_t stride);
+
+/**
+ * Get the rendered code for a receive request, from the cache if it was
+ * shown before
+ * Encodes a "monero:" URI with tx_amount when amount is set, at the
+ * largest scale that fits.
+ * @param address Receive address
+ * @param amount Requested amount in atomic units, 0 for any
+ * @param max_width Room across in pixels
+ * @param max_height Room down in pixels
+ * @return bitmap, valid until WALLET_QR_CACHE_SIZE other requests have
+ *         been rendered, or NULL if the code does not fit
+ */
+const qr_bitmap_t *wallet_qr_receive(const char *address, uint64_t amount,
+                                     int max_width, int max_height);
+
+#endif // WALLET_QR_H
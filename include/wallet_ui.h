@@ -1,10 +1,15 @@
 #ifndef WALLET_UI_H
 #define WALLET_UI_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <lvgl.h>
+#include "ui_list.h"
 
 /**
  * Initialize the wallet UI
+ * Builds the screens and loads the main one without rendering it, so it
+ * may run while the panel is still coming up.
  * @return 0 on success, negative on error
  */
 int wallet_ui_init(void);
@@ -20,16 +25,95 @@ void wallet_ui_deinit(void);
  */
 void wallet_ui_update_balance(uint64_t balance);
 
+// Confirmations that can wait for the user at once
+#define WALLET_UI_CONFIRM_QUEUE_SIZE 8
+
+// Longest address a confirmation can carry, including the terminator
+#define WALLET_UI_ADDRESS_SIZE 128
+
+/**
+ * Transaction shown for confirmation
+ */
+typedef struct {
+    uint64_t amount;                        // Atomic units
+    uint64_t fee;                           // Atomic units
+    char address[WALLET_UI_ADDRESS_SIZE];   // Destination address
+} wallet_ui_tx_t;
+
+/**
+ * Confirmation result, called on the LVGL thread from the input handler
+ * @param tx The transaction as it was shown
+ * @param accepted true if the user pressed Confirm
+ * @param ctx As passed to wallet_ui_request_confirmation()
+ */
+typedef void (*wallet_ui_confirm_cb_t)(const wallet_ui_tx_t *tx, bool accepted, void *ctx);
+
+/**
+ * Queue a transaction for confirmation and return without waiting
+ * Confirmations are shown one after another in request order; each
+ * callback runs once the user has decided. The first one replaces the
+ * main screen; on any other screen it waits until the user goes back.
+ * The transaction is copied.
+ * Call from the LVGL thread.
+ * @param tx Transaction to show
+ * @param cb Completion callback (may be NULL)
+ * @param ctx Passed back to the callback
+ * @return request id (> 0), negative if the queue is full
+ */
+int wallet_ui_request_confirmation(const wallet_ui_tx_t *tx, wallet_ui_confirm_cb_t cb, void *ctx);
+
+/**
+ * Withdraw a confirmation; its callback runs with accepted = false
+ * @param id Request id
+ * @return 0 on success, negative if there is no such request
+ */
+int wallet_ui_cancel_confirmation(uint32_t id);
+
+/**
+ * @return number of confirmations queued, including the one on screen
+ */
+int wallet_ui_pending_confirmations(void);
+
+/**
+ * Return to the main screen
+ */
+void wallet_ui_show_main(void);
+
+/**
+ * Show a full address for checking, until Back is pressed
+ * @param address Address to display
+ */
+void wallet_ui_show_address(const char *address);
+
+/**
+ * Show the receive screen, until Back is pressed
+ * @param address Receive address
+ * @param amount Requested amount in atomic units, 0 for any
+ */
+void wallet_ui_show_receive(const char *address, uint64_t amount);
+
+/**
+ * Show a titled list, e.g. transaction history or the address book,
+ * until a long press of OK
+ * @param title Title above the list
+ * @param source Where the items come from, copied; its context must stay
+ *        valid while the list is on screen
+ */
+void wallet_ui_show_list(const char *title, const ui_list_source_t *source);
+
+/**
+ * Refetch the list's page on screen after its source changed
+ */
+void wallet_ui_refresh_list(void);
+
 /**
- * Show transaction confirmation screen
- * @param amount Amount in atomic units
- * @param address Destination address
- * @return 1 if confirmed, 0 if cancelled
+ * Show the transaction history, newest first, from the on-device store
+ * (see tx_history.h); pending transactions are marked with a *
  */
-int wallet_ui_confirm_transaction(uint64_t amount, const char *address);
+void wallet_ui_show_history(void);
 
 /**
- * Show error message
+ * Show the error screen, until OK is pressed
  * @param message Error message to display
  */
 void wallet_ui_show_error(const char *message);
@@ -34,6 +34,7 @@
 #define LV_MEM_CUSTOM 0
 #if LV_MEM_CUSTOM == 0
     /*Size of the memory available for `lv_mem_alloc()` in bytes (>= 2kB)*/
+    /*All UI objects live in this pool; check wallet_ui_mem_max_used_bytes before changing it*/
     #define LV_MEM_SIZE (64U * 1024U)          /*[bytes]*/
     /*Set an address for the memory pool instead of allocating it as a normal array. Can be in external SRAM too.*/
     #define LV_MEM_ADR 0     /*0: unused*/
@@ -90,8 +91,13 @@
  *-----------*/
 
 /*Enable complex draw engine.
- *Required to draw shadow, gradient, rounded corners, circles, arc, skew, image transformations or any masks*/
-#define LV_DRAW_COMPLEX 1
+ *Required to draw shadow, gradient, rounded corners, circles, arc, skew, image transformations or any masks
+ *Off: the 1bpp panel thresholds anti-aliased edges and shadows to noise, and the e-paper theme
+ *(src/epd_theme.c) draws only square, opaque rectangles and text. Define it as 1 to build LVGL
+ *for a comparison with tools/ui_bench.c.*/
+#ifndef LV_DRAW_COMPLEX
+#define LV_DRAW_COMPLEX 0
+#endif
 #if LV_DRAW_COMPLEX != 0
     /*Allow buffering some shadow calculation.
     *LV_DRAW_SW_SHADOW_CACHE_SIZE is the max. shadow size to buffer, where shadow size is `shadow_width + radius`
@@ -333,7 +339,7 @@
 #define LV_USE_CANVAS     1
 #define LV_USE_CHART      1
 #define LV_USE_CHECKBOX   1
-#define LV_USE_COLORWHEEL 1
+#define LV_USE_COLORWHEEL LV_DRAW_COMPLEX   /*Requires: LV_DRAW_COMPLEX*/
 #define LV_USE_DROPDOWN   1   /*Requires: lv_label*/
 #define LV_USE_IMG        1   /*Requires: lv_label*/
 #define LV_USE_KEYBOARD   1
@@ -342,7 +348,7 @@
 #define LV_USE_LINE       1
 #define LV_USE_LIST       1
 #define LV_USE_MENU       1
-#define LV_USE_METER      1
+#define LV_USE_METER      LV_DRAW_COMPLEX   /*Requires: LV_DRAW_COMPLEX*/
 #define LV_USE_MSGBOX     1
 #define LV_USE_ROLLER     1   /*Requires: lv_label*/
 #define LV_USE_SLIDER     1
@@ -360,7 +366,8 @@
  * THEMES
  *==================*/
 
-/*A simple, impressive and very complete theme*/
+/*A simple, impressive and very complete theme
+ *The wallet uses src/epd_theme.c; this one stays for tools/ui_bench.c to compare against*/
 #define LV_USE_THEME_DEFAULT 1
 #if LV_USE_THEME_DEFAULT
 
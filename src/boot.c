@@ -0,0 +1,252 @@
+#include "boot.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifndef BOOT_REPORT_DEFAULT_PATH
+#define BOOT_REPORT_DEFAULT_PATH "/run/wallet-boot.txt"
+#endif
+
+typedef struct boot_state boot_state_t;
+
+typedef struct {
+    boot_state_t *state;
+    size_t index;
+} boot_worker_t;
+
+struct boot_state {
+    const boot_stage_t *stages;
+    size_t count;
+    void *ctx;
+    boot_report_t *report;
+    uint64_t t0;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    boot_worker_t workers[BOOT_MAX_STAGES];
+    pthread_t threads[BOOT_MAX_STAGES];
+    bool threaded[BOOT_MAX_STAGES];
+    bool inline_only[BOOT_MAX_STAGES];  // No thread could be created for it
+};
+
+static uint64_t boot_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @return 1 if all prerequisites are done, 0 if some are still
+ *         outstanding, -1 if one of them failed or was skipped
+ */
+static int boot_stage_ready(const boot_state_t *st, size_t i) {
+    int ready = 1;
+    for (size_t d = 0; d < i; d++) {
+        if (!(st->stages[i].after & BOOT_AFTER(d))) {
+            continue;
+        }
+        boot_stage_status_t s = st->report->stages[d].status;
+        if (s == BOOT_STAGE_FAILED || s == BOOT_STAGE_SKIPPED) {
+            return -1;
+        }
+        if (s != BOOT_STAGE_DONE) {
+            ready = 0;
+        }
+    }
+    return ready;
+}
+
+static void *boot_worker(void *arg);
+
+/**
+ * Skip stages whose prerequisites failed and start every background
+ * stage that is ready. Called with the lock held, both by the main loop
+ * and by workers as they finish, so a chain of background stages never
+ * waits for the main thread.
+ * @return number of stages still pending or running
+ */
+static size_t boot_launch_ready(boot_state_t *st) {
+    size_t open = 0;
+
+    for (size_t i = 0; i < st->count; i++) {
+        boot_stage_result_t *r = &st->report->stages[i];
+        if (r->status == BOOT_STAGE_RUNNING) {
+            open++;
+        }
+        if (r->status != BOOT_STAGE_PENDING) {
+            continue;
+        }
+        int ready = boot_stage_ready(st, i);
+        if (ready < 0) {
+            r->status = BOOT_STAGE_SKIPPED;
+            continue;
+        }
+        open++;
+        if (!ready || st->stages[i].main_thread || st->inline_only[i]) {
+            continue;
+        }
+        r->status = BOOT_STAGE_RUNNING;
+        r->start_us = boot_clock_us() - st->t0;
+        st->workers[i] = (boot_worker_t){ .state = st, .index = i };
+        if (pthread_create(&st->threads[i], NULL, boot_worker, &st->workers[i]) == 0) {
+            st->threaded[i] = true;
+        } else {
+            // No thread to spare: the main loop runs it instead
+            r->status = BOOT_STAGE_PENDING;
+            st->inline_only[i] = true;
+        }
+    }
+    return open;
+}
+
+/**
+ * Run one stage and record its result; called without the lock held
+ */
+static void boot_stage_exec(boot_state_t *st, size_t i) {
+    int ret = st->stages[i].run ? st->stages[i].run(st->ctx) : 0;
+    uint64_t end = boot_clock_us() - st->t0;
+
+    pthread_mutex_lock(&st->lock);
+    st->report->stages[i].end_us = end;
+    st->report->stages[i].status = ret < 0 ? BOOT_STAGE_FAILED : BOOT_STAGE_DONE;
+    boot_launch_ready(st);
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+}
+
+static void *boot_worker(void *arg) {
+    boot_worker_t *w = arg;
+    boot_stage_exec(w->state, w->index);
+    return NULL;
+}
+
+int boot_run(const boot_stage_t *stages, size_t count, void *ctx, boot_report_t *report) {
+    if (!stages || !report || count > BOOT_MAX_STAGES) {
+        return -1;
+    }
+
+    boot_state_t *st = calloc(1, sizeof(*st));
+    if (!st) {
+        return -1;
+    }
+    st->stages = stages;
+    st->count = count;
+    st->ctx = ctx;
+    st->report = report;
+    st->t0 = boot_clock_us();
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->cond, NULL);
+    memset(report, 0, sizeof(*report));
+    report->count = count;
+
+    pthread_mutex_lock(&st->lock);
+    while (boot_launch_ready(st) > 0) {
+        // Main-thread stages run here, in table order, as they become ready
+        size_t i;
+        for (i = 0; i < count; i++) {
+            if (report->stages[i].status == BOOT_STAGE_PENDING &&
+                (stages[i].main_thread || st->inline_only[i]) && boot_stage_ready(st, i) > 0) {
+                break;
+            }
+        }
+        if (i == count) {
+            pthread_cond_wait(&st->cond, &st->lock);
+            continue;
+        }
+        report->stages[i].status = BOOT_STAGE_RUNNING;
+        report->stages[i].start_us = boot_clock_us() - st->t0;
+        pthread_mutex_unlock(&st->lock);
+        boot_stage_exec(st, i);
+        pthread_mutex_lock(&st->lock);
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    int ret = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (st->threaded[i]) {
+            pthread_join(st->threads[i], NULL);
+        }
+        if (report->stages[i].status != BOOT_STAGE_DONE) {
+            ret = -1;
+        }
+    }
+    report->total_us = boot_clock_us() - st->t0;
+
+    pthread_cond_destroy(&st->cond);
+    pthread_mutex_destroy(&st->lock);
+    free(st);
+    return ret;
+}
+
+void boot_shutdown(const boot_stage_t *stages, const boot_report_t *report, void *ctx) {
+    if (!stages || !report) {
+        return;
+    }
+    for (size_t i = report->count; i-- > 0;) {
+        if (report->stages[i].status == BOOT_STAGE_DONE && stages[i].undo) {
+            stages[i].undo(ctx);
+        }
+    }
+}
+
+void boot_report_print(const boot_stage_t *stages, const boot_report_t *report, FILE *out) {
+    static const char *status_name[] = { "pending", "running", "ok", "FAILED", "skipped" };
+    size_t last = report->count;
+
+    fprintf(out, "Boot report (ms):\n");
+    fprintf(out, "  %-14s %8s %8s %8s  %-6s %s\n", "stage", "start", "end", "took", "thread", "status");
+    for (size_t i = 0; i < report->count; i++) {
+        const boot_stage_result_t *r = &report->stages[i];
+        bool ran = r->status == BOOT_STAGE_DONE || r->status == BOOT_STAGE_FAILED;
+        fprintf(out, "  %-14s %8.1f %8.1f %8.1f  %-6s %s\n", stages[i].name,
+                ran ? r->start_us / 1000.0 : 0.0, ran ? r->end_us / 1000.0 : 0.0,
+                ran ? (r->end_us - r->start_us) / 1000.0 : 0.0,
+                stages[i].main_thread ? "main" : "boot", status_name[r->status]);
+        if (ran && (last == report->count || r->end_us > report->stages[last].end_us)) {
+            last = i;
+        }
+    }
+    if (last == report->count) {
+        return;
+    }
+
+    // Walk back through whichever prerequisite finished last
+    size_t path[BOOT_MAX_STAGES], len = 0;
+    for (size_t i = last;;) {
+        path[len++] = i;
+        size_t prev = i;
+        for (size_t d = 0; d < i; d++) {
+            if ((stages[i].after & BOOT_AFTER(d)) &&
+                (prev == i || report->stages[d].end_us > report->stages[prev].end_us)) {
+                prev = d;
+            }
+        }
+        if (prev == i) {
+            break;
+        }
+        i = prev;
+    }
+    fprintf(out, "  critical path:");
+    while (len--) {
+        fprintf(out, " %s%s", stages[path[len]].name, len ? " >" : "");
+    }
+    fprintf(out, " (%.1f ms, boot total %.1f ms)\n", report->stages[last].end_us / 1000.0,
+            report->total_us / 1000.0);
+}
+
+void boot_report_write(const boot_stage_t *stages, const boot_report_t *report) {
+    if (!stages || !report) {
+        return;
+    }
+    boot_report_print(stages, report, stdout);
+
+    const char *path = getenv("WALLET_BOOT_REPORT");
+    if (!path || !*path) {
+        path = BOOT_REPORT_DEFAULT_PATH;
+    }
+    FILE *f = fopen(path, "w");
+    if (f) {
+        boot_report_print(stages, report, f);
+        fclose(f);
+    }
+}
@@ -1,18 +1,26 @@
+#define WLOG_MODULE display
 #include "display_fbdev.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
+#include "input_latency.h"
+#include "panel_wear.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <linux/fb.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 // Waveshare e-paper driver includes
 #include "EPD_2in13_V4.h"
 #include "DEV_Config.h"
+#include "epd_asset.h"
 
 // E-paper display dimensions (2.13" V4)
 #define EPD_WIDTH  122
@@ -27,12 +35,79 @@ static lv_disp_t *display = NULL;
 static lv_disp_drv_t disp_drv;
 static lv_disp_draw_buf_t disp_buf;
 
+// LVGL's draw buffer and the panel frame are static, so neither bringing
+// the display up again nor any flush touches an allocator
+static lv_color_t draw_pixels[EPD_WIDTH * EPD_HEIGHT];
+static uint8_t epaper_frame[((EPD_WIDTH + 7) / 8) * EPD_HEIGHT];
+
 // For e-paper, we need to convert RGB to monochrome
 static uint8_t *epaper_buffer = NULL;
 static bool waveshare_initialized = false;
 static bool use_fast_mode = false;
 static uint32_t update_count = 0;
 
+// Last frame on the glass, so a restart can take it as the base image
+// instead of clearing. The default lives in /run: it survives service
+// restarts and crashes, and costs no flash writes. It is written after a
+// full refresh and on shutdown only, and never holds a sensitive screen;
+// after any other refresh it is out of date and removed.
+#ifndef EPD_FRAME_CACHE_PATH
+#define EPD_FRAME_CACHE_PATH "/run/wallet-frame.bin"
+#endif
+#define EPD_FRAME_MAGIC 0x46445045U     // "EPDF"
+
+typedef struct {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint32_t crc32;     // CRC-32 of the frame that follows
+} epd_frame_header_t;
+
+static bool frame_retained = false;     // Panel RAM holds the retained frame
+static bool frame_saved = false;         // The cache file holds frame_saved_crc
+static uint32_t frame_saved_crc = 0;
+static bool screen_sensitive = false;   // Frames drawn now must not be kept
+static bool glass_sensitive = false;    // The glass shows such a frame
+static bool panel_after_partial = false;    // Controller needs a full init again
+
+// Packed 1bpp image kept on top of LVGL's output
+static struct {
+    const uint8_t *bits;
+    size_t stride;
+    int x;
+    int y;
+    int width;
+    int height;
+} overlay;
+
+METRICS_COUNTER(m_flushes, "wallet_epd_flushes_total", "LVGL flushes handled");
+METRICS_COUNTER(m_refresh_full, "wallet_epd_refresh_full_total", "Full-quality refreshes");
+METRICS_COUNTER(m_refresh_fast, "wallet_epd_refresh_fast_total", "Fast refreshes");
+METRICS_COUNTER(m_refresh_partial, "wallet_epd_refresh_partial_total", "Partial refreshes");
+METRICS_COUNTER(m_refresh_skipped, "wallet_epd_refresh_skipped_total",
+                "Refreshes skipped because the glass already showed the frame");
+METRICS_GAUGE(m_update_count, "wallet_epd_update_count", "Panel updates since the display was initialized");
+METRICS_HISTOGRAM(m_convert_us, "wallet_epd_convert_microseconds", "Time to convert a flushed area to 1bpp");
+METRICS_HISTOGRAM(m_refresh_us, "wallet_epd_refresh_microseconds", "Time from frame upload to refresh done");
+METRICS_HISTOGRAM(m_busy_us, "wallet_epd_busy_microseconds", "Time spent waiting on the BUSY pin, per wait");
+METRICS_COUNTER(m_busy_timeouts, "wallet_epd_busy_timeouts_total", "BUSY waits that timed out");
+#ifdef RADXA_ZERO_3W
+METRICS_COUNTER(m_spi_bytes, "wallet_epd_spi_bytes_total", "Bytes sent to the panel over SPI");
+METRICS_COUNTER(m_spi_ioctls, "wallet_epd_spi_ioctls_total", "SPI transfer ioctls for the panel");
+METRICS_COUNTER(m_spi_ns, "wallet_epd_spi_nanoseconds_total", "Time spent in SPI transfers for the panel");
+#endif
+
+// Length of the latest BUSY wait, which after a Display call is the refresh
+static uint32_t last_busy_ms = 0;
+
+static void busy_waited(UDOUBLE waited_ms, UBYTE timed_out) {
+    last_busy_ms = waited_ms;
+    metrics_observe(&m_busy_us, (uint64_t)waited_ms * 1000);
+    if (timed_out) {
+        metrics_inc(&m_busy_timeouts);
+    }
+}
+
 /**
  * Convert RGB565 to monochrome (1 bit per pixel)
  */
@@ -68,34 +143,162 @@ static void rgb_to_monochrome(const uint8_t *rgb, uint8_t *mono, size_t width, s
     }
 }
 
-int display_fbdev_init(void) {
-    // Initialize Waveshare driver first
-    printf("Initializing Waveshare e-paper driver...\n");
-    if (DEV_Module_Init() != 0) {
-        fprintf(stderr, "Error: Failed to initialize Waveshare driver\n");
+/**
+ * Copy the overlay into the e-paper buffer, a whole byte at a time
+ */
+static void overlay_blit(uint8_t *mono, size_t mono_stride) {
+    if (!overlay.bits) {
+        return;
+    }
+    size_t col = overlay.x / 8;
+    if (col >= mono_stride) {
+        return;
+    }
+    size_t bytes = overlay.width / 8;
+    if (bytes > mono_stride - col) {
+        bytes = mono_stride - col;
+    }
+    for (int row = 0; row < overlay.height && overlay.y + row < EPD_HEIGHT; row++) {
+        memcpy(mono + (overlay.y + row) * mono_stride + col, overlay.bits + row * overlay.stride, bytes);
+    }
+}
+
+/**
+ * Show the precompiled splash asset instead of a blank clear
+ * The asset is already packed 1bpp, so it is blitted straight into the
+ * e-paper buffer and doubles as the base image for later partial updates.
+ */
+static int show_splash(void) {
+    epd_asset_pack_t *assets = epd_asset_open(NULL);
+    if (!assets) {
         return -1;
     }
     
-    // Initialize e-paper display
-    printf("Initializing e-paper display...\n");
-    EPD_2in13_V4_Init();
-    EPD_2in13_V4_Clear();
-    waveshare_initialized = true;
-    update_count = 0;
+    epd_asset_t splash;
+    int ret = -1;
+    if (epd_asset_find(assets, "splash", &splash) == 0 &&
+        epd_asset_blit_1bpp(&splash, epaper_buffer, (EPD_WIDTH + 7) / 8, EPD_HEIGHT, 0, 0) == 0) {
+        WLOG_INFO("Showing splash asset (%ux%u)", splash.width, splash.height);
+        EPD_2in13_V4_Display_Base(epaper_buffer);
+        panel_wear_record(PANEL_REFRESH_FULL, last_busy_ms, 0, EPD_HEIGHT - 1);
+        ret = 0;
+    }
     
-    // Allocate e-paper buffer (monochrome)
-    // Format: (width + 7) / 8 bytes per row, height rows
-    size_t epaper_buf_size = ((EPD_WIDTH + 7) / 8) * EPD_HEIGHT;
-    epaper_buffer = (uint8_t *)malloc(epaper_buf_size);
-    if (!epaper_buffer) {
-        fprintf(stderr, "Error: Failed to allocate e-paper buffer\n");
-        DEV_Module_Exit();
+    epd_asset_close(assets);
+    return ret;
+}
+
+static const char *frame_cache_path(void) {
+    const char *path = getenv("WALLET_FRAME_CACHE");
+    return path && *path ? path : EPD_FRAME_CACHE_PATH;
+}
+
+/**
+ * Load the retained frame if it matches this panel and its checksum
+ */
+static int frame_load(uint8_t *frame, size_t size) {
+    epd_frame_header_t hdr;
+    int fd = open(frame_cache_path(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    bool ok = read(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              hdr.magic == EPD_FRAME_MAGIC && hdr.width == EPD_WIDTH && hdr.height == EPD_HEIGHT &&
+              read(fd, frame, size) == (ssize_t)size && epd_asset_crc32(frame, size) == hdr.crc32;
+    close(fd);
+    if (!ok) {
+        return -1;
+    }
+    frame_saved = true;
+    frame_saved_crc = hdr.crc32;
+    return 0;
+}
+
+/**
+ * Record what the glass now shows; unchanged frames are not rewritten
+ */
+static void frame_save(const uint8_t *frame, size_t size) {
+    uint32_t crc = epd_asset_crc32(frame, size);
+    if (frame_saved && crc == frame_saved_crc) {
+        return;
+    }
+
+    char tmp[PATH_MAX];
+    const char *path = frame_cache_path();
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    // A leftover temporary file keeps its mode through O_TRUNC
+    if (fd >= 0 && fchmod(fd, 0600) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        return;
+    }
+    epd_frame_header_t hdr = {
+        .magic = EPD_FRAME_MAGIC, .width = EPD_WIDTH, .height = EPD_HEIGHT, .crc32 = crc,
+    };
+    bool ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              write(fd, frame, size) == (ssize_t)size;
+    close(fd);
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return;
+    }
+    frame_saved = true;
+    frame_saved_crc = crc;
+}
+
+/**
+ * Remove the cache once the glass no longer shows it, so a restart does
+ * not take a wrong base image
+ */
+static void frame_forget(void) {
+    if (frame_saved) {
+        unlink(frame_cache_path());
+        frame_saved = false;
+    }
+}
+
+int display_fbdev_panel_init(bool splash) {
+    // Initialize Waveshare driver first
+    WLOG_INFO("Initializing Waveshare e-paper driver...");
+    if (DEV_Module_Init() != 0) {
+        WLOG_ERROR("Failed to initialize Waveshare driver");
         return -1;
     }
     
+    // E-paper buffer (monochrome)
+    // Format: (width + 7) / 8 bytes per row, height rows
+    size_t epaper_buf_size = sizeof(epaper_frame);
+    epaper_buffer = epaper_frame;
+    
     // Clear buffer (white)
     memset(epaper_buffer, 0xFF, epaper_buf_size);
     
+    // Initialize e-paper display. Without the splash the panel is left
+    // as it is: the first full-quality frame drives every pixel anyway.
+    WLOG_INFO("Initializing e-paper display...");
+    EPD_2in13_V4_SetBusyHook(busy_waited);
+    panel_wear_load(EPD_HEIGHT);
+    EPD_2in13_V4_Init();
+    update_count = 0;
+    frame_saved = false;
+    frame_retained = frame_load(epaper_buffer, epaper_buf_size) == 0;
+    if (frame_retained) {
+        // Warm start: the glass still shows this frame, so it becomes the
+        // base image and the first UI frame is a partial update from it
+        WLOG_INFO("Retained frame loaded, skipping the clear");
+        EPD_2in13_V4_Load_Base(epaper_buffer);
+        update_count = 3;
+    } else if (splash && show_splash() < 0) {
+        EPD_2in13_V4_Clear();
+        panel_wear_record(PANEL_REFRESH_FULL, last_busy_ms, 0, EPD_HEIGHT - 1);
+    }
+    waveshare_initialized = true;
+    
     // Optional: Try to open framebuffer for debugging/fallback
     const char *fbdev_path = getenv("LV_LINUX_FBDEV_DEVICE");
     if (!fbdev_path) {
@@ -107,8 +310,8 @@ int display_fbdev_init(void) {
         // Get framebuffer info for debugging
         if (ioctl(fb_fd, FBIOGET_FSCREENINFO, &finfo) == 0 &&
             ioctl(fb_fd, FBIOGET_VSCREENINFO, &vinfo) == 0) {
-            printf("Framebuffer available: %dx%d, %dbpp\n",
-                   vinfo.xres, vinfo.yres, vinfo.bits_per_pixel);
+            WLOG_INFO("Framebuffer available: %ux%u, %ubpp",
+                      vinfo.xres, vinfo.yres, vinfo.bits_per_pixel);
             
             // Memory map the framebuffer (for debugging)
             fb_size = finfo.smem_len;
@@ -122,27 +325,13 @@ int display_fbdev_init(void) {
         }
     }
     
+    return 0;
+}
+
+int display_fbdev_lvgl_init(void) {
     // Initialize LVGL display (v8.x API)
-    // Allocate display buffer
-    size_t buf_size = EPD_WIDTH * EPD_HEIGHT * sizeof(lv_color_t);
-    void *buf1 = malloc(buf_size);
-    if (!buf1) {
-        fprintf(stderr, "Error: Failed to allocate display buffer\n");
-        free(epaper_buffer);
-        if (waveshare_initialized) {
-            DEV_Module_Exit();
-        }
-        if (fb_mem) {
-            munmap(fb_mem, fb_size);
-        }
-        if (fb_fd >= 0) {
-            close(fb_fd);
-        }
-        return -1;
-    }
-    
     // Initialize display buffer
-    lv_disp_draw_buf_init(&disp_buf, buf1, NULL, EPD_WIDTH * EPD_HEIGHT);
+    lv_disp_draw_buf_init(&disp_buf, draw_pixels, NULL, EPD_WIDTH * EPD_HEIGHT);
     
     // Initialize display driver
     lv_disp_drv_init(&disp_drv);
@@ -154,26 +343,32 @@ int display_fbdev_init(void) {
     // Register display driver
     display = lv_disp_drv_register(&disp_drv);
     if (!display) {
-        fprintf(stderr, "Error: Failed to register LVGL display\n");
-        free(buf1);
-        free(epaper_buffer);
-        if (waveshare_initialized) {
-            DEV_Module_Exit();
-        }
-        if (fb_mem) {
-            munmap(fb_mem, fb_size);
-        }
-        if (fb_fd >= 0) {
-            close(fb_fd);
-        }
+        WLOG_ERROR("Failed to register LVGL display");
         return -1;
     }
     
-    printf("Display initialized: %dx%d (Waveshare 2.13\" V4)\n", EPD_WIDTH, EPD_HEIGHT);
+    WLOG_INFO("Display initialized: %dx%d (Waveshare 2.13\" V4)", EPD_WIDTH, EPD_HEIGHT);
+    return 0;
+}
+
+void display_fbdev_refresh(void) {
+    if (display) {
+        lv_refr_now(display);
+    }
+}
+
+int display_fbdev_init(void) {
+    if (display_fbdev_panel_init(true) < 0) {
+        return -1;
+    }
+    if (display_fbdev_lvgl_init() < 0) {
+        display_fbdev_deinit();
+        return -1;
+    }
     
     // Force an initial display refresh to show something
-    printf("Forcing initial display refresh...\n");
-    lv_refr_now(display);
+    WLOG_INFO("Forcing initial display refresh...");
+    display_fbdev_refresh();
     
     return 0;
 }
@@ -186,16 +381,18 @@ void display_fbdev_deinit(void) {
     
     // Put e-paper display to sleep
     if (waveshare_initialized) {
-        printf("Putting e-paper display to sleep...\n");
+        if (!glass_sensitive) {
+            frame_save(epaper_buffer, sizeof(epaper_frame));
+        }
+        WLOG_INFO("Putting e-paper display to sleep...");
         EPD_2in13_V4_Sleep();
+        EPD_2in13_V4_SetBusyHook(NULL);
+        panel_wear_save(true);
         DEV_Module_Exit();
         waveshare_initialized = false;
     }
     
-    if (epaper_buffer) {
-        free(epaper_buffer);
-        epaper_buffer = NULL;
-    }
+    epaper_buffer = NULL;
     
     if (fb_mem != MAP_FAILED && fb_mem != NULL) {
         munmap(fb_mem, fb_size);
@@ -211,9 +408,11 @@ void display_fbdev_deinit(void) {
 void display_fbdev_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p) {
     static int flush_count = 0;
     flush_count++;
+    metrics_inc(&m_flushes);
+    latency_mark(LATENCY_FLUSH, metrics_now_us());
     
     if (!epaper_buffer || !color_p || !area) {
-        printf("WARNING: display_fbdev_flush called with NULL parameters (flush #%d)\n", flush_count);
+        WLOG_WARN("display_fbdev_flush called with NULL parameters (flush #%d)", flush_count);
         lv_disp_flush_ready(disp_drv);
         return;
     }
@@ -222,15 +421,14 @@ void display_fbdev_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_colo
     int32_t width = lv_area_get_width(area);
     int32_t height = lv_area_get_height(area);
     
-    if (flush_count <= 3) {
-        printf("Flush #%d: area (%d,%d) to (%d,%d), size %dx%d\n", 
+    WLOG_DEBUG("Flush #%d: area (%d,%d) to (%d,%d), size %dx%d",
                flush_count, area->x1, area->y1, area->x2, area->y2, width, height);
-    }
     
     // Convert RGB565 to monochrome for the specified area
     // color_p is the buffer from LVGL containing the area to update
     // We need to convert only the area being updated, not the whole screen
     size_t mono_stride = (EPD_WIDTH + 7) / 8;
+    uint64_t convert_start = metrics_now_us();
     
     for (int32_t y = 0; y < height; y++) {
         for (int32_t x = 0; x < width; x++) {
@@ -264,6 +462,9 @@ void display_fbdev_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_colo
         }
     }
     
+    overlay_blit(epaper_buffer, mono_stride);
+    metrics_observe(&m_convert_us, metrics_now_us() - convert_start);
+    
     // Optional: Write to framebuffer for debugging (if available)
     if (fb_mem && fb_fd >= 0) {
         size_t fb_line_size = finfo.line_length;
@@ -282,46 +483,115 @@ void display_fbdev_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_colo
         bool is_full_update = (area->x1 == 0 && area->y1 == 0 && 
                                area->x2 == EPD_WIDTH - 1 && area->y2 == EPD_HEIGHT - 1);
         
-        if (flush_count <= 3) {
-            printf("Updating display: full_update=%d, update_count=%d\n", is_full_update, update_count);
-        }
+        WLOG_DEBUG("Updating display: full_update=%d, update_count=%d", is_full_update, update_count);
         
-        // Always use full quality for first few updates to ensure display works
-        // Use full refresh every 10 updates to prevent ghosting
-        // Use fast mode for partial updates, full mode for complete refreshes
-        if (is_full_update || (update_count % 10 == 0) || update_count < 3) {
-            // Full quality update
-            if (flush_count <= 3) {
-                printf("Using full quality update\n");
+        size_t epaper_buf_size = mono_stride * EPD_HEIGHT;
+        uint64_t refresh_start = metrics_now_us();
+        panel_refresh_t refresh_type;
+        
+        if (frame_retained) {
+            // First frame after a warm start: leave the glass alone if it
+            // already shows it, otherwise change only the pixels that differ
+            frame_retained = false;
+            if (frame_saved && epd_asset_crc32(epaper_buffer, epaper_buf_size) == frame_saved_crc) {
+                WLOG_INFO("Frame matches the retained one, no refresh needed");
+                metrics_inc(&m_refresh_skipped);
+                lv_disp_flush_ready(disp_drv);
+                return;
+            }
+            WLOG_INFO("Partial update from the retained frame");
+            EPD_2in13_V4_Display_Partial(epaper_buffer);
+            metrics_inc(&m_refresh_partial);
+            refresh_type = PANEL_REFRESH_PARTIAL;
+            panel_after_partial = true;
+        } else if (is_full_update || (update_count % 10 == 0) || update_count < 3) {
+            // Always use full quality for first few updates to ensure display works
+            // Use full refresh every 10 updates to prevent ghosting
+            // Use fast mode for partial updates, full mode for complete refreshes
+            if (panel_after_partial) {
+                EPD_2in13_V4_Init();
+                use_fast_mode = false;
+                panel_after_partial = false;
             }
+            // Full quality update
+            WLOG_DEBUG("Using full quality update");
             EPD_2in13_V4_Display(epaper_buffer);
+            metrics_inc(&m_refresh_full);
+            refresh_type = PANEL_REFRESH_FULL;
         } else {
             // Fast partial update
-            if (!use_fast_mode) {
+            if (!use_fast_mode || panel_after_partial) {
+                panel_after_partial = false;
                 EPD_2in13_V4_Init_Fast();
                 use_fast_mode = true;
             }
-            if (flush_count <= 3) {
-                printf("Using fast update\n");
-            }
+            WLOG_DEBUG("Using fast update");
             EPD_2in13_V4_Display_Fast(epaper_buffer);
+            metrics_inc(&m_refresh_fast);
+            refresh_type = PANEL_REFRESH_FAST;
         }
         
+        // Display calls return once BUSY is released; the wait before that
+        // was the refresh, everything earlier the upload
+        uint64_t refresh_done = metrics_now_us();
+        latency_mark(LATENCY_UPLOAD, refresh_done - (uint64_t)last_busy_ms * 1000);
+        latency_mark(LATENCY_PHOTON, refresh_done);
+        panel_wear_record(refresh_type, last_busy_ms, area->y1, area->y2);
+        
         // Wait for display to finish updating
         EPD_2in13_V4_ReadBusy();
+        metrics_observe(&m_refresh_us, metrics_now_us() - refresh_start);
         
-        if (flush_count <= 3) {
-            printf("Display update complete\n");
-        }
+        WLOG_DEBUG("Display update complete");
+#ifdef RADXA_ZERO_3W
+        SPI_STATS spi;
+        DEV_HARDWARE_SPI_GetStats(&spi);
+        metrics_set(&m_spi_bytes, (int64_t)spi.bytes);
+        metrics_set(&m_spi_ioctls, (int64_t)spi.ioctls);
+        metrics_set(&m_spi_ns, (int64_t)spi.ns);
+        WLOG_DEBUG("SPI: %llu bytes in %llu ioctls, %.0f bytes/s",
+                   (unsigned long long)spi.bytes, (unsigned long long)spi.ioctls,
+                   DEV_HARDWARE_SPI_Throughput());
+#endif
         
         update_count++;
+        metrics_set(&m_update_count, update_count);
+        glass_sensitive = screen_sensitive;
+        if (refresh_type == PANEL_REFRESH_FULL && !glass_sensitive) {
+            frame_save(epaper_buffer, epaper_buf_size);
+        } else {
+            frame_forget();
+        }
     } else {
-        printf("WARNING: Waveshare not initialized, cannot update display\n");
+        WLOG_WARN("Waveshare not initialized, cannot update display");
+        // Framebuffer only: the frame is as visible as it is going to get
+        uint64_t now = metrics_now_us();
+        latency_mark(LATENCY_UPLOAD, now);
+        latency_mark(LATENCY_PHOTON, now);
     }
     
     lv_disp_flush_ready(disp_drv);
 }
 
+void display_fbdev_set_sensitive(bool sensitive) {
+    screen_sensitive = sensitive;
+}
+
+void display_fbdev_set_overlay(const uint8_t *bits, size_t stride, int x, int y,
+                               int width, int height) {
+    if (!bits || x < 0 || y < 0 || x % 8 != 0 || width % 8 != 0 || height <= 0 ||
+        stride < (size_t)width / 8) {
+        overlay.bits = NULL;
+        return;
+    }
+    overlay.bits = bits;
+    overlay.stride = stride;
+    overlay.x = x;
+    overlay.y = y;
+    overlay.width = width;
+    overlay.height = height;
+}
+
 uint32_t display_fbdev_get_width(void) {
     return EPD_WIDTH;
 }
@@ -0,0 +1,80 @@
+#include "epd_theme.h"
+#include <stdbool.h>
+
+static struct {
+    lv_theme_t theme;
+    lv_style_t screen;
+    lv_style_t card;        // Plain objects
+    lv_style_t btn;
+    lv_style_t inverted;    // Focused or pressed
+    bool inited;
+} epd;
+
+static void style_init(lv_style_t *style) {
+    if (epd.inited) {
+        lv_style_reset(style);
+    }
+    lv_style_init(style);
+}
+
+static void styles_init(const lv_font_t *font) {
+    style_init(&epd.screen);
+    lv_style_set_bg_color(&epd.screen, lv_color_white());
+    lv_style_set_bg_opa(&epd.screen, LV_OPA_COVER);
+    lv_style_set_text_color(&epd.screen, lv_color_black());
+    lv_style_set_text_font(&epd.screen, font);
+
+    style_init(&epd.card);
+    lv_style_set_bg_color(&epd.card, lv_color_white());
+    lv_style_set_bg_opa(&epd.card, LV_OPA_COVER);
+    lv_style_set_border_color(&epd.card, lv_color_black());
+    lv_style_set_border_width(&epd.card, 1);
+    lv_style_set_radius(&epd.card, 0);
+    lv_style_set_pad_hor(&epd.card, EPD_THEME_PAD_HOR);
+    lv_style_set_pad_ver(&epd.card, EPD_THEME_PAD_VER);
+
+    style_init(&epd.btn);
+    lv_style_set_bg_color(&epd.btn, lv_color_white());
+    lv_style_set_bg_opa(&epd.btn, LV_OPA_COVER);
+    lv_style_set_border_color(&epd.btn, lv_color_black());
+    lv_style_set_border_width(&epd.btn, 1);
+    lv_style_set_radius(&epd.btn, 0);
+    lv_style_set_text_color(&epd.btn, lv_color_black());
+    lv_style_set_pad_hor(&epd.btn, EPD_THEME_PAD_HOR);
+    lv_style_set_pad_ver(&epd.btn, EPD_THEME_PAD_VER);
+
+    // An outline would need a margin the panel cannot spare, and a
+    // shaded fill thresholds to noise; a full inversion is unmistakable
+    style_init(&epd.inverted);
+    lv_style_set_bg_color(&epd.inverted, lv_color_black());
+    lv_style_set_text_color(&epd.inverted, lv_color_white());
+    lv_style_set_outline_width(&epd.inverted, 0);
+}
+
+static void apply_cb(lv_theme_t *theme, lv_obj_t *obj) {
+    (void)theme;
+    if (lv_obj_get_parent(obj) == NULL) {
+        lv_obj_add_style(obj, &epd.screen, 0);
+    } else if (lv_obj_check_type(obj, &lv_btn_class)) {
+        lv_obj_add_style(obj, &epd.btn, 0);
+        lv_obj_add_style(obj, &epd.inverted, LV_STATE_FOCUSED);
+        lv_obj_add_style(obj, &epd.inverted, LV_STATE_PRESSED);
+    } else if (lv_obj_check_type(obj, &lv_obj_class)) {
+        lv_obj_add_style(obj, &epd.card, 0);
+    }
+}
+
+lv_theme_t *epd_theme_init(lv_disp_t *disp, const lv_font_t *font) {
+    styles_init(font);
+    epd.theme = (lv_theme_t){
+        .apply_cb = apply_cb,
+        .disp = disp,
+        .color_primary = lv_color_black(),
+        .color_secondary = lv_color_white(),
+        .font_small = font,
+        .font_normal = font,
+        .font_large = font,
+    };
+    epd.inited = true;
+    return &epd.theme;
+}
@@ -0,0 +1,80 @@
+#define WLOG_MODULE latency
+#include "input_latency.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
+#include <stdbool.h>
+#include <string.h>
+
+METRICS_HISTOGRAM(m_total_us, "wallet_input_latency_microseconds", "Button edge to refresh done");
+METRICS_HISTOGRAM(m_queue_us, "wallet_input_queue_microseconds", "Button edge to LVGL reading the key");
+METRICS_HISTOGRAM(m_handle_us, "wallet_input_handle_microseconds", "LVGL handling the key");
+METRICS_HISTOGRAM(m_render_us, "wallet_input_render_microseconds", "Key handled to frame rendered");
+METRICS_HISTOGRAM(m_upload_us, "wallet_input_upload_microseconds", "Frame rendered to frame on the panel");
+METRICS_HISTOGRAM(m_refresh_us, "wallet_input_refresh_microseconds", "Panel refresh until BUSY released");
+METRICS_COUNTER(m_coalesced, "wallet_input_coalesced_total", "Presses folded into one already in flight");
+METRICS_COUNTER(m_no_redraw, "wallet_input_no_redraw_total", "Presses that changed nothing on screen");
+
+// Histogram for the step that ends at each stage
+static metric_t *const latency_step_metrics[LATENCY_STAGE_COUNT] = {
+    [LATENCY_EVENT] = &m_queue_us,
+    [LATENCY_INVALIDATE] = &m_handle_us,
+    [LATENCY_FLUSH] = &m_render_us,
+    [LATENCY_UPLOAD] = &m_upload_us,
+    [LATENCY_PHOTON] = &m_refresh_us,
+};
+
+static struct {
+    bool active;
+    uint32_t key;
+    uint64_t stamps[LATENCY_STAGE_COUNT];      // 0 until reached
+} lat;
+
+void latency_input(uint32_t key, uint64_t edge_us) {
+    if (lat.active) {
+        metrics_inc(&m_coalesced);
+        return;
+    }
+    memset(lat.stamps, 0, sizeof(lat.stamps));
+    lat.active = true;
+    lat.key = key;
+    lat.stamps[LATENCY_EDGE] = edge_us;
+}
+
+void latency_mark(latency_stage_t stage, uint64_t t_us) {
+    if (!lat.active || stage <= LATENCY_EDGE || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    if (stage >= LATENCY_UPLOAD || !lat.stamps[stage]) {
+        lat.stamps[stage] = t_us;
+    }
+}
+
+void latency_end(void) {
+    if (!lat.active) {
+        return;
+    }
+    lat.active = false;
+    if (!lat.stamps[LATENCY_PHOTON]) {
+        metrics_inc(&m_no_redraw);
+        return;
+    }
+
+    // A stage that was not seen (e.g. no BUSY wait on a simulator
+    // backend) takes the time of the one before it
+    uint64_t steps[LATENCY_STAGE_COUNT] = { 0 };
+    uint64_t prev = lat.stamps[LATENCY_EDGE];
+    for (int i = LATENCY_EVENT; i < LATENCY_STAGE_COUNT; i++) {
+        uint64_t t = lat.stamps[i] > prev ? lat.stamps[i] : prev;
+        steps[i] = t - prev;
+        metrics_observe(latency_step_metrics[i], steps[i]);
+        prev = t;
+    }
+    uint64_t total = prev - lat.stamps[LATENCY_EDGE];
+    metrics_observe(&m_total_us, total);
+
+    WLOG_DEBUG("key %u: %llu us (queue %llu, handle %llu, render %llu, upload %llu, refresh %llu)",
+               lat.key, (unsigned long long)total,
+               (unsigned long long)steps[LATENCY_EVENT], (unsigned long long)steps[LATENCY_INVALIDATE],
+               (unsigned long long)steps[LATENCY_FLUSH], (unsigned long long)steps[LATENCY_UPLOAD],
+               (unsigned long long)steps[LATENCY_PHOTON]);
+}
@@ -0,0 +1,377 @@
+#define WLOG_MODULE keypad
+#include "keypad.h"
+#include "gpio_driver.h"
+#include "gpio_config.h"
+#include "input_latency.h"
+#include "wallet_log.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#define KEYPAD_BUTTON_COUNT 3
+#define KEYPAD_QUEUE_SIZE 32            // Power of two
+
+typedef struct {
+    int gpio;
+    uint32_t key;           // Sent on press (or on release for a long-press button)
+    uint32_t long_key;      // Sent once held; 0 to repeat `key` instead
+    int fd;
+    bool down;              // Debounced state
+    uint64_t settle_us;     // End of the bounce window, 0 if none open
+    uint64_t hold_us;       // Next long-press/repeat deadline, 0 if none
+    bool long_sent;
+} keypad_button_state_t;
+
+typedef struct {
+    uint32_t key;
+    lv_indev_state_t state;
+    uint64_t edge_us;       // When the edge (or hold deadline) behind it was seen
+} keypad_event_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    bool running;
+    int efd;                // Key events are queued
+    int stop_fd;            // Wakes the event thread to exit
+    keypad_button_state_t buttons[KEYPAD_BUTTON_COUNT];
+    keypad_event_t queue[KEYPAD_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    keypad_event_t last;    // What LVGL saw most recently
+    uint32_t dropped;
+    lv_indev_drv_t indev_drv;
+    lv_indev_t *indev;
+    lv_group_t *group;
+} kp = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .efd = -1,
+    .stop_fd = -1,
+    .buttons = {
+        { .gpio = WALLET_BTN_UP_PIN,   .key = LV_KEY_PREV,  .fd = -1 },
+        { .gpio = WALLET_BTN_DOWN_PIN, .key = LV_KEY_NEXT,  .fd = -1 },
+        { .gpio = WALLET_BTN_OK_PIN,   .key = LV_KEY_ENTER, .long_key = LV_KEY_ESC, .fd = -1 },
+    },
+};
+
+static uint64_t keypad_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Queue a key event and wake the main loop
+ */
+static void keypad_push(uint32_t key, lv_indev_state_t state, uint64_t edge_us) {
+    pthread_mutex_lock(&kp.lock);
+    if (kp.head - kp.tail < KEYPAD_QUEUE_SIZE) {
+        kp.queue[kp.head++ % KEYPAD_QUEUE_SIZE] = (keypad_event_t){
+            .key = key, .state = state, .edge_us = edge_us,
+        };
+    } else {
+        kp.dropped++;
+    }
+    pthread_mutex_unlock(&kp.lock);
+
+    uint64_t one = 1;
+    if (write(kp.efd, &one, sizeof(one)) < 0) {
+        // Counter saturated: the main loop is already due to wake
+    }
+}
+
+static void keypad_click(uint32_t key, uint64_t edge_us) {
+    keypad_push(key, LV_INDEV_STATE_PRESSED, edge_us);
+    keypad_push(key, LV_INDEV_STATE_RELEASED, edge_us);
+}
+
+static int keypad_level(const keypad_button_state_t *b) {
+    int v = gpio_read_fd(b->fd);
+    if (v < 0) {
+        return -1;
+    }
+    return WALLET_BTN_ACTIVE_LOW ? !v : v;
+}
+
+/**
+ * Apply a debounced press or release
+ */
+static void keypad_change(keypad_button_state_t *b, bool down, uint64_t now) {
+    b->down = down;
+    b->settle_us = now + KEYPAD_DEBOUNCE_MS * 1000;
+    if (down) {
+        b->long_sent = false;
+        b->hold_us = now + KEYPAD_LONG_PRESS_MS * 1000;
+        if (!b->long_key) {
+            keypad_push(b->key, LV_INDEV_STATE_PRESSED, now);
+        }
+        return;
+    }
+    b->hold_us = 0;
+    if (!b->long_key) {
+        keypad_push(b->key, LV_INDEV_STATE_RELEASED, now);
+    } else if (!b->long_sent) {
+        // Short press: only now is it known not to be a long one
+        keypad_click(b->key, now);
+    }
+}
+
+/**
+ * Handle an edge, or the end of a bounce window
+ */
+static void keypad_sample(keypad_button_state_t *b, uint64_t now) {
+    // Always read: that is what clears the pending edge on the fd
+    int level = keypad_level(b);
+    if (b->settle_us && now < b->settle_us) {
+        return;     // Still bouncing; the level is re-read when the window ends
+    }
+    b->settle_us = 0;
+    if (level >= 0 && (bool)level != b->down) {
+        keypad_change(b, level, now);
+    }
+}
+
+/**
+ * Long press and repeat, generated here rather than by LVGL so they do
+ * not depend on how often the indev is read
+ */
+static void keypad_hold(keypad_button_state_t *b, uint64_t now) {
+    if (!b->hold_us || now < b->hold_us) {
+        return;
+    }
+    if (b->long_key) {
+        keypad_click(b->long_key, now);
+        b->long_sent = true;
+        b->hold_us = 0;
+        return;
+    }
+    keypad_push(b->key, LV_INDEV_STATE_RELEASED, now);
+    keypad_push(b->key, LV_INDEV_STATE_PRESSED, now);
+    b->hold_us = now + KEYPAD_REPEAT_MS * 1000;
+}
+
+static void *keypad_thread(void *arg) {
+    (void)arg;
+    struct pollfd pfds[KEYPAD_BUTTON_COUNT + 1];
+
+    for (int i = 0; i < KEYPAD_BUTTON_COUNT; i++) {
+        pfds[i] = (struct pollfd){ .fd = kp.buttons[i].fd, .events = POLLPRI | POLLERR };
+    }
+    pfds[KEYPAD_BUTTON_COUNT] = (struct pollfd){ .fd = kp.stop_fd, .events = POLLIN };
+
+    for (;;) {
+        // Sleep until an edge or the nearest debounce/hold deadline
+        uint64_t now = keypad_clock_us();
+        uint64_t next = 0;
+        for (int i = 0; i < KEYPAD_BUTTON_COUNT; i++) {
+            const keypad_button_state_t *b = &kp.buttons[i];
+            if (b->settle_us && (!next || b->settle_us < next)) {
+                next = b->settle_us;
+            }
+            if (b->hold_us && (!next || b->hold_us < next)) {
+                next = b->hold_us;
+            }
+        }
+        int timeout = -1;
+        if (next) {
+            timeout = next > now ? (int)((next - now + 999) / 1000) : 0;
+        }
+
+        int n = poll(pfds, KEYPAD_BUTTON_COUNT + 1, timeout);
+        if (n < 0) {
+            continue;
+        }
+        if (pfds[KEYPAD_BUTTON_COUNT].revents) {
+            break;
+        }
+
+        now = keypad_clock_us();
+        for (int i = 0; i < KEYPAD_BUTTON_COUNT; i++) {
+            keypad_button_state_t *b = &kp.buttons[i];
+            if (pfds[i].revents || (b->settle_us && now >= b->settle_us)) {
+                keypad_sample(b, now);
+            }
+            keypad_hold(b, now);
+        }
+    }
+    return NULL;
+}
+
+static void keypad_close_buttons(void) {
+    for (int i = 0; i < KEYPAD_BUTTON_COUNT; i++) {
+        keypad_button_state_t *b = &kp.buttons[i];
+        if (b->fd >= 0) {
+            close(b->fd);
+            b->fd = -1;
+            gpio_deinit_button(b->gpio);
+        }
+    }
+}
+
+int keypad_start(void) {
+    if (kp.running) {
+        return 0;
+    }
+
+    for (int i = 0; i < KEYPAD_BUTTON_COUNT; i++) {
+        keypad_button_state_t *b = &kp.buttons[i];
+        if (gpio_init_button(b->gpio) < 0) {
+            WLOG_ERROR("Failed to set up button GPIO %d", b->gpio);
+            keypad_close_buttons();
+            return -1;
+        }
+        b->fd = gpio_open_value(b->gpio, "both");
+        if (b->fd < 0) {
+            WLOG_ERROR("Failed to open button GPIO %d", b->gpio);
+            gpio_deinit_button(b->gpio);
+            keypad_close_buttons();
+            return -1;
+        }
+        b->down = keypad_level(b) == 1;
+        b->settle_us = 0;
+        b->hold_us = 0;
+        b->long_sent = b->down;     // Held since before start: not a press
+    }
+
+    kp.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    kp.stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (kp.efd < 0 || kp.stop_fd < 0) {
+        goto fail;
+    }
+    kp.head = kp.tail = 0;
+    kp.last = (keypad_event_t){ .key = LV_KEY_ENTER, .state = LV_INDEV_STATE_RELEASED };
+
+    if (pthread_create(&kp.thread, NULL, keypad_thread, NULL) != 0) {
+        goto fail;
+    }
+    kp.running = true;
+    return 0;
+
+fail:
+    if (kp.efd >= 0) {
+        close(kp.efd);
+        kp.efd = -1;
+    }
+    if (kp.stop_fd >= 0) {
+        close(kp.stop_fd);
+        kp.stop_fd = -1;
+    }
+    keypad_close_buttons();
+    return -1;
+}
+
+void keypad_stop(void) {
+    if (!kp.running) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(kp.stop_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(kp.thread, NULL);
+    }
+    kp.running = false;
+    close(kp.stop_fd);
+    kp.stop_fd = -1;
+    close(kp.efd);
+    kp.efd = -1;
+    keypad_close_buttons();
+    if (kp.dropped) {
+        WLOG_WARN("%u key events dropped", kp.dropped);
+    }
+}
+
+/**
+ * LVGL read callback: one queued event per call, asking for another read
+ * while more are waiting so a whole burst is handled in one dispatch
+ */
+static void keypad_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+    (void)drv;
+    bool pressed = false;
+    pthread_mutex_lock(&kp.lock);
+    if (kp.head != kp.tail) {
+        kp.last = kp.queue[kp.tail++ % KEYPAD_QUEUE_SIZE];
+        pressed = kp.last.state == LV_INDEV_STATE_PRESSED;
+    }
+    data->key = kp.last.key;
+    data->state = kp.last.state;
+    data->continue_reading = kp.head != kp.tail;
+    pthread_mutex_unlock(&kp.lock);
+
+    if (pressed) {
+        latency_input(kp.last.key, kp.last.edge_us);
+        latency_mark(LATENCY_EVENT, keypad_clock_us());
+    }
+}
+
+int keypad_lvgl_init(void) {
+    kp.group = lv_group_create();
+    if (!kp.group) {
+        return -1;
+    }
+    lv_group_set_default(kp.group);
+
+    lv_indev_drv_init(&kp.indev_drv);
+    kp.indev_drv.type = LV_INDEV_TYPE_KEYPAD;
+    kp.indev_drv.read_cb = keypad_read;
+    // Long press and repeat come from the event thread
+    kp.indev_drv.long_press_time = UINT16_MAX;
+    kp.indev_drv.long_press_repeat_time = UINT16_MAX;
+    kp.indev = lv_indev_drv_register(&kp.indev_drv);
+    if (!kp.indev) {
+        lv_group_set_default(NULL);
+        lv_group_del(kp.group);
+        kp.group = NULL;
+        return -1;
+    }
+    lv_indev_set_group(kp.indev, kp.group);
+
+    // Read only when keypad_dispatch() says there is something to read
+    lv_timer_pause(kp.indev_drv.read_timer);
+    return 0;
+}
+
+void keypad_lvgl_deinit(void) {
+    if (kp.indev) {
+        lv_indev_delete(kp.indev);
+        kp.indev = NULL;
+    }
+    if (kp.group) {
+        lv_group_set_default(NULL);
+        lv_group_del(kp.group);
+        kp.group = NULL;
+    }
+}
+
+int keypad_fd(void) {
+    return kp.efd;
+}
+
+void keypad_dispatch(void) {
+    uint64_t count;
+    if (kp.efd < 0 || read(kp.efd, &count, sizeof(count)) != sizeof(count)) {
+        return;
+    }
+    if (kp.indev) {
+        lv_indev_read_timer_cb(kp.indev_drv.read_timer);
+        lv_disp_t *disp = lv_disp_get_default();
+        if (disp && disp->inv_p) {
+            latency_mark(LATENCY_INVALIDATE, keypad_clock_us());
+        }
+        // Draw the focus change now rather than on the next refresh period
+        lv_refr_now(NULL);
+        latency_end();
+    }
+}
+
+lv_group_t *keypad_get_group(void) {
+    return kp.group;
+}
+
+void keypad_set_group(lv_group_t *group) {
+    if (kp.indev) {
+        lv_indev_set_group(kp.indev, group ? group : kp.group);
+    }
+}
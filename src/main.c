@@ -1,20 +1,81 @@
-#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <poll.h>
+#include <time.h>
 #include <lvgl.h>
 #include "display_fbdev.h"
 #include "wallet_ui.h"
+#include "ui_mem.h"
+#include "tx_history.h"
 #include "device_binding.h"
 #include "tropic_auth.h"
+#include "auth_service.h"
+#include "keypad.h"
+#include "boot.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
 
 static volatile bool running = true;
+static device_binding_t binding;
 
 static void signal_handler(int sig) {
     (void)sig;
     running = false;
 }
 
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Delay before checking the device identity again after a failure,
+// doubled on each failure up to the maximum
+#define IDENTITY_RETRY_MIN_MS 1000
+#define IDENTITY_RETRY_MAX_MS 60000
+
+static uint32_t identity_retry_ms = IDENTITY_RETRY_MIN_MS;
+
+static void identity_checked(const auth_completion_t *done);
+
+// Served before anything else: until it succeeds, the binding refuses
+// to sign or hand out service tokens
+static int identity_check(void) {
+    return auth_service_verify_identity(AUTH_PRIORITY_CONFIRM, &binding, identity_checked, NULL) < 0 ? -1 : 0;
+}
+
+static void identity_retry(lv_timer_t *timer);
+
+static void identity_check_later(void) {
+    WLOG_WARN("Could not check device identity against Tropic01, retrying in %u ms",
+              (unsigned)identity_retry_ms);
+    lv_timer_t *timer = lv_timer_create(identity_retry, identity_retry_ms, NULL);
+    if (timer) {
+        lv_timer_set_repeat_count(timer, 1);
+    }
+    identity_retry_ms = identity_retry_ms * 2 < IDENTITY_RETRY_MAX_MS ? identity_retry_ms * 2
+                                                                      : IDENTITY_RETRY_MAX_MS;
+}
+
+static void identity_retry(lv_timer_t *timer) {
+    (void)timer;
+    if (identity_check() < 0) {
+        identity_check_later();
+    }
+}
+
+static void identity_checked(const auth_completion_t *done) {
+    if (done->status < 0) {
+        identity_check_later();
+        return;
+    }
+    identity_retry_ms = IDENTITY_RETRY_MIN_MS;
+    if (done->status > 0) {
+        WLOG_INFO("Device identity refreshed from Tropic01");
+    }
+}
+
 static int tick_thread(void *data) {
     (void)data;
     while (running) {
@@ -24,46 +85,213 @@ static int tick_thread(void *data) {
     return 0;
 }
 
+/*
+ * Boot stages. The secure element and the panel come up on their own
+ * threads while LVGL and the UI are built here; the first frame goes out
+ * once both the UI and the panel are ready.
+ */
+enum {
+    STAGE_METRICS,
+    STAGE_TROPIC,
+    STAGE_BINDING,
+    STAGE_AUTH_SERVICE,
+    STAGE_HISTORY,
+    STAGE_LVGL,
+    STAGE_KEYPAD,
+    STAGE_KEYPAD_LVGL,
+    STAGE_PANEL,
+    STAGE_DISPLAY,
+    STAGE_UI,
+    STAGE_FIRST_FRAME,
+    STAGE_IDENTITY,
+    STAGE_COUNT
+};
+
+// Comes up first and goes down last so the whole run is observable.
+// The wallet works without it, so a failure here does not stop boot.
+static int boot_metrics(void *ctx) {
+    (void)ctx;
+    metrics_start();
+    return 0;
+}
+
+static void undo_metrics(void *ctx) {
+    (void)ctx;
+    metrics_stop();
+}
+
+static int boot_tropic(void *ctx) {
+    (void)ctx;
+    return tropic_auth_init();
+}
+
+static void undo_tropic(void *ctx) {
+    (void)ctx;
+    tropic_auth_deinit();
+}
+
+static int boot_binding(void *ctx) {
+    (void)ctx;
+    return device_binding_init(&binding);
+}
+
+static void undo_binding(void *ctx) {
+    (void)ctx;
+    device_binding_deinit(&binding);
+}
+
+// Secure element requests from here on go through the service thread
+static int boot_auth_service(void *ctx) {
+    (void)ctx;
+    return auth_service_start();
+}
+
+static void undo_auth_service(void *ctx) {
+    (void)ctx;
+    auth_service_stop();
+}
+
+// Only maps the files; without a history the wallet still works, and
+// the history screen is empty
+static int boot_history(void *ctx) {
+    (void)ctx;
+    if (tx_history_open(NULL) < 0) {
+        WLOG_WARN("Transaction history unavailable");
+    }
+    return 0;
+}
+
+static void undo_history(void *ctx) {
+    (void)ctx;
+    tx_history_close();
+}
+
+static int boot_lvgl(void *ctx) {
+    (void)ctx;
+    lv_init();
+    ui_mem_start();
+    return 0;
+}
+
+// Without buttons the wallet still shows its balance and can be shut
+// down cleanly, so a failure is reported on screen instead of stopping boot
+static bool keypad_failed = false;
+
+static int boot_keypad(void *ctx) {
+    (void)ctx;
+    if (keypad_start() < 0) {
+        WLOG_ERROR("Buttons unavailable, continuing without them");
+        keypad_failed = true;
+    }
+    return 0;
+}
+
+static void undo_keypad(void *ctx) {
+    (void)ctx;
+    keypad_stop();
+}
+
+// Before the UI, so its widgets land in the keypad's group
+static int boot_keypad_lvgl(void *ctx) {
+    (void)ctx;
+    return keypad_lvgl_init();
+}
+
+static void undo_keypad_lvgl(void *ctx) {
+    (void)ctx;
+    keypad_lvgl_deinit();
+}
+
+// No splash: the UI is ready long before a splash refresh would finish
+static int boot_panel(void *ctx) {
+    (void)ctx;
+    return display_fbdev_panel_init(false);
+}
+
+static int boot_display(void *ctx) {
+    (void)ctx;
+    return display_fbdev_lvgl_init();
+}
+
+static void undo_display(void *ctx) {
+    (void)ctx;
+    display_fbdev_deinit();
+}
+
+static int boot_ui(void *ctx) {
+    (void)ctx;
+    if (wallet_ui_init() < 0) {
+        return -1;
+    }
+    int64_t balance = tx_history_balance();
+    wallet_ui_update_balance(balance > 0 ? (uint64_t)balance : 0);
+    if (keypad_failed) {
+        wallet_ui_show_status("Error: buttons not working");
+    }
+    return 0;
+}
+
+static void undo_ui(void *ctx) {
+    (void)ctx;
+    wallet_ui_deinit();
+}
+
+// The UI was built without a panel to flush to; draw all of it now
+static int boot_first_frame(void *ctx) {
+    (void)ctx;
+    lv_obj_invalidate(lv_scr_act());
+    display_fbdev_refresh();
+    return 0;
+}
+
+// The identity came from the cache; confirm it now that the UI is up
+static int boot_identity(void *ctx) {
+    (void)ctx;
+    return identity_check();
+}
+
+static const boot_stage_t boot_stages[STAGE_COUNT] = {
+    [STAGE_METRICS]      = { "metrics",      boot_metrics,      undo_metrics,      0, false },
+    [STAGE_TROPIC]       = { "tropic",       boot_tropic,       undo_tropic,       0, false },
+    [STAGE_BINDING]      = { "binding",      boot_binding,      undo_binding,
+                             BOOT_AFTER(STAGE_TROPIC), false },
+    [STAGE_AUTH_SERVICE] = { "auth_service", boot_auth_service, undo_auth_service,
+                             BOOT_AFTER(STAGE_BINDING), false },
+    [STAGE_HISTORY]      = { "history",      boot_history,      undo_history,      0, false },
+    [STAGE_LVGL]         = { "lvgl",         boot_lvgl,         NULL,              0, true },
+    [STAGE_KEYPAD]       = { "keypad",       boot_keypad,       undo_keypad,       0, false },
+    [STAGE_KEYPAD_LVGL]  = { "keypad_lvgl",  boot_keypad_lvgl,  undo_keypad_lvgl,
+                             BOOT_AFTER(STAGE_LVGL), true },
+    [STAGE_PANEL]        = { "panel",        boot_panel,        undo_display,      0, false },
+    [STAGE_DISPLAY]      = { "display",      boot_display,      undo_display,
+                             BOOT_AFTER(STAGE_LVGL), true },
+    [STAGE_UI]           = { "ui",           boot_ui,           undo_ui,
+                             BOOT_AFTER(STAGE_DISPLAY) | BOOT_AFTER(STAGE_KEYPAD) |
+                             BOOT_AFTER(STAGE_KEYPAD_LVGL) | BOOT_AFTER(STAGE_HISTORY), true },
+    [STAGE_FIRST_FRAME]  = { "first_frame",  boot_first_frame,  NULL,
+                             BOOT_AFTER(STAGE_UI) | BOOT_AFTER(STAGE_PANEL), true },
+    [STAGE_IDENTITY]     = { "identity",     boot_identity,     NULL,
+                             BOOT_AFTER(STAGE_FIRST_FRAME) | BOOT_AFTER(STAGE_AUTH_SERVICE), true },
+};
+
 int main(int argc, char *argv[]) {
     (void)argc;
     (void)argv;
     
-    printf("Monero Hardware Wallet - Starting...\n");
+    WLOG_INFO("Monero Hardware Wallet - Starting...");
     
     // Setup signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
-    // Initialize Tropic01 authentication
-    if (tropic_auth_init() < 0) {
-        fprintf(stderr, "Failed to initialize Tropic01 authentication\n");
-        return 1;
-    }
-    
-    // Initialize device binding
-    device_binding_t binding;
-    if (device_binding_init(&binding) < 0) {
-        fprintf(stderr, "Failed to initialize device binding\n");
-        tropic_auth_deinit();
-        return 1;
-    }
-    
-    // Initialize LVGL
-    lv_init();
-    
-    // Initialize display
-    if (display_fbdev_init() < 0) {
-        fprintf(stderr, "Failed to initialize display\n");
-        device_binding_init(&binding); // Cleanup
-        tropic_auth_deinit();
-        return 1;
-    }
-    
-    // Initialize wallet UI
-    if (wallet_ui_init() < 0) {
-        fprintf(stderr, "Failed to initialize wallet UI\n");
-        display_fbdev_deinit();
-        tropic_auth_deinit();
+    // Bring everything up, in parallel where the dependencies allow
+    boot_report_t boot;
+    int boot_ret = boot_run(boot_stages, STAGE_COUNT, NULL, &boot);
+    boot_report_write(boot_stages, &boot);
+    if (boot_ret < 0) {
+        WLOG_ERROR("Failed to start the wallet");
+        boot_shutdown(boot_stages, &boot, NULL);
+        wlog_shutdown();
         return 1;
     }
     
@@ -71,23 +299,39 @@ int main(int argc, char *argv[]) {
     // For now, we'll handle ticks in the main loop
     // TODO: Implement proper threading with pthread or similar
     
-    printf("Wallet initialized. Entering main loop...\n");
+    WLOG_INFO("Wallet initialized. Entering main loop...");
     
     // Main loop
+    // Sleep on the auth service's and the keypad's eventfds so a secure
+    // element result or a button press is handed to the UI as soon as it
+    // arrives, not on the next tick, and advance LVGL by the time that
+    // actually passed
+    struct pollfd pfds[] = {
+        { .fd = auth_service_fd(), .events = POLLIN },
+        { .fd = keypad_fd(), .events = POLLIN },
+    };
+    uint64_t last_ms = monotonic_ms();
     while (running) {
-        lv_tick_inc(5);
+        uint64_t now_ms = monotonic_ms();
+        lv_tick_inc((uint32_t)(now_ms - last_ms));
+        last_ms = now_ms;
         lv_timer_handler();
-        usleep(5000);
+        if (poll(pfds, 2, 5) > 0) {
+            if (pfds[1].revents & POLLIN) {
+                keypad_dispatch();
+            }
+            if (pfds[0].revents & POLLIN) {
+                auth_service_dispatch();
+            }
+        }
     }
     
-    printf("Shutting down...\n");
+    WLOG_INFO("Shutting down...");
     
-    // Cleanup
-    wallet_ui_deinit();
-    display_fbdev_deinit();
-    tropic_auth_deinit();
+    // Cleanup, in reverse boot order
+    boot_shutdown(boot_stages, &boot, NULL);
     
-    printf("Goodbye!\n");
+    WLOG_INFO("Goodbye!");
+    wlog_shutdown();
     return 0;
 }
-
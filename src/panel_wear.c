@@ -0,0 +1,195 @@
+#define WLOG_MODULE display
+#include "panel_wear.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
+#include "epd_asset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+
+#define PANEL_WEAR_MAGIC 0x52574550U    // "PEWR"
+#define PANEL_WEAR_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t regions;
+    uint32_t crc32;     // CRC-32 of the panel_wear_t that follows
+} panel_wear_header_t;
+
+#define PANEL_WEAR_TYPE_METRIC(family, kind, text) \
+    { .name = family "{type=\"" kind "\"}", .help = text, .type = METRICS_TYPE_COUNTER }
+#define PANEL_WEAR_TYPE_METRICS(family, text) {                                   \
+    [PANEL_REFRESH_FULL] = PANEL_WEAR_TYPE_METRIC(family, "full", text),          \
+    [PANEL_REFRESH_FAST] = PANEL_WEAR_TYPE_METRIC(family, "fast", text),          \
+    [PANEL_REFRESH_PARTIAL] = PANEL_WEAR_TYPE_METRIC(family, "partial", text),    \
+}
+#define PANEL_WEAR_BAND_METRIC(n) {                                               \
+    .name = "wallet_panel_region_updates_total{band=\"" #n "\"}",                 \
+    .help = "Lifetime non-full refreshes that changed each band of the panel, top first", \
+    .type = METRICS_TYPE_COUNTER,                                                 \
+}
+
+_Static_assert(PANEL_WEAR_REGIONS == 10, "update the band metrics below");
+
+static metric_t m_refreshes[PANEL_REFRESH_TYPES] =
+    PANEL_WEAR_TYPE_METRICS("wallet_panel_refreshes_total", "Lifetime refreshes by type");
+static metric_t m_busy_ms[PANEL_REFRESH_TYPES] =
+    PANEL_WEAR_TYPE_METRICS("wallet_panel_busy_milliseconds_total", "Lifetime BUSY time by refresh type");
+static metric_t m_energy_mj[PANEL_REFRESH_TYPES] =
+    PANEL_WEAR_TYPE_METRICS("wallet_panel_energy_millijoules_total",
+                            "Estimated lifetime refresh energy by refresh type");
+static metric_t m_regions[PANEL_WEAR_REGIONS] = {
+    PANEL_WEAR_BAND_METRIC(0), PANEL_WEAR_BAND_METRIC(1), PANEL_WEAR_BAND_METRIC(2),
+    PANEL_WEAR_BAND_METRIC(3), PANEL_WEAR_BAND_METRIC(4), PANEL_WEAR_BAND_METRIC(5),
+    PANEL_WEAR_BAND_METRIC(6), PANEL_WEAR_BAND_METRIC(7), PANEL_WEAR_BAND_METRIC(8),
+    PANEL_WEAR_BAND_METRIC(9),
+};
+
+static struct {
+    panel_wear_t counters;
+    int height;
+    bool registered;
+    bool dirty;
+    time_t saved_at;
+} wear;
+
+static const char *panel_wear_path(void) {
+    const char *path = getenv("WALLET_PANEL_WEAR");
+    return path && *path ? path : PANEL_WEAR_PATH;
+}
+
+static void panel_wear_publish(void) {
+    const panel_wear_t *w = &wear.counters;
+    for (int t = 0; t < PANEL_REFRESH_TYPES; t++) {
+        metrics_set(&m_refreshes[t], (int64_t)w->refreshes[t]);
+        metrics_set(&m_busy_ms[t], (int64_t)w->busy_ms[t]);
+        metrics_set(&m_energy_mj[t], (int64_t)panel_wear_energy_mj(w, t));
+    }
+    for (int i = 0; i < PANEL_WEAR_REGIONS; i++) {
+        metrics_set(&m_regions[i], (int64_t)w->region_updates[i]);
+    }
+}
+
+void panel_wear_load(int height) {
+    wear.height = height > 0 ? height : 1;
+    wear.dirty = false;
+    wear.saved_at = time(NULL);
+    memset(&wear.counters, 0, sizeof(wear.counters));
+
+    int fd = open(panel_wear_path(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        panel_wear_header_t hdr;
+        panel_wear_t counters;
+        bool ok = read(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+                  hdr.magic == PANEL_WEAR_MAGIC && hdr.version == PANEL_WEAR_VERSION &&
+                  hdr.regions == PANEL_WEAR_REGIONS &&
+                  read(fd, &counters, sizeof(counters)) == (ssize_t)sizeof(counters) &&
+                  epd_asset_crc32((const uint8_t *)&counters, sizeof(counters)) == hdr.crc32;
+        close(fd);
+        if (ok) {
+            wear.counters = counters;
+        } else {
+            WLOG_WARN("Panel wear counters in %s unreadable, starting from zero", panel_wear_path());
+        }
+    }
+
+    if (!wear.registered) {
+        // Family by family, so each one's lines stay together, and
+        // backwards, as the registry lists the newest first
+        for (int t = PANEL_REFRESH_TYPES - 1; t >= 0; t--) {
+            metrics_register(&m_refreshes[t]);
+        }
+        for (int t = PANEL_REFRESH_TYPES - 1; t >= 0; t--) {
+            metrics_register(&m_busy_ms[t]);
+        }
+        for (int t = PANEL_REFRESH_TYPES - 1; t >= 0; t--) {
+            metrics_register(&m_energy_mj[t]);
+        }
+        for (int i = PANEL_WEAR_REGIONS - 1; i >= 0; i--) {
+            metrics_register(&m_regions[i]);
+        }
+        wear.registered = true;
+    }
+    panel_wear_publish();
+}
+
+void panel_wear_record(panel_refresh_t type, uint32_t busy_ms, int y1, int y2) {
+    if (type >= PANEL_REFRESH_TYPES) {
+        return;
+    }
+    panel_wear_t *w = &wear.counters;
+    w->refreshes[type]++;
+    w->busy_ms[type] += busy_ms;
+
+    // A full refresh drives every pixel anyway; for the others, count the
+    // bands that actually changed
+    if (type != PANEL_REFRESH_FULL) {
+        y1 = y1 < 0 ? 0 : y1;
+        y2 = y2 >= wear.height ? wear.height - 1 : y2;
+        if (y1 <= y2) {
+            int first = y1 * PANEL_WEAR_REGIONS / wear.height;
+            int last = y2 * PANEL_WEAR_REGIONS / wear.height;
+            for (int i = first; i <= last; i++) {
+                w->region_updates[i]++;
+            }
+        }
+    }
+
+    wear.dirty = true;
+    panel_wear_publish();
+    panel_wear_save(false);
+}
+
+void panel_wear_save(bool force) {
+    time_t now = time(NULL);
+    if (!wear.dirty || (!force && now - wear.saved_at < PANEL_WEAR_SAVE_S)) {
+        return;
+    }
+    wear.saved_at = now;
+
+    char tmp[PATH_MAX];
+    const char *path = panel_wear_path();
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        WLOG_WARN("Cannot save panel wear counters to %s", path);
+        return;
+    }
+    panel_wear_header_t hdr = {
+        .magic = PANEL_WEAR_MAGIC, .version = PANEL_WEAR_VERSION, .regions = PANEL_WEAR_REGIONS,
+        .crc32 = epd_asset_crc32((const uint8_t *)&wear.counters, sizeof(wear.counters)),
+    };
+    // fsync before the rename: unlike the frame cache this is on flash
+    // and must survive a power cut
+    bool ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              write(fd, &wear.counters, sizeof(wear.counters)) == (ssize_t)sizeof(wear.counters) &&
+              fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        WLOG_WARN("Cannot save panel wear counters to %s", path);
+        return;
+    }
+    wear.dirty = false;
+}
+
+void panel_wear_get(panel_wear_t *out) {
+    if (out) {
+        *out = wear.counters;
+    }
+}
+
+double panel_wear_energy_mj(const panel_wear_t *w, panel_refresh_t type) {
+    if (!w || type >= PANEL_REFRESH_TYPES) {
+        return 0.0;
+    }
+    // ms * uW = nJ
+    return (double)w->busy_ms[type] * PANEL_REFRESH_POWER_UW / 1e6;
+}
@@ -0,0 +1,582 @@
+#define WLOG_MODULE history
+#include "tx_history.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
+#include "epd_asset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TX_HISTORY_LOG_MAGIC 0x4c485854U       // "TXHL"
+#define TX_HISTORY_INDEX_MAGIC 0x49485854U     // "TXHI"
+#define TX_HISTORY_RECORD_MAGIC 0x52485854U    // "TXHR"
+#define TX_HISTORY_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t generation;    // Shared with the index built for this log
+    int64_t base_balance;   // Balance before the first record
+} log_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t stride;        // sizeof(index_entry_t)
+    uint64_t generation;    // Of the log this indexes
+} index_header_t;
+
+typedef struct {
+    uint64_t offset;        // Of the record in the log
+    int64_t balance;        // After the record
+} index_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t crc32;         // CRC-32 of the payload
+    uint32_t seq;           // Position in the history
+    uint16_t length;        // Payload bytes
+    uint16_t reserved;
+} record_header_t;
+
+// Payload: this, then address_len bytes of address
+typedef struct {
+    uint8_t txid[32];
+    uint64_t amount;
+    uint64_t fee;
+    int64_t timestamp;
+    uint64_t height;
+    uint8_t direction;
+    uint8_t address_len;
+    uint8_t reserved[6];
+} record_t;
+
+// Records start 8-byte aligned in the log
+#define RECORD_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+#define RECORD_MAX_SIZE \
+    RECORD_ALIGN(sizeof(record_header_t) + sizeof(record_t) + TX_HISTORY_ADDRESS_SIZE - 1)
+
+_Static_assert(sizeof(log_header_t) % 8 == 0, "records must stay aligned");
+_Static_assert(sizeof(index_entry_t) == 16, "index stride is part of the format");
+_Static_assert(TX_HISTORY_ADDRESS_SIZE <= 256, "address_len is one byte");
+
+METRICS_HISTOGRAM(m_commit_us, "wallet_tx_history_commit_microseconds",
+                  "Time to make a batch of transaction history appends durable");
+METRICS_GAUGE(m_records, "wallet_tx_history_records", "Transactions in the on-device history");
+
+// A file mapped read-only; written with pwrite and remapped as it grows
+typedef struct {
+    int fd;
+    uint8_t *base;
+    size_t mapped;
+    uint64_t size;          // Bytes in use
+} hfile_t;
+
+static struct {
+    char dir[PATH_MAX];
+    hfile_t log;
+    hfile_t index;
+    log_header_t log_hdr;
+    uint32_t count;         // Committed records
+    int64_t balance;        // After the last committed record
+    index_entry_t pending[TX_HISTORY_BATCH_MAX];
+    int pending_count;
+    bool open;
+} hist = { .log.fd = -1, .index.fd = -1 };
+
+static int history_path(char *path, size_t size, const char *dir, const char *name,
+                        const char *suffix) {
+    return snprintf(path, size, "%s/%s%s", dir, name, suffix) < (int)size ? 0 : -1;
+}
+
+// New files and renames are only durable once their directory is synced
+static void sync_dir(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static uint64_t new_generation(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t gen = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 20);
+    return gen == hist.log_hdr.generation ? gen + 1 : gen;
+}
+
+static int hfile_map(hfile_t *f, uint64_t need) {
+    if (need <= f->mapped) {
+        return 0;
+    }
+    if (need > f->size) {
+        return -1;
+    }
+    void *base = f->base ? mremap(f->base, f->mapped, f->size, MREMAP_MAYMOVE)
+                         : mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (base == MAP_FAILED) {
+        WLOG_WARN("Cannot map %llu bytes of history", (unsigned long long)f->size);
+        return -1;
+    }
+    // Reads are a record or an index entry at a time; readahead around
+    // them would only cost flash reads
+    madvise(base, f->size, MADV_RANDOM);
+    f->base = base;
+    f->mapped = f->size;
+    return 0;
+}
+
+static void hfile_close(hfile_t *f) {
+    if (f->base) {
+        munmap(f->base, f->mapped);
+    }
+    if (f->fd >= 0) {
+        close(f->fd);
+    }
+    *f = (hfile_t){ .fd = -1 };
+}
+
+static int64_t balance_after(int64_t balance, const tx_history_entry_t *entry) {
+    if (entry->direction == TX_HISTORY_IN) {
+        return balance + (int64_t)entry->amount;
+    }
+    return balance - (int64_t)(entry->amount + entry->fee);
+}
+
+/**
+ * Lay out a record, header included
+ * @return bytes to write, padding included
+ */
+static size_t record_encode(const tx_history_entry_t *entry, uint32_t seq, uint8_t *buf) {
+    size_t address_len = strnlen(entry->address, TX_HISTORY_ADDRESS_SIZE - 1);
+    record_t rec = {
+        .amount = entry->amount, .fee = entry->fee, .timestamp = entry->timestamp,
+        .height = entry->height, .direction = (uint8_t)entry->direction,
+        .address_len = (uint8_t)address_len,
+    };
+    memcpy(rec.txid, entry->txid, sizeof(rec.txid));
+
+    record_header_t hdr = {
+        .magic = TX_HISTORY_RECORD_MAGIC, .seq = seq,
+        .length = (uint16_t)(sizeof(rec) + address_len),
+    };
+    size_t size = RECORD_ALIGN(sizeof(hdr) + hdr.length);
+    memset(buf, 0, size);
+    memcpy(buf + sizeof(hdr), &rec, sizeof(rec));
+    memcpy(buf + sizeof(hdr) + sizeof(rec), entry->address, address_len);
+    hdr.crc32 = epd_asset_crc32(buf + sizeof(hdr), hdr.length);
+    memcpy(buf, &hdr, sizeof(hdr));
+    return size;
+}
+
+/**
+ * Check and decode the record at offset in the log
+ * @param offset Where the record should start
+ * @param seq Position it should have
+ * @param out Output transaction (may be NULL)
+ * @param end Set to the offset after the record (may be NULL)
+ * @return 0 on success, negative if there is no intact record there
+ */
+static int record_read(uint64_t offset, uint32_t seq, tx_history_entry_t *out, uint64_t *end) {
+    record_header_t hdr;
+    record_t rec;
+
+    if (offset + sizeof(hdr) > hist.log.size || hfile_map(&hist.log, offset + sizeof(hdr)) < 0) {
+        return -1;
+    }
+    memcpy(&hdr, hist.log.base + offset, sizeof(hdr));
+    if (hdr.magic != TX_HISTORY_RECORD_MAGIC || hdr.seq != seq || hdr.length < sizeof(rec) ||
+        hdr.length > sizeof(rec) + TX_HISTORY_ADDRESS_SIZE - 1) {
+        return -1;
+    }
+    if (offset + sizeof(hdr) + hdr.length > hist.log.size ||
+        hfile_map(&hist.log, offset + sizeof(hdr) + hdr.length) < 0) {
+        return -1;
+    }
+    // Mapped again from here on, so the base may have moved
+    const uint8_t *payload = hist.log.base + offset + sizeof(hdr);
+    memcpy(&rec, payload, sizeof(rec));
+    if (rec.address_len != hdr.length - sizeof(rec) ||
+        epd_asset_crc32(payload, hdr.length) != hdr.crc32) {
+        return -1;
+    }
+
+    if (out) {
+        memcpy(out->txid, rec.txid, sizeof(out->txid));
+        out->amount = rec.amount;
+        out->fee = rec.fee;
+        out->timestamp = rec.timestamp;
+        out->height = rec.height;
+        out->direction = rec.direction == TX_HISTORY_OUT ? TX_HISTORY_OUT : TX_HISTORY_IN;
+        memcpy(out->address, payload + sizeof(rec), rec.address_len);
+        out->address[rec.address_len] = '\0';
+    }
+    if (end) {
+        *end = offset + RECORD_ALIGN(sizeof(hdr) + hdr.length);
+    }
+    return 0;
+}
+
+static int log_open(const char *path) {
+    struct stat st;
+    hist.log.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (hist.log.fd < 0 || fstat(hist.log.fd, &st) < 0) {
+        WLOG_ERROR("Cannot open transaction history %s", path);
+        return -1;
+    }
+
+    if ((size_t)st.st_size < sizeof(log_header_t)) {
+        // New, or cut off before its header was complete: nothing to lose
+        hist.log_hdr = (log_header_t){
+            .magic = TX_HISTORY_LOG_MAGIC, .version = TX_HISTORY_VERSION,
+            .generation = new_generation(),
+        };
+        if (ftruncate(hist.log.fd, 0) < 0 ||
+            pwrite(hist.log.fd, &hist.log_hdr, sizeof(hist.log_hdr), 0) != (ssize_t)sizeof(hist.log_hdr) ||
+            fsync(hist.log.fd) < 0) {
+            WLOG_ERROR("Cannot create transaction history %s", path);
+            return -1;
+        }
+        sync_dir(hist.dir);
+        hist.log.size = sizeof(hist.log_hdr);
+        return 0;
+    }
+
+    if (pread(hist.log.fd, &hist.log_hdr, sizeof(hist.log_hdr), 0) != (ssize_t)sizeof(hist.log_hdr) ||
+        hist.log_hdr.magic != TX_HISTORY_LOG_MAGIC || hist.log_hdr.version != TX_HISTORY_VERSION) {
+        // Not ours to overwrite
+        WLOG_ERROR("Transaction history %s has an unknown format", path);
+        return -1;
+    }
+    hist.log.size = (uint64_t)st.st_size;
+    return 0;
+}
+
+static const index_entry_t *index_entry(uint32_t i) {
+    return (const index_entry_t *)(hist.index.base + sizeof(index_header_t)) + i;
+}
+
+/**
+ * Index the records past the last indexed one, and cut off the log after
+ * the last intact record
+ * @return records indexed, negative on error
+ */
+static int index_recover(void) {
+    index_entry_t batch[TX_HISTORY_BATCH_MAX];
+    tx_history_entry_t entry;
+    int n = 0, total = 0;
+
+    uint64_t offset = sizeof(log_header_t);
+    if (hist.count > 0) {
+        record_read(index_entry(hist.count - 1)->offset, hist.count - 1, NULL, &offset);
+    }
+    for (;;) {
+        uint64_t next;
+        bool ok = record_read(offset, hist.count + n, &entry, &next) == 0;
+        if (ok) {
+            hist.balance = balance_after(hist.balance, &entry);
+            batch[n++] = (index_entry_t){ .offset = offset, .balance = hist.balance };
+            offset = next;
+        }
+        if (n == TX_HISTORY_BATCH_MAX || (!ok && n > 0)) {
+            size_t len = n * sizeof(batch[0]);
+            if (pwrite(hist.index.fd, batch, len, hist.index.size) != (ssize_t)len) {
+                return -1;
+            }
+            hist.index.size += len;
+            hist.count += n;
+            total += n;
+            n = 0;
+        }
+        if (!ok) {
+            break;
+        }
+    }
+
+    if (offset < hist.log.size) {
+        WLOG_WARN("Dropping %llu bytes of torn history records",
+                  (unsigned long long)(hist.log.size - offset));
+        if (ftruncate(hist.log.fd, (off_t)offset) < 0) {
+            return -1;
+        }
+        hist.log.size = offset;
+    } else if (offset > hist.log.size) {
+        // Only the last record's padding was lost: put it back, or the
+        // next record would start unaligned where recovery cannot find it
+        if (ftruncate(hist.log.fd, (off_t)offset) < 0) {
+            return -1;
+        }
+        hist.log.size = offset;
+    }
+    if (total > 0 && fdatasync(hist.index.fd) < 0) {
+        return -1;
+    }
+    return total;
+}
+
+static int index_open(const char *path) {
+    struct stat st;
+    index_header_t hdr = { 0 };
+    hist.index.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (hist.index.fd < 0 || fstat(hist.index.fd, &st) < 0) {
+        WLOG_ERROR("Cannot open transaction history index %s", path);
+        return -1;
+    }
+
+    bool valid = (size_t)st.st_size >= sizeof(hdr) &&
+                 pread(hist.index.fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+                 hdr.magic == TX_HISTORY_INDEX_MAGIC && hdr.version == TX_HISTORY_VERSION &&
+                 hdr.stride == sizeof(index_entry_t) && hdr.generation == hist.log_hdr.generation;
+    if (!valid) {
+        // Only the log is authoritative: rebuild the index from it
+        if (st.st_size > 0) {
+            WLOG_WARN("Rebuilding the transaction history index");
+        }
+        hdr = (index_header_t){
+            .magic = TX_HISTORY_INDEX_MAGIC, .version = TX_HISTORY_VERSION,
+            .stride = sizeof(index_entry_t), .generation = hist.log_hdr.generation,
+        };
+        if (ftruncate(hist.index.fd, 0) < 0 ||
+            pwrite(hist.index.fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+            WLOG_ERROR("Cannot write transaction history index %s", path);
+            return -1;
+        }
+        st.st_size = sizeof(hdr);
+    }
+
+    // A torn entry at the end is dropped, and so is any entry whose
+    // record did not make it
+    hist.count = (uint32_t)(((uint64_t)st.st_size - sizeof(hdr)) / sizeof(index_entry_t));
+    hist.index.size = (uint64_t)st.st_size;
+    if (hist.count > 0 && hfile_map(&hist.index, hist.index.size) < 0) {
+        return -1;
+    }
+    while (hist.count > 0 &&
+           record_read(index_entry(hist.count - 1)->offset, hist.count - 1, NULL, NULL) < 0) {
+        hist.count--;
+    }
+    hist.index.size = sizeof(hdr) + (uint64_t)hist.count * sizeof(index_entry_t);
+    if ((uint64_t)st.st_size != hist.index.size) {
+        WLOG_WARN("Dropping %llu bytes of the transaction history index",
+                  (unsigned long long)((uint64_t)st.st_size - hist.index.size));
+        if (ftruncate(hist.index.fd, (off_t)hist.index.size) < 0) {
+            return -1;
+        }
+    }
+    hist.balance = hist.count > 0 ? index_entry(hist.count - 1)->balance : hist.log_hdr.base_balance;
+
+    int recovered = index_recover();
+    if (recovered < 0) {
+        WLOG_ERROR("Cannot recover transaction history index %s", path);
+        return -1;
+    }
+    if (recovered > 0) {
+        WLOG_INFO("Indexed %d history records written before the last shutdown", recovered);
+    }
+    return 0;
+}
+
+int tx_history_open(const char *dir) {
+    char path[PATH_MAX];
+
+    if (hist.open) {
+        tx_history_close();
+    }
+    if (!dir) {
+        dir = getenv("WALLET_TX_HISTORY");
+        dir = dir && *dir ? dir : TX_HISTORY_DIR;
+    }
+    if (snprintf(hist.dir, sizeof(hist.dir), "%s", dir) >= (int)sizeof(hist.dir)) {
+        return -1;
+    }
+    hist.log_hdr = (log_header_t){ 0 };
+    hist.pending_count = 0;
+
+    if (history_path(path, sizeof(path), hist.dir, TX_HISTORY_LOG_NAME, "") < 0 || log_open(path) < 0 ||
+        history_path(path, sizeof(path), hist.dir, TX_HISTORY_INDEX_NAME, "") < 0 || index_open(path) < 0) {
+        hfile_close(&hist.log);
+        hfile_close(&hist.index);
+        return -1;
+    }
+    hist.open = true;
+    metrics_set(&m_records, hist.count);
+    WLOG_INFO("Transaction history: %u records", hist.count);
+    return 0;
+}
+
+void tx_history_close(void) {
+    if (!hist.open) {
+        return;
+    }
+    tx_history_commit();
+    hfile_close(&hist.log);
+    hfile_close(&hist.index);
+    hist.count = 0;
+    hist.open = false;
+}
+
+int tx_history_append(const tx_history_entry_t *entry) {
+    uint8_t buf[RECORD_MAX_SIZE];
+
+    if (!hist.open || !entry) {
+        return -1;
+    }
+    // Full after a failed commit
+    if (hist.pending_count == TX_HISTORY_BATCH_MAX && tx_history_commit() < 0) {
+        return -1;
+    }
+    // A failed write is overwritten by the next one
+    size_t size = record_encode(entry, hist.count + hist.pending_count, buf);
+    if (pwrite(hist.log.fd, buf, size, (off_t)hist.log.size) != (ssize_t)size) {
+        WLOG_WARN("Cannot append to the transaction history");
+        return -1;
+    }
+
+    int64_t balance = hist.pending_count > 0 ? hist.pending[hist.pending_count - 1].balance
+                                             : hist.balance;
+    hist.pending[hist.pending_count++] = (index_entry_t){
+        .offset = hist.log.size, .balance = balance_after(balance, entry),
+    };
+    hist.log.size += size;
+    return hist.pending_count == TX_HISTORY_BATCH_MAX ? tx_history_commit() : 0;
+}
+
+int tx_history_commit(void) {
+    if (!hist.open) {
+        return -1;
+    }
+    if (hist.pending_count == 0) {
+        return 0;
+    }
+    uint64_t start = metrics_now_us();
+
+    // The records reach storage before anything points at them
+    size_t len = hist.pending_count * sizeof(index_entry_t);
+    if (fdatasync(hist.log.fd) < 0 ||
+        pwrite(hist.index.fd, hist.pending, len, (off_t)hist.index.size) != (ssize_t)len ||
+        fdatasync(hist.index.fd) < 0) {
+        WLOG_WARN("Cannot commit %d transaction history records", hist.pending_count);
+        return -1;
+    }
+    hist.index.size += len;
+    hist.count += hist.pending_count;
+    hist.balance = hist.pending[hist.pending_count - 1].balance;
+    hist.pending_count = 0;
+
+    metrics_observe(&m_commit_us, metrics_now_us() - start);
+    metrics_set(&m_records, hist.count);
+    return 0;
+}
+
+uint32_t tx_history_count(void) {
+    return hist.open ? hist.count : 0;
+}
+
+int tx_history_get(uint32_t index, tx_history_entry_t *out) {
+    if (!hist.open || !out || index >= hist.count ||
+        hfile_map(&hist.index, sizeof(index_header_t) + ((uint64_t)index + 1) * sizeof(index_entry_t)) < 0) {
+        return -1;
+    }
+    if (record_read(index_entry(index)->offset, index, out, NULL) < 0) {
+        WLOG_WARN("Transaction history record %u is damaged", index);
+        return -1;
+    }
+    return 0;
+}
+
+int64_t tx_history_balance(void) {
+    return hist.open ? hist.balance : 0;
+}
+
+/**
+ * Write the newest keep records to new files next to the current ones
+ */
+static int compact_write(const char *log_tmp, const char *index_tmp, uint32_t keep) {
+    uint8_t buf[RECORD_MAX_SIZE];
+    tx_history_entry_t entry;
+    uint32_t first = hist.count - keep;
+
+    if (hfile_map(&hist.index, hist.index.size) < 0) {
+        return -1;
+    }
+    int log_fd = open(log_tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    int index_fd = open(index_tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    log_header_t log_hdr = {
+        .magic = TX_HISTORY_LOG_MAGIC, .version = TX_HISTORY_VERSION,
+        .generation = new_generation(),
+        .base_balance = first > 0 ? index_entry(first - 1)->balance : hist.log_hdr.base_balance,
+    };
+    index_header_t index_hdr = {
+        .magic = TX_HISTORY_INDEX_MAGIC, .version = TX_HISTORY_VERSION,
+        .stride = sizeof(index_entry_t), .generation = log_hdr.generation,
+    };
+    bool ok = log_fd >= 0 && index_fd >= 0 &&
+              write(log_fd, &log_hdr, sizeof(log_hdr)) == (ssize_t)sizeof(log_hdr) &&
+              write(index_fd, &index_hdr, sizeof(index_hdr)) == (ssize_t)sizeof(index_hdr);
+
+    uint64_t offset = sizeof(log_hdr);
+    for (uint32_t i = 0; ok && i < keep; i++) {
+        ok = tx_history_get(first + i, &entry) == 0;
+        if (ok) {
+            size_t size = record_encode(&entry, i, buf);
+            index_entry_t e = { .offset = offset, .balance = index_entry(first + i)->balance };
+            ok = write(log_fd, buf, size) == (ssize_t)size &&
+                 write(index_fd, &e, sizeof(e)) == (ssize_t)sizeof(e);
+            offset += size;
+        }
+    }
+    ok = ok && fsync(log_fd) == 0 && fsync(index_fd) == 0;
+    if (log_fd >= 0) {
+        close(log_fd);
+    }
+    if (index_fd >= 0) {
+        close(index_fd);
+    }
+    return ok ? 0 : -1;
+}
+
+int tx_history_compact(uint32_t keep) {
+    char log_path[PATH_MAX], index_path[PATH_MAX], log_tmp[PATH_MAX], index_tmp[PATH_MAX];
+
+    if (!hist.open || tx_history_commit() < 0) {
+        return -1;
+    }
+    if (keep >= hist.count) {
+        return 0;
+    }
+    if (history_path(log_path, sizeof(log_path), hist.dir, TX_HISTORY_LOG_NAME, "") < 0 ||
+        history_path(index_path, sizeof(index_path), hist.dir, TX_HISTORY_INDEX_NAME, "") < 0 ||
+        history_path(log_tmp, sizeof(log_tmp), hist.dir, TX_HISTORY_LOG_NAME, ".tmp") < 0 ||
+        history_path(index_tmp, sizeof(index_tmp), hist.dir, TX_HISTORY_INDEX_NAME, ".tmp") < 0) {
+        return -1;
+    }
+
+    uint32_t dropped = hist.count - keep;
+    if (compact_write(log_tmp, index_tmp, keep) < 0 || rename(log_tmp, log_path) < 0) {
+        unlink(log_tmp);
+        unlink(index_tmp);
+        WLOG_WARN("Cannot compact the transaction history");
+        return -1;
+    }
+    // Between the renames the index belongs to another generation, so a
+    // power cut here only costs a rebuild of the new log's index
+    if (rename(index_tmp, index_path) < 0) {
+        unlink(index_tmp);
+    }
+    sync_dir(hist.dir);
+
+    char dir[PATH_MAX];
+    memcpy(dir, hist.dir, sizeof(dir));
+    if (tx_history_open(dir) < 0) {
+        return -1;
+    }
+    WLOG_INFO("Compacted the transaction history: %u records dropped", dropped);
+    return 0;
+}
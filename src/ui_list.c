@@ -0,0 +1,233 @@
+#define WLOG_MODULE ui
+#include "ui_list.h"
+#include "wallet_log.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Space around the text of a row
+#define UI_LIST_ROW_PAD 3
+
+/**
+ * Set a label's text only if it differs, so unchanged rows are not
+ * invalidated and redrawn
+ */
+static void row_set_text(lv_obj_t *label, const char *text) {
+    const char *current = lv_label_get_text(label);
+    if (current && strcmp(current, text) == 0) {
+        return;
+    }
+    lv_label_set_text(label, text);
+}
+
+// Hiding or showing invalidates the row; only do it on a change
+static void row_set_shown(lv_obj_t *row, bool shown) {
+    if (lv_obj_has_flag(row, LV_OBJ_FLAG_HIDDEN) != shown) {
+        return;
+    }
+    if (shown) {
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+static int row_index(const ui_list_t *list, const lv_obj_t *obj) {
+    for (int i = 0; i < list->visible; i++) {
+        if (list->rows[i].row == obj) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Bind the rows to the page starting at list->top
+ */
+static void list_bind(ui_list_t *list) {
+    ui_list_item_t items[UI_LIST_MAX_ROWS];
+    int n = 0;
+
+    list->count = list->source.count ? list->source.count(list->source.ctx) : 0;
+    if (list->count == 0) {
+        list->top = 0;
+    } else if (list->top >= list->count) {
+        list->top = (list->count - 1) / list->visible * list->visible;
+    }
+
+    if (list->count > 0 && list->source.fetch) {
+        uint32_t left = list->count - list->top;
+        n = list->source.fetch(list->source.ctx, list->top, items,
+                               left < (uint32_t)list->visible ? (int)left : list->visible);
+        n = n < 0 ? 0 : n > list->visible ? list->visible : n;
+    }
+    if (n == 0) {
+        // Keep one row to focus, so a long press still gets back out
+        snprintf(items[0].text, sizeof(items[0].text), "%s", UI_LIST_EMPTY_TEXT);
+        items[0].value[0] = '\0';
+        n = 1;
+        list->count = 0;
+    }
+
+    for (int i = 0; i < list->visible; i++) {
+        ui_list_row_t *r = &list->rows[i];
+        if (i < n) {
+            items[i].text[UI_LIST_TEXT_SIZE - 1] = '\0';
+            items[i].value[UI_LIST_VALUE_SIZE - 1] = '\0';
+            row_set_text(r->text, items[i].text);
+            row_set_text(r->value, items[i].value);
+        }
+        row_set_shown(r->row, i < n);
+    }
+    list->shown = n;
+
+    // Hidden edges are skipped by focus, so the first and last items stay
+    // put instead of bouncing off an edge (and redrawing)
+    row_set_shown(list->before, list->top > 0);
+    row_set_shown(list->after, list->top + (uint32_t)n < list->count);
+}
+
+static void row_event_cb(lv_event_t *e) {
+    ui_list_t *list = lv_event_get_user_data(e);
+    int i = row_index(list, lv_event_get_target(e));
+    if (i < 0 || list->count == 0 || !list->source.select) {
+        return;
+    }
+    list->source.select(list->source.ctx, list->top + i);
+}
+
+/**
+ * Focus reached an edge: turn the page and focus its nearest row
+ */
+static void edge_event_cb(lv_event_t *e) {
+    ui_list_t *list = lv_event_get_user_data(e);
+    bool forward = lv_event_get_target(e) == list->after;
+
+    if (forward && list->top + (uint32_t)list->shown < list->count) {
+        list->top += list->visible;
+    } else if (!forward && list->top > 0) {
+        list->top = list->top > (uint32_t)list->visible ? list->top - list->visible : 0;
+    }
+    list_bind(list);
+    lv_group_focus_obj(list->rows[forward ? 0 : list->shown - 1].row);
+}
+
+static lv_obj_t *edge_create(ui_list_t *list) {
+    // No size: never drawn, so showing or hiding it invalidates nothing
+    lv_obj_t *edge = lv_obj_create(list->box);
+    if (!edge) {
+        return NULL;
+    }
+    lv_obj_remove_style_all(edge);
+    lv_obj_set_size(edge, 0, 0);
+    lv_obj_clear_flag(edge, LV_OBJ_FLAG_SCROLL_ON_FOCUS);
+    lv_obj_add_flag(edge, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_event_cb(edge, edge_event_cb, LV_EVENT_FOCUSED, list);
+    lv_group_add_obj(list->group, edge);
+    return edge;
+}
+
+int ui_list_init(ui_list_t *list, lv_obj_t *parent, lv_group_t *group, lv_coord_t y,
+                 lv_coord_t height, const lv_font_t *font, lv_event_cb_t cancel_cb) {
+    if (!list || !parent || !group || !font) {
+        return -1;
+    }
+    memset(list, 0, sizeof(*list));
+    lv_coord_t row_height = font->line_height + 2 * UI_LIST_ROW_PAD;
+    list->visible = height / row_height;
+    if (list->visible > UI_LIST_MAX_ROWS) {
+        list->visible = UI_LIST_MAX_ROWS;
+    }
+    if (list->visible < 1) {
+        return -1;
+    }
+    list->group = group;
+
+    list->box = lv_obj_create(parent);
+    if (!list->box) {
+        return -1;
+    }
+    lv_obj_remove_style_all(list->box);
+    lv_obj_clear_flag(list->box, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_pos(list->box, 0, y);
+    lv_obj_set_size(list->box, lv_pct(100), height);
+
+    // Focus order: edge, rows, edge
+    list->before = edge_create(list);
+    for (int i = 0; i < list->visible && list->before; i++) {
+        ui_list_row_t *r = &list->rows[i];
+        r->row = lv_obj_create(list->box);
+        if (!r->row) {
+            return -1;
+        }
+        lv_obj_remove_style_all(r->row);
+        lv_obj_clear_flag(r->row, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ON_FOCUS);
+        lv_obj_set_pos(r->row, 0, i * row_height);
+        lv_obj_set_size(r->row, lv_pct(100), row_height);
+        lv_obj_set_style_pad_all(r->row, UI_LIST_ROW_PAD, 0);
+        // The focused row is drawn inverted
+        lv_obj_set_style_bg_color(r->row, lv_color_black(), LV_STATE_FOCUSED);
+        lv_obj_set_style_bg_opa(r->row, LV_OPA_COVER, LV_STATE_FOCUSED);
+        lv_obj_set_style_text_color(r->row, lv_color_white(), LV_STATE_FOCUSED);
+        lv_obj_add_flag(r->row, LV_OBJ_FLAG_HIDDEN);
+
+        r->text = lv_label_create(r->row);
+        r->value = lv_label_create(r->row);
+        if (!r->text || !r->value) {
+            return -1;
+        }
+        lv_label_set_text(r->text, "");
+        lv_label_set_long_mode(r->text, LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(r->text, lv_pct(62));
+        lv_obj_set_style_text_font(r->text, font, 0);
+        lv_obj_align(r->text, LV_ALIGN_LEFT_MID, 0, 0);
+        lv_label_set_text(r->value, "");
+        lv_obj_set_style_text_font(r->value, font, 0);
+        lv_obj_align(r->value, LV_ALIGN_RIGHT_MID, 0, 0);
+
+        lv_obj_add_event_cb(r->row, row_event_cb, LV_EVENT_CLICKED, list);
+        if (cancel_cb) {
+            lv_obj_add_event_cb(r->row, cancel_cb, LV_EVENT_CANCEL, NULL);
+        }
+        lv_group_add_obj(group, r->row);
+    }
+    list->after = edge_create(list);
+    if (!list->before || !list->after) {
+        return -1;
+    }
+
+    // Wrapping from the last row to the first would skip the pages between
+    lv_group_set_wrap(group, false);
+    WLOG_DEBUG("List with %d rows of %d px", list->visible, row_height);
+    return 0;
+}
+
+void ui_list_set_source(ui_list_t *list, const ui_list_source_t *source) {
+    if (!list || !list->box) {
+        return;
+    }
+    list->source = source ? *source : (ui_list_source_t){ 0 };
+    list->top = 0;
+    list_bind(list);
+    lv_group_focus_obj(list->rows[0].row);
+}
+
+void ui_list_refresh(ui_list_t *list) {
+    if (!list || !list->box) {
+        return;
+    }
+    list_bind(list);
+    // The page may have shrunk under the focused row
+    int focused = row_index(list, lv_group_get_focused(list->group));
+    if (focused < 0 || focused >= list->shown) {
+        lv_group_focus_obj(list->rows[list->shown - 1].row);
+    }
+}
+
+uint32_t ui_list_selected(const ui_list_t *list) {
+    if (!list || !list->box || list->count == 0) {
+        return UINT32_MAX;
+    }
+    int focused = row_index(list, lv_group_get_focused(list->group));
+    return focused < 0 ? UINT32_MAX : list->top + focused;
+}
@@ -0,0 +1,57 @@
+#define WLOG_MODULE ui
+#include "ui_mem.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
+#include <lvgl.h>
+#include <stdbool.h>
+
+METRICS_GAUGE(m_used, "wallet_ui_mem_used_bytes", "LVGL pool bytes allocated");
+METRICS_GAUGE(m_max_used, "wallet_ui_mem_max_used_bytes", "High-water mark of the LVGL pool");
+METRICS_GAUGE(m_largest_free, "wallet_ui_mem_largest_free_bytes",
+              "Largest allocation the LVGL pool could serve");
+METRICS_GAUGE(m_frag, "wallet_ui_mem_fragmentation_percent",
+              "LVGL pool free space outside its largest free block");
+
+static lv_timer_t *sample_timer;
+static bool warned;
+
+void ui_mem_stats(ui_mem_stats_t *out) {
+    lv_mem_monitor_t mon;
+    if (!out) {
+        return;
+    }
+    lv_mem_monitor(&mon);
+    *out = (ui_mem_stats_t){
+        .size = mon.total_size, .used = mon.total_size - mon.free_size,
+        .max_used = mon.max_used, .largest_free = mon.free_biggest_size,
+        .blocks = mon.used_cnt, .frag_pct = mon.frag_pct,
+    };
+}
+
+static void sample_cb(lv_timer_t *timer) {
+    (void)timer;
+    ui_mem_stats_t st;
+    ui_mem_stats(&st);
+    metrics_set(&m_used, st.used);
+    metrics_set(&m_max_used, st.max_used);
+    metrics_set(&m_largest_free, st.largest_free);
+    metrics_set(&m_frag, st.frag_pct);
+
+    // Once is enough: past this point LV_MEM_SIZE needs raising
+    if (!warned && st.size && (uint64_t)st.max_used * 100 >= (uint64_t)st.size * UI_MEM_WARN_PCT) {
+        WLOG_WARN("LVGL pool %u of %u bytes used at its peak", st.max_used, st.size);
+        warned = true;
+    }
+}
+
+int ui_mem_start(void) {
+    if (sample_timer) {
+        return 0;
+    }
+    sample_timer = lv_timer_create(sample_cb, UI_MEM_SAMPLE_MS, NULL);
+    if (!sample_timer) {
+        return -1;
+    }
+    sample_cb(sample_timer);
+    return 0;
+}
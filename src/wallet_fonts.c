@@ -0,0 +1,121 @@
+#include "wallet_fonts.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Letters served from the table: printable ASCII
+#define GLYPH_TABLE_FIRST 0x20
+#define GLYPH_TABLE_COUNT 95
+
+#ifdef WALLET_FONT_1BPP
+// Generated by tools/epd_fontc at build time
+extern const lv_font_t wallet_font_12_1bpp;
+extern const lv_font_t wallet_font_14_1bpp;
+extern const lv_font_t wallet_font_16_1bpp;
+extern const lv_font_t wallet_font_18_1bpp;
+
+static const lv_font_t *const font_base[WALLET_FONT_COUNT] = {
+    [WALLET_FONT_12] = &wallet_font_12_1bpp,
+    [WALLET_FONT_14] = &wallet_font_14_1bpp,
+    [WALLET_FONT_16] = &wallet_font_16_1bpp,
+    [WALLET_FONT_18] = &wallet_font_18_1bpp,
+};
+#else
+static const lv_font_t *const font_base[WALLET_FONT_COUNT] = {
+    [WALLET_FONT_12] = &lv_font_montserrat_12,
+    [WALLET_FONT_14] = &lv_font_montserrat_14,
+    [WALLET_FONT_16] = &lv_font_montserrat_16,
+    [WALLET_FONT_18] = &lv_font_montserrat_18,
+};
+#endif
+
+/**
+ * A font in front of a generated one that answers for the table's letters
+ * from glyph descriptors and bitmap pointers looked up once. Nothing is
+ * rendered or copied: the bitmaps stay in the generated font's tables.
+ */
+typedef struct {
+    lv_font_t font;                 // First: LVGL passes this pointer back
+    const lv_font_t *base;
+    bool present[GLYPH_TABLE_COUNT];
+    lv_font_glyph_dsc_t dsc[GLYPH_TABLE_COUNT];
+    const uint8_t *bitmap[GLYPH_TABLE_COUNT];
+} glyph_table_t;
+
+static glyph_table_t glyph_tables[WALLET_FONT_COUNT];
+static const lv_font_t *fonts[WALLET_FONT_COUNT];
+
+static bool glyph_table_get_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc,
+                                uint32_t letter, uint32_t letter_next) {
+    const glyph_table_t *c = (const glyph_table_t *)font;
+    uint32_t i = letter - GLYPH_TABLE_FIRST;
+    if (i < GLYPH_TABLE_COUNT) {
+        if (!c->present[i]) {
+            return false;
+        }
+        *dsc = c->dsc[i];
+        return true;
+    }
+    return c->base->get_glyph_dsc(c->base, dsc, letter, letter_next);
+}
+
+static const uint8_t *glyph_table_get_bitmap(const lv_font_t *font, uint32_t letter) {
+    const glyph_table_t *c = (const glyph_table_t *)font;
+    uint32_t i = letter - GLYPH_TABLE_FIRST;
+    if (i < GLYPH_TABLE_COUNT) {
+        return c->present[i] ? c->bitmap[i] : NULL;
+    }
+    return c->base->get_glyph_bitmap(c->base, letter);
+}
+
+/**
+ * Only plain, unkerned lv_font_fmt_txt fonts, as epd_fontc makes them,
+ * can be put behind a table: their glyphs do not depend on the next
+ * letter, and their bitmaps are pointers into constant tables rather than
+ * a shared decompression buffer. LVGL's built-in Montserrat is kerned, so
+ * builds without WALLET_FONT_1BPP use it as it is.
+ */
+static bool glyph_table_usable(const lv_font_t *base) {
+    if (base->get_glyph_dsc != lv_font_get_glyph_dsc_fmt_txt) {
+        return false;
+    }
+    const lv_font_fmt_txt_dsc_t *fdsc = base->dsc;
+    return fdsc->kern_dsc == NULL && fdsc->bitmap_format == LV_FONT_FMT_TXT_PLAIN;
+}
+
+static const lv_font_t *glyph_table_init(glyph_table_t *c, const lv_font_t *base) {
+    if (!glyph_table_usable(base)) {
+        return base;
+    }
+    memset(c, 0, sizeof(*c));
+    c->font = *base;
+    c->font.get_glyph_dsc = glyph_table_get_dsc;
+    c->font.get_glyph_bitmap = glyph_table_get_bitmap;
+    c->base = base;
+
+    for (uint32_t i = 0; i < GLYPH_TABLE_COUNT; i++) {
+        uint32_t letter = GLYPH_TABLE_FIRST + i;
+        lv_font_glyph_dsc_t dsc;
+        if (!base->get_glyph_dsc(base, &dsc, letter, 0)) {
+            continue;
+        }
+        c->bitmap[i] = base->get_glyph_bitmap(base, letter);
+        // Draw code fetches the bitmap from the resolved font: keep it here
+        dsc.resolved_font = &c->font;
+        c->dsc[i] = dsc;
+        c->present[i] = true;
+    }
+    return &c->font;
+}
+
+void wallet_fonts_init(void) {
+    for (int i = 0; i < WALLET_FONT_COUNT; i++) {
+        fonts[i] = glyph_table_init(&glyph_tables[i], font_base[i]);
+    }
+}
+
+const lv_font_t *wallet_font(wallet_font_id_t id) {
+    if (id >= WALLET_FONT_COUNT) {
+        id = WALLET_FONT_14;
+    }
+    return fonts[id] ? fonts[id] : font_base[id];
+}
@@ -0,0 +1,305 @@
+#include "wallet_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/eventfd.h>
+
+#define WLOG_RING_MASK (WLOG_RING_SIZE - 1)
+#define WLOG_DRAIN_MS 100           // Latency of INFO and below
+#define WLOG_LINE_MAX 256
+
+_Static_assert((WLOG_RING_SIZE & WLOG_RING_MASK) == 0, "WLOG_RING_SIZE must be a power of two");
+
+/**
+ * A captured message. String arguments are copied into `strings` and
+ * their `i` holds the offset there, or -1 if they did not fit.
+ */
+typedef struct {
+    _Atomic uint32_t seq;       // Slot sequence, see wlog_write()
+    uint8_t level;
+    uint8_t nargs;
+    uint64_t time_us;
+    const char *module;
+    const char *fmt;
+    wlog_arg_t args[WLOG_MAX_ARGS];
+    char strings[WLOG_STR_MAX];
+} wlog_record_t;
+
+typedef enum {
+    WLOG_SINK_STDERR,
+    WLOG_SINK_SYSLOG,
+    WLOG_SINK_FILE,
+} wlog_sink_t;
+
+static struct {
+    wlog_record_t ring[WLOG_RING_SIZE];
+    _Atomic uint32_t head;          // Next slot producers claim
+    uint32_t tail;                  // Next slot to drain, under drain_lock
+    _Atomic uint32_t dropped;
+    uint32_t dropped_reported;
+    pthread_mutex_t drain_lock;
+    pthread_once_t once;
+    pthread_t thread;
+    _Atomic bool running;
+    int efd;
+    wlog_sink_t sink;
+    FILE *file;
+} wlog = {
+    .drain_lock = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+    .efd = -1,
+};
+
+static uint64_t wlog_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Format one argument for the conversion in spec (without a length
+ * modifier), which ends in conv
+ */
+static int wlog_format_arg(char *out, size_t size, char *spec, size_t spec_len, char conv,
+                           const wlog_record_t *rec, const wlog_arg_t *arg) {
+    switch (conv) {
+    case 'd': case 'i':
+        memcpy(spec + spec_len - 1, "lld", 4);
+        return snprintf(out, size, spec, (long long)arg->i);
+    case 'u': case 'o': case 'x': case 'X':
+        memcpy(spec + spec_len - 1, "ll", 2);
+        spec[spec_len + 1] = conv;
+        spec[spec_len + 2] = '\0';
+        return snprintf(out, size, spec, (unsigned long long)arg->i);
+    case 'c':
+        return snprintf(out, size, spec, (int)arg->i);
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        return snprintf(out, size, spec, arg->type == WLOG_ARG_DOUBLE ? arg->f : (double)arg->i);
+    case 's':
+        if (arg->type != WLOG_ARG_STR) {
+            return snprintf(out, size, "?");
+        }
+        return snprintf(out, size, spec, arg->i >= 0 ? rec->strings + arg->i : "...");
+    case 'p':
+        return snprintf(out, size, spec, arg->p);
+    default:
+        return snprintf(out, size, "?");
+    }
+}
+
+/**
+ * printf() for a captured record. Supports the conversions the macros
+ * can capture; '*' widths are not supported.
+ */
+static size_t wlog_format(char *out, size_t size, const wlog_record_t *rec) {
+    size_t len = 0;
+    int argi = 0;
+
+    for (const char *f = rec->fmt; *f && len < size - 1; f++) {
+        if (*f != '%') {
+            out[len++] = *f;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[len++] = '%';
+            f++;
+            continue;
+        }
+
+        // Copy flags, width and precision; drop the length modifier
+        char spec[32] = "%";
+        size_t spec_len = 1;
+        const char *p = f + 1;
+        while (*p && strchr("-+ #0123456789.", *p) && spec_len < sizeof(spec) - 5) {
+            spec[spec_len++] = *p++;
+        }
+        while (*p && strchr("hljztLq", *p)) {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        char conv = *p;
+        spec[spec_len++] = conv;
+        spec[spec_len] = '\0';
+        f = p;
+
+        int n = argi < rec->nargs
+            ? wlog_format_arg(out + len, size - len, spec, spec_len, conv, rec, &rec->args[argi])
+            : snprintf(out + len, size - len, "?");
+        argi++;
+        if (n > 0) {
+            len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+        }
+    }
+
+    // A message is one line whatever its format ended with
+    while (len > 0 && (out[len - 1] == '\n' || out[len - 1] == '\r')) {
+        len--;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static void wlog_emit(int level, const char *module, uint64_t time_us, const char *msg) {
+    static const char level_char[] = { '-', 'E', 'W', 'I', 'D', 'T' };
+    static const int syslog_prio[] = { LOG_INFO, LOG_ERR, LOG_WARNING, LOG_INFO, LOG_DEBUG, LOG_DEBUG };
+
+    if (wlog.sink == WLOG_SINK_SYSLOG) {
+        syslog(syslog_prio[level], "%s: %s", module, msg);
+        return;
+    }
+    fprintf(wlog.file ? wlog.file : stderr, "[%5llu.%06llu] %c %s: %s\n",
+            (unsigned long long)(time_us / 1000000), (unsigned long long)(time_us % 1000000),
+            level_char[level], module, msg);
+}
+
+void wlog_flush(void) {
+    char line[WLOG_LINE_MAX];
+
+    pthread_mutex_lock(&wlog.drain_lock);
+    for (;;) {
+        wlog_record_t *rec = &wlog.ring[wlog.tail & WLOG_RING_MASK];
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != wlog.tail + 1) {
+            break;
+        }
+        wlog_format(line, sizeof(line), rec);
+        wlog_emit(rec->level, rec->module, rec->time_us, line);
+        // Hand the slot back for the producer one lap ahead
+        atomic_store_explicit(&rec->seq, wlog.tail + WLOG_RING_SIZE, memory_order_release);
+        wlog.tail++;
+    }
+
+    uint32_t dropped = atomic_load_explicit(&wlog.dropped, memory_order_relaxed);
+    if (dropped != wlog.dropped_reported) {
+        snprintf(line, sizeof(line), "%u messages dropped, ring full", dropped - wlog.dropped_reported);
+        wlog_emit(WLOG_LEVEL_WARN, "log", wlog_clock_us(), line);
+        wlog.dropped_reported = dropped;
+    }
+    fflush(wlog.file ? wlog.file : stderr);
+    pthread_mutex_unlock(&wlog.drain_lock);
+}
+
+static void *wlog_thread(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = wlog.efd, .events = POLLIN };
+
+    while (atomic_load(&wlog.running)) {
+        if (poll(&pfd, 1, WLOG_DRAIN_MS) > 0) {
+            uint64_t count;
+            if (read(wlog.efd, &count, sizeof(count)) < 0) {
+                // Raced with another reader; nothing to do
+            }
+        }
+        wlog_flush();
+    }
+    return NULL;
+}
+
+static void wlog_start(void) {
+    for (uint32_t i = 0; i < WLOG_RING_SIZE; i++) {
+        atomic_init(&wlog.ring[i].seq, i);
+    }
+
+    const char *sink = getenv("WALLET_LOG");
+    if (sink && strcmp(sink, "syslog") == 0) {
+        openlog("wallet", LOG_PID, LOG_USER);
+        wlog.sink = WLOG_SINK_SYSLOG;
+    } else if (sink && strncmp(sink, "file:", 5) == 0) {
+        wlog.file = fopen(sink + 5, "a");
+        if (wlog.file) {
+            wlog.sink = WLOG_SINK_FILE;
+        }
+    }
+
+    wlog.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    atomic_store(&wlog.running, true);
+    if (wlog.efd < 0 || pthread_create(&wlog.thread, NULL, wlog_thread, NULL) != 0) {
+        // No drain thread: wlog_write() flushes inline instead
+        atomic_store(&wlog.running, false);
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    atexit(wlog_flush);
+}
+
+void wlog_write(int level, const char *module, const char *fmt, int nargs, const wlog_arg_t *args) {
+    pthread_once(&wlog.once, wlog_start);
+
+    // Bounded MPMC ring: a slot is free for position pos when its
+    // sequence equals pos, and holds a message once it is pos + 1
+    uint32_t pos = atomic_load_explicit(&wlog.head, memory_order_relaxed);
+    wlog_record_t *rec;
+    for (;;) {
+        rec = &wlog.ring[pos & WLOG_RING_MASK];
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&wlog.head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&wlog.dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&wlog.head, memory_order_relaxed);
+        }
+    }
+
+    rec->level = (uint8_t)level;
+    rec->time_us = wlog_clock_us();
+    rec->module = module;
+    rec->fmt = fmt;
+    rec->nargs = (uint8_t)(nargs < WLOG_MAX_ARGS ? nargs : WLOG_MAX_ARGS);
+
+    size_t used = 0;
+    for (int i = 0; i < rec->nargs; i++) {
+        rec->args[i] = args[i];
+        if (args[i].type != WLOG_ARG_STR) {
+            continue;
+        }
+        // Strings may not outlive the call, so copy what fits
+        if (used >= WLOG_STR_MAX) {
+            rec->args[i].i = -1;
+            continue;
+        }
+        const char *s = args[i].s ? args[i].s : "(null)";
+        size_t n = strnlen(s, WLOG_STR_MAX - used - 1);
+        memcpy(rec->strings + used, s, n);
+        rec->strings[used + n] = '\0';
+        rec->args[i].i = (int64_t)used;
+        used += n + 1;
+    }
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+
+    if (!atomic_load_explicit(&wlog.running, memory_order_relaxed)) {
+        wlog_flush();
+    } else if (level <= WLOG_LEVEL_WARN) {
+        // Problems go out now; everything else waits for the next drain
+        uint64_t one = 1;
+        if (write(wlog.efd, &one, sizeof(one)) < 0) {
+            // Counter saturated: the drain thread is already due to wake
+        }
+    }
+}
+
+void wlog_shutdown(void) {
+    if (atomic_exchange(&wlog.running, false)) {
+        uint64_t one = 1;
+        if (write(wlog.efd, &one, sizeof(one)) == sizeof(one)) {
+            pthread_join(wlog.thread, NULL);
+        }
+    }
+    wlog_flush();
+}
+
+uint32_t wlog_dropped(void) {
+    return atomic_load(&wlog.dropped);
+}
@@ -0,0 +1,243 @@
+#define WLOG_MODULE app
+#include "wallet_metrics.h"
+#include "wallet_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#define METRICS_LINE_MAX 256
+
+static struct {
+    metric_t *_Atomic head;         // Registry, newest first
+    pthread_t thread;
+    bool running;
+    int listen_fd;
+    int stop_fd;                    // Wakes the server thread to exit
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+} metrics = {
+    .listen_fd = -1,
+    .stop_fd = -1,
+};
+
+void metrics_register(metric_t *m) {
+    metric_t *head = atomic_load_explicit(&metrics.head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&m->next, head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&metrics.head, &head, m,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+uint64_t metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Largest value that falls into histogram bucket i
+ */
+static uint64_t metrics_hist_upper(unsigned i) {
+    if (i < (1u << METRICS_HIST_SUB_BITS)) {
+        return i;
+    }
+    unsigned shift = (i >> METRICS_HIST_SUB_BITS) - 1;
+    uint64_t sub = i & ((1u << METRICS_HIST_SUB_BITS) - 1);
+    return (((1ull << METRICS_HIST_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+static int metrics_write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        // A scraper that hangs up must not raise SIGPIPE here
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == ENOTSOCK) {
+            n = write(fd, buf, len);
+        }
+        if (n < 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static const char *const metrics_type_names[] = {
+    [METRICS_TYPE_COUNTER] = "counter",
+    [METRICS_TYPE_GAUGE] = "gauge",
+    [METRICS_TYPE_HISTOGRAM] = "histogram",
+};
+
+/**
+ * Histogram lines: only the buckets that hold samples, cumulatively, as
+ * Prometheus expects. Buckets are read one by one while writers carry on,
+ * so a snapshot taken under load may be off by the samples in flight.
+ */
+static int metrics_dump_hist(int fd, const metric_t *m) {
+    char line[METRICS_LINE_MAX];
+    const metrics_hist_t *h = m->hist;
+    uint64_t cumulative = 0;
+
+    for (unsigned i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        uint64_t n = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (!n) {
+            continue;
+        }
+        cumulative += n;
+        int len = snprintf(line, sizeof(line), "%s_bucket{le=\"%llu\"} %llu\n", m->name,
+                           (unsigned long long)metrics_hist_upper(i), (unsigned long long)cumulative);
+        if (metrics_write_all(fd, line, (size_t)len) < 0) {
+            return -1;
+        }
+    }
+    int len = snprintf(line, sizeof(line),
+                       "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n%s_max %llu\n",
+                       m->name, (unsigned long long)cumulative,
+                       m->name, (unsigned long long)atomic_load_explicit(&h->sum, memory_order_relaxed),
+                       m->name, (unsigned long long)cumulative,
+                       m->name, (unsigned long long)atomic_load_explicit(&h->max, memory_order_relaxed));
+    return metrics_write_all(fd, line, (size_t)len);
+}
+
+int metrics_dump(int fd) {
+    char line[METRICS_LINE_MAX];
+    const metric_t *family = NULL;      // Last metric HELP/TYPE were written for
+
+    for (const metric_t *m = atomic_load_explicit(&metrics.head, memory_order_acquire); m;
+         m = atomic_load_explicit(&m->next, memory_order_relaxed)) {
+        // Labelled metrics of one family share their HELP and TYPE lines
+        int base = (int)strcspn(m->name, "{");
+        if (!family || (int)strcspn(family->name, "{") != base ||
+            strncmp(family->name, m->name, (size_t)base) != 0) {
+            int len = snprintf(line, sizeof(line), "# HELP %.*s %s\n# TYPE %.*s %s\n",
+                               base, m->name, m->help, base, m->name, metrics_type_names[m->type]);
+            if (metrics_write_all(fd, line, (size_t)len) < 0) {
+                return -1;
+            }
+            family = m;
+        }
+        int len;
+        if (m->type == METRICS_TYPE_HISTOGRAM) {
+            if (metrics_dump_hist(fd, m) < 0) {
+                return -1;
+            }
+            continue;
+        }
+        len = snprintf(line, sizeof(line), "%s %lld\n", m->name,
+                       (long long)atomic_load_explicit(&m->value, memory_order_relaxed));
+        if (metrics_write_all(fd, line, (size_t)len) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *metrics_thread(void *arg) {
+    (void)arg;
+    struct pollfd pfds[2] = {
+        { .fd = metrics.listen_fd, .events = POLLIN },
+        { .fd = metrics.stop_fd, .events = POLLIN },
+    };
+
+    for (;;) {
+        if (poll(pfds, 2, -1) < 0) {
+            continue;
+        }
+        if (pfds[1].revents) {
+            break;
+        }
+        if (!(pfds[0].revents & POLLIN)) {
+            continue;
+        }
+        int fd = accept4(metrics.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        // One snapshot per connection; a client that stops reading only
+        // holds up the next scrape, never the code being measured
+        struct timeval tv = { .tv_sec = 1 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        metrics_dump(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_start(void) {
+    if (metrics.running) {
+        return 0;
+    }
+
+    const char *path = getenv("WALLET_METRICS");
+    if (!path) {
+        path = METRICS_SOCKET_PATH;
+    }
+    if (!*path) {
+        return 0;
+    }
+    if (strlen(path) >= sizeof(metrics.path)) {
+        WLOG_ERROR("Metrics socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(metrics.path, path);
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, metrics.path);
+
+    metrics.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    metrics.stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (metrics.listen_fd < 0 || metrics.stop_fd < 0) {
+        goto fail;
+    }
+    unlink(metrics.path);       // Left behind by a previous run
+    if (bind(metrics.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        chmod(metrics.path, 0660) < 0 ||
+        listen(metrics.listen_fd, 4) < 0) {
+        WLOG_ERROR("Cannot serve metrics on %s", metrics.path);
+        goto fail;
+    }
+    if (pthread_create(&metrics.thread, NULL, metrics_thread, NULL) != 0) {
+        goto fail;
+    }
+    metrics.running = true;
+    WLOG_INFO("Metrics served on %s", metrics.path);
+    return 0;
+
+fail:
+    if (metrics.listen_fd >= 0) {
+        close(metrics.listen_fd);
+        metrics.listen_fd = -1;
+        unlink(metrics.path);
+    }
+    if (metrics.stop_fd >= 0) {
+        close(metrics.stop_fd);
+        metrics.stop_fd = -1;
+    }
+    return -1;
+}
+
+void metrics_stop(void) {
+    if (!metrics.running) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(metrics.stop_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(metrics.thread, NULL);
+    }
+    metrics.running = false;
+    close(metrics.listen_fd);
+    metrics.listen_fd = -1;
+    close(metrics.stop_fd);
+    metrics.stop_fd = -1;
+    unlink(metrics.path);
+}
@@ -0,0 +1,609 @@
+#define WLOG_MODULE ui
+#include "wallet_qr.h"
+#include "wallet_log.h"
+#include "wallet_metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+// Error correction codewords per block, and blocks, by level and version
+static const uint8_t ecc_block_len[4][QR_MAX_VERSION + 1] = {
+    [QR_ECC_L] = { 0,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18 },
+    [QR_ECC_M] = { 0, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26 },
+    [QR_ECC_Q] = { 0, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24 },
+    [QR_ECC_H] = { 0, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28 },
+};
+static const uint8_t ecc_blocks[4][QR_MAX_VERSION + 1] = {
+    [QR_ECC_L] = { 0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4 },
+    [QR_ECC_M] = { 0, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5 },
+    [QR_ECC_Q] = { 0, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8 },
+    [QR_ECC_H] = { 0, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8 },
+};
+static const uint8_t ecc_format_bits[4] = {
+    [QR_ECC_L] = 1, [QR_ECC_M] = 0, [QR_ECC_Q] = 3, [QR_ECC_H] = 2,
+};
+
+#define QR_MAX_CODEWORDS 346    // All codewords of version 10
+#define QR_MAX_BLOCKS 8
+#define QR_MAX_ECC_LEN 30
+
+// Where the URI is longer than this, the request is not cached
+#define QR_ADDRESS_MAX 128
+
+METRICS_HISTOGRAM(m_qr_render_us, "wallet_qr_render_microseconds",
+                  "Time to encode and render a receive QR code");
+METRICS_COUNTER(m_qr_cache_hits, "wallet_qr_cache_hits_total", "Receive QR codes served from the cache");
+
+/**
+ * Code under construction, with the map of modules that belong to
+ * function patterns and must not carry data or be masked
+ */
+typedef struct {
+    qr_code_t *qr;
+    uint8_t function[QR_MAX_SIZE][QR_MAX_SIZE];
+} qr_build_t;
+
+typedef struct {
+    char address[QR_ADDRESS_MAX];
+    uint64_t amount;
+    int max_width;
+    int max_height;
+    uint32_t used;          // Last use, 0 for a free entry
+    qr_bitmap_t bitmap;
+} qr_cache_entry_t;
+
+static struct {
+    qr_cache_entry_t entries[WALLET_QR_CACHE_SIZE];
+    uint32_t clock;
+    uint32_t serial;
+} qr_cache;
+
+static int raw_codewords(int ver) {
+    int modules = (16 * ver + 128) * ver + 64;
+    if (ver >= 2) {
+        int align = ver / 7 + 2;
+        modules -= (25 * align - 10) * align - 55;
+        if (ver >= 7) {
+            modules -= 36;
+        }
+    }
+    return modules / 8;
+}
+
+static int data_codewords(int ver, qr_ecc_t ecc) {
+    return raw_codewords(ver) - ecc_block_len[ecc][ver] * ecc_blocks[ecc][ver];
+}
+
+// Mode indicator, character count and the bytes themselves
+static size_t data_bits(int ver, size_t len) {
+    return 4 + (ver < 10 ? 8 : 16) + len * 8;
+}
+
+// GF(256) over x^8 + x^4 + x^3 + x^2 + 1, filled on first use
+static uint8_t gf_exp[255];
+static uint8_t gf_log[256];
+
+static void gf_init(void) {
+    if (gf_exp[0]) {
+        return;
+    }
+    unsigned x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= 0x11D;
+        }
+    }
+}
+
+static uint8_t gf_mul(uint8_t x, uint8_t y) {
+    return x && y ? gf_exp[(gf_log[x] + gf_log[y]) % 255] : 0;
+}
+
+// Reed-Solomon generator polynomial, highest coefficient (always 1) left out
+static void rs_divisor(int degree, uint8_t *gen) {
+    memset(gen, 0, degree);
+    gen[degree - 1] = 1;
+    uint8_t root = 1;
+    for (int i = 0; i < degree; i++) {
+        for (int j = 0; j < degree; j++) {
+            gen[j] = gf_mul(gen[j], root);
+            if (j + 1 < degree) {
+                gen[j] ^= gen[j + 1];
+            }
+        }
+        root = gf_mul(root, 0x02);
+    }
+}
+
+static void rs_remainder(const uint8_t *data, int len, const uint8_t *gen, int degree, uint8_t *rem) {
+    memset(rem, 0, degree);
+    for (int i = 0; i < len; i++) {
+        uint8_t factor = data[i] ^ rem[0];
+        memmove(rem, rem + 1, degree - 1);
+        rem[degree - 1] = 0;
+        for (int j = 0; j < degree; j++) {
+            rem[j] ^= gf_mul(gen[j], factor);
+        }
+    }
+}
+
+static void set_function(qr_build_t *b, int x, int y, bool dark) {
+    b->qr->modules[y][x] = dark;
+    b->function[y][x] = 1;
+}
+
+static void draw_finder(qr_build_t *b, int cx, int cy) {
+    int size = b->qr->size;
+    for (int dy = -4; dy <= 4; dy++) {
+        for (int dx = -4; dx <= 4; dx++) {
+            int x = cx + dx, y = cy + dy;
+            int dist = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+            if (x >= 0 && x < size && y >= 0 && y < size) {
+                set_function(b, x, y, dist != 2 && dist != 4);
+            }
+        }
+    }
+}
+
+static void draw_alignment(qr_build_t *b, int cx, int cy) {
+    for (int dy = -2; dy <= 2; dy++) {
+        for (int dx = -2; dx <= 2; dx++) {
+            set_function(b, cx + dx, cy + dy, (abs(dx) > abs(dy) ? abs(dx) : abs(dy)) != 1);
+        }
+    }
+}
+
+// Level and mask, BCH-protected
+static unsigned format_bits(qr_ecc_t ecc, uint8_t mask) {
+    unsigned data = (unsigned)ecc_format_bits[ecc] << 3 | mask;
+    unsigned rem = data;
+    for (int i = 0; i < 10; i++) {
+        rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+    }
+    return (data << 10 | rem) ^ 0x5412;
+}
+
+/**
+ * Where format bit i goes: the first copy wraps around the top left
+ * finder, the second is split between the other two
+ */
+static void format_position(int size, int copy, int i, int *x, int *y) {
+    if (copy == 0) {
+        *x = i < 8 ? 8 : i == 8 ? 7 : 14 - i;
+        *y = i < 6 ? i : i < 8 ? i + 1 : 8;
+    } else {
+        *x = i < 8 ? size - 1 - i : 8;
+        *y = i < 8 ? 8 : size - 15 + i;
+    }
+}
+
+static void draw_format(qr_build_t *b, uint8_t mask) {
+    int size = b->qr->size;
+    unsigned bits = format_bits(b->qr->ecc, mask);
+    for (int copy = 0; copy < 2; copy++) {
+        for (int i = 0; i < 15; i++) {
+            int x, y;
+            format_position(size, copy, i, &x, &y);
+            set_function(b, x, y, (bits >> i) & 1);
+        }
+    }
+    set_function(b, 8, size - 8, true);
+}
+
+static void draw_version(qr_build_t *b) {
+    int ver = b->qr->version;
+    if (ver < 7) {
+        return;
+    }
+    unsigned rem = ver;
+    for (int i = 0; i < 12; i++) {
+        rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
+    }
+    unsigned long bits = (unsigned long)ver << 12 | rem;
+    for (int i = 0; i < 18; i++) {
+        bool bit = (bits >> i) & 1;
+        int a = b->qr->size - 11 + i % 3;
+        int c = i / 3;
+        set_function(b, a, c, bit);
+        set_function(b, c, a, bit);
+    }
+}
+
+static void draw_function_patterns(qr_build_t *b) {
+    int size = b->qr->size;
+    for (int i = 0; i < size; i++) {
+        set_function(b, 6, i, i % 2 == 0);
+        set_function(b, i, 6, i % 2 == 0);
+    }
+    draw_finder(b, 3, 3);
+    draw_finder(b, size - 4, 3);
+    draw_finder(b, 3, size - 4);
+
+    int ver = b->qr->version;
+    if (ver >= 2) {
+        int n = ver / 7 + 2;
+        int step = (ver * 4 + n * 2 + 1) / (n * 2 - 2) * 2;
+        int pos[QR_MAX_VERSION / 7 + 2];
+        pos[0] = 6;
+        for (int i = n - 1, p = size - 7; i >= 1; i--, p -= step) {
+            pos[i] = p;
+        }
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                // Not on top of the finders
+                if ((i == 0 && j == 0) || (i == 0 && j == n - 1) || (i == n - 1 && j == 0)) {
+                    continue;
+                }
+                draw_alignment(b, pos[i], pos[j]);
+            }
+        }
+    }
+
+    // Reserved for now; the real format bits follow the mask choice
+    draw_format(b, 0);
+    draw_version(b);
+}
+
+// Codewords in the up-and-down zigzag of column pairs, right to left
+static void draw_codewords(qr_build_t *b, const uint8_t *cw, int len) {
+    int size = b->qr->size;
+    int i = 0;
+    for (int right = size - 1; right >= 1; right -= 2) {
+        if (right == 6) {
+            right = 5;      // Skip the vertical timing pattern
+        }
+        for (int vert = 0; vert < size; vert++) {
+            for (int j = 0; j < 2; j++) {
+                int x = right - j;
+                bool upward = ((right + 1) & 2) == 0;
+                int y = upward ? size - 1 - vert : vert;
+                if (!b->function[y][x] && i < len * 8) {
+                    b->qr->modules[y][x] = (cw[i >> 3] >> (7 - (i & 7))) & 1;
+                    i++;
+                }
+            }
+        }
+    }
+}
+
+static bool mask_bit(uint8_t mask, int x, int y) {
+    switch (mask) {
+    case 0: return (x + y) % 2 == 0;
+    case 1: return y % 2 == 0;
+    case 2: return x % 3 == 0;
+    case 3: return (x + y) % 3 == 0;
+    case 4: return (x / 3 + y / 2) % 2 == 0;
+    case 5: return x * y % 2 + x * y % 3 == 0;
+    case 6: return (x * y % 2 + x * y % 3) % 2 == 0;
+    default: return ((x + y) % 2 + x * y % 3) % 2 == 0;
+    }
+}
+
+// One row or column of modules, bit i = module i; the finder check reads
+// four bits past the last possible pattern
+typedef uint64_t qr_line_t;
+_Static_assert(QR_MAX_SIZE + 4 <= 64, "qr_line_t too narrow");
+
+// Every mask repeats every 6 modules across, so a row of it is its first
+// 6 bits over and over
+static qr_line_t mask_row(uint8_t mask, int y) {
+    qr_line_t period = 0;
+    for (int x = 0; x < 6; x++) {
+        period |= (qr_line_t)mask_bit(mask, x, y) << x;
+    }
+    qr_line_t row = 0;
+    for (int x = 0; x < 64; x += 6) {
+        row |= period << x;
+    }
+    return row;
+}
+
+static void apply_mask(qr_build_t *b, uint8_t mask) {
+    int size = b->qr->size;
+    for (int y = 0; y < size; y++) {
+        qr_line_t row = mask_row(mask, y);
+        for (int x = 0; x < size; x++) {
+            b->qr->modules[y][x] ^= (uint8_t)((row >> x) & 1) & !b->function[y][x];
+        }
+    }
+}
+
+// Runs of five or more, and dark-light-dark-dark-dark-light-dark with
+// four light modules on a side (outside the code counts as light), for
+// every position of the line at once
+static long line_penalty(qr_line_t line, int size) {
+    long result = 0;
+
+    // A run ends wherever the next module differs
+    qr_line_t ends = (line ^ (line >> 1)) & ((1ULL << (size - 1)) - 1);
+    int start = 0;
+    while (ends) {
+        int end = __builtin_ctzll(ends);
+        int run = end - start + 1;
+        result += run >= 5 ? run - 2 : 0;
+        start = end + 1;
+        ends &= ends - 1;
+    }
+    int run = size - start;
+    result += run >= 5 ? run - 2 : 0;
+
+    qr_line_t light = ~line;
+    qr_line_t finder = line & (light >> 1) & (line >> 2) & (line >> 3) & (line >> 4) &
+                       (light >> 5) & (line >> 6);
+    qr_line_t light_before = ((light << 1) | 0x1) & ((light << 2) | 0x3) &
+                             ((light << 3) | 0x7) & ((light << 4) | 0xF);
+    qr_line_t light_after = (light >> 7) & (light >> 8) & (light >> 9) & (light >> 10);
+    return result + 40L * __builtin_popcountll(finder & (light_before | light_after));
+}
+
+/**
+ * Mask penalty from the standard: runs, 2x2 blocks, finder look-alikes
+ * and dark/light imbalance, worked out on whole rows and columns at once
+ */
+static long penalty(const qr_line_t *rows, int size) {
+    qr_line_t cols[QR_MAX_SIZE] = { 0 };
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            cols[x] |= ((rows[y] >> x) & 1) << y;
+        }
+    }
+
+    long result = 0;
+    long dark = 0;
+    qr_line_t pairs = (1ULL << (size - 1)) - 1;     // Left module of each pair
+    for (int i = 0; i < size; i++) {
+        result += line_penalty(rows[i], size) + line_penalty(cols[i], size);
+        dark += __builtin_popcountll(rows[i]);
+        if (i + 1 < size) {
+            qr_line_t differ = (rows[i] ^ (rows[i] >> 1)) | (rows[i + 1] ^ (rows[i + 1] >> 1)) |
+                               (rows[i] ^ rows[i + 1]);
+            result += 3L * __builtin_popcountll(~differ & pairs);
+        }
+    }
+    long total = (long)size * size;
+    long k = (labs(dark * 20 - total * 10) + total - 1) / total - 1;
+    return result + k * 10;
+}
+
+int qr_encode(const uint8_t *data, size_t len, qr_ecc_t ecc, qr_code_t *qr) {
+    if (!data || !qr || ecc > QR_ECC_H) {
+        return -1;
+    }
+
+    int ver = 1;
+    while (ver <= QR_MAX_VERSION && data_bits(ver, len) > (size_t)data_codewords(ver, ecc) * 8) {
+        ver++;
+    }
+    if (ver > QR_MAX_VERSION) {
+        return -1;
+    }
+    // Spend whatever room the version has left on error correction
+    while (ecc < QR_ECC_H && data_bits(ver, len) <= (size_t)data_codewords(ver, ecc + 1) * 8) {
+        ecc++;
+    }
+
+    // Data codewords: mode, count, bytes, terminator, padding
+    uint8_t cw[QR_MAX_CODEWORDS] = { 0 };
+    size_t capacity = (size_t)data_codewords(ver, ecc) * 8;
+    size_t bit = 0;
+#define PUT_BITS(value, n) do {                                         \
+        for (int _i = (n) - 1; _i >= 0; _i--, bit++) {                  \
+            cw[bit >> 3] |= (uint8_t)((((value) >> _i) & 1U) << (7 - (bit & 7))); \
+        }                                                               \
+    } while (0)
+    PUT_BITS(0x4U, 4);
+    PUT_BITS((unsigned)len, ver < 10 ? 8 : 16);
+    for (size_t i = 0; i < len; i++) {
+        PUT_BITS(data[i], 8);
+    }
+#undef PUT_BITS
+    bit += capacity - bit < 4 ? capacity - bit : 4;
+    size_t n_data = (bit + 7) / 8;
+    for (uint8_t pad = 0xEC; n_data < capacity / 8; pad ^= 0xEC ^ 0x11) {
+        cw[n_data++] = pad;
+    }
+
+    // Split into blocks, add error correction and interleave
+    int blocks = ecc_blocks[ecc][ver];
+    int ecc_len = ecc_block_len[ecc][ver];
+    int raw = raw_codewords(ver);
+    int short_blocks = blocks - raw % blocks;
+    int short_len = raw / blocks - ecc_len;     // Data codewords of a short block
+    uint8_t gen[QR_MAX_ECC_LEN];
+    uint8_t ecc_cw[QR_MAX_BLOCKS][QR_MAX_ECC_LEN];
+    int block_start[QR_MAX_BLOCKS];
+    gf_init();
+    rs_divisor(ecc_len, gen);
+    for (int i = 0, k = 0; i < blocks; i++) {
+        int block_len = short_len + (i >= short_blocks);
+        block_start[i] = k;
+        rs_remainder(cw + k, block_len, gen, ecc_len, ecc_cw[i]);
+        k += block_len;
+    }
+    uint8_t all[QR_MAX_CODEWORDS];
+    int n = 0;
+    for (int j = 0; j <= short_len; j++) {
+        for (int i = 0; i < blocks; i++) {
+            if (j < short_len + (i >= short_blocks)) {
+                all[n++] = cw[block_start[i] + j];
+            }
+        }
+    }
+    for (int j = 0; j < ecc_len; j++) {
+        for (int i = 0; i < blocks; i++) {
+            all[n++] = ecc_cw[i][j];
+        }
+    }
+
+    qr_build_t b = { .qr = qr };
+    memset(qr, 0, sizeof(*qr));
+    qr->version = (uint8_t)ver;
+    qr->size = (uint8_t)(ver * 4 + 17);
+    qr->ecc = ecc;
+    draw_function_patterns(&b);
+    draw_codewords(&b, all, n);
+
+    // Try every mask on rows of bits and keep the one the standard
+    // scores best; only that one is applied to the modules
+    qr_line_t code[QR_MAX_SIZE] = { 0 };
+    qr_line_t maskable[QR_MAX_SIZE] = { 0 };
+    int size = qr->size;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            code[y] |= (qr_line_t)qr->modules[y][x] << x;
+            maskable[y] |= (qr_line_t)!b.function[y][x] << x;
+        }
+    }
+    long best = -1;
+    for (uint8_t mask = 0; mask < 8; mask++) {
+        qr_line_t rows[QR_MAX_SIZE];
+        for (int y = 0; y < size; y++) {
+            rows[y] = code[y] ^ (mask_row(mask, y) & maskable[y]);
+        }
+        unsigned bits = format_bits(ecc, mask);
+        for (int copy = 0; copy < 2; copy++) {
+            for (int i = 0; i < 15; i++) {
+                int x, y;
+                format_position(size, copy, i, &x, &y);
+                rows[y] = (rows[y] & ~(1ULL << x)) | (qr_line_t)((bits >> i) & 1) << x;
+            }
+        }
+        long score = penalty(rows, size);
+        if (best < 0 || score < best) {
+            best = score;
+            qr->mask = mask;
+        }
+    }
+    apply_mask(&b, qr->mask);
+    draw_format(&b, qr->mask);
+    return 0;
+}
+
+int qr_render_1bpp(const qr_code_t *qr, int scale, int width, uint8_t *dst, size_t stride) {
+    if (!qr || !dst || scale < 1 || width % 8 != 0 || (size_t)width / 8 > stride) {
+        return -1;
+    }
+    int span = (qr->size + 2 * QR_QUIET_ZONE) * scale;
+    if (span > width) {
+        return -1;
+    }
+    size_t bytes = width / 8;
+    int left = (width - span) / 2 + QR_QUIET_ZONE * scale;
+    int row = 0;
+
+    for (; row < QR_QUIET_ZONE * scale; row++) {
+        memset(dst + row * stride, 0xFF, bytes);
+    }
+    // Each row of modules is drawn once and copied down for the scale
+    for (int y = 0; y < qr->size; y++) {
+        uint8_t *line = dst + row * stride;
+        memset(line, 0xFF, bytes);
+        for (int x = 0; x < qr->size; x++) {
+            if (!qr->modules[y][x]) {
+                continue;
+            }
+            for (int px = left + x * scale, end = px + scale; px < end; px++) {
+                line[px >> 3] &= (uint8_t)~(0x80 >> (px & 7));
+            }
+        }
+        for (row++; row < (QR_QUIET_ZONE + y + 1) * scale; row++) {
+            memcpy(dst + row * stride, line, bytes);
+        }
+    }
+    for (int i = 0; i < QR_QUIET_ZONE * scale; i++, row++) {
+        memset(dst + row * stride, 0xFF, bytes);
+    }
+    return row;
+}
+
+// monero: URI, with the amount in XMR and no trailing zeros
+static int receive_uri(char *uri, size_t size, const char *address, uint64_t amount) {
+    int len;
+    if (amount == 0) {
+        len = snprintf(uri, size, "monero:%s", address);
+    } else {
+        len = snprintf(uri, size, "monero:%s?tx_amount=%" PRIu64 ".%012" PRIu64,
+                       address, amount / (uint64_t)1000000000000, amount % (uint64_t)1000000000000);
+        while (len > 0 && (size_t)len < size && uri[len - 1] == '0') {
+            uri[--len] = '\0';
+        }
+        if (len > 0 && (size_t)len < size && uri[len - 1] == '.') {
+            uri[--len] = '\0';
+        }
+    }
+    return len > 0 && (size_t)len < size ? len : -1;
+}
+
+static int render_receive(qr_bitmap_t *bitmap, const char *address, uint64_t amount,
+                          int max_width, int max_height) {
+    char uri[QR_ADDRESS_MAX + 48];
+    int len = receive_uri(uri, sizeof(uri), address, amount);
+    if (len < 0) {
+        return -1;
+    }
+    qr_code_t qr;
+    if (qr_encode((const uint8_t *)uri, len, QR_ECC_L, &qr) < 0) {
+        return -1;
+    }
+
+    int room = max_width < max_height ? max_width : max_height;
+    if (room > QR_BITMAP_MAX_WIDTH) {
+        room = QR_BITMAP_MAX_WIDTH;
+    }
+    int scale = room / (qr.size + 2 * QR_QUIET_ZONE);
+    int width = ((qr.size + 2 * QR_QUIET_ZONE) * scale + 7) & ~7;
+    if (scale < 1 || width > (max_width & ~7)) {
+        return -1;
+    }
+    bitmap->width = width;
+    bitmap->stride = width / 8;
+    int rows = qr_render_1bpp(&qr, scale, width, bitmap->bits, bitmap->stride);
+    if (rows < 0) {
+        return -1;
+    }
+    bitmap->height = rows;
+    WLOG_DEBUG("Receive QR: version %d, level %d, mask %d, %d px/module, %dx%d",
+               qr.version, qr.ecc, qr.mask, scale, bitmap->width, bitmap->height);
+    return 0;
+}
+
+const qr_bitmap_t *wallet_qr_receive(const char *address, uint64_t amount,
+                                     int max_width, int max_height) {
+    if (!address || strlen(address) >= QR_ADDRESS_MAX) {
+        return NULL;
+    }
+
+    qr_cache_entry_t *victim = &qr_cache.entries[0];
+    for (int i = 0; i < WALLET_QR_CACHE_SIZE; i++) {
+        qr_cache_entry_t *e = &qr_cache.entries[i];
+        if (e->used && e->amount == amount && e->max_width == max_width &&
+            e->max_height == max_height && strcmp(e->address, address) == 0) {
+            e->used = ++qr_cache.clock;
+            metrics_inc(&m_qr_cache_hits);
+            return &e->bitmap;
+        }
+        if (e->used < victim->used) {
+            victim = e;
+        }
+    }
+
+    uint64_t start = metrics_now_us();
+    victim->used = 0;
+    if (render_receive(&victim->bitmap, address, amount, max_width, max_height) < 0) {
+        WLOG_WARN("Receive QR does not fit in %dx%d", max_width, max_height);
+        return NULL;
+    }
+    strcpy(victim->address, address);
+    victim->amount = amount;
+    victim->max_width = max_width;
+    victim->max_height = max_height;
+    victim->used = ++qr_cache.clock;
+    victim->bitmap.serial = ++qr_cache.serial;
+    metrics_observe(&m_qr_render_us, metrics_now_us() - start);
+    return &victim->bitmap;
+}
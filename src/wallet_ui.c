@@ -1,154 +1,603 @@
+#define WLOG_MODULE ui
 #include "wallet_ui.h"
 #include "display_fbdev.h"
+#include "keypad.h"
+#include "wallet_log.h"
+#include "wallet_fonts.h"
+#include "epd_theme.h"
+#include "wallet_qr.h"
+#include "tx_history.h"
 #include <lvgl.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+
+/*
+ * Every screen is built once in wallet_ui_init() and kept for the life of
+ * the UI. Showing a screen only rewrites the labels whose text changed,
+ * so re-showing one with the same content invalidates nothing and LVGL's
+ * heap never sees the create/delete churn of per-use screens.
+ */
+typedef enum {
+    UI_SCREEN_MAIN,
+    UI_SCREEN_CONFIRM,
+    UI_SCREEN_ERROR,
+    UI_SCREEN_ADDRESS,
+    UI_SCREEN_RECEIVE,
+    UI_SCREEN_LIST,
+    UI_SCREEN_COUNT
+} ui_screen_id_t;
+
+typedef struct {
+    lv_obj_t *screen;
+    lv_group_t *group;      // Focus order of the screen's buttons
+} ui_screen_t;
+
+static ui_screen_t screens[UI_SCREEN_COUNT];
+
+// Screens kept out of the display's retained-frame cache
+static const bool screen_sensitive[UI_SCREEN_COUNT] = {
+    [UI_SCREEN_CONFIRM] = true,
+    [UI_SCREEN_ADDRESS] = true,
+    [UI_SCREEN_RECEIVE] = true,
+    [UI_SCREEN_LIST] = true,
+};
 
 static lv_obj_t *balance_label = NULL;
 static lv_obj_t *status_label = NULL;
-static lv_obj_t *main_screen = NULL;
-static bool transaction_confirmed = false;
 
-static void btn_event_cb(lv_event_t *e) {
-    lv_event_code_t code = lv_event_get_code(e);
-    if (code == LV_EVENT_CLICKED) {
-        transaction_confirmed = true;
+static struct {
+    lv_obj_t *amount;
+    lv_obj_t *fee;
+    lv_obj_t *address;
+    lv_obj_t *pending;
+    lv_obj_t *cancel_btn;
+} confirm_ui;
+
+static struct {
+    lv_obj_t *message;
+} error_ui;
+
+static struct {
+    lv_obj_t *address;
+} address_ui;
+
+// Receive QR code: below the amount, as large as fits above the
+// address line and the Back button
+#define RECEIVE_QR_Y 54
+#define RECEIVE_QR_MAX_HEIGHT 112
+#define RECEIVE_ADDRESS_Y 60
+
+static struct {
+    lv_obj_t *amount;
+    lv_obj_t *address;
+    lv_obj_t *qr;                   // Stands in for the QR overlay
+    uint32_t qr_serial;             // Code on screen, 0 for none
+} receive_ui;
+
+// List screen: a title, then rows down to the bottom of the panel
+#define LIST_Y 32
+#define LIST_HEIGHT 214
+
+static struct {
+    lv_obj_t *title;
+    ui_list_t list;
+} list_ui;
+
+typedef struct {
+    uint32_t id;
+    wallet_ui_tx_t tx;
+    wallet_ui_confirm_cb_t cb;
+    void *ctx;
+} confirm_request_t;
+
+/*
+ * Confirmations waiting for the user, in request order; the first one is
+ * on screen
+ */
+static struct {
+    confirm_request_t queue[WALLET_UI_CONFIRM_QUEUE_SIZE];
+    int count;
+    uint32_t next_id;
+} confirms;
+
+/**
+ * Set a label's text only if it differs, so unchanged fields are not
+ * invalidated and redrawn
+ */
+static void ui_set_text(lv_obj_t *label, const char *text) {
+    const char *current = lv_label_get_text(label);
+    if (current && strcmp(current, text) == 0) {
+        return;
+    }
+    lv_label_set_text(label, text);
+}
+
+/**
+ * Switch screens; the keypad follows the new screen's group
+ */
+static void ui_show(ui_screen_id_t id) {
+    ui_screen_t *s = &screens[id];
+    if (!s->screen) return;
+
+    // The receive QR is drawn by the display, not LVGL
+    if (id != UI_SCREEN_RECEIVE) {
+        display_fbdev_set_overlay(NULL, 0, 0, 0, 0, 0);
+    }
+    display_fbdev_set_sensitive(screen_sensitive[id]);
+    if (lv_scr_act() != s->screen) {
+        lv_scr_load(s->screen);
+    }
+    keypad_set_group(s->group);
+}
+
+/**
+ * Create a screen and make its group the default while it is built, so
+ * its buttons join it
+ */
+static lv_obj_t *ui_screen_begin(ui_screen_id_t id) {
+    ui_screen_t *s = &screens[id];
+    s->screen = lv_obj_create(NULL);
+    s->group = lv_group_create();
+    if (!s->screen || !s->group) {
+        return NULL;
+    }
+    lv_group_set_default(s->group);
+    return s->screen;
+}
+
+static lv_obj_t *ui_label(lv_obj_t *parent, lv_align_t align, lv_coord_t y,
+                          const lv_font_t *font, const char *text) {
+    lv_obj_t *label = lv_label_create(parent);
+    lv_obj_align(label, align, 0, y);
+    lv_label_set_text(label, text);
+    lv_obj_set_style_text_font(label, font, 0);
+    return label;
+}
+
+/**
+ * Label that wraps across the screen width, for addresses and messages
+ */
+static lv_obj_t *ui_wrapped_label(lv_obj_t *parent, lv_coord_t y, const lv_font_t *font) {
+    lv_obj_t *label = ui_label(parent, LV_ALIGN_TOP_MID, y, font, "");
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_width(label, display_fbdev_get_width() - 8);
+    lv_obj_set_style_text_align(label, LV_TEXT_ALIGN_CENTER, 0);
+    return label;
+}
+
+static lv_obj_t *ui_button(lv_obj_t *parent, lv_align_t align, lv_coord_t x, lv_coord_t y,
+                           const char *text, lv_event_cb_t cb) {
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_align(btn, align, x, y);
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text(label, text);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+    // A long press of OK sends ESC, which buttons report as CANCEL
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CANCEL, NULL);
+    return btn;
+}
+
+static void confirm_update_pending(void) {
+    char pending_str[32] = "";
+    if (confirms.count > 1) {
+        snprintf(pending_str, sizeof(pending_str), "%d more waiting", confirms.count - 1);
+    }
+    ui_set_text(confirm_ui.pending, pending_str);
+}
+
+/**
+ * Whether a screen is the one LVGL is showing
+ */
+static bool ui_active(ui_screen_id_t id) {
+    return screens[id].screen && lv_scr_act() == screens[id].screen;
+}
+
+/**
+ * Put the first waiting confirmation on the confirm screen. Screens are
+ * only switched if the confirm screen is showing: back to the main
+ * screen once nothing is left. A user on another screen stays there.
+ */
+static void confirm_show_head(void) {
+    bool active = ui_active(UI_SCREEN_CONFIRM);
+    if (confirms.count == 0) {
+        if (active) {
+            ui_show(UI_SCREEN_MAIN);
+        }
+        return;
+    }
+    const wallet_ui_tx_t *tx = &confirms.queue[0].tx;
+
+    char amount_str[64];
+    snprintf(amount_str, sizeof(amount_str), "Amount: %.12f XMR", tx->amount / 1e12);
+    ui_set_text(confirm_ui.amount, amount_str);
+
+    char fee_str[64];
+    snprintf(fee_str, sizeof(fee_str), "Fee: %.12f XMR", tx->fee / 1e12);
+    ui_set_text(confirm_ui.fee, fee_str);
+
+    // Address label (truncated)
+    char addr_display[32];
+    if (tx->address[0]) {
+        snprintf(addr_display, sizeof(addr_display), "To: %.12s...", tx->address);
+    } else {
+        strcpy(addr_display, "To: Unknown");
+    }
+    ui_set_text(confirm_ui.address, addr_display);
+
+    confirm_update_pending();
+
+    // A new head starts on Cancel so a stray OK press does not approve
+    if (active) {
+        lv_group_focus_obj(confirm_ui.cancel_btn);
+    }
+}
+
+/**
+ * Go to the first waiting confirmation, or the main screen if there is none
+ */
+static void confirm_open(void) {
+    confirm_show_head();
+    if (confirms.count == 0) {
+        ui_show(UI_SCREEN_MAIN);
+        return;
+    }
+    ui_show(UI_SCREEN_CONFIRM);
+    lv_group_focus_obj(confirm_ui.cancel_btn);
+}
+
+/**
+ * Remove a confirmation and report it; the screen is updated first so
+ * the callback can already queue another
+ */
+static void confirm_finish(int index, bool accepted) {
+    confirm_request_t req = confirms.queue[index];
+    confirms.count--;
+    memmove(&confirms.queue[index], &confirms.queue[index + 1],
+            (confirms.count - index) * sizeof(confirms.queue[0]));
+    if (index == 0) {
+        confirm_show_head();
+    } else {
+        confirm_update_pending();
+    }
+
+    if (req.cb) {
+        req.cb(&req.tx, accepted, req.ctx);
+    }
+}
+
+static void confirm_btn_event_cb(lv_event_t *e) {
+    if (confirms.count > 0) {
+        confirm_finish(0, lv_event_get_code(e) == LV_EVENT_CLICKED);
     }
 }
 
 static void cancel_btn_event_cb(lv_event_t *e) {
-    lv_event_code_t code = lv_event_get_code(e);
-    if (code == LV_EVENT_CLICKED) {
-        transaction_confirmed = false;
+    (void)e;
+    if (confirms.count > 0) {
+        confirm_finish(0, false);
     }
 }
 
+// Back to a waiting confirmation if there is one, else the main screen
+static void back_btn_event_cb(lv_event_t *e) {
+    (void)e;
+    confirm_open();
+}
+
+static int build_main_screen(void) {
+    lv_obj_t *scr = ui_screen_begin(UI_SCREEN_MAIN);
+    if (!scr) return -1;
+
+    balance_label = ui_label(scr, LV_ALIGN_TOP_MID, 20, wallet_font(WALLET_FONT_18), "Balance: 0.000000000 XMR");
+    status_label = ui_label(scr, LV_ALIGN_BOTTOM_MID, -20, wallet_font(WALLET_FONT_14), "Ready");
+    return 0;
+}
+
+static int build_confirm_screen(void) {
+    lv_obj_t *scr = ui_screen_begin(UI_SCREEN_CONFIRM);
+    if (!scr) return -1;
+
+    confirm_ui.pending = ui_label(scr, LV_ALIGN_TOP_MID, 2, wallet_font(WALLET_FONT_12), "");
+    confirm_ui.amount = ui_label(scr, LV_ALIGN_TOP_MID, 20, wallet_font(WALLET_FONT_16), "");
+    confirm_ui.address = ui_label(scr, LV_ALIGN_CENTER, -20, wallet_font(WALLET_FONT_14), "");
+    confirm_ui.fee = ui_label(scr, LV_ALIGN_CENTER, 5, wallet_font(WALLET_FONT_14), "");
+    ui_button(scr, LV_ALIGN_BOTTOM_LEFT, 20, -20, "Confirm", confirm_btn_event_cb);
+    confirm_ui.cancel_btn = ui_button(scr, LV_ALIGN_BOTTOM_RIGHT, -20, -20, "Cancel", cancel_btn_event_cb);
+    return 0;
+}
+
+static int build_error_screen(void) {
+    lv_obj_t *scr = ui_screen_begin(UI_SCREEN_ERROR);
+    if (!scr) return -1;
+
+    ui_label(scr, LV_ALIGN_TOP_MID, 20, wallet_font(WALLET_FONT_18), "Error");
+    error_ui.message = ui_wrapped_label(scr, 60, wallet_font(WALLET_FONT_14));
+    ui_button(scr, LV_ALIGN_BOTTOM_MID, 0, -20, "OK", back_btn_event_cb);
+    return 0;
+}
+
+static int build_address_screen(void) {
+    lv_obj_t *scr = ui_screen_begin(UI_SCREEN_ADDRESS);
+    if (!scr) return -1;
+
+    ui_label(scr, LV_ALIGN_TOP_MID, 10, wallet_font(WALLET_FONT_16), "Address");
+    address_ui.address = ui_wrapped_label(scr, 40, wallet_font(WALLET_FONT_12));
+    ui_button(scr, LV_ALIGN_BOTTOM_MID, 0, -20, "Back", back_btn_event_cb);
+    return 0;
+}
+
+static int build_receive_screen(void) {
+    lv_obj_t *scr = ui_screen_begin(UI_SCREEN_RECEIVE);
+    if (!scr) return -1;
+
+    ui_label(scr, LV_ALIGN_TOP_MID, 10, wallet_font(WALLET_FONT_16), "Receive");
+    receive_ui.amount = ui_label(scr, LV_ALIGN_TOP_MID, 35, wallet_font(WALLET_FONT_14), "");
+    receive_ui.address = ui_wrapped_label(scr, RECEIVE_ADDRESS_Y, wallet_font(WALLET_FONT_12));
+    receive_ui.qr = lv_obj_create(scr);
+    lv_obj_remove_style_all(receive_ui.qr);
+    lv_obj_add_flag(receive_ui.qr, LV_OBJ_FLAG_HIDDEN);
+    ui_button(scr, LV_ALIGN_BOTTOM_MID, 0, -20, "Back", back_btn_event_cb);
+    return 0;
+}
+
+// No Back button: the list owns the focus, a long press goes back
+static int build_list_screen(void) {
+    lv_obj_t *scr = ui_screen_begin(UI_SCREEN_LIST);
+    if (!scr) return -1;
+
+    list_ui.title = ui_label(scr, LV_ALIGN_TOP_MID, 8, wallet_font(WALLET_FONT_16), "");
+    return ui_list_init(&list_ui.list, scr, screens[UI_SCREEN_LIST].group, LIST_Y, LIST_HEIGHT,
+                        wallet_font(WALLET_FONT_14), back_btn_event_cb);
+}
+
 int wallet_ui_init(void) {
-    printf("Initializing wallet UI...\n");
-    
-    // Create main screen
-    main_screen = lv_obj_create(NULL);
-    if (!main_screen) {
-        fprintf(stderr, "Failed to create main screen\n");
-        return -1;
-    }
-    lv_scr_load(main_screen);
-    printf("Main screen created and loaded\n");
-    
-    // Create balance label
-    balance_label = lv_label_create(main_screen);
-    if (!balance_label) {
-        fprintf(stderr, "Failed to create balance label\n");
-        return -1;
+    WLOG_INFO("Initializing wallet UI...");
+
+    static int (*const builders[UI_SCREEN_COUNT])(void) = {
+        [UI_SCREEN_MAIN] = build_main_screen,
+        [UI_SCREEN_CONFIRM] = build_confirm_screen,
+        [UI_SCREEN_ERROR] = build_error_screen,
+        [UI_SCREEN_ADDRESS] = build_address_screen,
+        [UI_SCREEN_RECEIVE] = build_receive_screen,
+        [UI_SCREEN_LIST] = build_list_screen,
+    };
+
+    wallet_fonts_init();
+
+    // Widgets pick up the theme when they are created
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_disp_set_theme(disp, epd_theme_init(disp, wallet_font(WALLET_FONT_14)));
+
+    // Build every screen up front; widgets join each screen's own group
+    lv_group_t *default_group = lv_group_get_default();
+    int ret = 0;
+    for (int i = 0; i < UI_SCREEN_COUNT && ret == 0; i++) {
+        ret = builders[i]();
     }
-    lv_obj_align(balance_label, LV_ALIGN_TOP_MID, 0, 20);
-    lv_label_set_text(balance_label, "Balance: 0.000000000 XMR");
-    lv_obj_set_style_text_font(balance_label, &lv_font_montserrat_18, 0);
-    printf("Balance label created\n");
-    
-    // Create status label
-    status_label = lv_label_create(main_screen);
-    if (!status_label) {
-        fprintf(stderr, "Failed to create status label\n");
+    lv_group_set_default(default_group);
+    if (ret < 0) {
+        WLOG_ERROR("Failed to create wallet screens");
+        wallet_ui_deinit();
         return -1;
     }
-    lv_obj_align(status_label, LV_ALIGN_BOTTOM_MID, 0, -20);
-    lv_label_set_text(status_label, "Ready");
-    lv_obj_set_style_text_font(status_label, &lv_font_montserrat_14, 0);
-    printf("Status label created\n");
-    
-    // Force a refresh to make sure UI is rendered
-    printf("Forcing UI refresh...\n");
-    lv_refr_now(NULL);
-    
+    WLOG_DEBUG("Wallet screens created");
+
+    ui_show(UI_SCREEN_MAIN);
     return 0;
 }
 
 void wallet_ui_deinit(void) {
-    if (main_screen) {
-        lv_obj_del(main_screen);
-        main_screen = NULL;
+    // Anything still waiting is rejected, so requesters can clean up
+    while (confirms.count > 0) {
+        confirm_finish(confirms.count - 1, false);
+    }
+
+    keypad_set_group(NULL);
+    display_fbdev_set_overlay(NULL, 0, 0, 0, 0, 0);
+    for (int i = 0; i < UI_SCREEN_COUNT; i++) {
+        if (screens[i].screen) {
+            lv_obj_del(screens[i].screen);
+        }
+        if (screens[i].group) {
+            lv_group_del(screens[i].group);
+        }
+        screens[i] = (ui_screen_t){ 0 };
     }
     balance_label = NULL;
     status_label = NULL;
+    memset(&confirm_ui, 0, sizeof(confirm_ui));
+    memset(&error_ui, 0, sizeof(error_ui));
+    memset(&address_ui, 0, sizeof(address_ui));
+    memset(&receive_ui, 0, sizeof(receive_ui));
+    memset(&list_ui, 0, sizeof(list_ui));
 }
 
 void wallet_ui_update_balance(uint64_t balance) {
     if (!balance_label) return;
-    
+
     // Convert atomic units to XMR (12 decimal places)
     char balance_str[64];
     snprintf(balance_str, sizeof(balance_str), "Balance: %.12f XMR", balance / 1e12);
-    lv_label_set_text(balance_label, balance_str);
-}
-
-int wallet_ui_confirm_transaction(uint64_t amount, const char *address) {
-    if (!main_screen) return 0;
-    
-    transaction_confirmed = false;
-    
-    // Create confirmation screen
-    lv_obj_t *confirm_screen = lv_obj_create(NULL);
-    lv_scr_load(confirm_screen);
-    
-    // Amount label
-    char amount_str[64];
-    snprintf(amount_str, sizeof(amount_str), "Amount: %.12f XMR", amount / 1e12);
-    lv_obj_t *amount_label = lv_label_create(confirm_screen);
-    lv_obj_align(amount_label, LV_ALIGN_TOP_MID, 0, 20);
-    lv_label_set_text(amount_label, amount_str);
-    lv_obj_set_style_text_font(amount_label, &lv_font_montserrat_16, 0);
-    
-    // Address label (truncated)
+    ui_set_text(balance_label, balance_str);
+}
+
+int wallet_ui_request_confirmation(const wallet_ui_tx_t *tx, wallet_ui_confirm_cb_t cb, void *ctx) {
+    if (!tx || !screens[UI_SCREEN_CONFIRM].screen) {
+        return -1;
+    }
+    if (confirms.count == WALLET_UI_CONFIRM_QUEUE_SIZE) {
+        return -1;
+    }
+
+    confirm_request_t *req = &confirms.queue[confirms.count++];
+    if (++confirms.next_id > INT32_MAX) {
+        confirms.next_id = 1;
+    }
+    req->id = confirms.next_id;
+    req->tx = *tx;
+    req->tx.address[WALLET_UI_ADDRESS_SIZE - 1] = '\0';
+    req->cb = cb;
+    req->ctx = ctx;
+
+    // A new head goes on screen if the user is on the main screen; from
+    // any other screen, Back leads to it. Otherwise only the waiting
+    // count changes.
+    if (confirms.count > 1) {
+        confirm_update_pending();
+    } else if (ui_active(UI_SCREEN_MAIN)) {
+        confirm_open();
+    } else {
+        confirm_show_head();
+    }
+    return (int)req->id;
+}
+
+int wallet_ui_cancel_confirmation(uint32_t id) {
+    for (int i = 0; i < confirms.count; i++) {
+        if (confirms.queue[i].id == id) {
+            confirm_finish(i, false);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int wallet_ui_pending_confirmations(void) {
+    return confirms.count;
+}
+
+void wallet_ui_show_main(void) {
+    ui_show(UI_SCREEN_MAIN);
+}
+
+void wallet_ui_show_address(const char *address) {
+    if (!address_ui.address) return;
+
+    ui_set_text(address_ui.address, address ? address : "");
+    ui_show(UI_SCREEN_ADDRESS);
+}
+
+void wallet_ui_show_receive(const char *address, uint64_t amount) {
+    if (!receive_ui.address) return;
+
+    char amount_str[64] = "Any amount";
+    if (amount > 0) {
+        snprintf(amount_str, sizeof(amount_str), "%.12f XMR", amount / 1e12);
+    }
+    ui_set_text(receive_ui.amount, amount_str);
+
+    const qr_bitmap_t *qr = address && address[0] ?
+        wallet_qr_receive(address, amount, display_fbdev_get_width(), RECEIVE_QR_MAX_HEIGHT) : NULL;
+    if (!qr) {
+        // No room for a code: the full address, as before
+        display_fbdev_set_overlay(NULL, 0, 0, 0, 0, 0);
+        lv_obj_add_flag(receive_ui.qr, LV_OBJ_FLAG_HIDDEN);
+        if (receive_ui.qr_serial) {
+            lv_obj_align(receive_ui.address, LV_ALIGN_TOP_MID, 0, RECEIVE_ADDRESS_Y);
+            receive_ui.qr_serial = 0;
+        }
+        ui_set_text(receive_ui.address, address ? address : "");
+        ui_show(UI_SCREEN_RECEIVE);
+        return;
+    }
+
+    // Byte-aligned, so the display copies the code into the frame whole
+    int x = ((int)display_fbdev_get_width() - qr->width) / 2 & ~7;
+    display_fbdev_set_overlay(qr->bits, qr->stride, x, RECEIVE_QR_Y, qr->width, qr->height);
+    if (qr->serial != receive_ui.qr_serial) {
+        lv_obj_set_pos(receive_ui.qr, x, RECEIVE_QR_Y);
+        lv_obj_set_size(receive_ui.qr, qr->width, qr->height);
+        lv_obj_clear_flag(receive_ui.qr, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_invalidate(receive_ui.qr);
+        lv_obj_align(receive_ui.address, LV_ALIGN_TOP_MID, 0, RECEIVE_QR_Y + qr->height + 4);
+        receive_ui.qr_serial = qr->serial;
+    }
+
+    // The code carries the full address; the label is for a quick check
     char addr_display[32];
-    if (address && strlen(address) > 0) {
-        snprintf(addr_display, sizeof(addr_display), "To: %.12s...", address);
+    size_t len = strlen(address);
+    if (len > 15) {
+        snprintf(addr_display, sizeof(addr_display), "%.6s...%s", address, address + len - 6);
     } else {
-        strcpy(addr_display, "To: Unknown");
+        snprintf(addr_display, sizeof(addr_display), "%s", address);
     }
-    lv_obj_t *addr_label = lv_label_create(confirm_screen);
-    lv_obj_align(addr_label, LV_ALIGN_CENTER, 0, -20);
-    lv_label_set_text(addr_label, addr_display);
-    lv_obj_set_style_text_font(addr_label, &lv_font_montserrat_14, 0);
-    
-    // Confirm button
-    lv_obj_t *confirm_btn = lv_btn_create(confirm_screen);
-    lv_obj_align(confirm_btn, LV_ALIGN_BOTTOM_LEFT, 20, -20);
-    lv_obj_t *confirm_label = lv_label_create(confirm_btn);
-    lv_label_set_text(confirm_label, "Confirm");
-    lv_obj_add_event_cb(confirm_btn, btn_event_cb, LV_EVENT_CLICKED, NULL);
-    
-    // Cancel button
-    lv_obj_t *cancel_btn = lv_btn_create(confirm_screen);
-    lv_obj_align(cancel_btn, LV_ALIGN_BOTTOM_RIGHT, -20, -20);
-    lv_obj_t *cancel_label = lv_label_create(cancel_btn);
-    lv_label_set_text(cancel_label, "Cancel");
-    lv_obj_add_event_cb(cancel_btn, cancel_btn_event_cb, LV_EVENT_CLICKED, NULL);
-    
-    // Wait for user input (in real implementation, this would be event-driven)
-    // For now, return immediately (actual implementation would use input handling)
-    
-    // Clean up
-    lv_obj_del(confirm_screen);
-    lv_scr_load(main_screen);
-    
-    return transaction_confirmed ? 1 : 0;
+    ui_set_text(receive_ui.address, addr_display);
+    ui_show(UI_SCREEN_RECEIVE);
+}
+
+void wallet_ui_show_list(const char *title, const ui_list_source_t *source) {
+    if (!list_ui.title) return;
+
+    ui_set_text(list_ui.title, title ? title : "");
+    ui_list_set_source(&list_ui.list, source);
+    ui_show(UI_SCREEN_LIST);
+}
+
+void wallet_ui_refresh_list(void) {
+    if (!list_ui.title) return;
+
+    ui_list_refresh(&list_ui.list);
+}
+
+static uint32_t history_count(void *ctx) {
+    (void)ctx;
+    return tx_history_count();
+}
+
+// Newest first; each row is one index lookup, however long the history
+static int history_fetch(void *ctx, uint32_t first, ui_list_item_t *items, int n) {
+    (void)ctx;
+    uint32_t count = tx_history_count();
+    int i;
+    for (i = 0; i < n && first + i < count; i++) {
+        tx_history_entry_t tx;
+        if (tx_history_get(count - 1 - first - i, &tx) < 0) {
+            snprintf(items[i].text, sizeof(items[i].text), "Unreadable");
+            items[i].value[0] = '\0';
+            continue;
+        }
+        char date[8] = "";
+        struct tm tm;
+        time_t t = (time_t)tx.timestamp;
+        if (localtime_r(&t, &tm)) {
+            strftime(date, sizeof(date), "%m-%d", &tm);
+        }
+        bool out = tx.direction == TX_HISTORY_OUT;
+        snprintf(items[i].text, sizeof(items[i].text), "%s %s%s", date, out ? "out" : "in",
+                 tx.height ? "" : " *");
+        snprintf(items[i].value, sizeof(items[i].value), "%c%.3f", out ? '-' : '+', tx.amount / 1e12);
+    }
+    return i;
+}
+
+// OK on a transaction shows its counterparty in full
+static void history_select(void *ctx, uint32_t index) {
+    (void)ctx;
+    uint32_t count = tx_history_count();
+    tx_history_entry_t tx;
+    if (index < count && tx_history_get(count - 1 - index, &tx) == 0 && tx.address[0]) {
+        wallet_ui_show_address(tx.address);
+    }
+}
+
+void wallet_ui_show_history(void) {
+    static const ui_list_source_t source = {
+        .count = history_count, .fetch = history_fetch, .select = history_select,
+    };
+    wallet_ui_show_list("History", &source);
 }
 
 void wallet_ui_show_error(const char *message) {
-    if (!status_label) return;
-    
-    char error_msg[128];
-    snprintf(error_msg, sizeof(error_msg), "Error: %s", message);
-    lv_label_set_text(status_label, error_msg);
-    lv_obj_set_style_text_color(status_label, lv_color_hex(0xFF0000), 0);
+    if (!error_ui.message) return;
+
+    ui_set_text(error_ui.message, message ? message : "");
+    ui_show(UI_SCREEN_ERROR);
 }
 
 void wallet_ui_show_status(const char *message) {
     if (!status_label) return;
-    
-    lv_label_set_text(status_label, message);
-    lv_obj_set_style_text_color(status_label, lv_color_hex(0x000000), 0);
-}
 
+    ui_set_text(status_label, message);
+}
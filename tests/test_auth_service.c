@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <poll.h>
+#include "auth_service.h"
+
+// Order in which the auth service serves queued requests, and which
+// signatures it coalesces into one batch.
+//
+// Usage:
+//   test_auth_service
+//
+// Runs against the in-process Tropic01 model, slowed down so that every
+// request below is queued while the first one is still on the chip.
+// Exits non-zero if a check fails.
+
+// Chip model with no handshake delay and 50 ms per command
+#define TEST_TRANSPORT "model:0,50000"
+
+#define DISPATCH_TIMEOUT_MS 5000
+
+static int failures;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+typedef struct {
+    char name;
+    uint32_t run_us;
+} finished_t;
+
+static finished_t finished[AUTH_SERVICE_QUEUE_SIZE];
+static int finished_count;
+
+static void on_done(const auth_completion_t *done) {
+    finished[finished_count].name = *(const char *)done->user_data;
+    finished[finished_count].run_us = done->run_us;
+    finished_count++;
+}
+
+static const finished_t *find(char name) {
+    for (int i = 0; i < finished_count; i++) {
+        if (finished[i].name == name) {
+            return &finished[i];
+        }
+    }
+    return NULL;
+}
+
+// Dispatch until n requests have finished
+static void wait_for(int n) {
+    struct pollfd pfd = { .fd = auth_service_fd(), .events = POLLIN };
+    while (finished_count < n && poll(&pfd, 1, DISPATCH_TIMEOUT_MS) > 0) {
+        auth_service_dispatch();
+    }
+    CHECK(finished_count == n);
+}
+
+// A signature at the head takes the signatures right behind it at its
+// level, and nothing from a less urgent level or past another request
+static void test_sign_coalescing(void) {
+    static const char names[] = "XABVCD";
+    static uint8_t data[32];
+    static uint8_t sig[6][32];
+    const char *order;
+
+    finished_count = 0;
+    // X keeps the chip busy while the others queue
+    CHECK(auth_service_verify(AUTH_PRIORITY_CONFIRM, data, sizeof(data), sig[0], sizeof(sig[0]),
+                              on_done, (void *)&names[0]) > 0);
+    CHECK(auth_service_sign(AUTH_PRIORITY_BACKGROUND, data, sizeof(data), sig[1], sizeof(sig[1]),
+                            on_done, (void *)&names[1]) > 0);
+    CHECK(auth_service_sign(AUTH_PRIORITY_NETWORK, data, sizeof(data), sig[2], sizeof(sig[2]),
+                            on_done, (void *)&names[2]) > 0);
+    CHECK(auth_service_verify(AUTH_PRIORITY_NETWORK, data, sizeof(data), sig[3], sizeof(sig[3]),
+                              on_done, (void *)&names[3]) > 0);
+    CHECK(auth_service_sign(AUTH_PRIORITY_NETWORK, data, sizeof(data), sig[4], sizeof(sig[4]),
+                            on_done, (void *)&names[4]) > 0);
+    CHECK(auth_service_sign(AUTH_PRIORITY_BACKGROUND, data, sizeof(data), sig[5], sizeof(sig[5]),
+                            on_done, (void *)&names[5]) > 0);
+    wait_for(6);
+
+    // Network first, in submission order, then the background batch
+    order = "XBVCAD";
+    for (int i = 0; i < finished_count; i++) {
+        CHECK(finished[i].name == order[i]);
+    }
+    const finished_t *a = find('A'), *b = find('B'), *c = find('C'), *d = find('D');
+    CHECK(a && d && a->run_us == d->run_us);
+    CHECK(b && c && b->run_us != c->run_us);
+}
+
+// Signatures queued back to back at one level share a batch
+static void test_sign_run(void) {
+    static const char names[] = "XEFG";
+    static uint8_t data[32];
+    static uint8_t sig[4][32];
+
+    finished_count = 0;
+    CHECK(auth_service_verify(AUTH_PRIORITY_CONFIRM, data, sizeof(data), sig[0], sizeof(sig[0]),
+                              on_done, (void *)&names[0]) > 0);
+    for (int i = 1; i < 4; i++) {
+        CHECK(auth_service_sign(AUTH_PRIORITY_NETWORK, data, sizeof(data), sig[i], sizeof(sig[i]),
+                                on_done, (void *)&names[i]) > 0);
+    }
+    wait_for(4);
+
+    const finished_t *e = find('E'), *f = find('F'), *g = find('G');
+    CHECK(e && f && g && e->run_us == f->run_us && f->run_us == g->run_us);
+    CHECK(finished[0].name == 'X');
+}
+
+int main(void) {
+    setenv("TROPIC01_TRANSPORT", TEST_TRANSPORT, 1);
+    if (tropic_auth_init() < 0 || auth_service_start() < 0) {
+        fprintf(stderr, "test_auth_service: cannot start the auth service\n");
+        return 1;
+    }
+
+    test_sign_coalescing();
+    test_sign_run();
+
+    auth_service_stop();
+    tropic_auth_deinit();
+
+    if (failures) {
+        fprintf(stderr, "test_auth_service: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("test_auth_service: ok\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "tx_history.h"
+
+// Crash recovery of the transaction history: records cut off or left
+// unindexed by a power cut are dropped or indexed when it is reopened.
+//
+// Usage:
+//   test_tx_history
+//
+// Works in a fresh directory under $TMPDIR (or /tmp) and removes it
+// afterwards. Exits non-zero if a check fails.
+
+#define INDEX_HEADER_SIZE 16
+#define INDEX_ENTRY_SIZE 16
+
+static int failures;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static char dir[PATH_MAX];
+
+static void history_path(char *path, const char *name) {
+    snprintf(path, PATH_MAX, "%.*s/%s", PATH_MAX - 32, dir, name);
+}
+
+static off_t file_size(const char *name) {
+    char path[PATH_MAX];
+    struct stat st;
+    history_path(path, name);
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+static int file_truncate(const char *name, off_t size) {
+    char path[PATH_MAX];
+    history_path(path, name);
+    return truncate(path, size);
+}
+
+static void make_entry(uint32_t i, tx_history_entry_t *e) {
+    memset(e, 0, sizeof(*e));
+    memset(e->txid, (int)(i + 1), sizeof(e->txid));
+    e->amount = 1000 + i;
+    e->timestamp = 1700000000 + i;
+    e->height = 3000000 + i;
+    e->direction = TX_HISTORY_IN;
+    // Records 0-9 end one byte short of their 8-byte alignment
+    snprintf(e->address, sizeof(e->address), "44AFFq5kSiGBoZ%u", i);
+}
+
+// Balance after the first n entries from make_entry()
+static int64_t balance_of(uint32_t n) {
+    int64_t balance = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        balance += 1000 + i;
+    }
+    return balance;
+}
+
+// Start over with n committed entries
+static void fill(uint32_t n) {
+    tx_history_entry_t e;
+    file_truncate(TX_HISTORY_LOG_NAME, 0);
+    file_truncate(TX_HISTORY_INDEX_NAME, 0);
+    CHECK(tx_history_open(dir) == 0);
+    for (uint32_t i = 0; i < n; i++) {
+        make_entry(i, &e);
+        CHECK(tx_history_append(&e) == 0);
+    }
+    CHECK(tx_history_commit() == 0);
+    CHECK(tx_history_count() == n);
+    tx_history_close();
+}
+
+// The first n entries read back as written
+static void check_entries(uint32_t n) {
+    tx_history_entry_t want, got;
+    CHECK(tx_history_count() == n);
+    CHECK(tx_history_balance() == balance_of(n));
+    for (uint32_t i = 0; i < n; i++) {
+        make_entry(i, &want);
+        CHECK(tx_history_get(i, &got) == 0);
+        CHECK(memcmp(want.txid, got.txid, sizeof(want.txid)) == 0);
+        CHECK(want.amount == got.amount && want.height == got.height);
+        CHECK(strcmp(want.address, got.address) == 0);
+    }
+    CHECK(tx_history_get(n, &got) < 0);
+}
+
+// A record cut off half-way is dropped, with its index entry
+static void test_torn_indexed_record(void) {
+    fill(10);
+    off_t log_size = file_size(TX_HISTORY_LOG_NAME);
+    CHECK(file_truncate(TX_HISTORY_LOG_NAME, log_size - 20) == 0);
+
+    CHECK(tx_history_open(dir) == 0);
+    check_entries(9);
+    tx_history_close();
+    CHECK(file_size(TX_HISTORY_INDEX_NAME) == INDEX_HEADER_SIZE + 9 * INDEX_ENTRY_SIZE);
+    CHECK(file_size(TX_HISTORY_LOG_NAME) < log_size - 20);
+}
+
+// Records logged but not indexed are indexed, up to a torn last one
+static void test_unindexed_records(void) {
+    fill(10);
+    off_t log_size = file_size(TX_HISTORY_LOG_NAME);
+    CHECK(file_truncate(TX_HISTORY_INDEX_NAME, INDEX_HEADER_SIZE + 4 * INDEX_ENTRY_SIZE) == 0);
+    CHECK(file_truncate(TX_HISTORY_LOG_NAME, log_size - 20) == 0);
+
+    CHECK(tx_history_open(dir) == 0);
+    check_entries(9);
+    tx_history_close();
+}
+
+// A last record that lost only its padding is kept, and the record
+// appended after it can still be recovered
+static void test_lost_padding(void) {
+    tx_history_entry_t e;
+    fill(10);
+    CHECK(file_truncate(TX_HISTORY_LOG_NAME, file_size(TX_HISTORY_LOG_NAME) - 1) == 0);
+
+    CHECK(tx_history_open(dir) == 0);
+    check_entries(10);
+    make_entry(10, &e);
+    CHECK(tx_history_append(&e) == 0);
+    tx_history_close();
+    CHECK(file_truncate(TX_HISTORY_INDEX_NAME, INDEX_HEADER_SIZE + 4 * INDEX_ENTRY_SIZE) == 0);
+
+    CHECK(tx_history_open(dir) == 0);
+    check_entries(11);
+    tx_history_close();
+}
+
+// The history takes appends again after a torn record was dropped
+static void test_append_after_recovery(void) {
+    tx_history_entry_t e;
+    fill(10);
+    CHECK(file_truncate(TX_HISTORY_LOG_NAME, file_size(TX_HISTORY_LOG_NAME) - 20) == 0);
+
+    CHECK(tx_history_open(dir) == 0);
+    make_entry(9, &e);
+    CHECK(tx_history_append(&e) == 0);
+    CHECK(tx_history_commit() == 0);
+    tx_history_close();
+
+    CHECK(tx_history_open(dir) == 0);
+    check_entries(10);
+    tx_history_close();
+}
+
+int main(void) {
+    char path[PATH_MAX];
+    const char *tmp = getenv("TMPDIR");
+
+    snprintf(dir, sizeof(dir), "%s/test_tx_history.XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    test_torn_indexed_record();
+    test_unindexed_records();
+    test_lost_padding();
+    test_append_after_recovery();
+
+    history_path(path, TX_HISTORY_LOG_NAME);
+    unlink(path);
+    history_path(path, TX_HISTORY_INDEX_NAME);
+    unlink(path);
+    rmdir(dir);
+
+    if (failures) {
+        fprintf(stderr, "test_tx_history: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("test_tx_history: ok\n");
+    return 0;
+}
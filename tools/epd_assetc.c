@@ -0,0 +1,489 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include "epd_asset.h"
+
+#ifdef HAVE_LIBPNG
+#include <png.h>
+#endif
+
+// Build-time asset converter: turns BMP (and PNG when built with libpng)
+// images into an EPDA container already packed in the panel's native format.
+//
+// Usage:
+//   epd_assetc -o assets.epda [-f 1bpp|2bpp|4bpp] [-r] [-t threshold] [name=]image ...
+//
+// -f, -r and -t apply to every image that follows them on the command line.
+
+#define MAX_ASSETS 256
+
+typedef struct {
+    char name[EPD_ASSET_NAME_SIZE];
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t flags;
+    uint16_t stride;
+    uint8_t *data;
+    uint32_t size;
+    uint32_t raw_size;
+} asset_t;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint8_t *rgb;   // width * height * 3, top-down, R G B
+} image_t;
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32(const uint8_t *p) { return (uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)); }
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "epd_assetc: cannot open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return NULL;
+    }
+    uint8_t *buf = malloc((size_t)size);
+    if (buf && fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    *len = (size_t)size;
+    return buf;
+}
+
+/**
+ * Load an uncompressed 1/4/8/24/32-bit BMP into top-down RGB
+ */
+static int load_bmp(const char *path, image_t *img) {
+    size_t len;
+    uint8_t *buf = read_file(path, &len);
+    if (!buf) {
+        return -1;
+    }
+
+    if (len < 54 || buf[0] != 'B' || buf[1] != 'M') {
+        fprintf(stderr, "epd_assetc: %s is not a BMP file\n", path);
+        free(buf);
+        return -1;
+    }
+
+    uint32_t data_offset = rd32(buf + 10);
+    uint32_t info_size = rd32(buf + 14);
+    int32_t width = (int32_t)rd32(buf + 18);
+    int32_t height = (int32_t)rd32(buf + 22);
+    uint16_t bpp = rd16(buf + 28);
+    uint32_t compression = rd32(buf + 30);
+    uint32_t colors_used = rd32(buf + 46);
+
+    bool top_down = height < 0;
+    if (top_down) {
+        height = -height;
+    }
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF ||
+        (compression != 0 && compression != 3)) {
+        fprintf(stderr, "epd_assetc: %s: unsupported BMP layout\n", path);
+        free(buf);
+        return -1;
+    }
+    if (bpp != 1 && bpp != 4 && bpp != 8 && bpp != 24 && bpp != 32) {
+        fprintf(stderr, "epd_assetc: %s: unsupported bit depth %u\n", path, bpp);
+        free(buf);
+        return -1;
+    }
+
+    const uint8_t *palette = buf + 14 + info_size;
+    uint32_t palette_entries = colors_used ? colors_used : (bpp <= 8 ? (1u << bpp) : 0);
+    size_t row_bytes = (((size_t)width * bpp + 31) / 32) * 4;
+    if (data_offset + row_bytes * (size_t)height > len ||
+        (size_t)(palette - buf) + palette_entries * 4 > len) {
+        fprintf(stderr, "epd_assetc: %s: truncated BMP\n", path);
+        free(buf);
+        return -1;
+    }
+
+    img->width = (uint32_t)width;
+    img->height = (uint32_t)height;
+    img->rgb = malloc((size_t)width * height * 3);
+    if (!img->rgb) {
+        free(buf);
+        return -1;
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t *row = buf + data_offset + row_bytes * (size_t)(top_down ? y : height - 1 - y);
+        uint8_t *out = img->rgb + (size_t)y * width * 3;
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t r, g, b;
+            if (bpp >= 24) {
+                const uint8_t *px = row + (size_t)x * (bpp / 8);
+                b = px[0];
+                g = px[1];
+                r = px[2];
+            } else {
+                uint32_t idx;
+                if (bpp == 8) {
+                    idx = row[x];
+                } else if (bpp == 4) {
+                    idx = (row[x / 2] >> ((x % 2) ? 0 : 4)) & 0x0F;
+                } else {
+                    idx = (row[x / 8] >> (7 - (x % 8))) & 0x01;
+                }
+                if (idx >= palette_entries) {
+                    idx = 0;
+                }
+                b = palette[idx * 4];
+                g = palette[idx * 4 + 1];
+                r = palette[idx * 4 + 2];
+            }
+            out[x * 3] = r;
+            out[x * 3 + 1] = g;
+            out[x * 3 + 2] = b;
+        }
+    }
+
+    free(buf);
+    return 0;
+}
+
+#ifdef HAVE_LIBPNG
+static int load_png(const char *path, image_t *img) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&png, path)) {
+        fprintf(stderr, "epd_assetc: %s: %s\n", path, png.message);
+        return -1;
+    }
+    png.format = PNG_FORMAT_RGB;
+
+    img->width = png.width;
+    img->height = png.height;
+    img->rgb = malloc(PNG_IMAGE_SIZE(png));
+    if (!img->rgb) {
+        png_image_free(&png);
+        return -1;
+    }
+    if (!png_image_finish_read(&png, NULL, img->rgb, 0, NULL)) {
+        fprintf(stderr, "epd_assetc: %s: %s\n", path, png.message);
+        free(img->rgb);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+static int load_image(const char *path, image_t *img) {
+    const char *ext = strrchr(path, '.');
+    if (ext && strcasecmp(ext, ".png") == 0) {
+#ifdef HAVE_LIBPNG
+        return load_png(path, img);
+#else
+        fprintf(stderr, "epd_assetc: %s: built without libpng, convert to BMP first\n", path);
+        return -1;
+#endif
+    }
+    return load_bmp(path, img);
+}
+
+/**
+ * ACeP palette in EPD_7IN3F/EPD_5IN65F index order
+ */
+static const uint8_t acep_palette[7][3] = {
+    {   0,   0,   0 },  // Black
+    { 255, 255, 255 },  // White
+    {   0, 255,   0 },  // Green
+    {   0,   0, 255 },  // Blue
+    { 255,   0,   0 },  // Red
+    { 255, 255,   0 },  // Yellow
+    { 255, 128,   0 },  // Orange
+};
+
+static uint8_t nearest_acep(uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t best = 0;
+    uint32_t best_dist = UINT32_MAX;
+    for (uint8_t i = 0; i < 7; i++) {
+        int dr = r - acep_palette[i][0];
+        int dg = g - acep_palette[i][1];
+        int db = b - acep_palette[i][2];
+        uint32_t dist = (uint32_t)(dr * dr * 3 + dg * dg * 4 + db * db * 2);
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static uint8_t luma(const uint8_t *px) {
+    return (uint8_t)((px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8);
+}
+
+/**
+ * Pack an RGB image into the panel's native layout
+ */
+static int pack_image(const image_t *img, uint8_t format, uint8_t threshold, asset_t *out) {
+    uint32_t bits = format;
+    out->stride = (uint16_t)((img->width * bits + 7) / 8);
+    out->raw_size = (uint32_t)out->stride * img->height;
+    out->data = calloc(1, out->raw_size);
+    if (!out->data) {
+        return -1;
+    }
+
+    for (uint32_t y = 0; y < img->height; y++) {
+        uint8_t *row = out->data + (size_t)y * out->stride;
+        const uint8_t *src = img->rgb + (size_t)y * img->width * 3;
+        for (uint32_t x = 0; x < img->width; x++) {
+            const uint8_t *px = src + x * 3;
+            switch (format) {
+            case EPD_ASSET_FMT_1BPP:
+                if (luma(px) >= threshold) {
+                    row[x / 8] |= 0x80 >> (x % 8);
+                }
+                break;
+            case EPD_ASSET_FMT_2BPP_GRAY:
+                row[x / 4] |= (luma(px) >> 6) << (6 - (x % 4) * 2);
+                break;
+            case EPD_ASSET_FMT_4BPP_7COLOR:
+                row[x / 2] |= nearest_acep(px[0], px[1], px[2]) << ((x % 2) ? 0 : 4);
+                break;
+            default:
+                return -1;
+            }
+        }
+    }
+
+    out->size = out->raw_size;
+    return 0;
+}
+
+/**
+ * PackBits encoder; returns the encoded length or 0 if it would not shrink
+ */
+static uint32_t packbits(const uint8_t *src, uint32_t len, uint8_t *dst) {
+    uint32_t in = 0, out = 0;
+
+    while (in < len) {
+        uint32_t run = 1;
+        while (in + run < len && run < 128 && src[in + run] == src[in]) {
+            run++;
+        }
+        if (run >= 3) {
+            if (out + 2 >= len) return 0;
+            dst[out++] = (uint8_t)(int8_t)(1 - (int)run);
+            dst[out++] = src[in];
+            in += run;
+            continue;
+        }
+
+        uint32_t lit = 0;
+        while (in + lit < len && lit < 128) {
+            if (in + lit + 2 < len && src[in + lit] == src[in + lit + 1] &&
+                src[in + lit] == src[in + lit + 2]) {
+                break;
+            }
+            lit++;
+        }
+        if (out + 1 + lit >= len) return 0;
+        dst[out++] = (uint8_t)(lit - 1);
+        memcpy(dst + out, src + in, lit);
+        out += lit;
+        in += lit;
+    }
+    return out;
+}
+
+static int parse_format(const char *s, uint8_t *format) {
+    if (strcmp(s, "1bpp") == 0) {
+        *format = EPD_ASSET_FMT_1BPP;
+    } else if (strcmp(s, "2bpp") == 0 || strcmp(s, "4gray") == 0) {
+        *format = EPD_ASSET_FMT_2BPP_GRAY;
+    } else if (strcmp(s, "4bpp") == 0 || strcmp(s, "7color") == 0) {
+        *format = EPD_ASSET_FMT_4BPP_7COLOR;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void asset_name(const char *arg, char *name, const char **path) {
+    const char *eq = strchr(arg, '=');
+    const char *base;
+    size_t len;
+
+    if (eq) {
+        base = arg;
+        len = (size_t)(eq - arg);
+        *path = eq + 1;
+    } else {
+        base = strrchr(arg, '/');
+        base = base ? base + 1 : arg;
+        const char *dot = strrchr(base, '.');
+        len = dot ? (size_t)(dot - base) : strlen(base);
+        *path = arg;
+    }
+    if (len >= EPD_ASSET_NAME_SIZE) {
+        len = EPD_ASSET_NAME_SIZE - 1;
+    }
+    memset(name, 0, EPD_ASSET_NAME_SIZE);
+    memcpy(name, base, len);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: epd_assetc -o out.epda [-f 1bpp|2bpp|4bpp] [-r] [-t threshold] [name=]image ...\n"
+            "  -f  native pixel format for following images (default 1bpp)\n"
+            "  -r  PackBits-compress following images when it saves space\n"
+            "  -t  1bpp luminance threshold for following images (default 128)\n");
+}
+
+static int write_container(const char *path, const asset_t *assets, uint16_t count) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "epd_assetc: cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    epd_asset_file_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, EPD_ASSET_MAGIC, 4);
+    hdr.version = EPD_ASSET_VERSION;
+    hdr.count = count;
+    hdr.table_offset = sizeof(hdr);
+
+    uint32_t offset = sizeof(hdr) + (uint32_t)count * sizeof(epd_asset_entry_t);
+    epd_asset_entry_t entries[MAX_ASSETS];
+    for (uint16_t i = 0; i < count; i++) {
+        offset = (offset + 3) & ~3u;
+        memset(&entries[i], 0, sizeof(entries[i]));
+        memcpy(entries[i].name, assets[i].name, EPD_ASSET_NAME_SIZE);
+        entries[i].width = assets[i].width;
+        entries[i].height = assets[i].height;
+        entries[i].format = assets[i].format;
+        entries[i].flags = assets[i].flags;
+        entries[i].stride = assets[i].stride;
+        entries[i].offset = offset;
+        entries[i].size = assets[i].size;
+        entries[i].raw_size = assets[i].raw_size;
+        entries[i].crc32 = epd_asset_crc32(assets[i].data, assets[i].size);
+        offset += assets[i].size;
+    }
+
+    static const uint8_t pad[4] = { 0 };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+              (count == 0 || fwrite(entries, sizeof(entries[0]), count, fp) == count);
+    long pos = (long)(sizeof(hdr) + (size_t)count * sizeof(epd_asset_entry_t));
+    for (uint16_t i = 0; ok && i < count; i++) {
+        ok = fwrite(pad, 1, entries[i].offset - (uint32_t)pos, fp) == entries[i].offset - (uint32_t)pos &&
+             fwrite(assets[i].data, 1, assets[i].size, fp) == assets[i].size;
+        pos = (long)(entries[i].offset + entries[i].size);
+    }
+
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "epd_assetc: failed writing %s\n", path);
+        remove(path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    uint8_t format = EPD_ASSET_FMT_1BPP;
+    uint8_t threshold = 128;
+    bool rle = false;
+    static asset_t assets[MAX_ASSETS];
+    uint16_t count = 0;
+    uint64_t raw_total = 0, stored_total = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(arg, "-f") == 0 && i + 1 < argc) {
+            if (parse_format(argv[++i], &format) < 0) {
+                fprintf(stderr, "epd_assetc: unknown format '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "-t") == 0 && i + 1 < argc) {
+            threshold = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "-r") == 0) {
+            rle = true;
+        } else if (strcmp(arg, "-h") == 0 || arg[0] == '-') {
+            usage();
+            return arg[1] == 'h' ? 0 : 1;
+        } else {
+            if (count >= MAX_ASSETS) {
+                fprintf(stderr, "epd_assetc: too many assets (max %d)\n", MAX_ASSETS);
+                return 1;
+            }
+
+            asset_t *a = &assets[count];
+            const char *path;
+            asset_name(arg, a->name, &path);
+
+            image_t img;
+            if (load_image(path, &img) < 0) {
+                return 1;
+            }
+            a->width = (uint16_t)img.width;
+            a->height = (uint16_t)img.height;
+            a->format = format;
+            if (pack_image(&img, format, threshold, a) < 0) {
+                free(img.rgb);
+                return 1;
+            }
+            free(img.rgb);
+
+            if (rle) {
+                uint8_t *enc = malloc(a->raw_size);
+                uint32_t enc_len = enc ? packbits(a->data, a->raw_size, enc) : 0;
+                if (enc_len > 0) {
+                    free(a->data);
+                    a->data = enc;
+                    a->size = enc_len;
+                    a->flags |= EPD_ASSET_FLAG_RLE;
+                } else {
+                    free(enc);
+                }
+            }
+
+            printf("  %-24s %4ux%-4u %ubpp %6u -> %6u bytes%s\n", a->name, a->width, a->height,
+                   a->format, a->raw_size, a->size, (a->flags & EPD_ASSET_FLAG_RLE) ? " (rle)" : "");
+            raw_total += a->raw_size;
+            stored_total += a->size;
+            count++;
+        }
+    }
+
+    if (!out_path) {
+        usage();
+        return 1;
+    }
+
+    int ret = write_container(out_path, assets, count);
+    if (ret == 0) {
+        printf("Wrote %u assets to %s (%llu bytes of pixel data, %llu packed)\n", count, out_path,
+               (unsigned long long)raw_total, (unsigned long long)stored_total);
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        free(assets[i].data);
+    }
+    return ret == 0 ? 0 : 1;
+}
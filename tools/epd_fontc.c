@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+// Build-time font converter: renders a TrueType/OpenType font with
+// FreeType's monochrome hinter and writes it out as an LVGL v8 font at
+// 1 bit per pixel. The hinter snaps stems to whole pixels at the target
+// size, so glyphs come out sharp on the panel, with no grey edges left
+// for display_fbdev.c to threshold away.
+//
+// Usage:
+//   epd_fontc -o out.c -n name -s px [-r first-last]... font.ttf
+//
+// Ranges are code points, decimal or 0x hex; the default is printable
+// ASCII. Kerning is left out so the runtime glyph table (wallet_fonts.c)
+// can key glyphs on the letter alone.
+
+#define MAX_RANGES 16
+#define MAX_GLYPHS 1024
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} range_t;
+
+typedef struct {
+    uint32_t bitmap_index;
+    uint32_t adv_w;         // 1/16 px
+    uint16_t box_w;
+    uint16_t box_h;
+    int16_t ofs_x;
+    int16_t ofs_y;
+} glyph_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    uint8_t acc;            // Bits of the byte being filled
+    int nbits;
+} bitstream_t;
+
+static int bs_put(bitstream_t *bs, int bit) {
+    bs->acc = (uint8_t)((bs->acc << 1) | (bit & 1));
+    if (++bs->nbits < 8) {
+        return 0;
+    }
+    if (bs->len == bs->cap) {
+        size_t cap = bs->cap ? bs->cap * 2 : 4096;
+        uint8_t *data = realloc(bs->data, cap);
+        if (!data) {
+            return -1;
+        }
+        bs->data = data;
+        bs->cap = cap;
+    }
+    bs->data[bs->len++] = bs->acc;
+    bs->acc = 0;
+    bs->nbits = 0;
+    return 0;
+}
+
+// Glyphs start on a byte; rows within a glyph are not padded
+static int bs_align(bitstream_t *bs) {
+    while (bs->nbits) {
+        if (bs_put(bs, 0) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int parse_range(const char *arg, range_t *r) {
+    char *end;
+    unsigned long first = strtoul(arg, &end, 0);
+    unsigned long last = first;
+    if (*end == '-') {
+        last = strtoul(end + 1, &end, 0);
+    }
+    if (*end || last < first || last > 0x10FFFF) {
+        return -1;
+    }
+    r->first = (uint32_t)first;
+    r->last = (uint32_t)last;
+    return 0;
+}
+
+/**
+ * Render one glyph and append its bitmap, cropped to the inked box
+ */
+static int render_glyph(FT_Face face, uint32_t code, bitstream_t *bs, glyph_t *g) {
+    memset(g, 0, sizeof(*g));
+    if (FT_Load_Char(face, code, FT_LOAD_RENDER | FT_LOAD_TARGET_MONO | FT_LOAD_MONOCHROME) != 0) {
+        return -1;
+    }
+    FT_GlyphSlot slot = face->glyph;
+    const FT_Bitmap *bm = &slot->bitmap;
+    g->adv_w = (uint32_t)((slot->advance.x + 2) >> 2);     // 26.6 -> 1/16 px
+
+    // Crop blank rows and columns; FreeType's box is not always tight
+    int top = (int)bm->rows, bottom = -1, left = (int)bm->width, right = -1;
+    for (int y = 0; y < (int)bm->rows; y++) {
+        const uint8_t *row = bm->buffer + y * bm->pitch;
+        for (int x = 0; x < (int)bm->width; x++) {
+            if (row[x >> 3] & (0x80 >> (x & 7))) {
+                top = y < top ? y : top;
+                bottom = y > bottom ? y : bottom;
+                left = x < left ? x : left;
+                right = x > right ? x : right;
+            }
+        }
+    }
+    if (bottom < 0) {
+        return 0;   // Blank, e.g. space: advance only
+    }
+
+    g->bitmap_index = (uint32_t)bs->len;
+    g->box_w = (uint16_t)(right - left + 1);
+    g->box_h = (uint16_t)(bottom - top + 1);
+    g->ofs_x = (int16_t)(slot->bitmap_left + left);
+    g->ofs_y = (int16_t)(slot->bitmap_top - bottom - 1);
+    for (int y = top; y <= bottom; y++) {
+        const uint8_t *row = bm->buffer + y * bm->pitch;
+        for (int x = left; x <= right; x++) {
+            if (bs_put(bs, (row[x >> 3] >> (7 - (x & 7))) & 1) < 0) {
+                return -1;
+            }
+        }
+    }
+    return bs_align(bs);
+}
+
+static void write_font(FILE *fp, const char *name, int px, const char *font_path,
+                       const range_t *ranges, int nranges, const bitstream_t *bs,
+                       const glyph_t *glyphs, int nglyphs, int line_height, int base_line) {
+    fprintf(fp, "/* Generated by epd_fontc from %s at %d px, 1 bpp. Do not edit. */\n\n", font_path, px);
+    fprintf(fp, "#include <lvgl.h>\n\n");
+
+    fprintf(fp, "static LV_ATTRIBUTE_LARGE_CONST const uint8_t glyph_bitmap[] = {");
+    for (size_t i = 0; i < bs->len; i++) {
+        fprintf(fp, "%s0x%02x,", i % 16 ? " " : "\n    ", bs->data[i]);
+    }
+    fprintf(fp, "%s};\n\n", bs->len ? "\n" : "\n    0\n");
+
+    fprintf(fp, "static const lv_font_fmt_txt_glyph_dsc_t glyph_dsc[] = {\n");
+    fprintf(fp, "    {.bitmap_index = 0, .adv_w = 0, .box_w = 0, .box_h = 0, .ofs_x = 0, .ofs_y = 0},\n");
+    for (int i = 0; i < nglyphs; i++) {
+        const glyph_t *g = &glyphs[i];
+        fprintf(fp, "    {.bitmap_index = %u, .adv_w = %u, .box_w = %u, .box_h = %u, .ofs_x = %d, .ofs_y = %d},\n",
+                g->bitmap_index, g->adv_w, g->box_w, g->box_h, g->ofs_x, g->ofs_y);
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "static const lv_font_fmt_txt_cmap_t cmaps[] = {\n");
+    uint32_t glyph_id = 1;
+    for (int i = 0; i < nranges; i++) {
+        uint32_t len = ranges[i].last - ranges[i].first + 1;
+        fprintf(fp, "    {.range_start = %u, .range_length = %u, .glyph_id_start = %u,\n"
+                    "     .unicode_list = NULL, .glyph_id_ofs_list = NULL, .list_length = 0,\n"
+                    "     .type = LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY},\n",
+                ranges[i].first, len, glyph_id);
+        glyph_id += len;
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp,
+            "#if LV_VERSION_CHECK(8, 0, 0)\n"
+            "static lv_font_fmt_txt_glyph_cache_t cache;\n"
+            "static const lv_font_fmt_txt_dsc_t font_dsc = {\n"
+            "#else\n"
+            "static lv_font_fmt_txt_dsc_t font_dsc = {\n"
+            "#endif\n"
+            "    .glyph_bitmap = glyph_bitmap,\n"
+            "    .glyph_dsc = glyph_dsc,\n"
+            "    .cmaps = cmaps,\n"
+            "    .kern_dsc = NULL,\n"
+            "    .kern_scale = 0,\n"
+            "    .cmap_num = %d,\n"
+            "    .bpp = 1,\n"
+            "    .kern_classes = 0,\n"
+            "    .bitmap_format = 0,\n"
+            "#if LV_VERSION_CHECK(8, 0, 0)\n"
+            "    .cache = &cache\n"
+            "#endif\n"
+            "};\n\n", nranges);
+
+    fprintf(fp,
+            "#if LV_VERSION_CHECK(8, 0, 0)\n"
+            "const lv_font_t %s = {\n"
+            "#else\n"
+            "lv_font_t %s = {\n"
+            "#endif\n"
+            "    .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,\n"
+            "    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,\n"
+            "    .line_height = %d,\n"
+            "    .base_line = %d,\n"
+            "    .subpx = LV_FONT_SUBPX_NONE,\n"
+            "    .underline_position = -1,\n"
+            "    .underline_thickness = 1,\n"
+            "    .dsc = &font_dsc\n"
+            "};\n", name, name, line_height, base_line);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: epd_fontc -o out.c -n name -s px [-r first-last]... font.ttf\n"
+            "  -n  C name of the lv_font_t to define\n"
+            "  -s  pixel size (em height) to render at\n"
+            "  -r  code point range to include (default 0x20-0x7e), repeatable\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL, *name = NULL, *font_path = NULL;
+    int px = 0;
+    range_t ranges[MAX_RANGES];
+    int nranges = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(arg, "-n") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(arg, "-s") == 0 && i + 1 < argc) {
+            px = atoi(argv[++i]);
+        } else if (strcmp(arg, "-r") == 0 && i + 1 < argc) {
+            if (nranges >= MAX_RANGES || parse_range(argv[++i], &ranges[nranges]) < 0) {
+                fprintf(stderr, "epd_fontc: bad or too many ranges at '%s'\n", argv[i]);
+                return 1;
+            }
+            nranges++;
+        } else if (strcmp(arg, "-h") == 0 || arg[0] == '-') {
+            usage();
+            return arg[1] == 'h' ? 0 : 1;
+        } else {
+            font_path = arg;
+        }
+    }
+    if (!out_path || !name || !font_path || px <= 0) {
+        usage();
+        return 1;
+    }
+    if (nranges == 0) {
+        ranges[nranges++] = (range_t){ 0x20, 0x7e };
+    }
+
+    FT_Library ft;
+    FT_Face face;
+    if (FT_Init_FreeType(&ft) != 0) {
+        fprintf(stderr, "epd_fontc: cannot initialize FreeType\n");
+        return 1;
+    }
+    if (FT_New_Face(ft, font_path, 0, &face) != 0 || FT_Set_Pixel_Sizes(face, 0, (FT_UInt)px) != 0) {
+        fprintf(stderr, "epd_fontc: cannot load %s at %d px\n", font_path, px);
+        FT_Done_FreeType(ft);
+        return 1;
+    }
+
+    static glyph_t glyphs[MAX_GLYPHS];
+    bitstream_t bs = { 0 };
+    int nglyphs = 0, missing = 0;
+    for (int r = 0; r < nranges; r++) {
+        for (uint32_t c = ranges[r].first; c <= ranges[r].last; c++) {
+            if (nglyphs >= MAX_GLYPHS) {
+                fprintf(stderr, "epd_fontc: too many glyphs (max %d)\n", MAX_GLYPHS);
+                return 1;
+            }
+            // A missing code point gets a zero-size glyph so ranges stay
+            // contiguous; rendering it would draw the font's .notdef box
+            if (!FT_Get_Char_Index(face, c)) {
+                memset(&glyphs[nglyphs++], 0, sizeof(glyphs[0]));
+                missing++;
+                continue;
+            }
+            if (render_glyph(face, c, &bs, &glyphs[nglyphs]) < 0) {
+                fprintf(stderr, "epd_fontc: cannot render U+%04X\n", c);
+                return 1;
+            }
+            nglyphs++;
+        }
+    }
+
+    // Line metrics in whole pixels, from the hinted size
+    int ascender = (int)((face->size->metrics.ascender + 63) >> 6);
+    int descender = (int)(-face->size->metrics.descender + 63) >> 6;
+
+    FILE *fp = fopen(out_path, "w");
+    if (!fp) {
+        fprintf(stderr, "epd_fontc: cannot create %s\n", out_path);
+        return 1;
+    }
+    write_font(fp, name, px, font_path, ranges, nranges, &bs, glyphs, nglyphs,
+               ascender + descender, descender);
+    bool ok = fclose(fp) == 0;
+
+    printf("  %-24s %2d px %4d glyphs %6zu bitmap bytes%s\n", name, px, nglyphs, bs.len,
+           missing ? " (some code points missing from the font)" : "");
+    free(bs.data);
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/crypto.h>
+#include "tropic_model.h"
+#include "tropic_proto.h"
+#include "tropic_session.h"
+
+// Tropic01 model server and session benchmark, for developing and timing
+// the secure-session layer without the chip.
+//
+// Usage:
+//   tropic_model serve tcp:HOST:PORT|unix:PATH [-H handshake_us] [-C command_us] [-d drop_every]
+//   tropic_model bench model[:HS_US,CMD_US]|tcp:HOST:PORT|unix:PATH [-n count]
+//
+// "bench" times one handshake, sequential signatures on the persistent
+// session, the same signatures pipelined, then packed 16 to a SIGN_BATCH
+// command, and the handshake-per-operation pattern the session layer
+// replaces.
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static tropic_session_t *open_session(const char *spec) {
+    uint8_t pairing_key[32];
+    tropic_seed_key(TROPIC_PLACEHOLDER_PAIRING_SEED, pairing_key);
+    tropic_session_t *s = tropic_session_open(tropic_transport_create(spec), 0, pairing_key);
+    OPENSSL_cleanse(pairing_key, sizeof(pairing_key));
+    return s;
+}
+
+static int bench(const char *spec, int count) {
+    uint8_t msg[32], sig[TROPIC_SESSION_PIPELINE_MAX][32];
+    tropic_cmd_t cmds[TROPIC_SESSION_PIPELINE_MAX];
+    tropic_session_stats_t stats;
+    uint64_t t0;
+    int i;
+
+    memset(msg, 0x5A, sizeof(msg));
+
+    t0 = now_us();
+    tropic_session_t *s = open_session(spec);
+    if (!s) {
+        fprintf(stderr, "tropic_model: cannot open a session over %s\n", spec);
+        return 1;
+    }
+    printf("session open:        %8.1f us\n", (double)(now_us() - t0));
+
+    t0 = now_us();
+    for (i = 0; i < count; i++) {
+        cmds[0] = (tropic_cmd_t){ .cmd = TROPIC_L3_SIGN, .req = msg, .req_len = sizeof(msg),
+                                  .res = sig[0], .res_size = sizeof(sig[0]) };
+        if (tropic_session_exec(s, cmds, 1) < 0) {
+            fprintf(stderr, "tropic_model: sign failed\n");
+            break;
+        }
+    }
+    printf("sign, sequential:    %8.1f us/op\n", (double)(now_us() - t0) / count);
+
+    t0 = now_us();
+    for (i = 0; i < count; i += TROPIC_SESSION_PIPELINE_MAX) {
+        int n = count - i < TROPIC_SESSION_PIPELINE_MAX ? count - i : TROPIC_SESSION_PIPELINE_MAX;
+        for (int j = 0; j < n; j++) {
+            cmds[j] = (tropic_cmd_t){ .cmd = TROPIC_L3_SIGN, .req = msg, .req_len = sizeof(msg),
+                                      .res = sig[j], .res_size = sizeof(sig[j]) };
+        }
+        if (tropic_session_exec(s, cmds, (size_t)n) < 0) {
+            fprintf(stderr, "tropic_model: pipelined sign failed\n");
+            break;
+        }
+    }
+    printf("sign, pipelined x%d:  %8.1f us/op\n", TROPIC_SESSION_PIPELINE_MAX,
+           (double)(now_us() - t0) / count);
+
+    // A 16-input transaction: every message packed into one SIGN_BATCH
+    static uint8_t batch_req[TROPIC_L3_MAX - 1];
+    static uint8_t batch_res[TROPIC_SIGN_BATCH_RES_SIZE(16)];
+    size_t batch_len = 0;
+    for (i = 0; i < 16; i++) {
+        tropic_sign_batch_add(batch_req, &batch_len, msg, sizeof(msg));
+    }
+    t0 = now_us();
+    for (i = 0; i < count; i += 16) {
+        cmds[0] = (tropic_cmd_t){ .cmd = TROPIC_L3_SIGN_BATCH, .req = batch_req, .req_len = batch_len,
+                                  .res = batch_res, .res_size = sizeof(batch_res) };
+        if (tropic_session_exec(s, cmds, 1) < 0 || cmds[0].result != TROPIC_L3_RESULT_OK) {
+            fprintf(stderr, "tropic_model: batch sign failed\n");
+            break;
+        }
+    }
+    printf("sign, batched x16:   %8.1f us/op\n", (double)(now_us() - t0) / (((count + 15) / 16) * 16));
+
+    tropic_session_get_stats(s, &stats);
+    tropic_session_close(s);
+
+    // What every call cost before: a fresh secure channel per operation
+    int fresh = count < 50 ? count : 50;
+    t0 = now_us();
+    for (i = 0; i < fresh; i++) {
+        tropic_session_t *one = open_session(spec);
+        if (!one) {
+            break;
+        }
+        cmds[0] = (tropic_cmd_t){ .cmd = TROPIC_L3_SIGN, .req = msg, .req_len = sizeof(msg),
+                                  .res = sig[0], .res_size = sizeof(sig[0]) };
+        tropic_session_exec(one, cmds, 1);
+        tropic_session_close(one);
+    }
+    printf("sign, handshake/op:  %8.1f us/op\n", (double)(now_us() - t0) / fresh);
+
+    printf("handshakes %u, renegotiations %u, commands %u, errors %u\n",
+           stats.handshakes, stats.renegotiations, stats.commands, stats.errors);
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: tropic_model serve tcp:HOST:PORT|unix:PATH [-H handshake_us] [-C command_us] [-d drop_every]\n"
+            "       tropic_model bench model[:HS_US,CMD_US]|tcp:HOST:PORT|unix:PATH [-n count]\n");
+}
+
+int main(int argc, char *argv[]) {
+    tropic_model_config_t config = { 0 };
+    int count = 1000;
+
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        if (strcmp(argv[i], "-H") == 0) {
+            config.handshake_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-C") == 0) {
+            config.command_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            config.drop_session_every = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            count = atoi(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (count <= 0) {
+        count = 1;
+    }
+
+    if (strcmp(argv[1], "serve") == 0) {
+        return tropic_model_listen(argv[2], &config) < 0 ? 1 : 0;
+    }
+    if (strcmp(argv[1], "bench") == 0) {
+        return bench(argv[2], count);
+    }
+    usage();
+    return 1;
+}
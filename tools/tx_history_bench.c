@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include "tx_history.h"
+
+// Transaction history benchmark, for sizing commits and checking page
+// reads on the device's own eMMC or SD card.
+//
+// Usage:
+//   tx_history_bench DIR [-n count] [-b batch] [-p page] [-r reads]
+//
+// DIR must be on the storage to measure; any history in it is replaced.
+// Appends count transactions, committing every batch (at most
+// TX_HISTORY_BATCH_MAX), then times reopening the history, reads of
+// page transactions from random positions with the files in the page
+// cache and, after dropping them from it, the first page after opening,
+// which is what the history screen costs at boot. Ends with a compaction
+// to half the history.
+
+#define COLD_SAMPLES 20
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_latency(const char *what, uint64_t *us, int n) {
+    qsort(us, n, sizeof(us[0]), cmp_u64);
+    printf("%-22s p50 %6llu us  p99 %6llu us  max %6llu us\n", what,
+           (unsigned long long)us[n / 2], (unsigned long long)us[n * 99 / 100],
+           (unsigned long long)us[n - 1]);
+}
+
+static void history_path(char *path, const char *dir, const char *name) {
+    snprintf(path, PATH_MAX, "%s/%s", dir, name);
+}
+
+// Evict both files from the page cache, as after a reboot
+static void drop_cache(const char *dir) {
+    static const char *const names[] = { TX_HISTORY_LOG_NAME, TX_HISTORY_INDEX_NAME };
+    char path[PATH_MAX];
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        history_path(path, dir, names[i]);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+}
+
+// Newest first, as the history screen shows it
+static int read_page(uint32_t first, int page) {
+    tx_history_entry_t entry;
+    uint32_t count = tx_history_count();
+    for (int i = 0; i < page && first + i < count; i++) {
+        if (tx_history_get(count - 1 - first - i, &entry) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void make_entry(uint32_t i, tx_history_entry_t *entry) {
+    memset(entry, 0, sizeof(*entry));
+    for (size_t b = 0; b < sizeof(entry->txid); b++) {
+        entry->txid[b] = (uint8_t)(i * 31 + b);
+    }
+    entry->direction = i % 3 == 0 ? TX_HISTORY_OUT : TX_HISTORY_IN;
+    entry->amount = 1000000000ULL + (uint64_t)i * 7919;
+    entry->fee = entry->direction == TX_HISTORY_OUT ? 30000000 : 0;
+    entry->timestamp = 1700000000 + (int64_t)i * 600;
+    entry->height = 3000000 + i;
+    // Integrated-address length, so records are the size they will be
+    memset(entry->address, '4' + i % 5, 106);
+}
+
+static int bench(const char *dir, int count, int batch, int page, int reads) {
+    char path[PATH_MAX];
+    tx_history_entry_t entry;
+    uint64_t *us = calloc(reads > COLD_SAMPLES ? reads : COLD_SAMPLES, sizeof(uint64_t));
+    if (!us) {
+        return 1;
+    }
+
+    history_path(path, dir, TX_HISTORY_LOG_NAME);
+    unlink(path);
+    history_path(path, dir, TX_HISTORY_INDEX_NAME);
+    unlink(path);
+    if (tx_history_open(dir) < 0) {
+        fprintf(stderr, "tx_history_bench: cannot open a history in %s\n", dir);
+        free(us);
+        return 1;
+    }
+
+    uint64_t t0 = now_us();
+    for (int i = 0; i < count; i++) {
+        make_entry(i, &entry);
+        if (tx_history_append(&entry) < 0 || ((i + 1) % batch == 0 && tx_history_commit() < 0)) {
+            fprintf(stderr, "tx_history_bench: append failed\n");
+            free(us);
+            return 1;
+        }
+    }
+    tx_history_commit();
+    double elapsed = (double)(now_us() - t0);
+    printf("append, commit x%-4d  %8.0f tx/s  %8.1f us/commit\n", batch,
+           count / (elapsed / 1e6), elapsed / ((count + batch - 1) / batch));
+
+    tx_history_close();
+    t0 = now_us();
+    tx_history_open(dir);
+    printf("open, %u records:     %8llu us  (balance %lld)\n", tx_history_count(),
+           (unsigned long long)(now_us() - t0), (long long)tx_history_balance());
+
+    srand(1);
+    for (int i = 0; i < reads; i++) {
+        uint32_t first = (uint32_t)rand() % (uint32_t)count;
+        t0 = now_us();
+        if (read_page(first, page) < 0) {
+            fprintf(stderr, "tx_history_bench: read failed\n");
+            free(us);
+            return 1;
+        }
+        us[i] = now_us() - t0;
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "page of %d, cached:", page);
+    print_latency(what, us, reads);
+
+    for (int i = 0; i < COLD_SAMPLES; i++) {
+        tx_history_close();
+        drop_cache(dir);
+        t0 = now_us();
+        if (tx_history_open(dir) < 0 || read_page(0, page) < 0) {
+            fprintf(stderr, "tx_history_bench: cold read failed\n");
+            free(us);
+            return 1;
+        }
+        us[i] = now_us() - t0;
+    }
+    print_latency("open + page, uncached:", us, COLD_SAMPLES);
+
+    t0 = now_us();
+    int ret = tx_history_compact((uint32_t)count / 2);
+    printf("compact to %-6d      %8llu us%s\n", count / 2, (unsigned long long)(now_us() - t0),
+           ret < 0 ? " (failed)" : "");
+    tx_history_close();
+    free(us);
+    return ret < 0 ? 1 : 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: tx_history_bench DIR [-n count] [-b batch] [-p page] [-r reads]\n");
+}
+
+int main(int argc, char *argv[]) {
+    int count = 10000, batch = 1, page = 8, reads = 1000;
+
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        if (strcmp(argv[i], "-n") == 0) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            page = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            reads = atoi(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    count = count > 0 ? count : 1;
+    batch = batch < 1 ? 1 : batch > TX_HISTORY_BATCH_MAX ? TX_HISTORY_BATCH_MAX : batch;
+    page = page > 0 ? page : 1;
+    reads = reads > 0 ? reads : 1;
+    return bench(argv[1], count, batch, page, reads);
+}
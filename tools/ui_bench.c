@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <lvgl.h>
+#include "wallet_fonts.h"
+#include "epd_theme.h"
+#include "ui_list.h"
+
+// Theme render benchmark: the wallet's kinds of screen drawn under
+// LVGL's default theme and under the e-paper theme, into an off-screen
+// buffer the size of the panel. Runs on the host or the device; nothing
+// reaches the panel, so the times are LVGL's rendering alone.
+//
+// Usage:
+//   ui_bench [-n frames]
+//
+// For each theme and screen, times full redraws and focus moves with the
+// keypad. A focus move is a press and release of DOWN through a keypad
+// input device, as keypad.c reports it, timed until the theme's
+// transition animations have finished with LVGL's clock advanced one
+// refresh period at a time; it is reported with the frames and pixels
+// it redrew.
+//
+// The draw profile is fixed when LVGL is built: build it once more with
+// -DLV_DRAW_COMPLEX=1 to compare against the complex draw paths.
+
+// Panel size, as in display_fbdev.c
+#define BENCH_WIDTH 122
+#define BENCH_HEIGHT 250
+
+// Longest a focus move may animate for
+#define SETTLE_MAX_MS 1000
+
+#define LIST_ITEMS 100
+
+static lv_disp_t *disp;
+static lv_indev_t *keys;
+static bool key_pending;    // Report DOWN pressed at the next read
+static bool key_down;
+static lv_color_t pixels[BENCH_WIDTH * BENCH_HEIGHT];
+static unsigned int flushes;
+static uint64_t flushed_px;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_latency(const char *what, uint64_t *us, int n) {
+    qsort(us, n, sizeof(us[0]), cmp_u64);
+    printf("  %-8s p50 %6llu us  p99 %6llu us  max %6llu us", what,
+           (unsigned long long)us[n / 2], (unsigned long long)us[n * 99 / 100],
+           (unsigned long long)us[n - 1]);
+}
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p) {
+    (void)color_p;
+    flushes++;
+    flushed_px += (uint64_t)lv_area_get_width(area) * lv_area_get_height(area);
+    lv_disp_flush_ready(drv);
+}
+
+static lv_obj_t *label(lv_obj_t *parent, lv_align_t align, lv_coord_t y, wallet_font_id_t font,
+                       const char *text) {
+    lv_obj_t *l = lv_label_create(parent);
+    lv_obj_align(l, align, 0, y);
+    lv_label_set_text(l, text);
+    lv_obj_set_style_text_font(l, wallet_font(font), 0);
+    return l;
+}
+
+static void button(lv_obj_t *parent, lv_align_t align, lv_coord_t x, const char *text) {
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_align(btn, align, x, -20);
+    lv_obj_t *l = lv_label_create(btn);
+    lv_label_set_text(l, text);
+}
+
+// The screens below follow the layouts in wallet_ui.c
+
+static void build_main(lv_obj_t *scr) {
+    label(scr, LV_ALIGN_TOP_MID, 20, WALLET_FONT_18, "Balance: 12.345678900 XMR");
+    label(scr, LV_ALIGN_BOTTOM_MID, -20, WALLET_FONT_14, "Ready");
+}
+
+static void build_confirm(lv_obj_t *scr) {
+    label(scr, LV_ALIGN_TOP_MID, 2, WALLET_FONT_12, "2 more waiting");
+    label(scr, LV_ALIGN_TOP_MID, 20, WALLET_FONT_16, "Send: 1.250000000 XMR");
+    label(scr, LV_ALIGN_CENTER, -20, WALLET_FONT_14, "To: 44AFFq5k...RVGQBEP3A");
+    label(scr, LV_ALIGN_CENTER, 5, WALLET_FONT_14, "Fee: 0.000030000 XMR");
+    button(scr, LV_ALIGN_BOTTOM_LEFT, 20, "Confirm");
+    button(scr, LV_ALIGN_BOTTOM_RIGHT, -20, "Cancel");
+}
+
+static uint32_t list_count(void *ctx) {
+    (void)ctx;
+    return LIST_ITEMS;
+}
+
+static int list_fetch(void *ctx, uint32_t first, ui_list_item_t *items, int n) {
+    (void)ctx;
+    int i;
+    for (i = 0; i < n && first + i < LIST_ITEMS; i++) {
+        snprintf(items[i].text, sizeof(items[i].text), "Tx %u", first + i);
+        snprintf(items[i].value, sizeof(items[i].value), "+%u.%02u", first + i, (first + i) * 7 % 100);
+    }
+    return i;
+}
+
+static void build_list(lv_obj_t *scr) {
+    static ui_list_t list;
+    static const ui_list_source_t source = { .count = list_count, .fetch = list_fetch };
+    label(scr, LV_ALIGN_TOP_MID, 8, WALLET_FONT_16, "History");
+    if (ui_list_init(&list, scr, lv_group_get_default(), 32, 214, wallet_font(WALLET_FONT_14), NULL) == 0) {
+        ui_list_set_source(&list, &source);
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*build)(lv_obj_t *scr);
+} bench_screens[] = {
+    { "main", build_main },
+    { "confirm", build_confirm },
+    { "list", build_list },
+};
+
+static void keypad_read(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+    (void)drv;
+    data->key = LV_KEY_NEXT;
+    key_down = key_pending;
+    key_pending = false;
+    data->state = key_down ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+// Run LVGL a refresh period at a time until the key is released and the
+// theme's animations have run out
+static void settle(void) {
+    int ms = 0;
+    do {
+        lv_tick_inc(LV_DISP_DEF_REFR_PERIOD);
+        lv_timer_handler();
+        ms += LV_DISP_DEF_REFR_PERIOD;
+    } while ((key_pending || key_down || lv_anim_count_running() > 0) && ms < SETTLE_MAX_MS);
+}
+
+static void bench_theme(const char *name, lv_theme_t *theme, int frames, uint64_t *us) {
+    lv_obj_t *home = lv_scr_act();
+    lv_disp_set_theme(disp, theme);
+    printf("%s theme\n", name);
+
+    for (size_t s = 0; s < sizeof(bench_screens) / sizeof(bench_screens[0]); s++) {
+        lv_group_t *group = lv_group_create();
+        lv_group_set_default(group);
+        lv_indev_set_group(keys, group);
+        lv_obj_t *scr = lv_obj_create(NULL);
+        bench_screens[s].build(scr);
+        lv_scr_load(scr);
+        settle();
+        printf(" %s\n", bench_screens[s].name);
+
+        for (int i = 0; i < frames; i++) {
+            lv_obj_invalidate(scr);
+            uint64_t t0 = now_us();
+            lv_refr_now(disp);
+            us[i] = now_us() - t0;
+        }
+        print_latency("redraw", us, frames);
+        printf("\n");
+
+        if (lv_group_get_obj_count(group) > 1) {
+            flushes = 0;
+            flushed_px = 0;
+            for (int i = 0; i < frames; i++) {
+                uint64_t t0 = now_us();
+                key_pending = true;
+                settle();
+                us[i] = now_us() - t0;
+            }
+            print_latency("focus", us, frames);
+            printf("  %5.1f flushes %7.0f px\n", (double)flushes / frames, (double)flushed_px / frames);
+        }
+
+        lv_scr_load(home);
+        lv_indev_set_group(keys, NULL);
+        lv_group_set_default(NULL);
+        lv_obj_del(scr);
+        lv_group_del(group);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: ui_bench [-n frames]\n");
+}
+
+int main(int argc, char *argv[]) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_disp_drv_t drv;
+    static lv_indev_drv_t keys_drv;
+    int frames = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    frames = frames > 0 ? frames : 1;
+    uint64_t *us = calloc(frames, sizeof(uint64_t));
+    if (!us) {
+        return 1;
+    }
+
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buf, pixels, NULL, BENCH_WIDTH * BENCH_HEIGHT);
+    lv_disp_drv_init(&drv);
+    drv.hor_res = BENCH_WIDTH;
+    drv.ver_res = BENCH_HEIGHT;
+    drv.flush_cb = flush_cb;
+    drv.draw_buf = &draw_buf;
+    disp = lv_disp_drv_register(&drv);
+    if (!disp) {
+        fprintf(stderr, "ui_bench: cannot register a display\n");
+        free(us);
+        return 1;
+    }
+    lv_indev_drv_init(&keys_drv);
+    keys_drv.type = LV_INDEV_TYPE_KEYPAD;
+    keys_drv.read_cb = keypad_read;
+    keys = lv_indev_drv_register(&keys_drv);
+    wallet_fonts_init();
+    const lv_font_t *font = wallet_font(WALLET_FONT_14);
+
+    printf("LVGL %d.%d.%d, %dx%d, LV_DRAW_COMPLEX %d, %d frames\n", LVGL_VERSION_MAJOR,
+           LVGL_VERSION_MINOR, LVGL_VERSION_PATCH, BENCH_WIDTH, BENCH_HEIGHT, LV_DRAW_COMPLEX, frames);
+    bench_theme("default", lv_theme_default_init(disp, lv_palette_main(LV_PALETTE_BLUE),
+                                                 lv_palette_main(LV_PALETTE_RED), false, font),
+                frames, us);
+    bench_theme("e-paper", epd_theme_init(disp, font), frames, us);
+    free(us);
+    return 0;
+}